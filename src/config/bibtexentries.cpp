@@ -20,6 +20,7 @@
 #include "bibtexentries.h"
 
 #include <QStandardPaths>
+#include <QHash>
 
 #ifdef HAVE_KFI18N
 #include <KLocalizedString>
@@ -46,13 +47,44 @@ public:
 #ifdef HAVE_KF
     static const QVector<EntryDescription> entryDescriptionsBibLaTeX;
 #endif // HAVE_KF
+
+    /// Lower-case entry names mapped to the position of their description
+    QHash<QString, int> indexByName;
+    /// Like 'indexByName', but including alternative entry names
+    QHash<QString, int> indexByNameOrAlt;
+
+    void rebuildIndex(const BibTeXEntries *p) {
+        indexByName.clear();
+        indexByNameOrAlt.clear();
+        for (int i = 0; i < p->size(); ++i) {
+            const EntryDescription &ed = p->at(i);
+            /// Configuration file uses camel-case, index lower case names instead.
+            /// If several descriptions share a name, the first one is used
+            const QString name = ed.upperCamelCase.toLower();
+            if (!indexByName.contains(name))
+                indexByName.insert(name, i);
+            if (!indexByNameOrAlt.contains(name))
+                indexByNameOrAlt.insert(name, i);
+            const QString altName = ed.upperCamelCaseAlt.toLower();
+            if (!altName.isEmpty() && !indexByNameOrAlt.contains(altName))
+                indexByNameOrAlt.insert(altName, i);
+        }
+    }
+
+    static int lookup(const QHash<QString, int> &index, const QString &name) {
+        /// Most names are already lower case, avoid converting them
+        QHash<QString, int>::ConstIterator it = index.constFind(name);
+        if (it == index.constEnd())
+            it = index.constFind(name.toLower());
+        return it == index.constEnd() ? -1 : it.value();
+    }
 };
 
 
 BibTeXEntries::BibTeXEntries(const QVector<EntryDescription> &other)
         : QVector<EntryDescription>(other), d(new BibTeXEntriesPrivate())
 {
-    /// nothing
+    d->rebuildIndex(this);
 }
 
 BibTeXEntries::~BibTeXEntries()
@@ -126,37 +158,27 @@ const BibTeXEntries &BibTeXEntries::instance()
 
 QString BibTeXEntries::format(const QString &name, KBibTeX::Casing casing) const
 {
-    QString iName = name.toLower();
-
     switch (casing) {
-    case KBibTeX::Casing::LowerCase: return iName;
+    case KBibTeX::Casing::LowerCase: return name.toLower();
     case KBibTeX::Casing::UpperCase: return name.toUpper();
-    case KBibTeX::Casing::InitialCapital:
+    case KBibTeX::Casing::InitialCapital: {
+        QString iName = name.toLower();
         iName[0] = iName[0].toUpper();
         return iName;
+    }
     case KBibTeX::Casing::LowerCamelCase: {
-        for (const auto &ed : const_cast<const BibTeXEntries &>(*this)) {
-            /// configuration file uses camel-case
-            QString itName = ed.upperCamelCase.toLower();
-            if (itName == iName) {
-                iName = ed.upperCamelCase;
-                break;
-            }
-        }
+        /// configuration file uses camel-case
+        const int i = BibTeXEntriesPrivate::lookup(d->indexByName, name);
+        QString iName = i >= 0 ? at(i).upperCamelCase : name.toLower();
 
         /// make an educated guess how camel-case would look like
         iName[0] = iName[0].toLower();
         return iName;
     }
     case KBibTeX::Casing::UpperCamelCase: {
-        for (const auto &ed : const_cast<const BibTeXEntries &>(*this)) {
-            /// configuration file uses camel-case
-            QString itName = ed.upperCamelCase.toLower();
-            if (itName == iName) {
-                iName = ed.upperCamelCase;
-                break;
-            }
-        }
+        /// configuration file uses camel-case
+        const int i = BibTeXEntriesPrivate::lookup(d->indexByName, name);
+        QString iName = i >= 0 ? at(i).upperCamelCase : name.toLower();
 
         /// make an educated guess how camel-case would look like
         iName[0] = iName[0].toUpper();
@@ -168,13 +190,6 @@ QString BibTeXEntries::format(const QString &name, KBibTeX::Casing casing) const
 
 QString BibTeXEntries::label(const QString &name) const
 {
-    const QString iName = name.toLower();
-
-    for (const auto &ed : const_cast<const BibTeXEntries &>(*this)) {
-        /// Configuration file uses camel-case, convert this to lower case for faster comparison
-        QString itName = ed.upperCamelCase.toLower();
-        if (itName == iName || (!(itName = ed.upperCamelCaseAlt.toLower()).isEmpty() && itName == iName))
-            return ed.label;
-    }
-    return QString();
+    const int i = BibTeXEntriesPrivate::lookup(d->indexByNameOrAlt, name);
+    return i >= 0 ? at(i).label : QString();
 }
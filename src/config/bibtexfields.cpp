@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2022 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -21,6 +21,7 @@
 
 #include <QExplicitlySharedDataPointer>
 #include <QStandardPaths>
+#include <QHash>
 
 #ifdef HAVE_KF
 #include <KSharedConfig>
@@ -57,8 +58,13 @@ public:
     KSharedConfigPtr layoutConfig;
 #endif // HAVE_KF
 
+    /// Lower-case field names mapped to the position of their description,
+    /// covering only descriptions without an alternative name (i.e. no 'meta fields')
+    QHash<QString, int> indexByName;
+    int indexedSize;
+
     BibTeXFieldsPrivate(const QString &style, BibTeXFields *parent)
-            : p(parent) {
+            : p(parent), indexedSize(-1) {
 #ifdef HAVE_KF
         const QString stylefile = style + QStringLiteral(".kbstyle");
         layoutConfig = KSharedConfig::openConfig(stylefile, KConfig::FullConfig, QStandardPaths::AppDataLocation);
@@ -69,6 +75,43 @@ public:
 #endif // HAVE_KF
     }
 
+    void rebuildIndex() {
+        indexByName.clear();
+        indexedSize = p->size();
+        for (int i = 0; i < p->size(); ++i) {
+            const FieldDescription &fd = p->at(i);
+            if (!fd.upperCamelCaseAlt.isEmpty()) continue;
+            /// Configuration file uses camel-case, index lower case names instead.
+            /// If several descriptions share a name, the first one is used
+            const QString name = fd.upperCamelCase.toLower();
+            if (!indexByName.contains(name))
+                indexByName.insert(name, i);
+        }
+    }
+
+    int indexOf(const QString &name) const {
+        /// Most names are already lower case, avoid converting them
+        QHash<QString, int>::ConstIterator it = indexByName.constFind(name);
+        if (it == indexByName.constEnd())
+            it = indexByName.constFind(name.toLower());
+        if (p->size() == indexedSize) {
+            if (it == indexByName.constEnd())
+                return -1;
+            const FieldDescription &fd = p->at(it.value());
+            if (fd.upperCamelCaseAlt.isEmpty() && fd.upperCamelCase.compare(name, Qt::CaseInsensitive) == 0)
+                return it.value();
+        }
+
+        /// Index is outdated as descriptions got modified after the last rebuild,
+        /// fall back to check every description
+        for (int i = 0; i < p->size(); ++i) {
+            const FieldDescription &fd = p->at(i);
+            if (fd.upperCamelCaseAlt.isEmpty() && fd.upperCamelCase.compare(name, Qt::CaseInsensitive) == 0)
+                return i;
+        }
+        return -1;
+    }
+
 #ifdef HAVE_KF
     void load() {
         int logicalIndex = 0;
@@ -98,6 +141,8 @@ public:
                 }
             }
         }
+
+        rebuildIndex();
     }
 
     void save() {
@@ -143,6 +188,8 @@ BibTeXFields::BibTeXFields(const QString &style, const QVector<FieldDescription>
 {
 #ifdef HAVE_KF
     d->load();
+#else // HAVE_KF
+    d->rebuildIndex();
 #endif // HAVE_KF
 }
 
@@ -332,37 +379,27 @@ void BibTeXFields::resetToDefaults(const QString &treeViewName)
 
 QString BibTeXFields::format(const QString &name, KBibTeX::Casing casing) const
 {
-    QString iName = name.toLower();
-
     switch (casing) {
-    case KBibTeX::Casing::LowerCase: return iName;
+    case KBibTeX::Casing::LowerCase: return name.toLower();
     case KBibTeX::Casing::UpperCase: return name.toUpper();
-    case KBibTeX::Casing::InitialCapital:
+    case KBibTeX::Casing::InitialCapital: {
+        QString iName = name.toLower();
         iName[0] = iName[0].toUpper();
         return iName;
+    }
     case KBibTeX::Casing::LowerCamelCase: {
-        for (const auto &fd : const_cast<const BibTeXFields &>(*this)) {
-            /// configuration file uses camel-case
-            QString itName = fd.upperCamelCase.toLower();
-            if (itName == iName && fd.upperCamelCaseAlt.isEmpty()) {
-                iName = fd.upperCamelCase;
-                break;
-            }
-        }
+        /// configuration file uses camel-case
+        const int i = d->indexOf(name);
+        QString iName = i >= 0 ? at(i).upperCamelCase : name.toLower();
 
         /// make an educated guess how camel-case would look like
         iName[0] = iName[0].toLower();
         return iName;
     }
     case KBibTeX::Casing::UpperCamelCase: {
-        for (const auto &fd : const_cast<const BibTeXFields &>(*this)) {
-            /// configuration file uses camel-case
-            QString itName = fd.upperCamelCase.toLower();
-            if (itName == iName && fd.upperCamelCaseAlt.isEmpty()) {
-                iName = fd.upperCamelCase;
-                break;
-            }
-        }
+        /// configuration file uses camel-case
+        const int i = d->indexOf(name);
+        QString iName = i >= 0 ? at(i).upperCamelCase : name.toLower();
 
         /// make an educated guess how camel-case would look like
         iName[0] = iName[0].toUpper();
@@ -374,12 +411,10 @@ QString BibTeXFields::format(const QString &name, KBibTeX::Casing casing) const
 
 const FieldDescription BibTeXFields::find(const QString &name) const
 {
-    const QString iName = name.toLower();
-    for (const auto &fd : const_cast<const BibTeXFields &>(*this)) {
-        if (fd.upperCamelCase.toLower() == iName && fd.upperCamelCaseAlt.isEmpty())
-            return fd;
-    }
-    qCWarning(LOG_KBIBTEX_CONFIG) << "No field description for " << name << "(" << iName << ")";
+    const int i = d->indexOf(name);
+    if (i >= 0)
+        return at(i);
+    qCWarning(LOG_KBIBTEX_CONFIG) << "No field description for " << name;
     return FieldDescription {QString(), QString(), {}, QString(), KBibTeX::TypeFlag::Source, KBibTeX::TypeFlag::Source, {}, {}, 0, {}, false, false};
 }
 
@@ -143,8 +143,7 @@ def print_header(headerincludes, implementationincludes, enums, settings, output
         if 'availabletype' in setting:
             print("    static const " +
                   setting['availabletype'] + " available" + stem + "s;", file=outputdevice)
-        print(("    const " if needsReference(type) else "    ") + type + (" &" if needsReference(type) else " ") +
-              lowercasestart + "();", file=outputdevice)
+        print("    " + type + " " + lowercasestart + "();", file=outputdevice)
         print('#ifdef HAVE_KF', file=outputdevice)
         print('    /*!', file=outputdevice)
         print('     * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions', file=outputdevice)
@@ -215,6 +214,9 @@ def print_implementation(headerincludes, implementationincludes, enums, settings
     print('#ifdef HAVE_KF', file=outputdevice)
     print('    KSharedConfigPtr config;', file=outputdevice)
     print('    KConfigWatcher::Ptr watcher;', file=outputdevice)
+    print('    /// Guards all cached values and the configuration object, as settings', file=outputdevice)
+    print('    /// are read from worker threads as well, e.g. by exporters', file=outputdevice)
+    print('    QRecursiveMutex mutex;', file=outputdevice)
     print(file=outputdevice)
     for setting in settings:
         stem = setting['stem']
@@ -317,6 +319,7 @@ def print_implementation(headerincludes, implementationincludes, enums, settings
     print('#ifdef HAVE_KF', file=outputdevice)
     print(
         '    QObject::connect(d->watcher.data(), &KConfigWatcher::configChanged, QCoreApplication::instance(), [this](const KConfigGroup &group, const QByteArrayList &names) {', file=outputdevice)
+    print('        QMutexLocker locker(&d->mutex);', file=outputdevice)
     print('        QSet<int> eventsToPublish;', file=outputdevice)
     for setting in settings:
         stem = setting['stem']
@@ -331,6 +334,7 @@ def print_implementation(headerincludes, implementationincludes, enums, settings
             print('            eventsToPublish.insert(' +
                   setting['notificationevent'] + ');', file=outputdevice)
         print('        }', file=outputdevice)
+    print('        locker.unlock();', file=outputdevice)
     print(file=outputdevice)
     print('        for (const int eventId : eventsToPublish)', file=outputdevice)
     print('            NotificationHub::publishEvent(eventId);', file=outputdevice)
@@ -382,10 +386,10 @@ def print_implementation(headerincludes, implementationincludes, enums, settings
 
         print(file=outputdevice)
 
-        print(("const " if needsReference(type) else "") + type + (" &" if needsReference(type) else " ") +
-              "Preferences::" + lowercasestart + "()", file=outputdevice)
+        print(type + " Preferences::" + lowercasestart + "()", file=outputdevice)
         print("{", file=outputdevice)
         print('#ifdef HAVE_KF', file=outputdevice)
+        print('    QMutexLocker locker(&d->mutex);', file=outputdevice)
         print('    if (d->dirtyFlag' + stem + ') {', file=outputdevice)
         print('        d->config->reparseConfiguration();', file=outputdevice)
         print('        static const KConfigGroup configGroup(d->config, QStringLiteral("' +
@@ -435,6 +439,7 @@ def print_implementation(headerincludes, implementationincludes, enums, settings
         print("bool Preferences::set" + stem + '(const ' + type +
               (" &" if needsReference(type) else " ") + 'newValue)', file=outputdevice)
         print("{", file=outputdevice)
+        print('    QMutexLocker locker(&d->mutex);', file=outputdevice)
 
         if 'sanitizecode' in setting:
             newValueVariable = 'sanitizedNewValue'
@@ -46,6 +46,7 @@
 
 #include <QVector>
 #include <QDir>
+#include <QMutex>
 
 class Preferences::Private
 {
@@ -53,6 +54,9 @@ public:
 #ifdef HAVE_KF
     KSharedConfigPtr config;
     KConfigWatcher::Ptr watcher;
+    /// Guards all cached values and the configuration object, as settings
+    /// are read from worker threads as well, e.g. by exporters
+    QRecursiveMutex mutex;
 
     bool dirtyFlagBibliographySystem;
     Preferences::BibliographySystem cachedBibliographySystem;
@@ -307,6 +311,7 @@ Preferences::Preferences()
 {
 #ifdef HAVE_KF
     QObject::connect(d->watcher.data(), &KConfigWatcher::configChanged, QCoreApplication::instance(), [this](const KConfigGroup &group, const QByteArrayList &names) {
+        QMutexLocker locker(&d->mutex);
         std::set<int> eventsToPublish;
         if (group.name() == QStringLiteral("General") && names.contains("BibliographySystem")) {
             /// Configuration setting BibliographySystem got changed by another Preferences instance";
@@ -418,6 +423,7 @@ Preferences::Preferences()
             d->dirtyFlagColorCodes = true;
             eventsToPublish.insert(NotificationHub::EventConfigurationChanged);
         }
+        locker.unlock();
 
         for (const int eventId : eventsToPublish)
             NotificationHub::publishEvent(eventId);
@@ -436,6 +442,7 @@ const Preferences::BibliographySystem Preferences::defaultBibliographySystem = P
 Preferences::BibliographySystem Preferences::bibliographySystem()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibliographySystem) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("General"));
@@ -457,6 +464,7 @@ Preferences::BibliographySystem Preferences::bibliographySystem()
 #ifdef HAVE_KF
 bool Preferences::setBibliographySystem(const Preferences::BibliographySystem newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBibliographySystem(newValue)) return false;
     d->dirtyFlagBibliographySystem = false;
     d->cachedBibliographySystem = newValue;
@@ -473,9 +481,10 @@ const QString Preferences::personNameFormatLastFirst = QStringLiteral("<%l><, %s
 const QString Preferences::personNameFormatFirstLast = QStringLiteral("<%f ><%l>< %s>");
 const QString Preferences::defaultPersonNameFormat = Preferences::personNameFormatLastFirst;
 
-const QString &Preferences::personNameFormat()
+QString Preferences::personNameFormat()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagPersonNameFormat) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("General"));
@@ -497,6 +506,7 @@ const QString &Preferences::personNameFormat()
 #ifdef HAVE_KF
 bool Preferences::setPersonNameFormat(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForPersonNameFormat(newValue)) return false;
     d->dirtyFlagPersonNameFormat = false;
     d->cachedPersonNameFormat = newValue;
@@ -512,9 +522,10 @@ bool Preferences::setPersonNameFormat(const QString &newValue)
 const QStringList Preferences::availableCopyReferenceCommands {QStringLiteral("cite"), QStringLiteral("citealt"), QStringLiteral("citeauthor"), QStringLiteral("citeauthor*"), QStringLiteral("citeyear"), QStringLiteral("citeyearpar"), QStringLiteral("shortcite"), QStringLiteral("citet"), QStringLiteral("citet*"), QStringLiteral("citep"), QStringLiteral("citep*")};
 const QString Preferences::defaultCopyReferenceCommand = Preferences::availableCopyReferenceCommands.front();
 
-const QString &Preferences::copyReferenceCommand()
+QString Preferences::copyReferenceCommand()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagCopyReferenceCommand) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("LaTeX"));
@@ -536,6 +547,7 @@ const QString &Preferences::copyReferenceCommand()
 #ifdef HAVE_KF
 bool Preferences::setCopyReferenceCommand(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     QString sanitizedNewValue = newValue;
     const QString lowerSanitizedNewValue = sanitizedNewValue.toLower();
     for (const QString &knownCopyReferenceCommand : availableCopyReferenceCommands)
@@ -561,6 +573,7 @@ const Preferences::PageSize Preferences::defaultPageSize = Preferences::availabl
 Preferences::PageSize Preferences::pageSize()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagPageSize) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("General"));
@@ -582,6 +595,7 @@ Preferences::PageSize Preferences::pageSize()
 #ifdef HAVE_KF
 bool Preferences::setPageSize(const Preferences::PageSize newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForPageSize(newValue)) return false;
     d->dirtyFlagPageSize = false;
     d->cachedPageSize = newValue;
@@ -600,6 +614,7 @@ const Preferences::BackupScope Preferences::defaultBackupScope = Preferences::av
 Preferences::BackupScope Preferences::backupScope()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBackupScope) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("InputOutput"));
@@ -621,6 +636,7 @@ Preferences::BackupScope Preferences::backupScope()
 #ifdef HAVE_KF
 bool Preferences::setBackupScope(const Preferences::BackupScope newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBackupScope(newValue)) return false;
     d->dirtyFlagBackupScope = false;
     d->cachedBackupScope = newValue;
@@ -638,6 +654,7 @@ const int Preferences::defaultNumberOfBackups = 5;
 int Preferences::numberOfBackups()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagNumberOfBackups) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("InputOutput"));
@@ -659,6 +676,7 @@ int Preferences::numberOfBackups()
 #ifdef HAVE_KF
 bool Preferences::setNumberOfBackups(const int newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForNumberOfBackups(newValue)) return false;
     d->dirtyFlagNumberOfBackups = false;
     d->cachedNumberOfBackups = newValue;
@@ -673,9 +691,10 @@ bool Preferences::setNumberOfBackups(const int newValue)
 
 const QStringList Preferences::defaultIdSuggestionFormatStrings {QStringLiteral("A"), QStringLiteral("A2|y"), QStringLiteral("A3|y"), QStringLiteral("A4|y|\":|T5"), QStringLiteral("al|\":|T"), QStringLiteral("al|y"), QStringLiteral("al|Y"), QStringLiteral("Al\"-|\"-|y"), QStringLiteral("Al\"+|Y"), QStringLiteral("al|y|T"), QStringLiteral("al|Y|T3"), QStringLiteral("al|Y|T3l"), QStringLiteral("a|\":|Y|\":|T1"), QStringLiteral("a|y"), QStringLiteral("A|\":|Y")};
 
-const QStringList &Preferences::idSuggestionFormatStrings()
+QStringList Preferences::idSuggestionFormatStrings()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagIdSuggestionFormatStrings) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("IdSuggestions"));
@@ -697,6 +716,7 @@ const QStringList &Preferences::idSuggestionFormatStrings()
 #ifdef HAVE_KF
 bool Preferences::setIdSuggestionFormatStrings(const QStringList &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForIdSuggestionFormatStrings(newValue)) return false;
     d->dirtyFlagIdSuggestionFormatStrings = false;
     d->cachedIdSuggestionFormatStrings = newValue;
@@ -711,9 +731,10 @@ bool Preferences::setIdSuggestionFormatStrings(const QStringList &newValue)
 
 const QString Preferences::defaultActiveIdSuggestionFormatString {};
 
-const QString &Preferences::activeIdSuggestionFormatString()
+QString Preferences::activeIdSuggestionFormatString()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagActiveIdSuggestionFormatString) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("IdSuggestions"));
@@ -735,6 +756,7 @@ const QString &Preferences::activeIdSuggestionFormatString()
 #ifdef HAVE_KF
 bool Preferences::setActiveIdSuggestionFormatString(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForActiveIdSuggestionFormatString(newValue)) return false;
     d->dirtyFlagActiveIdSuggestionFormatString = false;
     d->cachedActiveIdSuggestionFormatString = newValue;
@@ -752,6 +774,7 @@ const bool Preferences::defaultLyXUseAutomaticPipeDetection = true;
 bool Preferences::lyXUseAutomaticPipeDetection()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagLyXUseAutomaticPipeDetection) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("LyX"));
@@ -773,6 +796,7 @@ bool Preferences::lyXUseAutomaticPipeDetection()
 #ifdef HAVE_KF
 bool Preferences::setLyXUseAutomaticPipeDetection(const bool newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForLyXUseAutomaticPipeDetection(newValue)) return false;
     d->dirtyFlagLyXUseAutomaticPipeDetection = false;
     d->cachedLyXUseAutomaticPipeDetection = newValue;
@@ -787,9 +811,10 @@ bool Preferences::setLyXUseAutomaticPipeDetection(const bool newValue)
 
 const QString Preferences::defaultLyXPipePath = QDir::homePath() + QStringLiteral("/.lyxpipe.in");
 
-const QString &Preferences::lyXPipePath()
+QString Preferences::lyXPipePath()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagLyXPipePath) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("LyX"));
@@ -811,6 +836,7 @@ const QString &Preferences::lyXPipePath()
 #ifdef HAVE_KF
 bool Preferences::setLyXPipePath(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     QString sanitizedNewValue = newValue;
     if (sanitizedNewValue.endsWith(QStringLiteral(".out")))
         sanitizedNewValue = sanitizedNewValue.left(sanitizedNewValue.length() - 4);
@@ -831,9 +857,10 @@ bool Preferences::setLyXPipePath(const QString &newValue)
 const QStringList Preferences::availableBibTeXEncodings {QStringLiteral("LaTeX"), QStringLiteral("ISO-8859-1"), QStringLiteral("ISO-8859-2"), QStringLiteral("ISO-8859-3"), QStringLiteral("ISO-8859-4"), QStringLiteral("ISO-8859-5"), QStringLiteral("ISO-8859-6"), QStringLiteral("ISO-8859-7"), QStringLiteral("ISO-8859-8"), QStringLiteral("ISO-8859-9"), QStringLiteral("ISO-8859-10"), QStringLiteral("ISO-8859-13"), QStringLiteral("ISO-8859-14"), QStringLiteral("ISO-8859-15"), QStringLiteral("ISO-8859-16"), QStringLiteral("UTF-8"), QStringLiteral("UTF-16"), QStringLiteral("UTF-16BE"), QStringLiteral("UTF-16LE"), QStringLiteral("UTF-32"), QStringLiteral("UTF-32BE"), QStringLiteral("UTF-32LE"), QStringLiteral("KOI8-R"), QStringLiteral("KOI8-U"), QStringLiteral("Big5"), QStringLiteral("Big5-HKSCS"), QStringLiteral("GB18030"), QStringLiteral("EUC-JP"), QStringLiteral("EUC-KR"), QStringLiteral("ISO 2022-JP"), QStringLiteral("Shift-JIS"), QStringLiteral("Windows-949"), QStringLiteral("Windows-1250"), QStringLiteral("Windows-1251"), QStringLiteral("Windows-1252"), QStringLiteral("Windows-1253"), QStringLiteral("Windows-1254"), QStringLiteral("Windows-1255"), QStringLiteral("Windows-1256"), QStringLiteral("Windows-1257"), QStringLiteral("Windows-1258")};
 const QString Preferences::defaultBibTeXEncoding = QStringLiteral("UTF-8");
 
-const QString &Preferences::bibTeXEncoding()
+QString Preferences::bibTeXEncoding()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXEncoding) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -855,6 +882,7 @@ const QString &Preferences::bibTeXEncoding()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXEncoding(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     QString sanitizedNewValue = newValue;
     const QString lowerSanitizedNewValue = sanitizedNewValue.toLower();
     for (const QString &knownBibTeXEncoding : availableBibTeXEncodings)
@@ -877,9 +905,10 @@ bool Preferences::setBibTeXEncoding(const QString &newValue)
 const QStringList Preferences::availableBibTeXStringDelimiters {QStringLiteral("{}"), QStringLiteral("\"\""), QStringLiteral("()")};
 const QString Preferences::defaultBibTeXStringDelimiter = Preferences::availableBibTeXStringDelimiters.front();
 
-const QString &Preferences::bibTeXStringDelimiter()
+QString Preferences::bibTeXStringDelimiter()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXStringDelimiter) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -901,6 +930,7 @@ const QString &Preferences::bibTeXStringDelimiter()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXStringDelimiter(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     QString sanitizedNewValue = newValue;
     const QString lowerSanitizedNewValue = sanitizedNewValue.toLower();
     for (const QString &knownBibTeXStringDelimiter : availableBibTeXStringDelimiters)
@@ -926,6 +956,7 @@ const Preferences::CommentContext Preferences::defaultBibTeXCommentContext = Pre
 Preferences::CommentContext Preferences::bibTeXCommentContext()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXCommentContext) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -947,6 +978,7 @@ Preferences::CommentContext Preferences::bibTeXCommentContext()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXCommentContext(const Preferences::CommentContext newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBibTeXCommentContext(newValue)) return false;
     d->dirtyFlagBibTeXCommentContext = false;
     d->cachedBibTeXCommentContext = newValue;
@@ -961,9 +993,10 @@ bool Preferences::setBibTeXCommentContext(const Preferences::CommentContext newV
 
 const QString Preferences::defaultBibTeXCommentPrefix = QString();
 
-const QString &Preferences::bibTeXCommentPrefix()
+QString Preferences::bibTeXCommentPrefix()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXCommentPrefix) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -985,6 +1018,7 @@ const QString &Preferences::bibTeXCommentPrefix()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXCommentPrefix(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBibTeXCommentPrefix(newValue)) return false;
     d->dirtyFlagBibTeXCommentPrefix = false;
     d->cachedBibTeXCommentPrefix = newValue;
@@ -1003,6 +1037,7 @@ const KBibTeX::Casing Preferences::defaultBibTeXKeywordCasing = Preferences::ava
 KBibTeX::Casing Preferences::bibTeXKeywordCasing()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXKeywordCasing) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -1024,6 +1059,7 @@ KBibTeX::Casing Preferences::bibTeXKeywordCasing()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXKeywordCasing(const KBibTeX::Casing newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBibTeXKeywordCasing(newValue)) return false;
     d->dirtyFlagBibTeXKeywordCasing = false;
     d->cachedBibTeXKeywordCasing = newValue;
@@ -1041,6 +1077,7 @@ const bool Preferences::defaultBibTeXProtectCasing = true;
 bool Preferences::bibTeXProtectCasing()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXProtectCasing) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -1062,6 +1099,7 @@ bool Preferences::bibTeXProtectCasing()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXProtectCasing(const bool newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBibTeXProtectCasing(newValue)) return false;
     d->dirtyFlagBibTeXProtectCasing = false;
     d->cachedBibTeXProtectCasing = newValue;
@@ -1077,9 +1115,10 @@ bool Preferences::setBibTeXProtectCasing(const bool newValue)
 const QStringList Preferences::availableBibTeXListSeparators {QStringLiteral("; "), QStringLiteral(", ")};
 const QString Preferences::defaultBibTeXListSeparator = Preferences::availableBibTeXListSeparators.front();
 
-const QString &Preferences::bibTeXListSeparator()
+QString Preferences::bibTeXListSeparator()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXListSeparator) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -1101,6 +1140,7 @@ const QString &Preferences::bibTeXListSeparator()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXListSeparator(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     QString sanitizedNewValue = newValue;
     const QString lowerSanitizedNewValue = sanitizedNewValue.toLower();
     for (const QString &knownBibTeXListSeparator : availableBibTeXListSeparators)
@@ -1125,6 +1165,7 @@ const bool Preferences::defaultbibTeXEntriesSortedByIdentifier = false;
 bool Preferences::bibTeXEntriesSortedByIdentifier()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagbibTeXEntriesSortedByIdentifier) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterBibTeX"));
@@ -1146,6 +1187,7 @@ bool Preferences::bibTeXEntriesSortedByIdentifier()
 #ifdef HAVE_KF
 bool Preferences::setbibTeXEntriesSortedByIdentifier(const bool newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForbibTeXEntriesSortedByIdentifier(newValue)) return false;
     d->dirtyFlagbibTeXEntriesSortedByIdentifier = false;
     d->cachedbibTeXEntriesSortedByIdentifier = newValue;
@@ -1160,9 +1202,10 @@ bool Preferences::setbibTeXEntriesSortedByIdentifier(const bool newValue)
 
 const QString Preferences::defaultLaTeXBabelLanguage = QStringLiteral("english");
 
-const QString &Preferences::laTeXBabelLanguage()
+QString Preferences::laTeXBabelLanguage()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagLaTeXBabelLanguage) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterLaTeXbased"));
@@ -1184,6 +1227,7 @@ const QString &Preferences::laTeXBabelLanguage()
 #ifdef HAVE_KF
 bool Preferences::setLaTeXBabelLanguage(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForLaTeXBabelLanguage(newValue)) return false;
     d->dirtyFlagLaTeXBabelLanguage = false;
     d->cachedLaTeXBabelLanguage = newValue;
@@ -1198,9 +1242,10 @@ bool Preferences::setLaTeXBabelLanguage(const QString &newValue)
 
 const QString Preferences::defaultBibTeXBibliographyStyle = QStringLiteral("plain");
 
-const QString &Preferences::bibTeXBibliographyStyle()
+QString Preferences::bibTeXBibliographyStyle()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagBibTeXBibliographyStyle) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("FileExporterLaTeXbased"));
@@ -1222,6 +1267,7 @@ const QString &Preferences::bibTeXBibliographyStyle()
 #ifdef HAVE_KF
 bool Preferences::setBibTeXBibliographyStyle(const QString &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForBibTeXBibliographyStyle(newValue)) return false;
     d->dirtyFlagBibTeXBibliographyStyle = false;
     d->cachedBibTeXBibliographyStyle = newValue;
@@ -1240,6 +1286,7 @@ const Preferences::FileViewDoubleClickAction Preferences::defaultFileViewDoubleC
 Preferences::FileViewDoubleClickAction Preferences::fileViewDoubleClickAction()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagFileViewDoubleClickAction) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("User Interface"));
@@ -1261,6 +1308,7 @@ Preferences::FileViewDoubleClickAction Preferences::fileViewDoubleClickAction()
 #ifdef HAVE_KF
 bool Preferences::setFileViewDoubleClickAction(const Preferences::FileViewDoubleClickAction newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForFileViewDoubleClickAction(newValue)) return false;
     d->dirtyFlagFileViewDoubleClickAction = false;
     d->cachedFileViewDoubleClickAction = newValue;
@@ -1275,9 +1323,10 @@ bool Preferences::setFileViewDoubleClickAction(const Preferences::FileViewDouble
 
 const QVector<QPair<QString, QString>> Preferences::defaultColorCodes {{QStringLiteral("#c30"), i18nc("Color Labels", "Important")}, {QStringLiteral("#03f"), i18nc("Color Labels", "Unread")}, {QStringLiteral("#096"), i18nc("Color Labels", "Read")}, {QStringLiteral("#fd0"), i18nc("Color Labels", "Watch")}};
 
-const QVector<QPair<QString, QString>> &Preferences::colorCodes()
+QVector<QPair<QString, QString>> Preferences::colorCodes()
 {
 #ifdef HAVE_KF
+    QMutexLocker locker(&d->mutex);
     if (d->dirtyFlagColorCodes) {
         d->config->reparseConfiguration();
         static const KConfigGroup configGroup(d->config, QStringLiteral("Color Labels"));
@@ -1299,6 +1348,7 @@ const QVector<QPair<QString, QString>> &Preferences::colorCodes()
 #ifdef HAVE_KF
 bool Preferences::setColorCodes(const QVector<QPair<QString, QString>> &newValue)
 {
+    QMutexLocker locker(&d->mutex);
     if (!d->validateValueForColorCodes(newValue)) return false;
     d->dirtyFlagColorCodes = false;
     d->cachedColorCodes = newValue;
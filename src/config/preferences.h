@@ -62,7 +62,7 @@ public:
     static const QString personNameFormatLastFirst;
     static const QString personNameFormatFirstLast;
     static const QString defaultPersonNameFormat;
-    const QString &personNameFormat();
+    QString personNameFormat();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -75,7 +75,7 @@ public:
 
     static const QString defaultCopyReferenceCommand;
     static const QStringList availableCopyReferenceCommands;
-    const QString &copyReferenceCommand();
+    QString copyReferenceCommand();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -125,7 +125,7 @@ public:
     /// *** IdSuggestionFormatStrings of type QStringList ***
 
     static const QStringList defaultIdSuggestionFormatStrings;
-    const QStringList &idSuggestionFormatStrings();
+    QStringList idSuggestionFormatStrings();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -137,7 +137,7 @@ public:
     /// *** ActiveIdSuggestionFormatString of type QString ***
 
     static const QString defaultActiveIdSuggestionFormatString;
-    const QString &activeIdSuggestionFormatString();
+    QString activeIdSuggestionFormatString();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -161,7 +161,7 @@ public:
     /// *** LyXPipePath of type QString ***
 
     static const QString defaultLyXPipePath;
-    const QString &lyXPipePath();
+    QString lyXPipePath();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -174,7 +174,7 @@ public:
 
     static const QString defaultBibTeXEncoding;
     static const QStringList availableBibTeXEncodings;
-    const QString &bibTeXEncoding();
+    QString bibTeXEncoding();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -187,7 +187,7 @@ public:
 
     static const QString defaultBibTeXStringDelimiter;
     static const QStringList availableBibTeXStringDelimiters;
-    const QString &bibTeXStringDelimiter();
+    QString bibTeXStringDelimiter();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -212,7 +212,7 @@ public:
     /// *** BibTeXCommentPrefix of type QString ***
 
     static const QString defaultBibTeXCommentPrefix;
-    const QString &bibTeXCommentPrefix();
+    QString bibTeXCommentPrefix();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -250,7 +250,7 @@ public:
 
     static const QString defaultBibTeXListSeparator;
     static const QStringList availableBibTeXListSeparators;
-    const QString &bibTeXListSeparator();
+    QString bibTeXListSeparator();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -274,7 +274,7 @@ public:
     /// *** LaTeXBabelLanguage of type QString ***
 
     static const QString defaultLaTeXBabelLanguage;
-    const QString &laTeXBabelLanguage();
+    QString laTeXBabelLanguage();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -286,7 +286,7 @@ public:
     /// *** BibTeXBibliographyStyle of type QString ***
 
     static const QString defaultBibTeXBibliographyStyle;
-    const QString &bibTeXBibliographyStyle();
+    QString bibTeXBibliographyStyle();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
@@ -311,7 +311,7 @@ public:
     /// *** ColorCodes of type QVector<QPair<QString, QString>> ***
 
     static const QVector<QPair<QString, QString>> defaultColorCodes;
-    const QVector<QPair<QString, QString>> &colorCodes();
+    QVector<QPair<QString, QString>> colorCodes();
 #ifdef HAVE_KF
     /*!
      * @return true if this setting has been changed, i.e. the new value was different from the old value; false otherwise or under error conditions
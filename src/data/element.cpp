@@ -18,6 +18,7 @@
  ***************************************************************************/
 
 #include <QDebug>
+#include <QAtomicInt>
 
 #include "element.h"
 #include "macro.h"
@@ -27,8 +28,9 @@
 
 Element::Element()
 {
-    static int idCounter = 0;
-    uniqueId = ++idCounter;
+    /// Atomic counter as elements may be created on worker threads
+    static QAtomicInt idCounter;
+    uniqueId = idCounter.fetchAndAddRelaxed(1) + 1;
 }
 
 bool Element::operator<(const Element &other) const
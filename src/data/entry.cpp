@@ -73,7 +73,7 @@ const QString Entry::etMastersThesis = QStringLiteral("mastersthesis");
 const QString Entry::etTechReport = QStringLiteral("techreport");
 const QString Entry::etUnpublished = QStringLiteral("unpublished");
 
-quint64 Entry::internalUniqueIdCounter = 0;
+QAtomicInteger<quint64> Entry::internalUniqueIdCounter = 0;
 
 /**
  * Private class to store internal variables that should not be visible
@@ -87,14 +87,14 @@ public:
 };
 
 Entry::Entry(const QString &type, const QString &id)
-        : Element(), QMap<QString, Value>(), internalUniqueId(++internalUniqueIdCounter), d(new Entry::EntryPrivate)
+        : Element(), QMap<QString, Value>(), internalUniqueId(internalUniqueIdCounter.fetchAndAddRelaxed(1) + 1), d(new Entry::EntryPrivate)
 {
     d->type = type;
     d->id = id;
 }
 
 Entry::Entry(const Entry &other)
-        : Element(), QMap<QString, Value>(), internalUniqueId(++internalUniqueIdCounter), d(new Entry::EntryPrivate)
+        : Element(), QMap<QString, Value>(), internalUniqueId(internalUniqueIdCounter.fetchAndAddRelaxed(1) + 1), d(new Entry::EntryPrivate)
 {
     operator=(other);
 }
@@ -21,6 +21,7 @@
 #define KBIBTEX_DATA_ENTRY_H
 
 #include <QMap>
+#include <QAtomicInteger>
 
 #include <Element>
 #include <Value>
@@ -230,8 +231,9 @@ public:
 private:
     /// Unique numeric identifier
     const quint64 internalUniqueId;
-    /// Keeping track of next available unique numeric identifier
-    static quint64 internalUniqueIdCounter;
+    /// Keeping track of next available unique numeric identifier,
+    /// atomic as entries may get created in several threads concurrently
+    static QAtomicInteger<quint64> internalUniqueIdCounter;
 
     class EntryPrivate;
     EntryPrivate *const d;
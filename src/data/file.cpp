@@ -23,6 +23,7 @@
 #include <QTextStream>
 #include <QIODevice>
 #include <QStringList>
+#include <QAtomicInteger>
 
 #include <Preferences>
 #include "entry.h"
@@ -51,14 +52,15 @@ class File::FilePrivate
 private:
     quint64 validInvalidField;
     static const quint64 initialInternalIdCounter;
-    static quint64 internalIdCounter;
+    /// Atomic as files may get created in several threads concurrently
+    static QAtomicInteger<quint64> internalIdCounter;
 
 public:
     const quint64 internalId;
     QHash<QString, QVariant> properties;
 
     explicit FilePrivate(File *parent)
-            : validInvalidField(valid), internalId(++internalIdCounter)
+            : validInvalidField(valid), internalId(internalIdCounter.fetchAndAddRelaxed(1) + 1)
     {
         Q_UNUSED(parent)
         const bool isValid = checkValidity();
@@ -126,7 +128,7 @@ public:
 };
 
 const quint64 File::FilePrivate::initialInternalIdCounter = 99999;
-quint64 File::FilePrivate::internalIdCounter = File::FilePrivate::initialInternalIdCounter;
+QAtomicInteger<quint64> File::FilePrivate::internalIdCounter = File::FilePrivate::initialInternalIdCounter;
 
 File::File()
         : QList<QSharedPointer<Element> >(), d(new FilePrivate(this))
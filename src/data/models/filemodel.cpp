@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -23,6 +23,7 @@
 
 #include <QColor>
 #include <QFile>
+#include <QPair>
 #include <QString>
 
 #ifdef HAVE_KFI18N
@@ -43,10 +44,11 @@
 
 const int FileModel::NumberRole = Qt::UserRole + 9581;
 const int FileModel::SortRole = Qt::UserRole + 236; /// see also MDIWidget's SortRole
+const int FileModel::renderCacheMaxRows = 8192;
 
 
 FileModel::FileModel(QObject *parent)
-        : QAbstractTableModel(parent), m_file(nullptr)
+        : QAbstractTableModel(parent), m_file(nullptr), m_rowIndexValid(false), m_rowIndexFileCount(0), m_renderCache(renderCacheMaxRows)
 {
     NotificationHub::registerNotificationListener(this);
     readConfiguration();
@@ -56,6 +58,8 @@ void FileModel::notificationEvent(int eventId)
 {
     if (eventId == NotificationHub::EventConfigurationChanged) {
         readConfiguration();
+        /// Rendering of names, colors, etc. may have changed
+        m_renderCache.clear();
         int column = 0;
         for (const auto &fd : const_cast<const BibTeXFields &>(BibTeXFields::instance())) {
             /// Colors may have changed
@@ -70,6 +74,7 @@ void FileModel::notificationEvent(int eventId)
         }
     } else if (eventId == NotificationHub::EventBibliographySystemChanged) {
         beginResetModel();
+        m_renderCache.clear();
         endResetModel();
         Q_EMIT bibliographySystemChanged();
     }
@@ -78,7 +83,8 @@ void FileModel::notificationEvent(int eventId)
 void FileModel::readConfiguration()
 {
     colorToLabel.clear();
-    for (QVector<QPair<QString, QString>>::ConstIterator it = Preferences::instance().colorCodes().constBegin(); it != Preferences::instance().colorCodes().constEnd(); ++it)
+    const QVector<QPair<QString, QString>> colorCodes = Preferences::instance().colorCodes();
+    for (QVector<QPair<QString, QString>>::ConstIterator it = colorCodes.constBegin(); it != colorCodes.constEnd(); ++it)
         colorToLabel.insert(it->first, it->second);
 }
 
@@ -154,6 +160,8 @@ void FileModel::setBibliographyFile(File *file)
     if (resetNecessary) {
         beginResetModel();
         m_file = file;
+        invalidateRowIndex();
+        m_renderCache.clear();
         endResetModel();
     }
 }
@@ -181,6 +189,10 @@ int FileModel::columnCount(const QModelIndex &parent) const
 
 QVariant FileModel::data(const QModelIndex &index, int role) const
 {
+    /// Not traced, as views call this function for every visible cell and
+    /// role on each repaint; a trace scope here would contend for the
+    /// tracing lock and quickly fill the trace. Sorting and filtering,
+    /// where most calls originate from, are traced in SortFilterFileModel
     /// do not accept invalid indices
     if (!index.isValid())
         return QVariant();
@@ -194,98 +206,122 @@ QVariant FileModel::data(const QModelIndex &index, int role) const
         return QVariant();
 
     if (index.row() < m_file->count() && index.column() < BibTeXFields::instance().count()) {
-        const FieldDescription &fd = BibTeXFields::instance().at(index.column());
-        const QString &raw = fd.upperCamelCase;
-        const QString &rawAlt = fd.upperCamelCaseAlt;
-        const QStringList &rawAliases = fd.upperCamelCaseAliases;
-        QSharedPointer<Element> element = (*m_file)[index.row()];
-        QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+        const QSharedPointer<Element> &element = m_file->at(index.row());
+        RenderCacheRow *cacheRow = m_renderCache.object(element.data());
+        if (cacheRow == nullptr) {
+            cacheRow = new RenderCacheRow();
+            cacheRow->entry = element.dynamicCast<Entry>();
+            cacheRow->colorResolved = cacheRow->hasColor = false;
+            cacheRow->rgba = 0;
+            cacheRow->followsCrossRef = !cacheRow->entry.isNull() && cacheRow->entry->contains(Entry::ftCrossRef);
+            m_renderCache.insert(element.data(), cacheRow);
+        }
 
         /// if BibTeX entry has a "x-color" field, use that color to highlight row
-        if (role == Qt::BackgroundRole) {
-            /// Retrieve "color"
-            QString colorName;
-            if (entry.isNull() || (colorName = PlainTextValue::text(entry->value(Entry::ftColor))) == QStringLiteral("#000000") || colorName.isEmpty())
+        if (role == Qt::BackgroundRole || role == Qt::ForegroundRole) {
+            if (!cacheRow->colorResolved) {
+                /// Retrieve "color" only once per element, not for every column and role
+                QString colorName;
+                if (!cacheRow->entry.isNull() && (colorName = PlainTextValue::text(cacheRow->entry->value(Entry::ftColor))) != QStringLiteral("#000000") && !colorName.isEmpty()) {
+                    const QColor color(colorName);
+                    cacheRow->rgba = color.rgba();
+                    cacheRow->hasColor = color.isValid();
+                }
+                cacheRow->colorResolved = true;
+            }
+            if (!cacheRow->hasColor)
                 return QVariant();
-            else {
+
+            if (role == Qt::BackgroundRole) {
                 /// There is a valid color, set it as background
-                QColor color(colorName);
+                QColor color = QColor::fromRgba(cacheRow->rgba);
                 /// Use slightly different colors for even and odd rows
                 color.setAlphaF(index.row() % 2 == 0 ? 0.75 : 1.0);
                 return QVariant(color);
-            }
-        } else if (role == Qt::ForegroundRole) {
-            /// Retrieve "color"
-            QString colorName;
-            if (entry.isNull() || (colorName = PlainTextValue::text(entry->value(Entry::ftColor))) == QStringLiteral("#000000") || colorName.isEmpty())
-                return QVariant();
-            else {
-                /// There is a valid color ...
-                const QColor color(colorName);
+            } else {
                 /// Retrieve red, green, blue, and alpha components
                 int r = 0, g = 0, b = 0, a = 0;
-                color.getRgb(&r, &g, &b, &a);
+                QColor::fromRgba(cacheRow->rgba).getRgb(&r, &g, &b, &a);
                 /// If gray value is rather dark, return white as foreground color
                 if (qGray(r, g, b) < 128) return QColor(Qt::white);
                 /// For light gray values, return black as foreground color
                 else return QColor(Qt::black);
             }
-        } else if (role == NumberRole) {
-            if (!entry.isNull() && raw.toLower() == Entry::ftStarRating) {
-                const QString text = PlainTextValue::text(entry->value(raw)).simplified();
-                bool ok = false;
-                const double numValue = text.toDouble(&ok);
-                if (ok)
-                    return QVariant::fromValue<double>(numValue);
-                else
-                    return QVariant();
-            } else
-                return QVariant();
         }
 
-        /// The only roles left at this point shall be SortRole, Qt::DisplayRole, and Qt::ToolTipRole
+        /// Remaining roles are cached per column
+        const int cellKey = index.column() * 4 + (role == NumberRole ? 0 : role == SortRole ? 1 : role == Qt::ToolTipRole ? 2 : 3);
+        const auto it = cacheRow->cells.constFind(cellKey);
+        if (it != cacheRow->cells.constEnd())
+            return it.value();
+        const QVariant result = renderCell(element, cacheRow->entry, index.column(), role);
+        cacheRow->cells.insert(cellKey, result);
+        return result;
+    } else
+        return QVariant(QStringLiteral("?"));
+}
+
+QVariant FileModel::renderCell(const QSharedPointer<Element> &element, const QSharedPointer<Entry> &entry, int column, int role) const
+{
+    const FieldDescription &fd = BibTeXFields::instance().at(column);
+    const QString &raw = fd.upperCamelCase;
+    const QString &rawAlt = fd.upperCamelCaseAlt;
+    const QStringList &rawAliases = fd.upperCamelCaseAliases;
+
+    if (role == NumberRole) {
+        if (!entry.isNull() && raw.toLower() == Entry::ftStarRating) {
+            const QString text = PlainTextValue::text(entry->value(raw)).simplified();
+            bool ok = false;
+            const double numValue = text.toDouble(&ok);
+            if (ok)
+                return QVariant::fromValue<double>(numValue);
+            else
+                return QVariant();
+        } else
+            return QVariant();
+    }
+
+    /// The only roles left at this point shall be SortRole, Qt::DisplayRole, and Qt::ToolTipRole
 
-        if (!entry.isNull()) {
-            return QVariant(entryText(entry.data(), raw, rawAlt, rawAliases, role, true));
+    if (!entry.isNull()) {
+        return QVariant(entryText(entry.data(), raw, rawAlt, rawAliases, role, true));
+    } else {
+        QSharedPointer<Macro> macro = element.dynamicCast<Macro>();
+        if (!macro.isNull()) {
+            if (raw == QStringLiteral("^id"))
+                return QVariant(macro->key());
+            else if (raw == QStringLiteral("^type"))
+                return QVariant(i18n("Macro"));
+            else if (raw == QStringLiteral("Title")) {
+                const QString text = PlainTextValue::text(macro->value()).simplified();
+                return QVariant(text);
+            } else
+                return QVariant();
         } else {
-            QSharedPointer<Macro> macro = element.dynamicCast<Macro>();
-            if (!macro.isNull()) {
-                if (raw == QStringLiteral("^id"))
-                    return QVariant(macro->key());
-                else if (raw == QStringLiteral("^type"))
-                    return QVariant(i18n("Macro"));
-                else if (raw == QStringLiteral("Title")) {
-                    const QString text = PlainTextValue::text(macro->value()).simplified();
+            QSharedPointer<Comment> comment = element.dynamicCast<Comment>();
+            if (!comment.isNull()) {
+                if (raw == QStringLiteral("^type"))
+                    return QVariant(i18n("Comment"));
+                else if (raw == Entry::ftTitle) {
+                    const QString text = comment->text().simplified();
                     return QVariant(text);
                 } else
                     return QVariant();
             } else {
-                QSharedPointer<Comment> comment = element.dynamicCast<Comment>();
-                if (!comment.isNull()) {
+                QSharedPointer<Preamble> preamble = element.dynamicCast<Preamble>();
+                if (!preamble.isNull()) {
                     if (raw == QStringLiteral("^type"))
-                        return QVariant(i18n("Comment"));
+                        return QVariant(i18n("Preamble"));
                     else if (raw == Entry::ftTitle) {
-                        const QString text = comment->text().simplified();
+                        const QString text = PlainTextValue::text(preamble->value()).simplified();
                         return QVariant(text);
                     } else
                         return QVariant();
-                } else {
-                    QSharedPointer<Preamble> preamble = element.dynamicCast<Preamble>();
-                    if (!preamble.isNull()) {
-                        if (raw == QStringLiteral("^type"))
-                            return QVariant(i18n("Preamble"));
-                        else if (raw == Entry::ftTitle) {
-                            const QString text = PlainTextValue::text(preamble->value()).simplified();
-                            return QVariant(text);
-                        } else
-                            return QVariant();
-                    } else
-                        return QVariant(QStringLiteral("?"));
-                }
+                } else
+                    return QVariant(QStringLiteral("?"));
             }
         }
-    } else
-        return QVariant(QStringLiteral("?"));
+    }
 }
 
 QVariant FileModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -304,6 +340,8 @@ Qt::ItemFlags FileModel::flags(const QModelIndex &index) const
 void FileModel::clear() {
     beginResetModel();
     m_file->clear();
+    invalidateRowIndex();
+    m_renderCache.clear();
     endResetModel();
 }
 
@@ -315,7 +353,10 @@ bool FileModel::removeRow(int row, const QModelIndex &parent)
         return false;
 
     beginRemoveRows(QModelIndex(), row, row);
+    /// Removed element's address may get reused by a new element
+    m_renderCache.remove(m_file->at(row).data());
     m_file->removeAt(row);
+    invalidateRowIndex();
     endRemoveRows();
 
     return true;
@@ -327,71 +368,155 @@ bool FileModel::removeRowList(const QList<int> &rows)
 
     QList<int> internalRows = rows;
     std::sort(internalRows.begin(), internalRows.end(), std::greater<int>());
+    internalRows.erase(std::unique(internalRows.begin(), internalRows.end()), internalRows.end());
+    if (internalRows.isEmpty()) return true;
+    /// Validate all rows before removing anything
+    if (internalRows.last() < 0 || internalRows.first() >= rowCount() || internalRows.first() >= m_file->count())
+        return false;
 
-    beginRemoveRows(QModelIndex(), internalRows.last(), internalRows.first());
+    /// Group rows into ranges of adjacent rows, starting from the bottom
+    /// so that removing a range does not shift the rows of later ranges
+    QVector<QPair<int, int>> ranges; ///< pairs of first and last row
     for (int row : const_cast<const QList<int> &>(internalRows)) {
-        if (row < 0 || row >= rowCount() || row >= m_file->count())
-            return false;
-        m_file->removeAt(row);
+        if (!ranges.isEmpty() && ranges.last().first == row + 1)
+            ranges.last().first = row;
+        else
+            ranges.append(qMakePair(row, row));
+    }
+
+    /// Removed elements' addresses may get reused by new elements
+    for (int row : const_cast<const QList<int> &>(internalRows))
+        m_renderCache.remove(m_file->at(row).data());
+
+    /// Signalling many small ranges is more expensive for views than a reset
+    static const int maxRangesBeforeReset = 32;
+    if (ranges.count() > maxRangesBeforeReset) {
+        beginResetModel();
+        QVector<bool> removeFlags(m_file->count(), false);
+        for (int row : const_cast<const QList<int> &>(internalRows))
+            removeFlags[row] = true;
+        /// Compact remaining elements in a single pass
+        int target = 0;
+        for (int i = 0; i < removeFlags.count(); ++i)
+            if (!removeFlags[i]) {
+                if (target != i)
+                    (*m_file)[target] = m_file->at(i);
+                ++target;
+            }
+        m_file->erase(m_file->begin() + target, m_file->end());
+        invalidateRowIndex();
+        endResetModel();
+    } else {
+        for (const auto &range : const_cast<const QVector<QPair<int, int>> &>(ranges)) {
+            beginRemoveRows(QModelIndex(), range.first, range.second);
+            m_file->erase(m_file->begin() + range.first, m_file->begin() + range.second + 1);
+            invalidateRowIndex();
+            endRemoveRows();
+        }
     }
-    endRemoveRows();
 
     return true;
 }
 
 bool FileModel::insertRow(QSharedPointer<Element> element, int row, const QModelIndex &parent)
 {
-    if (m_file == nullptr || row < 0 || row > rowCount() || parent != QModelIndex())
+    if (parent != QModelIndex())
         return false;
+    return insertRowList(QVector<QSharedPointer<Element>>() << element, row);
+}
+
+bool FileModel::insertRowList(const QVector<QSharedPointer<Element>> &elements, int row)
+{
+    if (m_file == nullptr || row < 0 || row > rowCount())
+        return false;
+    if (elements.isEmpty())
+        return true;
+
+    /// Check for duplicate ids or keys when inserting new elements,
+    /// considering both existing elements and elements inserted before
+    const QStringList allKeys = m_file->allKeys();
+#if QT_VERSION >= 0x050e00
+    QSet<QString> usedKeys(allKeys.constBegin(), allKeys.constEnd());
+#else // QT_VERSION < 0x050e00
+    QSet<QString> usedKeys = allKeys.toSet();
+#endif // QT_VERSION >= 0x050e00
+    for (const QSharedPointer<Element> &element : elements)
+        makeKeyUnique(element, usedKeys);
+
+    const bool appending = row == m_file->count();
+    beginInsertRows(QModelIndex(), row, row + elements.count() - 1);
+    if (appending) {
+        m_file->reserve(m_file->count() + elements.count());
+        for (const QSharedPointer<Element> &element : elements) {
+            /// Appending does not move any existing rows, so the row index can be extended
+            if (m_rowIndexValid && !m_rowIndex.contains(element.data()))
+                m_rowIndex.insert(element.data(), m_file->count());
+            m_file->append(element);
+        }
+        if (m_rowIndexValid)
+            m_rowIndexFileCount = m_file->count();
+    } else {
+        /// Move the tail only once instead of once per inserted element
+        const QList<QSharedPointer<Element>> tail = m_file->mid(row);
+        m_file->erase(m_file->begin() + row, m_file->end());
+        for (const QSharedPointer<Element> &element : elements)
+            m_file->append(element);
+        m_file->append(tail);
+        invalidateRowIndex();
+    }
+    endInsertRows();
+
+    return true;
+}
+
+void FileModel::makeKeyUnique(const QSharedPointer<Element> &element, QSet<QString> &usedKeys)
+{
+    static const QString pattern = QStringLiteral("%1_%2");
 
-    /// Check for duplicate ids or keys when inserting a new element
     /// First, check entries
     QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
     if (!entry.isNull()) {
         /// Fetch current entry's id
         const QString id = entry->id();
-        if (!m_file->containsKey(id).isNull()) {
+        if (usedKeys.contains(id)) {
             /// Same entry id used for an existing entry or macro
             int overflow = 2;
-            static const QString pattern = QStringLiteral("%1_%2");
             /// Test alternative ids with increasing "overflow" counter:
             /// id_2, id_3, id_4 ,...
             QString newId = pattern.arg(id).arg(overflow);
-            while (!m_file->containsKey(newId).isNull()) {
+            while (usedKeys.contains(newId)) {
                 ++overflow;
                 newId = pattern.arg(id).arg(overflow);
             }
             /// Guaranteed to find an alternative, apply it to entry
             entry->setId(newId);
-        }
-    } else {
-        /// Next, check macros
-        QSharedPointer<Macro> macro = element.dynamicCast<Macro>();
-        if (!macro.isNull()) {
-            /// Fetch current macro's key
-            const QString key = macro->key();
-            if (!m_file->containsKey(key).isNull()) {
-                /// Same entry key used for an existing entry or macro
-                int overflow = 2;
-                static const QString pattern = QStringLiteral("%1_%2");
-                /// Test alternative keys with increasing "overflow" counter:
-                /// key_2, key_3, key_4 ,...
-                QString newKey = pattern.arg(key).arg(overflow);
-                while (!m_file->containsKey(newKey).isNull()) {
-                    ++overflow;
-                    newKey = pattern.arg(key).arg(overflow);
-                }
-                /// Guaranteed to find an alternative, apply it to macro
-                macro->setKey(newKey);
-            }
-        }
+            usedKeys.insert(newId);
+        } else
+            usedKeys.insert(id);
+        return;
     }
 
-    beginInsertRows(QModelIndex(), row, row);
-    m_file->insert(row, element);
-    endInsertRows();
-
-    return true;
+    /// Next, check macros
+    QSharedPointer<Macro> macro = element.dynamicCast<Macro>();
+    if (!macro.isNull()) {
+        /// Fetch current macro's key
+        const QString key = macro->key();
+        if (usedKeys.contains(key)) {
+            /// Same entry key used for an existing entry or macro
+            int overflow = 2;
+            /// Test alternative keys with increasing "overflow" counter:
+            /// key_2, key_3, key_4 ,...
+            QString newKey = pattern.arg(key).arg(overflow);
+            while (usedKeys.contains(newKey)) {
+                ++overflow;
+                newKey = pattern.arg(key).arg(overflow);
+            }
+            /// Guaranteed to find an alternative, apply it to macro
+            macro->setKey(newKey);
+            usedKeys.insert(newKey);
+        } else
+            usedKeys.insert(key);
+    }
 }
 
 QSharedPointer<Element> FileModel::element(int row) const
@@ -403,10 +528,61 @@ QSharedPointer<Element> FileModel::element(int row) const
 
 int FileModel::row(QSharedPointer<Element> element) const
 {
-    if (m_file == nullptr) return -1;
-    return m_file->indexOf(element);
+    if (m_file == nullptr || element.isNull()) return -1;
+
+    if (m_rowIndexValid) {
+        const int row = m_rowIndex.value(element.data(), -1);
+        /// The bibliography file may have been modified bypassing this model,
+        /// so verify the indexed row before trusting it
+        if (row >= 0 && row < m_file->count() && m_file->at(row) == element)
+            return row;
+        /// Elements not in the index are not in the file unless the file
+        /// has been modified since the index was built
+        if (row < 0 && m_rowIndexFileCount == m_file->count())
+            return -1;
+    }
+
+    rebuildRowIndex();
+    return m_rowIndex.value(element.data(), -1);
+}
+
+void FileModel::allElementsChanged()
+{
+    m_renderCache.clear();
+    if (rowCount() > 0)
+        Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+void FileModel::invalidateRowIndex()
+{
+    m_rowIndexValid = false;
+    m_rowIndex.clear();
+}
+
+void FileModel::rebuildRowIndex() const
+{
+    m_rowIndex.clear();
+    m_rowIndex.reserve(m_file->count());
+    /// Go backwards so that for elements contained multiple times the first row is kept, as with indexOf
+    for (int row = m_file->count() - 1; row >= 0; --row)
+        m_rowIndex.insert(m_file->at(row).data(), row);
+    m_rowIndexFileCount = m_file->count();
+    m_rowIndexValid = true;
 }
 
 void FileModel::elementChanged(int row) {
+    const QSharedPointer<Element> changedElement = element(row);
+    if (!changedElement.isNull()) {
+        m_renderCache.remove(changedElement.data());
+        /// Entries cross-referencing the changed one may display some of its values
+        if (Entry::isEntry(*changedElement)) {
+            const auto keys = m_renderCache.keys();
+            for (const Element *key : keys) {
+                const RenderCacheRow *cacheRow = m_renderCache.object(key);
+                if (cacheRow != nullptr && cacheRow->followsCrossRef)
+                    m_renderCache.remove(key);
+            }
+        }
+    }
     Q_EMIT dataChanged(createIndex(row, 0), createIndex(row, columnCount() - 1));
 }
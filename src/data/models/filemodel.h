@@ -23,6 +23,10 @@
 #include <QAbstractItemModel>
 #include <QLatin1String>
 #include <QList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QCache>
 #include <QStringList>
 
 #include <NotificationHub>
@@ -61,13 +65,35 @@ public:
 
     void clear();
     virtual bool removeRow(int row, const QModelIndex &parent = QModelIndex());
+    /**
+     * Remove many rows at once. Contiguous rows are removed as one range,
+     * for heavily fragmented selections the model is reset instead.
+     * @param rows rows to remove, in any order and possibly with duplicates
+     * @return true if all rows were valid and got removed, false otherwise (nothing removed)
+     */
     bool removeRowList(const QList<int> &rows);
     bool insertRow(QSharedPointer<Element> element, int row, const QModelIndex &parent = QModelIndex());
+    /**
+     * Insert many elements at once starting at the given row, signalling
+     * a single range insertion. Like for @see insertRow, entry ids and
+     * macro keys clashing with existing ones or with those of previously
+     * inserted elements get a suffix like '_2' appended.
+     * @param elements elements to insert, in this order
+     * @param row row where the first element will be inserted
+     * @return true if the elements got inserted, false otherwise
+     */
+    bool insertRowList(const QVector<QSharedPointer<Element>> &elements, int row);
 
     QSharedPointer<Element> element(int row) const;
     int row(QSharedPointer<Element> element) const;
     /// Notifies the model that a given element has been modified
     void elementChanged(int row);
+    /**
+     * Notifies the model that elements may have been modified
+     * without knowing which ones, discarding all cached cell data
+     * and signalling a change of all cells.
+     */
+    void allElementsChanged();
 
     void notificationEvent(int eventId) override;
 
@@ -77,6 +103,31 @@ Q_SIGNALS:
 private:
     File *m_file;
     QMap<QString, QString> colorToLabel;
+    /// Maps elements to their rows, built lazily and rebuilt on mismatch
+    mutable QHash<const Element *, int> m_rowIndex;
+    mutable bool m_rowIndexValid;
+    /// Number of elements in the bibliography file covered by the row index
+    mutable int m_rowIndexFileCount;
+
+    /// Data rendered for one element, filled lazily as cells are requested
+    struct RenderCacheRow {
+        QSharedPointer<Entry> entry;
+        bool colorResolved, hasColor;
+        /// Element's color as QRgb value, valid only if hasColor is set
+        uint rgba;
+        /// Rendered data for a column and role, see FileModel::data
+        QHash<int, QVariant> cells;
+        /// Values may be inherited from a cross-referenced entry
+        bool followsCrossRef;
+    };
+    /// Bounded number of elements whose cells are cached
+    static const int renderCacheMaxRows;
+    mutable QCache<const Element *, RenderCacheRow> m_renderCache;
+
+    void invalidateRowIndex();
+    void rebuildRowIndex() const;
+    QVariant renderCell(const QSharedPointer<Element> &element, const QSharedPointer<Entry> &entry, int column, int role) const;
+    static void makeKeyUnique(const QSharedPointer<Element> &element, QSet<QString> &usedKeys);
 
     void readConfiguration();
     static QString leftSqueezeText(const QString &text, int n);
@@ -40,7 +40,7 @@
 #include <Preferences>
 #include "logging_data.h"
 
-quint64 ValueItem::internalIdCounter = 0;
+QAtomicInteger<quint64> ValueItem::internalIdCounter = 0;
 
 uint qHash(const QSharedPointer<ValueItem> &valueItem)
 {
@@ -50,7 +50,7 @@ uint qHash(const QSharedPointer<ValueItem> &valueItem)
 const QRegularExpression ValueItem::ignoredInSorting(QStringLiteral("[{}\\\\]+"));
 
 ValueItem::ValueItem()
-        : internalId(++internalIdCounter)
+        : internalId(internalIdCounter.fetchAndAddRelaxed(1) + 1)
 {
     /// nothing
 }
@@ -420,7 +420,8 @@ bool VerbatimText::containsPattern(const QString &pattern, Qt::CaseSensitivity c
         /// Only if simple text match failed, check color labels
         /// For a match, the user's pattern has to be the start of the color label
         /// and this verbatim text has to contain the color as hex string
-        for (QVector<QPair<QString, QString>>::ConstIterator it = Preferences::instance().colorCodes().constBegin(); !contained && it != Preferences::instance().colorCodes().constEnd(); ++it)
+        const QVector<QPair<QString, QString>> colorCodes = Preferences::instance().colorCodes();
+        for (QVector<QPair<QString, QString>>::ConstIterator it = colorCodes.constBegin(); !contained && it != colorCodes.constEnd(); ++it)
             contained = text.compare(it->first, Qt::CaseInsensitive) == 0 && it->second.contains(pattern, Qt::CaseInsensitive);
     }
 
@@ -567,6 +568,30 @@ bool Value::contains(const ValueItem &item) const
     return false;
 }
 
+Value Value::deepCopy() const
+{
+    Value result;
+    result.reserve(count());
+    for (const QSharedPointer<ValueItem> &valueItem : const_cast<const Value &>(*this)) {
+        if (const QSharedPointer<const Person> person = valueItem.dynamicCast<const Person>())
+            result.append(QSharedPointer<Person>(new Person(*person)));
+        else if (const QSharedPointer<const Keyword> keyword = valueItem.dynamicCast<const Keyword>())
+            result.append(QSharedPointer<Keyword>(new Keyword(*keyword)));
+        else if (const QSharedPointer<const MacroKey> macroKey = valueItem.dynamicCast<const MacroKey>())
+            result.append(QSharedPointer<MacroKey>(new MacroKey(*macroKey)));
+        else if (const QSharedPointer<const PlainText> plainText = valueItem.dynamicCast<const PlainText>())
+            result.append(QSharedPointer<PlainText>(new PlainText(*plainText)));
+        else if (const QSharedPointer<const VerbatimText> verbatimText = valueItem.dynamicCast<const VerbatimText>())
+            result.append(QSharedPointer<VerbatimText>(new VerbatimText(*verbatimText)));
+        else {
+            /// Unknown kind of value item, cannot copy it, so share it
+            qCWarning(LOG_KBIBTEX_DATA) << "Cannot copy value item of unknown type";
+            result.append(valueItem);
+        }
+    }
+    return result;
+}
+
 Value &Value::operator=(const Value &rhs)
 {
     return static_cast<Value &>(QVector<QSharedPointer<ValueItem> >::operator =((rhs)));
@@ -717,6 +742,11 @@ QDebug operator<<(QDebug dbg, const Value &value) {
 
 
 QString PlainTextValue::text(const Value &value, const FormattingOptions formattingOptions)
+{
+    return text(value, Preferences::instance().personNameFormat(), formattingOptions);
+}
+
+QString PlainTextValue::text(const Value &value, const QString &personNameFormat, const FormattingOptions formattingOptions)
 {
     ValueItemType vit = ValueItemType::Other;
     ValueItemType lastVit = ValueItemType::Other;
@@ -732,15 +762,15 @@ QString PlainTextValue::text(const Value &value, const FormattingOptions formatt
         } else {
             // Some text that may contain a number like  5
             bool ok = false;
-            firstIndex = PlainTextValue::text(value.first()).toInt(&ok);
+            firstIndex = text(*value.first(), vit, personNameFormat).toInt(&ok);
             if (!ok || (firstIndex < 1) || (firstIndex > 12))
                 firstIndex = -1;
             ok = true;
-            lastIndex = value.length() > 1 ? PlainTextValue::text(value.last()).toInt(&ok) : firstIndex;
+            lastIndex = value.length() > 1 ? text(*value.last(), vit, personNameFormat).toInt(&ok) : firstIndex;
             if (!ok || (lastIndex < 1) || (lastIndex > 12))
                 lastIndex = -1;
             static const QSet<QString> centerOfThree{QStringLiteral("#"), QStringLiteral("-"), QStringLiteral("--"), QStringLiteral("/"), QChar(0x2013)};
-            if (value.length() == 3 && !centerOfThree.contains(PlainTextValue::text(value.at(1)))) {
+            if (value.length() == 3 && !centerOfThree.contains(text(*value.at(1), vit, personNameFormat))) {
                 // If value contains three elements, the center one must be one of the allowed strings in the set
                 lastIndex = firstIndex = -1;
             }
@@ -759,7 +789,7 @@ QString PlainTextValue::text(const Value &value, const FormattingOptions formatt
 
     QString result;
     for (const auto &valueItem : value) {
-        QString nextText = text(*valueItem, vit);
+        QString nextText = text(*valueItem, vit, personNameFormat);
         if (!nextText.isEmpty()) {
             if (lastVit == ValueItemType::Person && vit == ValueItemType::Person)
                 result.append(i18n(" and ")); // TODO proper list of authors/editors, not just joined by "and"
@@ -787,10 +817,10 @@ QString PlainTextValue::text(const QSharedPointer<const ValueItem> &valueItem)
 QString PlainTextValue::text(const ValueItem &valueItem)
 {
     ValueItemType vit;
-    return text(valueItem, vit);
+    return text(valueItem, vit, Preferences::instance().personNameFormat());
 }
 
-QString PlainTextValue::text(const ValueItem &valueItem, ValueItemType &vit)
+QString PlainTextValue::text(const ValueItem &valueItem, ValueItemType &vit, const QString &personNameFormat)
 {
     QString result;
     vit = ValueItemType::Other;
@@ -806,7 +836,7 @@ QString PlainTextValue::text(const ValueItem &valueItem, ValueItemType &vit)
         } else {
             const Person *person = dynamic_cast<const Person *>(&valueItem);
             if (person != nullptr) {
-                result = Person::transcribePersonName(person, Preferences::instance().personNameFormat());
+                result = Person::transcribePersonName(person, personNameFormat);
                 vit = ValueItemType::Person;
             } else {
                 const Keyword *keyword = dynamic_cast<const Keyword *>(&valueItem);
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2022 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -23,6 +23,7 @@
 #include <QVector>
 #include <QVariant>
 #include <QSharedPointer>
+#include <QAtomicInteger>
 
 #ifdef HAVE_KF
 #include "kbibtexdata_export.h"
@@ -74,8 +75,9 @@ protected:
 private:
     /// Unique numeric identifier
     const quint64 internalId;
-    /// Keeping track of next available unique numeric identifier
-    static quint64 internalIdCounter;
+    /// Keeping track of next available unique numeric identifier,
+    /// atomic as value items may get created in several threads concurrently
+    static QAtomicInteger<quint64> internalIdCounter;
 };
 
 class KBIBTEXDATA_EXPORT Keyword: public ValueItem
@@ -271,6 +273,15 @@ public:
 
     bool contains(const ValueItem &item) const;
 
+    /**
+      * Copying a Value shares its value items with the original.
+      * This function instead copies each value item as well, so that
+      * the returned value can be handed to another thread while the
+      * original keeps being edited.
+      * @return copy of this value not sharing any value items
+      */
+    Value deepCopy() const;
+
     Value &operator=(const Value &rhs);
     Value &operator=(Value &&rhs);
     Value &operator<<(const QSharedPointer<ValueItem> &value);
@@ -290,13 +301,19 @@ public:
     };
     Q_DECLARE_FLAGS(FormattingOptions, FormattingOption)
     static QString text(const Value &value, const FormattingOptions formattingOptions = FormattingOption::NoOptions);
+    /**
+     * Same as above, but persons' names get formatted using the given format
+     * instead of the one from the preferences, which are not accessed at all.
+     * Use this variant from worker threads with a format read beforehand.
+     */
+    static QString text(const Value &value, const QString &personNameFormat, const FormattingOptions formattingOptions = FormattingOption::NoOptions);
     static QString text(const ValueItem &valueItem);
     static QString text(const QSharedPointer<const ValueItem> &valueItem);
 
 private:
     enum class ValueItemType { Other = 0, Person, Keyword};
 
-    static QString text(const ValueItem &valueItem, ValueItemType &vit);
+    static QString text(const ValueItem &valueItem, ValueItemType &vit, const QString &personNameFormat);
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(PlainTextValue::FormattingOptions)
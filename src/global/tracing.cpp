@@ -0,0 +1,215 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QIODevice>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include "logging_global.h"
+
+QAtomicInteger<int> Tracing::enabled(0);
+
+namespace {
+
+typedef struct {
+    const char *category;
+    const char *name;
+    qint64 start;
+    qint64 duration;
+    /// Zero for regular events, otherwise the id of an asynchronous event
+    quint64 asyncId;
+    int threadId;
+    QString detail;
+} TraceEvent;
+
+class TraceRecorder
+{
+public:
+    /// Limit memory usage if tracing runs for a long time
+    static const int maxEvents = 1 << 20;
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    QVector<TraceEvent> events;
+    QHash<int, QString> threadNames;
+    int droppedEvents;
+    /// File to write trace to when the program exits, as set in environment variable KBIBTEX_TRACE
+    QString outputFilename;
+
+    static TraceRecorder &instance() {
+        static TraceRecorder singleton;
+        return singleton;
+    }
+
+    void add(const char *category, const char *name, qint64 start, qint64 duration, quint64 asyncId, const QString &detail) {
+        /// Small sequential ids make traces easier to read than native thread handles
+        static QAtomicInteger<int> nextThreadId(1);
+        static thread_local int threadId = 0;
+        const bool isNewThread = threadId == 0;
+        if (isNewThread)
+            threadId = nextThreadId.fetchAndAddRelaxed(1);
+
+        QMutexLocker locker(&mutex);
+        if (isNewThread) {
+            const QThread *thread = QThread::currentThread();
+            const bool isMainThread = QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread();
+            threadNames.insert(threadId, isMainThread ? QStringLiteral("main") : (thread->objectName().isEmpty() ? QString(QStringLiteral("thread %1")).arg(threadId) : thread->objectName()));
+        }
+        if (events.size() >= maxEvents) {
+            ++droppedEvents;
+            return;
+        }
+        events.append({category, name, start, duration, asyncId, threadId, detail});
+    }
+
+    bool write(QIODevice *device) {
+        QMutexLocker locker(&mutex);
+        QTextStream ts(device);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        ts.setCodec("UTF-8");
+#else // QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        ts.setEncoding(QStringConverter::Utf8);
+#endif // QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        const QString pid = QString::number(QCoreApplication::applicationPid());
+
+        ts << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (auto it = threadNames.constBegin(); it != threadNames.constEnd(); ++it) {
+            ts << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << it.key() << ",\"args\":{\"name\":\"" << escaped(it.value()) << "\"}}";
+            first = false;
+        }
+        for (const TraceEvent &event : const_cast<const QVector<TraceEvent> &>(events)) {
+            const QString common = QString(QStringLiteral("\"name\":\"%1\",\"cat\":\"%2\",\"pid\":%3,\"tid\":%4")).arg(escaped(QString::fromUtf8(event.name)), escaped(QString::fromUtf8(event.category)), pid).arg(event.threadId);
+            const QString args = event.detail.isEmpty() ? QString() : QStringLiteral(",\"args\":{\"detail\":\"") + escaped(event.detail) + QStringLiteral("\"}");
+            ts << (first ? "" : ",\n");
+            first = false;
+            if (event.asyncId == 0)
+                ts << "{" << common << ",\"ph\":\"X\",\"ts\":" << microseconds(event.start) << ",\"dur\":" << microseconds(event.duration) << args << "}";
+            else {
+                const QString id = QStringLiteral(",\"id\":\"0x") + QString::number(event.asyncId, 16) + QStringLiteral("\"");
+                ts << "{" << common << id << ",\"ph\":\"b\",\"ts\":" << microseconds(event.start) << args << "},\n";
+                ts << "{" << common << id << ",\"ph\":\"e\",\"ts\":" << microseconds(event.start + event.duration) << "}";
+            }
+        }
+        ts << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << droppedEvents << "}}\n";
+        ts.flush();
+        return ts.status() == QTextStream::Ok;
+    }
+
+    void clear() {
+        QMutexLocker locker(&mutex);
+        events.clear();
+        droppedEvents = 0;
+    }
+
+private:
+    TraceRecorder()
+            : droppedEvents(0) {
+        clock.start();
+        outputFilename = qEnvironmentVariable("KBIBTEX_TRACE");
+        if (!outputFilename.isEmpty()) {
+            qCInfo(LOG_KBIBTEX_GLOBAL) << "Tracing enabled, writing trace to" << outputFilename << "at exit";
+            Tracing::setEnabled(true);
+        }
+    }
+
+    ~TraceRecorder() {
+        if (outputFilename.isEmpty())
+            return;
+        QFile file(outputFilename);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            write(&file);
+        else
+            qCWarning(LOG_KBIBTEX_GLOBAL) << "Could not write trace to" << outputFilename;
+    }
+
+    static QString escaped(const QString &text) {
+        QString result;
+        result.reserve(text.length() + 8);
+        for (const QChar &c : text) {
+            if (c == QLatin1Char('"') || c == QLatin1Char('\\'))
+                result.append(QLatin1Char('\\')).append(c);
+            else if (c.unicode() < 0x20)
+                result.append(QString(QStringLiteral("\\u%1")).arg(c.unicode(), 4, 16, QLatin1Char('0')));
+            else
+                result.append(c);
+        }
+        return result;
+    }
+
+    /// Chrome's trace format expects timestamps in microseconds
+    static inline QString microseconds(qint64 nanoseconds) {
+        return QString::number(nanoseconds / 1000.0, 'f', 3);
+    }
+};
+
+/// Create recorder when the library gets loaded, so that
+/// tracing is enabled right from the program's start
+const bool recorderInitialized = (TraceRecorder::instance(), true);
+
+} // namespace
+
+void Tracing::setEnabled(bool isEnabled)
+{
+    enabled.storeRelaxed(isEnabled ? 1 : 0);
+}
+
+qint64 Tracing::timestamp()
+{
+    return TraceRecorder::instance().clock.nsecsElapsed();
+}
+
+void Tracing::record(const char *category, const char *name, qint64 start, qint64 duration, const QString &detail)
+{
+    TraceRecorder::instance().add(category, name, start, duration, 0, detail);
+}
+
+void Tracing::recordAsync(const char *category, const char *name, quint64 id, qint64 start, qint64 duration, const QString &detail)
+{
+    /// Id 0 is reserved for regular events
+    TraceRecorder::instance().add(category, name, start, duration, id == 0 ? 1 : id, detail);
+}
+
+bool Tracing::writeChromeTrace(QIODevice *device)
+{
+    return TraceRecorder::instance().write(device);
+}
+
+bool Tracing::writeChromeTrace(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(LOG_KBIBTEX_GLOBAL) << "Could not write trace to" << filename;
+        return false;
+    }
+    return TraceRecorder::instance().write(&file);
+}
+
+void Tracing::clear()
+{
+    TraceRecorder::instance().clear();
+}
@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_GLOBAL_TRACING_H
+#define KBIBTEX_GLOBAL_TRACING_H
+
+#include <QAtomicInteger>
+#include <QString>
+
+#ifdef HAVE_KF
+#include "kbibtexglobal_export.h"
+#endif // HAVE_KF
+
+class QIODevice;
+
+/**
+ * Lightweight tracing of the time spent in selected code paths.
+ *
+ * Tracing gets enabled by setting the environment variable KBIBTEX_TRACE
+ * to a file name. When the program exits, all recorded events are written
+ * to this file in the Chrome trace event format, which can be inspected
+ * with Perfetto (https://ui.perfetto.dev/) or chrome://tracing.
+ * While tracing is disabled, a trace scope costs a single relaxed atomic
+ * load when entered and a comparison when left.
+ *
+ * Categories and names are not copied but recorded as pointers, so they
+ * must be string literals or otherwise live as long as the program.
+ *
+ * While tracing is enabled, each event takes a global lock and at most
+ * about one million events are kept. Therefore, do not place scopes in
+ * functions called per value or per table cell, like EncoderLaTeX's
+ * encode/decode or FileModel::data, but in the operation calling them,
+ * like loading or saving a file, or sorting a model.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXGLOBAL_EXPORT Tracing
+{
+public:
+    /// Record the time between construction and destruction as one event
+    class Scope
+    {
+    public:
+        inline Scope(const char *category, const char *name)
+                : m_category(category), m_name(name), m_start(Tracing::isEnabled() ? Tracing::timestamp() : -1) {
+            /// nothing
+        }
+
+        inline ~Scope() {
+            if (m_start >= 0)
+                Tracing::record(m_category, m_name, m_start, Tracing::timestamp() - m_start, m_detail);
+        }
+
+        /// Attach a detail like a file name or number of items to this event
+        inline void setDetail(const QString &detail) {
+            if (m_start >= 0)
+                m_detail = detail;
+        }
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        const char *const m_category;
+        const char *const m_name;
+        const qint64 m_start;
+        QString m_detail;
+    };
+
+    static inline bool isEnabled() {
+        return enabled.loadRelaxed() != 0;
+    }
+    static void setEnabled(bool isEnabled);
+
+    /// Nanoseconds since tracing got initialized
+    static qint64 timestamp();
+
+    static void record(const char *category, const char *name, qint64 start, qint64 duration, const QString &detail = QString());
+    /**
+     * Record an operation that may overlap with other operations on the
+     * same thread, like a network request waiting for its reply. Events
+     * with the same @p id are shown as one asynchronous track.
+     */
+    static void recordAsync(const char *category, const char *name, quint64 id, qint64 start, qint64 duration, const QString &detail = QString());
+
+    /// Write all events recorded so far in Chrome's trace event format
+    static bool writeChromeTrace(QIODevice *device);
+    static bool writeChromeTrace(const QString &filename);
+    static void clear();
+
+private:
+    static QAtomicInteger<int> enabled;
+};
+
+#define KBIBTEX_TRACE_SCOPE(category, name) Tracing::Scope kbibtexTraceScope((category), (name))
+
+#endif // KBIBTEX_GLOBAL_TRACING_H
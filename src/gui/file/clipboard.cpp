@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2020 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -115,10 +115,13 @@ public:
             FileModel *fileModel = fileView->fileModel();
             QSortFilterProxyModel *sfpModel = fileView->sortFilterProxyModel();
 
-            /// Insert new elements one by one
+            /// Insert all new elements at once
             const int startRow = fileModel->rowCount(); ///< Memorize row where insertion started
+            QVector<QSharedPointer<Element>> elements;
+            elements.reserve(file->count());
             for (const auto &element : const_cast<const File &>(*file))
-                fileModel->insertRow(element, fileView->model()->rowCount());
+                elements.append(element);
+            fileModel->insertRowList(elements, startRow);
             const int endRow = fileModel->rowCount() - 1; ///< Memorize row where insertion ended
 
             /// Select newly inserted elements
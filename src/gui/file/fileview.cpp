@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -143,6 +143,9 @@ bool FileView::editElement(QSharedPointer<Element> element)
         if (changed) {
             FileModel *model = fileModel();
             const File *bibliographyFile = model != nullptr ? model->bibliographyFile() : nullptr;
+            const int row = model != nullptr ? model->row(element) : -1;
+            if (row >= 0)
+                model->elementChanged(row);
             Q_EMIT currentElementChanged(currentElement(), bibliographyFile);
             Q_EMIT selectedElementsChanged();
             Q_EMIT modified(true);
@@ -230,6 +233,23 @@ void FileView::selectionDelete()
 /// FIXME the existence of this function is basically just one big hack
 void FileView::externalModification()
 {
+    /// Unknown which elements got modified, so let model refresh all cells
+    FileModel *model = fileModel();
+    if (model != nullptr)
+        model->allElementsChanged();
+    Q_EMIT modified(true);
+}
+
+void FileView::externalElementModification(const QSharedPointer<Element> &element)
+{
+    /// Refresh only the modified element's cells, as refreshing all
+    /// cells would be too costly to do for every edit
+    FileModel *model = fileModel();
+    const int row = model != nullptr && !element.isNull() ? model->row(element) : -1;
+    if (row >= 0)
+        model->elementChanged(row);
+    else if (model != nullptr)
+        model->allElementsChanged();
     Q_EMIT modified(true);
 }
 
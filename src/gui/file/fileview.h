@@ -72,6 +72,7 @@ public Q_SLOTS:
     void setSelectedElement(QSharedPointer<Element>);
     void selectionDelete();
     void externalModification();
+    void externalElementModification(const QSharedPointer<Element> &);
     void setFilterBarFilter(const SortFilterFileModel::FilterQuery &);
 
 protected:
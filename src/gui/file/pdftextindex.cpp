@@ -0,0 +1,296 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "pdftextindex.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QtConcurrentRun>
+
+#include <File>
+#include <Entry>
+#include <FileInfo>
+#include "logging_gui.h"
+
+/// Number of PDF files whose text is loaded in one go by the background worker
+static const int loadChunkSize = 16;
+/// Upper limit of memorized search terms
+static const int maxMemorizedQueries = 64;
+
+PDFTextIndex::PDFTextIndex(QObject *parent)
+        : QObject(parent), hasPendingEntries(false), locating(false), loading(false), canceled(new QAtomicInt(0)), lastQueryLatencyMicroseconds(0)
+{
+    connect(&locateWatcher, &QFutureWatcher<QHash<const Element *, QStringList>>::finished, this, &PDFTextIndex::pdfFilesLocated);
+    connect(&loadWatcher, &QFutureWatcher<QHash<QString, QByteArray>>::finished, this, &PDFTextIndex::chunkLoaded);
+    connect(&fileSystemWatcher, &QFileSystemWatcher::directoryChanged, this, &PDFTextIndex::pdfDirectoryChanged);
+}
+
+PDFTextIndex::~PDFTextIndex()
+{
+    /// Background workers do not access this object, so instead of waiting
+    /// for them, let them stop after the file they are working on
+    canceled->storeRelaxed(1);
+}
+
+void PDFTextIndex::setFile(const File *file)
+{
+    /// Locating files is done once here rather than for each row and filter change,
+    /// in the background on copies as entries may get modified in the meantime
+    EntrySnapshot entries;
+    QUrl bibTeXUrl;
+    if (file != nullptr) {
+        bibTeXUrl = file->property(File::Url, QUrl()).toUrl();
+        for (const QSharedPointer<Element> &element : *file) {
+            const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+            if (!entry.isNull())
+                entries.append(qMakePair(const_cast<const Element *>(element.data()), FileInfo::plainTextCopy(entry)));
+        }
+    }
+
+    if (locating) {
+        /// Only the most recent file matters, so locate its PDF files once the running search is done
+        pendingEntries = entries;
+        pendingBibTeXUrl = bibTeXUrl;
+        hasPendingEntries = true;
+    } else
+        locatePdfFiles(entries, bibTeXUrl);
+}
+
+void PDFTextIndex::locatePdfFiles(const EntrySnapshot &entries, const QUrl &bibTeXUrl)
+{
+    locating = true;
+    const QSharedPointer<QAtomicInt> canceled = this->canceled;
+    locateWatcher.setFuture(QtConcurrent::run([entries, bibTeXUrl, canceled]() {
+        /// Testing for existence of files is too slow to be done in the GUI thread
+        QHash<const Element *, QStringList> result;
+        for (const auto &elementEntry : entries) {
+            if (canceled->loadRelaxed() != 0)
+                break;
+            QStringList pdfFiles;
+            const auto entryUrlList = FileInfo::entryUrls(elementEntry.second, bibTeXUrl, FileInfo::TestExistence::Yes);
+            for (const QUrl &url : entryUrlList)
+                if (url.isLocalFile() && url.fileName().endsWith(QStringLiteral(".pdf"), Qt::CaseInsensitive))
+                    pdfFiles.append(url.toLocalFile());
+            if (!pdfFiles.isEmpty())
+                result.insert(elementEntry.first, pdfFiles);
+        }
+        return result;
+    }));
+}
+
+void PDFTextIndex::pdfFilesLocated()
+{
+    locating = false;
+    if (hasPendingEntries) {
+        /// Bibliography has changed while locating PDF files, result is outdated already
+        hasPendingEntries = false;
+        const EntrySnapshot entries = pendingEntries;
+        pendingEntries.clear();
+        locatePdfFiles(entries, pendingBibTeXUrl);
+        return;
+    }
+
+    elementPdfFiles = locateWatcher.result();
+    QSet<QString> allPdfFiles;
+    for (auto it = elementPdfFiles.constBegin(); it != elementPdfFiles.constEnd(); ++it)
+        for (const QString &pdfFile : it.value())
+            allPdfFiles.insert(pdfFile);
+
+    /// Forget text of PDF files no longer referenced
+    for (auto it = pdfText.begin(); it != pdfText.end();) {
+        if (allPdfFiles.contains(it.key()))
+            ++it;
+        else {
+            unwatchPdfFile(it.key());
+            it = pdfText.erase(it);
+        }
+    }
+    for (auto it = pendingPdfFiles.begin(); it != pendingPdfFiles.end();) {
+        if (allPdfFiles.contains(*it))
+            ++it;
+        else {
+            unwatchPdfFile(*it);
+            it = pendingPdfFiles.erase(it);
+        }
+    }
+
+    /// Load text of PDF files not known yet
+    for (const QString &pdfFile : const_cast<const QSet<QString> &>(allPdfFiles))
+        if (!pdfText.contains(pdfFile) && !pendingPdfFiles.contains(pdfFile)) {
+            pendingPdfFiles.insert(pdfFile);
+            watchPdfFile(pdfFile);
+        }
+    if (!loading)
+        loadNextChunk();
+
+    /// Elements may have gained or lost PDF files
+    Q_EMIT updated();
+}
+
+QSet<const Element *> PDFTextIndex::elementsContaining(const QString &term)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString foldedTerm = term.toCaseFolded();
+    QSet<QString> matchingPdfFiles;
+    auto memorized = queryResults.constFind(foldedTerm);
+    if (memorized != queryResults.constEnd())
+        matchingPdfFiles = memorized.value();
+    else {
+        /// Any PDF file containing the term also contains all of the term's substrings,
+        /// so if some substring has been searched for before, check only its results
+        const QSet<QString> *candidates = nullptr;
+        int longestSubstringLength = -1;
+        for (auto it = queryResults.constBegin(); it != queryResults.constEnd(); ++it)
+            if (it.key().length() > longestSubstringLength && foldedTerm.contains(it.key())) {
+                candidates = &it.value();
+                longestSubstringLength = it.key().length();
+            }
+
+        const QByteArray needle = foldedTerm.toUtf8();
+        if (candidates != nullptr) {
+            for (const QString &pdfFile : *candidates)
+                if (pdfText.value(pdfFile).contains(needle))
+                    matchingPdfFiles.insert(pdfFile);
+        } else {
+            for (auto it = pdfText.constBegin(); it != pdfText.constEnd(); ++it)
+                if (it.value().contains(needle))
+                    matchingPdfFiles.insert(it.key());
+        }
+
+        if (queryResults.count() >= maxMemorizedQueries)
+            queryResults.clear();
+        queryResults.insert(foldedTerm, matchingPdfFiles);
+    }
+
+    QSet<const Element *> result;
+    if (!matchingPdfFiles.isEmpty())
+        for (auto it = elementPdfFiles.constBegin(); it != elementPdfFiles.constEnd(); ++it)
+            for (const QString &pdfFile : it.value())
+                if (matchingPdfFiles.contains(pdfFile)) {
+                    result.insert(it.key());
+                    break;
+                }
+
+    lastQueryLatencyMicroseconds = timer.nsecsElapsed() / 1000;
+    qCDebug(LOG_KBIBTEX_GUI) << "Searching" << pdfText.count() << "PDF files for" << term << "found" << result.count() << "elements in" << lastQueryLatencyMicroseconds << "us";
+    return result;
+}
+
+bool PDFTextIndex::isLoading() const
+{
+    return locating || loading || !pendingPdfFiles.isEmpty();
+}
+
+qint64 PDFTextIndex::lastQueryLatency() const
+{
+    return lastQueryLatencyMicroseconds;
+}
+
+void PDFTextIndex::loadNextChunk()
+{
+    if (pendingPdfFiles.isEmpty()) return;
+
+    QStringList chunk;
+    chunk.reserve(loadChunkSize);
+    for (auto it = pendingPdfFiles.begin(); it != pendingPdfFiles.end() && chunk.count() < loadChunkSize;) {
+        chunk.append(*it);
+        it = pendingPdfFiles.erase(it);
+    }
+    loading = true;
+    const QSharedPointer<QAtomicInt> canceled = this->canceled;
+    loadWatcher.setFuture(QtConcurrent::run([chunk, canceled]() {
+        QHash<QString, QByteArray> result;
+        for (const QString &pdfFile : chunk) {
+            if (canceled->loadRelaxed() != 0)
+                break;
+            result.insert(pdfFile, FileInfo::pdfToText(pdfFile).toCaseFolded().toUtf8());
+        }
+        return result;
+    }));
+}
+
+void PDFTextIndex::chunkLoaded()
+{
+    loading = false;
+    const QHash<QString, QByteArray> result = loadWatcher.result();
+    for (auto it = result.constBegin(); it != result.constEnd(); ++it)
+        pdfText.insert(it.key(), it.value());
+    /// Memorized results do not cover the newly loaded text
+    queryResults.clear();
+
+    if (pendingPdfFiles.isEmpty())
+        Q_EMIT updated();
+    else
+        loadNextChunk();
+}
+
+void PDFTextIndex::pdfDirectoryChanged(const QString &directory)
+{
+    /// Directories get notified about files being created, deleted, or
+    /// replaced, so find out which of the PDF files in there changed
+    const auto it = watchedPdfFiles.find(directory);
+    if (it == watchedPdfFiles.end()) return;
+
+    bool changed = false;
+    for (auto pdfIt = it->begin(); pdfIt != it->end(); ++pdfIt) {
+        const QFileInfo pdfFileInfo(pdfIt.key());
+        /// Modification time is invalid for files that do not exist (anymore)
+        const QDateTime lastModified = pdfFileInfo.exists() ? pdfFileInfo.lastModified() : QDateTime();
+        if (lastModified == pdfIt.value()) continue;
+
+        pdfIt.value() = lastModified;
+        pdfText.remove(pdfIt.key());
+        FileInfo::invalidatePDFTextCache(pdfIt.key());
+        if (lastModified.isValid())
+            pendingPdfFiles.insert(pdfIt.key());
+        changed = true;
+    }
+    if (!changed) return;
+
+    queryResults.clear();
+    if (!pendingPdfFiles.isEmpty()) {
+        if (!loading)
+            loadNextChunk();
+    } else
+        Q_EMIT updated();
+}
+
+void PDFTextIndex::watchPdfFile(const QString &pdfFile)
+{
+    const QFileInfo pdfFileInfo(pdfFile);
+    const QString directory = pdfFileInfo.absolutePath();
+    QHash<QString, QDateTime> &pdfFiles = watchedPdfFiles[directory];
+    if (pdfFiles.isEmpty())
+        fileSystemWatcher.addPath(directory);
+    pdfFiles.insert(pdfFile, pdfFileInfo.lastModified());
+}
+
+void PDFTextIndex::unwatchPdfFile(const QString &pdfFile)
+{
+    const QString directory = QFileInfo(pdfFile).absolutePath();
+    const auto it = watchedPdfFiles.find(directory);
+    if (it == watchedPdfFiles.end()) return;
+    it->remove(pdfFile);
+    if (it->isEmpty()) {
+        fileSystemWatcher.removePath(directory);
+        watchedPdfFiles.erase(it);
+    }
+}
@@ -0,0 +1,133 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_GUI_PDFTEXTINDEX_H
+#define KBIBTEX_GUI_PDFTEXTINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+#include <QUrl>
+#include <QDateTime>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QFileSystemWatcher>
+
+#include "kbibtexgui_export.h"
+
+class File;
+class Element;
+class Entry;
+
+/**
+ * Keeps the plain text of all PDF files associated with a bibliography's
+ * entries in memory, so that searching in PDF files does not require
+ * to locate and read any files when filtering.
+ *
+ * PDF files get located and their text gets extracted or loaded from
+ * FileInfo's text cache by background workers, which stop early once the
+ * index is destroyed. The directories containing PDF files are watched,
+ * rather than each PDF file, so that large libraries do not exhaust the
+ * system's limit of watches. PDF files whose modification time changed
+ * get re-extracted. Results for search terms are memorized, and a
+ * term extending a previously searched term is only looked up in the
+ * previous results.
+ * The index itself lives in memory only and gets rebuilt for each opened
+ * bibliography; FileInfo's on-disk text cache makes rebuilding cheap.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXGUI_EXPORT PDFTextIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PDFTextIndex(QObject *parent = nullptr);
+    ~PDFTextIndex() override;
+
+    /**
+     * Determine which PDF files are associated with which elements.
+     * Returns immediately, as both locating PDF files and loading text
+     * of PDF files not known yet is done in the background. Signal
+     * @see updated gets emitted once results may have changed.
+     * @param file bibliography whose entries are to be indexed
+     */
+    void setFile(const File *file);
+
+    /**
+     * Find all elements with an associated PDF file containing the term.
+     * PDF files whose text has not been loaded yet are not considered.
+     * @param term text to search for, case-insensitive
+     * @return elements having at least one PDF file containing the term
+     */
+    QSet<const Element *> elementsContaining(const QString &term);
+
+    /// True while PDF files are being located or their text is being loaded in the background
+    bool isLoading() const;
+    /// Time in microseconds it took to answer the last call to @see elementsContaining
+    qint64 lastQueryLatency() const;
+
+Q_SIGNALS:
+    /// Text of PDF files has been loaded or has changed, previous query results may be outdated
+    void updated();
+
+private Q_SLOTS:
+    void pdfFilesLocated();
+    void chunkLoaded();
+    void pdfDirectoryChanged(const QString &directory);
+
+private:
+    /// Elements paired with plain-text copies of their entries, safe to be read in background
+    typedef QVector<QPair<const Element *, QSharedPointer<const Entry>>> EntrySnapshot;
+
+    /// PDF files associated with each element
+    QHash<const Element *, QStringList> elementPdfFiles;
+    /// Case-folded text of each PDF file, UTF-8 encoded to save memory
+    QHash<QString, QByteArray> pdfText;
+    /// Memorized results: search term (case-folded) to matching PDF files
+    QHash<QString, QSet<QString>> queryResults;
+
+    /// Most recent entries to locate PDF files for once the running search is done
+    EntrySnapshot pendingEntries;
+    QUrl pendingBibTeXUrl;
+    bool hasPendingEntries;
+    /// Set from starting a background worker until its result has been processed
+    bool locating, loading;
+    QFutureWatcher<QHash<const Element *, QStringList>> locateWatcher;
+
+    QSet<QString> pendingPdfFiles;
+    QFutureWatcher<QHash<QString, QByteArray>> loadWatcher;
+    /// Watched directories with the PDF files in them and their last known modification times
+    QHash<QString, QHash<QString, QDateTime>> watchedPdfFiles;
+    /// Shared with background workers, which stop after their current file once set
+    QSharedPointer<QAtomicInt> canceled;
+    QFileSystemWatcher fileSystemWatcher;
+    qint64 lastQueryLatencyMicroseconds;
+
+    void locatePdfFiles(const EntrySnapshot &entries, const QUrl &bibTeXUrl);
+    void loadNextChunk();
+    void watchPdfFile(const QString &pdfFile);
+    void unwatchPdfFile(const QString &pdfFile);
+};
+
+#endif // KBIBTEX_GUI_PDFTEXTINDEX_H
@@ -19,28 +19,298 @@
 
 #include "sortfilterfilemodel.h"
 
+#include <algorithm>
+
 #include <QRegularExpression>
-#include <QtConcurrentRun>
+#include <QBitArray>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 
 #include <BibTeXFields>
 #include <BibTeXEntries>
+#include <Preferences>
+#include <File>
 #include <Entry>
 #include <Macro>
 #include <Preamble>
 #include <Comment>
-#include <FileInfo>
+#include <Tracing>
 #include "widgets/starrating.h"
+#ifdef HAVE_POPPLERQT
+#include "pdftextindex.h"
+#endif // HAVE_POPPLERQT
+
+/**
+ * Inverted index mapping trigrams (sequences of three characters, case-folded)
+ * to the elements whose searchable texts contain them. As any text containing
+ * a search term also contains all of the term's trigrams, intersecting the
+ * trigrams' posting lists yields a superset of the matching elements.
+ * Thus, the index only narrows down which rows filterAcceptsRow has to check
+ * in detail, but never changes the filter's result.
+ *
+ * The index is updated lazily: elements get dropped when they change or get
+ * removed and are treated as candidates for any query until they are
+ * re-indexed at the next filter update.
+ */
+class SortFilterFileModel::FilterIndex
+{
+private:
+    /// Texts longer than this are not indexed, their elements are always checked in detail
+    static const int maxIndexedTextLength = 8192;
+    /// Slot number of elements that cannot be indexed
+    static const int unindexableSlot = -1;
+
+    QHash<const Element *, int> slotOfElement;
+    /// Number of slots that belonged to elements since dropped
+    int deadSlots;
+    int nextSlot;
+    /// Maps trigrams to the slots of elements containing them, ascending
+    QHash<quint64, QVector<int>> postings;
+
+    bool queryActive;
+    QBitArray candidateSlots;
+
+    static inline quint64 trigram(const QChar *c) {
+        return (static_cast<quint64>(c[0].unicode()) << 32) | (static_cast<quint64>(c[1].unicode()) << 16) | static_cast<quint64>(c[2].unicode());
+    }
+
+    static bool addTrigrams(const QString &text, QSet<quint64> &trigrams) {
+        if (text.length() > maxIndexedTextLength) return false;
+        const QString folded = text.toCaseFolded();
+        for (int i = folded.length() - 3; i >= 0; --i)
+            trigrams.insert(trigram(folded.constData() + i));
+        return true;
+    }
+
+    static bool addValueTrigrams(const Value &value, QSet<quint64> &trigrams) {
+        /// Texts as tested by the individual ValueItems' containsPattern
+        for (const QSharedPointer<ValueItem> &valueItem : value) {
+            if (const QSharedPointer<PlainText> plainText = valueItem.dynamicCast<PlainText>()) {
+                if (!addTrigrams(plainText->text().remove(ValueItem::ignoredInSorting), trigrams)) return false;
+            } else if (const QSharedPointer<Person> person = valueItem.dynamicCast<Person>()) {
+                const QString firstName = person->firstName().remove(ValueItem::ignoredInSorting);
+                const QString lastName = person->lastName().remove(ValueItem::ignoredInSorting);
+                if (!addTrigrams(person->suffix().remove(ValueItem::ignoredInSorting), trigrams)) return false;
+                if (!addTrigrams(QString(QStringLiteral("%1 %2|%2, %1")).arg(firstName, lastName), trigrams)) return false;
+            } else if (const QSharedPointer<MacroKey> macroKey = valueItem.dynamicCast<MacroKey>()) {
+                if (!addTrigrams(macroKey->text().remove(ValueItem::ignoredInSorting), trigrams)) return false;
+            } else if (const QSharedPointer<Keyword> keyword = valueItem.dynamicCast<Keyword>()) {
+                if (!addTrigrams(keyword->text().remove(ValueItem::ignoredInSorting), trigrams)) return false;
+            } else if (const QSharedPointer<VerbatimText> verbatimText = valueItem.dynamicCast<VerbatimText>()) {
+                const QString text = verbatimText->text().remove(ValueItem::ignoredInSorting);
+                if (!addTrigrams(text, trigrams)) return false;
+                if (verbatimText->hasComment() && !addTrigrams(verbatimText->comment().remove(ValueItem::ignoredInSorting), trigrams)) return false;
+                /// Color codes can be found by their labels
+                for (const auto &colorCode : Preferences::instance().colorCodes())
+                    if (text.compare(colorCode.first, Qt::CaseInsensitive) == 0)
+                        addTrigrams(colorCode.second, trigrams);
+            } else
+                return false; ///< unknown type of value item
+        }
+        return true;
+    }
+
+    /// Collect the trigrams of all texts filterAcceptsRow may test for the given element
+    static bool elementTrigrams(const QSharedPointer<Element> &element, QSet<quint64> &trigrams) {
+        if (const QSharedPointer<Entry> entry = element.dynamicCast<Entry>()) {
+            addTrigrams(entry->id(), trigrams);
+            addTrigrams(entry->type(), trigrams);
+            addTrigrams(BibTeXEntries::instance().label(entry->type()), trigrams);
+            for (Entry::ConstIterator it = entry->constBegin(); it != entry->constEnd(); ++it)
+                if (!addValueTrigrams(it.value(), trigrams))
+                    return false;
+            return true;
+        } else if (const QSharedPointer<Macro> macro = element.dynamicCast<Macro>()) {
+            addTrigrams(macro->key(), trigrams);
+            addTrigrams(QStringLiteral("macro"), trigrams);
+            return addValueTrigrams(macro->value(), trigrams);
+        } else if (const QSharedPointer<Comment> comment = element.dynamicCast<Comment>()) {
+            addTrigrams(QStringLiteral("comment"), trigrams);
+            return addTrigrams(comment->text(), trigrams);
+        } else if (const QSharedPointer<Preamble> preamble = element.dynamicCast<Preamble>()) {
+            addTrigrams(QStringLiteral("preamble"), trigrams);
+            return addValueTrigrams(preamble->value(), trigrams);
+        }
+        return false;
+    }
+
+    /// Slots of elements containing all trigrams of the given term, ascending
+    QVector<int> termCandidates(const QString &term) const {
+        QSet<quint64> termTrigrams;
+        addTrigrams(term, termTrigrams);
+
+        QVector<const QVector<int> *> lists;
+        lists.reserve(termTrigrams.count());
+        for (const quint64 t : const_cast<const QSet<quint64> &>(termTrigrams)) {
+            const auto it = postings.constFind(t);
+            if (it == postings.constEnd())
+                return QVector<int>(); ///< some trigram does not occur anywhere
+            lists.append(&it.value());
+        }
+        /// Start with shortest list to keep intermediate results small
+        std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+            return a->count() < b->count();
+        });
+
+        QVector<int> result = *lists.first();
+        for (int i = 1; i < lists.count() && !result.isEmpty(); ++i) {
+            QVector<int> intersection;
+            std::set_intersection(result.constBegin(), result.constEnd(), lists[i]->constBegin(), lists[i]->constEnd(), std::back_inserter(intersection));
+            result = intersection;
+        }
+        return result;
+    }
+
+public:
+    FilterIndex()
+            : deadSlots(0), nextSlot(0), queryActive(false)
+    {
+        /// nothing
+    }
+
+    void clear() {
+        slotOfElement.clear();
+        postings.clear();
+        deadSlots = nextSlot = 0;
+        queryActive = false;
+        candidateSlots.clear();
+    }
+
+    void drop(const Element *element) {
+        const auto it = slotOfElement.find(element);
+        if (it != slotOfElement.end()) {
+            if (it.value() != unindexableSlot) ++deadSlots;
+            slotOfElement.erase(it);
+        }
+    }
+
+    /// Index all elements not indexed yet
+    void update(const File *file) {
+        if (file == nullptr) return;
+
+        /// Rebuild from scratch if most slots are no longer used
+        if (deadSlots > 1024 && deadSlots > slotOfElement.count())
+            clear();
+
+        for (const QSharedPointer<Element> &element : *file) {
+            if (slotOfElement.contains(element.data())) continue;
+
+            QSet<quint64> trigrams;
+            if (!elementTrigrams(element, trigrams)) {
+                slotOfElement.insert(element.data(), unindexableSlot);
+                continue;
+            }
+            /// Slots are handed out in increasing order, keeping posting lists sorted
+            const int slot = nextSlot++;
+            slotOfElement.insert(element.data(), slot);
+            for (const quint64 t : const_cast<const QSet<quint64> &>(trigrams))
+                postings[t].append(slot);
+        }
+    }
+
+    void prepareQuery(const FilterQuery &filterQuery) {
+        queryActive = false;
+        candidateSlots.clear();
+
+        /// Criteria not covered by the index
+        if (filterQuery.terms.isEmpty() || filterQuery.field == Entry::ftStarRating || (filterQuery.searchPDFfiles && filterQuery.field.isEmpty()))
+            return;
+
+        QVector<int> candidates;
+        bool first = true;
+        for (const QString &term : filterQuery.terms) {
+            /// Terms shorter than a trigram do not narrow down the candidates
+            if (term.length() < 3) {
+                if (filterQuery.combination == FilterCombination::AnyTerm)
+                    return;
+                continue;
+            }
+            const QVector<int> termResult = termCandidates(term);
+            if (first) {
+                candidates = termResult;
+                first = false;
+            } else {
+                QVector<int> combined;
+                if (filterQuery.combination == FilterCombination::AnyTerm)
+                    std::set_union(candidates.constBegin(), candidates.constEnd(), termResult.constBegin(), termResult.constEnd(), std::back_inserter(combined));
+                else
+                    std::set_intersection(candidates.constBegin(), candidates.constEnd(), termResult.constBegin(), termResult.constEnd(), std::back_inserter(combined));
+                candidates = combined;
+            }
+        }
+        if (first) return; ///< no term was long enough
+
+        candidateSlots.resize(nextSlot);
+        for (const int slot : const_cast<const QVector<int> &>(candidates))
+            candidateSlots.setBit(slot);
+        queryActive = true;
+    }
+
+    /// False only if the element cannot match the current query
+    bool isCandidate(const Element *element) const {
+        if (!queryActive) return true;
+        const int slot = slotOfElement.value(element, unindexableSlot);
+        /// Elements unindexable, not indexed yet, or indexed after the query was prepared are always candidates
+        return slot == unindexableSlot || slot >= candidateSlots.size() || candidateSlots.testBit(slot);
+    }
+};
 
 SortFilterFileModel::SortFilterFileModel(QObject *parent)
-        : QSortFilterProxyModel(parent), m_internalModel(nullptr)
+        : QSortFilterProxyModel(parent), m_internalModel(nullptr), m_filterIndex(new FilterIndex()), m_pdfTextIndex(nullptr), m_pdfTextIndexOutdated(true)
 {
     m_filterQuery.combination = FilterCombination::AnyTerm;
+    m_filterQuery.searchPDFfiles = false;
     setSortRole(FileModel::SortRole);
+
+#ifdef HAVE_POPPLERQT
+    m_pdfTextIndex = new PDFTextIndex(this);
+    connect(m_pdfTextIndex, &PDFTextIndex::updated, this, [this]() {
+        /// More PDF files' text is known now, so re-run an active search in PDF files
+        if (isPDFSearch()) {
+            updatePDFMatches();
+            invalidateFilter();
+        }
+    });
+#endif // HAVE_POPPLERQT
+}
+
+SortFilterFileModel::~SortFilterFileModel()
+{
+    delete m_filterIndex;
 }
 
 void SortFilterFileModel::setSourceModel(QAbstractItemModel *model)
 {
+    if (m_internalModel != nullptr)
+        disconnect(m_internalModel, nullptr, this, nullptr);
+    m_filterIndex->clear();
+    m_pdfTextIndexOutdated = true;
+    m_pdfMatches.clear();
+
     m_internalModel = dynamic_cast<FileModel *>(model);
+    if (m_internalModel != nullptr) {
+        /// Connect before QSortFilterProxyModel does, so that the index has
+        /// dropped changed elements before rows get filtered again
+        connect(m_internalModel, &FileModel::dataChanged, this, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+            for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+                m_filterIndex->drop(m_internalModel->element(row).data());
+            m_pdfTextIndexOutdated = true;
+        });
+        connect(m_internalModel, &FileModel::rowsAboutToBeRemoved, this, [this](const QModelIndex &, int first, int last) {
+            for (int row = first; row <= last; ++row)
+                m_filterIndex->drop(m_internalModel->element(row).data());
+            m_pdfTextIndexOutdated = true;
+        });
+        connect(m_internalModel, &FileModel::rowsInserted, this, [this]() {
+            m_pdfTextIndexOutdated = true;
+        });
+        connect(m_internalModel, &FileModel::modelReset, this, [this]() {
+            m_filterIndex->clear();
+            m_pdfTextIndexOutdated = true;
+        });
+    }
+
     QSortFilterProxyModel::setSourceModel(model);
 }
 
@@ -49,13 +319,46 @@ FileModel *SortFilterFileModel::fileSourceModel() const
     return m_internalModel;
 }
 
+void SortFilterFileModel::sort(int column, Qt::SortOrder order)
+{
+    KBIBTEX_TRACE_SCOPE("gui", "SortFilterFileModel::sort");
+    QSortFilterProxyModel::sort(column, order);
+}
+
 void SortFilterFileModel::updateFilter(const SortFilterFileModel::FilterQuery &filterQuery)
 {
+    KBIBTEX_TRACE_SCOPE("gui", "SortFilterFileModel::updateFilter");
     m_filterQuery = filterQuery;
     m_filterQuery.field = filterQuery.field.toLower(); /// required for comparison in filter code
+    if (m_internalModel != nullptr && !m_filterQuery.terms.isEmpty())
+        m_filterIndex->update(m_internalModel->bibliographyFile());
+    m_filterIndex->prepareQuery(m_filterQuery);
+    updatePDFMatches();
     invalidate();
 }
 
+bool SortFilterFileModel::isPDFSearch() const
+{
+    return m_pdfTextIndex != nullptr && m_filterQuery.searchPDFfiles && m_filterQuery.field.isEmpty() && !m_filterQuery.terms.isEmpty();
+}
+
+void SortFilterFileModel::updatePDFMatches()
+{
+    m_pdfMatches.clear();
+#ifdef HAVE_POPPLERQT
+    if (!isPDFSearch() || m_internalModel == nullptr) return;
+
+    /// Locating PDF files is deferred until the first search in PDF files after a change
+    if (m_pdfTextIndexOutdated) {
+        m_pdfTextIndex->setFile(m_internalModel->bibliographyFile());
+        m_pdfTextIndexOutdated = false;
+    }
+    m_pdfMatches.reserve(m_filterQuery.terms.count());
+    for (const QString &term : const_cast<const QStringList &>(m_filterQuery.terms))
+        m_pdfMatches.append(term.isEmpty() ? QSet<const Element *>() : m_pdfTextIndex->elementsContaining(term));
+#endif // HAVE_POPPLERQT
+}
+
 bool SortFilterFileModel::simpleLessThan(const QModelIndex &left, const QModelIndex &right) const
 {
     const QString leftString = left.data(Qt::DisplayRole).toString().toLower();
@@ -152,6 +455,7 @@ bool SortFilterFileModel::filterAcceptsRow(int source_row, const QModelIndex &so
     Q_ASSERT_X(!rowElement.isNull(), "bool SortFilterFileModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const", "rowElement is NULL");
 
     if (m_filterQuery.terms.isEmpty()) return true; /// empty filter query
+    if (!m_filterIndex->isCandidate(rowElement.data())) return false; ///< cannot contain all or any terms
 
     QScopedArrayPointer<bool> eachTerm(new bool[m_filterQuery.terms.count()]);
     for (int i = m_filterQuery.terms.count() - 1; i >= 0; --i)
@@ -201,24 +505,11 @@ bool SortFilterFileModel::filterAcceptsRow(int source_row, const QModelIndex &so
             }
         }
 
-#ifdef HAVE_POPPLERQT
         /// Test associated PDF files
-        if (m_filterQuery.searchPDFfiles && m_filterQuery.field.isEmpty()) {///< not filtering for any specific field
-            const auto entryUrlList = FileInfo::entryUrls(entry, fileSourceModel()->bibliographyFile()->property(File::Url, QUrl()).toUrl(), FileInfo::TestExistence::Yes);
-            QList<QFuture<QString>> futurePdfToText;
-            for (const QUrl &url : entryUrlList) {
-                if (url.isLocalFile() && url.fileName().endsWith(QStringLiteral(".pdf")))
-                    futurePdfToText.append(QtConcurrent::run(FileInfo::pdfToText, url.toLocalFile()));
-
-                for(const QFuture<QString> &f : std::as_const(futurePdfToText)) {
-                    const QString text{f.result()};
-                    int i = 0;
-                    for (QStringList::ConstIterator itsl = m_filterQuery.terms.constBegin(); itsl != m_filterQuery.terms.constEnd(); ++itsl, ++i)
-                        eachTerm[i] |= (*itsl).isEmpty() ? true : text.contains(*itsl, Qt::CaseInsensitive);
-                }
-            }
+        if (!m_pdfMatches.isEmpty()) {
+            for (int i = m_pdfMatches.count() - 1; i >= 0; --i)
+                eachTerm[i] |= m_pdfMatches[i].contains(entry.data());
         }
-#endif // HAVE_POPPLERQT
 
         int i = 0;
         if (m_filterQuery.field.isEmpty())
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2019 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -21,11 +21,15 @@
 #define KBIBTEX_GUI_SORTFILTERFILEMODEL_H
 
 #include <QSortFilterProxyModel>
+#include <QSet>
+#include <QVector>
 
 #include <models/FileModel>
 
 #include "kbibtexgui_export.h"
 
+class PDFTextIndex;
+
 /**
  * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
  */
@@ -43,10 +47,13 @@ public:
     };
 
     explicit SortFilterFileModel(QObject *parent = nullptr);
+    ~SortFilterFileModel() override;
 
     void setSourceModel(QAbstractItemModel *model) override;
     FileModel *fileSourceModel() const;
 
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
 public Q_SLOTS:
     void updateFilter(const SortFilterFileModel::FilterQuery &);
 
@@ -55,8 +62,20 @@ protected:
     bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
 
 private:
+    class FilterIndex;
+
     FileModel *m_internalModel;
     SortFilterFileModel::FilterQuery m_filterQuery;
+    /// Narrows down rows to check in filterAcceptsRow
+    FilterIndex *m_filterIndex;
+    /// Text of associated PDF files, only available if built with Poppler
+    PDFTextIndex *m_pdfTextIndex;
+    bool m_pdfTextIndexOutdated;
+    /// For each filter term, elements whose PDF files contain this term
+    QVector<QSet<const Element *>> m_pdfMatches;
+
+    bool isPDFSearch() const;
+    void updatePDFMatches();
 
     bool simpleLessThan(const QModelIndex &left, const QModelIndex &right) const;
 };
@@ -434,7 +434,8 @@ public:
 
         /// Add color-label pairs to menu as stored
         /// in the user's configuration file
-        for (QVector<QPair<QString, QString>>::ConstIterator it = Preferences::instance().colorCodes().constBegin(); it != Preferences::instance().colorCodes().constEnd(); ++it) {
+        const QVector<QPair<QString, QString>> colorCodes = Preferences::instance().colorCodes();
+        for (QVector<QPair<QString, QString>>::ConstIterator it = colorCodes.constBegin(); it != colorCodes.constEnd(); ++it) {
             QAction *action = new QAction(QIcon(ColorLabelWidget::createSolidIcon(QColor(it->first))), it->second, menu);
             menu->addAction(action);
             const QString colorCode = it->first;
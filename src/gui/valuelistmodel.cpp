@@ -374,7 +374,8 @@ void ValueListModel::readConfiguration()
 {
     // Load mapping from color value to label from Preferences
     colorToLabel.clear();
-    for (QVector<QPair<QString, QString>>::ConstIterator it = Preferences::instance().colorCodes().constBegin(); it != Preferences::instance().colorCodes().constEnd(); ++it)
+    const QVector<QPair<QString, QString>> colorCodes = Preferences::instance().colorCodes();
+    for (QVector<QPair<QString, QString>>::ConstIterator it = colorCodes.constBegin(); it != colorCodes.constEnd(); ++it)
         colorToLabel.insert(it->first, it->second);
 }
 
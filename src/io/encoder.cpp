@@ -21,6 +21,8 @@
 
 #include <unicode/translit.h>
 
+#include <QMutex>
+
 #include "encoderlatex.h"
 #include "logging_io.h"
 
@@ -29,6 +31,8 @@ class Encoder::Private
 public:
     icu::Transliterator *translit;
     UErrorCode translitErrorCode;
+    /// Neither the transliterator nor the output buffer may be used by several threads at once
+    QMutex translitMutex;
 
     Private()
             : translit(nullptr)
@@ -128,6 +132,7 @@ QString Encoder::convertToPlainAscii(const QString &_input) const
 #else // ICU_MAJOR_VERSION < 76
     icu::UnicodeString uString {icu::UnicodeString::fromUTF8(input.toUtf8().constData())};
 #endif // ICU_MAJOR_VERSION
+    QMutexLocker locker(&d->translitMutex);
     /// Perform the actual transliteration, modifying Unicode string
     d->translit->transliterate(uString);
     if (U_FAILURE(d->translitErrorCode)) {
@@ -20,6 +20,7 @@
 #include "fileexporterbibtex.h"
 
 #include <typeinfo>
+#include <cstring>
 
 #ifdef HAVE_QTEXTCODEC
 #include <QTextCodec>
@@ -33,6 +34,7 @@
 #include <QTextStream>
 #include <QStringList>
 #include <QBuffer>
+#include <QBitArray>
 
 #include <BibTeXEntries>
 #include <BibTeXFields>
@@ -44,12 +46,33 @@
 #include <Preamble>
 #include <Value>
 #include <Comment>
+#include <Tracing>
 #include "encoderlatex.h"
 #include "fileexporter_p.h"
 #include "logging_io.h"
 
 #define normalizeText(text) (text).normalized(QString::NormalizationForm_C)
 
+/**
+ * Determine the length of the run of ASCII characters starting at @p begin.
+ * Four UTF-16 code units are tested at once by masking a 64-bit word,
+ * which is independent of byte order as the mask is the same for each unit.
+ */
+static inline int asciiRunLength(const QChar *begin, const QChar *end)
+{
+    const QChar *it = begin;
+    while (end - it >= 4) {
+        quint64 word;
+        std::memcpy(&word, it, sizeof(word));
+        if ((word & Q_UINT64_C(0xff80ff80ff80ff80)) != 0)
+            break;
+        it += 4;
+    }
+    while (it < end && it->unicode() < 128)
+        ++it;
+    return static_cast<int>(it - begin);
+}
+
 class FileExporterBibTeX::Private
 {
 private:
@@ -149,8 +172,9 @@ public:
         if (U_FAILURE(uConvErrorCode))
             return false;
 
-        static const size_t buffer_size{256};
-        static char buffer[buffer_size];
+        /// A single character needs only a few bytes, even with escape sequences
+        static const size_t buffer_size{32};
+        char buffer[buffer_size];
         const icu::UnicodeString uText(u);
         uConvErrorCode = U_ZERO_ERROR;
         const int32_t len{ucnv_fromUChars(uconv, buffer, buffer_size, uText.getBuffer(), uText.length(), &uConvErrorCode)};
@@ -158,6 +182,45 @@ public:
     }
 #endif // HAVE_QTEXTCODEC
 
+private:
+    /// Name of the encoding the encodability map was determined for
+    QString encodabilityMapEncoding;
+    /// One bit per character in the Basic Multilingual Plane telling
+    /// if the target encoding can represent this character
+    QBitArray encodabilityMap;
+    /// One bit per block of 256 characters telling if the
+    /// block's bits in the encodability map have been determined
+    QBitArray encodabilityMapBlocks;
+
+    /// Discard the encodability map unless it was determined for the given encoding
+    void prepareEncodabilityMap(const QString &encodingName) {
+        if (encodingName != encodabilityMapEncoding) {
+            encodabilityMapEncoding = encodingName;
+            encodabilityMap = QBitArray(0x10000);
+            encodabilityMapBlocks = QBitArray(0x100);
+        }
+    }
+
+#ifdef HAVE_QTEXTCODEC
+    inline bool isEncodable(const QChar c, QTextCodec *codec) {
+#else // HAVE_QTEXTCODEC
+    inline bool isEncodable(const QChar c, const QString &encoding) {
+#endif // HAVE_QTEXTCODEC
+        const int block = c.unicode() >> 8;
+        if (!encodabilityMapBlocks.testBit(block)) {
+            /// Testing characters one by one is expensive, but
+            /// has to be done only once per block and encoding
+            for (int u = block << 8; u < (block + 1) << 8; ++u)
+#ifdef HAVE_QTEXTCODEC
+                encodabilityMap.setBit(u, canEncode(QChar(u), codec));
+#else // HAVE_QTEXTCODEC
+                encodabilityMap.setBit(u, canEncode(QChar(u), encoding));
+#endif // HAVE_QTEXTCODEC
+            encodabilityMapBlocks.setBit(block);
+        }
+        return encodabilityMap.testBit(c.unicode());
+    }
+
 public:
     QChar stringOpenDelimiter;
     QChar stringCloseDelimiter;
@@ -208,58 +271,78 @@ public:
     }
 
     void loadPreferencesAndProperties(const File *bibtexfile) {
+        /// Properties of a File object overturn the global preferences;
+        /// the preferences are only read for properties the File object
+        /// lacks, so that exporting a File carrying all its properties
+        /// does not depend on the preferences at all
+        const auto hasProperty = [bibtexfile](const QString &key) {
+            return bibtexfile != nullptr && bibtexfile->hasProperty(key);
+        };
+
+        if (hasProperty(File::Encoding))
+            encoding = bibtexfile->property(File::Encoding).toString();
+        else
 #ifdef HAVE_KF
-        encoding = Preferences::instance().bibTeXEncoding();
-        QString stringDelimiter = Preferences::instance().bibTeXStringDelimiter();
-        if (stringDelimiter.length() != 2)
-            stringDelimiter = Preferences::defaultBibTeXStringDelimiter;
+            encoding = Preferences::instance().bibTeXEncoding();
+#else // HAVE_KF
+            encoding = QStringLiteral("LaTeX");
+#endif // HAVE_KF
+
+        QString stringDelimiter;
+        if (hasProperty(File::StringDelimiter))
+            stringDelimiter = bibtexfile->property(File::StringDelimiter).toString();
+        else
+#ifdef HAVE_KF
+            stringDelimiter = Preferences::instance().bibTeXStringDelimiter();
 #else // HAVE_KF
-        encoding = QStringLiteral("LaTeX");
-        const QString stringDelimiter = QStringLiteral("{}");
+            stringDelimiter = QStringLiteral("{}");
 #endif // HAVE_KF
+        if (stringDelimiter.length() != 2)
+            stringDelimiter = Preferences::defaultBibTeXStringDelimiter;
         stringOpenDelimiter = stringDelimiter[0];
         stringCloseDelimiter = stringDelimiter[1];
+
+        if (hasProperty(File::KeywordCasing))
+            keywordCasing = static_cast<KBibTeX::Casing>(bibtexfile->property(File::KeywordCasing).toInt());
+        else
 #ifdef HAVE_KF
-        keywordCasing = Preferences::instance().bibTeXKeywordCasing();
-        protectCasing = Preferences::instance().bibTeXProtectCasing() ? Qt::Checked : Qt::Unchecked;
-        listSeparator =  Preferences::instance().bibTeXListSeparator();
-        sortedByIdentifier = Preferences::instance().bibTeXEntriesSortedByIdentifier();
+            keywordCasing = Preferences::instance().bibTeXKeywordCasing();
 #else // HAVE_KF
-        keywordCasing = KBibTeX::Casing::LowerCase;
-        protectCasing = Qt::PartiallyChecked;
-        listSeparator = QStringLiteral("; ");
-        sortedByIdentifier = false;
+            keywordCasing = KBibTeX::Casing::LowerCase;
+#endif // HAVE_KF
+
+        if (hasProperty(File::ProtectCasing))
+            protectCasing = static_cast<Qt::CheckState>(bibtexfile->property(File::ProtectCasing).toInt());
+        else
+#ifdef HAVE_KF
+            protectCasing = Preferences::instance().bibTeXProtectCasing() ? Qt::Checked : Qt::Unchecked;
+#else // HAVE_KF
+            protectCasing = Qt::PartiallyChecked;
+#endif // HAVE_KF
+
+        /// If the user set "use global default", this property is an empty string,
+        /// in this case use the global preferences as well
+        personNameFormatting = hasProperty(File::NameFormatting) ? bibtexfile->property(File::NameFormatting).toString() : QString();
+        if (personNameFormatting.isEmpty())
+            personNameFormatting = Preferences::instance().personNameFormat();
+
+        if (hasProperty(File::ListSeparator))
+            listSeparator = bibtexfile->property(File::ListSeparator).toString();
+        else
+#ifdef HAVE_KF
+            listSeparator = Preferences::instance().bibTeXListSeparator();
+#else // HAVE_KF
+            listSeparator = QStringLiteral("; ");
+#endif // HAVE_KF
+
+        if (hasProperty(File::SortedByIdentifier))
+            sortedByIdentifier = bibtexfile->property(File::SortedByIdentifier).toBool();
+        else
+#ifdef HAVE_KF
+            sortedByIdentifier = Preferences::instance().bibTeXEntriesSortedByIdentifier();
+#else // HAVE_KF
+            sortedByIdentifier = false;
 #endif // HAVE_KF
-        personNameFormatting = Preferences::instance().personNameFormat();
-
-        /// Check if a valid File object was provided
-        if (bibtexfile != nullptr) {
-            /// If there is a File object, extract its properties which
-            /// overturn the global preferences
-            if (bibtexfile->hasProperty(File::Encoding))
-                encoding = bibtexfile->property(File::Encoding).toString();
-            if (bibtexfile->hasProperty(File::StringDelimiter)) {
-                QString stringDelimiter = bibtexfile->property(File::StringDelimiter).toString();
-                if (stringDelimiter.length() != 2)
-                    stringDelimiter = Preferences::defaultBibTeXStringDelimiter;
-                stringOpenDelimiter = stringDelimiter[0];
-                stringCloseDelimiter = stringDelimiter[1];
-            }
-            if (bibtexfile->hasProperty(File::KeywordCasing))
-                keywordCasing = static_cast<KBibTeX::Casing>(bibtexfile->property(File::KeywordCasing).toInt());
-            if (bibtexfile->hasProperty(File::ProtectCasing))
-                protectCasing = static_cast<Qt::CheckState>(bibtexfile->property(File::ProtectCasing).toInt());
-            if (bibtexfile->hasProperty(File::NameFormatting)) {
-                /// if the user set "use global default", this property is an empty string
-                /// in this case, keep default value
-                const QString buffer = bibtexfile->property(File::NameFormatting).toString();
-                personNameFormatting = buffer.isEmpty() ? personNameFormatting : buffer;
-            }
-            if (bibtexfile->hasProperty(File::ListSeparator))
-                listSeparator = bibtexfile->property(File::ListSeparator).toString();
-            if (bibtexfile->hasProperty(File::SortedByIdentifier))
-                sortedByIdentifier = bibtexfile->property(File::SortedByIdentifier).toBool();
-        }
     }
 
     QString internalValueToBibTeX(const Value &value, const Encoder::TargetEncoding targetEncoding, const QString &key = QString())
@@ -713,7 +796,53 @@ public:
         return false;
     }
 
-    QByteArray applyEncoding(const QString &input) {
+#ifndef HAVE_QTEXTCODEC
+    /**
+     * Convert text with the given converter and write the result to the
+     * device. Conversion happens in blocks of bounded size, so neither
+     * the converted data as a whole nor any static buffer is needed.
+     * If conversion fails before any block was written, the text gets
+     * written as UTF-8 instead. Blocks already written cannot be taken
+     * back, so a failure after that is reported by returning false.
+     * As unencodable characters get substituted, conversion fails only
+     * on internal converter errors anyway.
+     */
+    bool writeConverted(UConverter *uconv, const QString &text, QIODevice *iodevice) {
+        static const int32_t blockSize{1 << 16};
+        QByteArray block(blockSize, Qt::Uninitialized);
+        const UChar *source{reinterpret_cast<const UChar *>(text.utf16())};
+        const UChar *const sourceLimit{source + text.length()};
+        qint64 written{0};
+
+        ucnv_resetFromUnicode(uconv);
+        do {
+            char *target{block.data()};
+            uConvErrorCode = U_ZERO_ERROR;
+            /// All input is available, so flush converter's state at its end
+            ucnv_fromUnicode(uconv, &target, block.data() + blockSize, &source, sourceLimit, nullptr, true, &uConvErrorCode);
+            if (U_FAILURE(uConvErrorCode) && uConvErrorCode != U_BUFFER_OVERFLOW_ERROR)
+                break;
+            const qint64 len{target - block.constData()};
+            if (len > 0) {
+                if (iodevice->write(block.constData(), len) != len)
+                    return false;
+                written += len;
+            }
+        } while (uConvErrorCode == U_BUFFER_OVERFLOW_ERROR);
+
+        if (U_FAILURE(uConvErrorCode)) {
+            UErrorCode nameErrorCode{U_ZERO_ERROR};
+            qCWarning(LOG_KBIBTEX_IO) << "Conversion to" << ucnv_getName(uconv, &nameErrorCode) << "failed after" << written << "bytes:" << u_errorName(uConvErrorCode);
+            if (written > 0)
+                return false;
+            const QByteArray utf8Data{text.toUtf8()};
+            return iodevice->write(utf8Data) == utf8Data.length();
+        }
+        return written > 0 || text.isEmpty();
+    }
+#endif // not HAVE_QTEXTCODEC
+
+    bool applyEncoding(const QString &input, QIODevice *iodevice) {
         const auto dtc{determineTargetCodec()};
         const Encoder::TargetEncoding targetEncoding{dtc.first};
 #ifdef HAVE_QTEXTCODEC
@@ -724,16 +853,42 @@ public:
 
         QString rewrittenInput;
         rewrittenInput.reserve(input.length() * 12 / 10 /* add 20% */ + 1024 /* plus 1K */);
-        const Encoder &laTeXEncoder = EncoderLaTeX::instance();
-        for (const QChar &c : input) {
 #ifdef HAVE_QTEXTCODEC
-            if (codec == nullptr /** meaning UTF-8, which can encode anything */ || canEncode(c, codec))
+        if (codec == nullptr /** meaning UTF-8, which can encode anything */)
 #else //HAVE_QTEXTCODEC
-            if (targetEncoding == Encoder::TargetEncoding::UTF8 || encoding.startsWith(QStringLiteral("utf-")) || canEncode(c, encoding))
+        if (targetEncoding == Encoder::TargetEncoding::UTF8 || encoding.startsWith(QStringLiteral("utf-")))
 #endif // HAVE_QTEXTCODEC
-                rewrittenInput.append(c);
-            else
-                rewrittenInput.append(laTeXEncoder.encode(QString(c), Encoder::TargetEncoding::ASCII));
+            rewrittenInput.append(input);
+        else {
+            /// Copy runs of encodable characters as a whole and rewrite only
+            /// those characters the target encoding cannot represent.
+            /// ASCII characters are assumed to be encodable in any encoding
+            /// and skipped in bulk, as they make up most of typical BibTeX data
+#ifdef HAVE_QTEXTCODEC
+            prepareEncodabilityMap(QString::fromLatin1(codec->name()));
+#else //HAVE_QTEXTCODEC
+            prepareEncodabilityMap(encoding);
+#endif // HAVE_QTEXTCODEC
+            const Encoder &laTeXEncoder = EncoderLaTeX::instance();
+            const QChar *const end = input.constData() + input.length();
+            const QChar *runStart = input.constData();
+            for (const QChar *it = runStart; it < end;) {
+                it += asciiRunLength(it, end);
+                if (it == end)
+                    break;
+#ifdef HAVE_QTEXTCODEC
+                if (isEncodable(*it, codec)) {
+#else //HAVE_QTEXTCODEC
+                if (isEncodable(*it, encoding)) {
+#endif // HAVE_QTEXTCODEC
+                    ++it;
+                    continue;
+                }
+                rewrittenInput.append(runStart, static_cast<int>(it - runStart));
+                rewrittenInput.append(laTeXEncoder.encode(QString(*it), Encoder::TargetEncoding::ASCII));
+                runStart = ++it;
+            }
+            rewrittenInput.append(runStart, static_cast<int>(end - runStart));
         }
 
 #ifdef HAVE_QTEXTCODEC
@@ -763,11 +918,11 @@ public:
                 if (codec == nullptr) {
                     if (lowerNormalizedEncodingForComment != QStringLiteral("utf8") && lowerNormalizedEncodingForComment != QStringLiteral("latex")) {
                         qCWarning(LOG_KBIBTEX_IO) << "No codec (means UTF-8 encoded output) does not match with encoding" << encodingForComment;
-                        return QByteArray();
+                        return false;
                     }
                 } else if (lowerNormalizedCodecName != lowerNormalizedEncodingForComment) {
                     qCWarning(LOG_KBIBTEX_IO) << "Codec with name" << codec->name() << "does not match with encoding" << encodingForComment;
-                    return QByteArray();
+                    return false;
                 }
             }
 #endif // HAVE_QTEXTCODEC
@@ -786,41 +941,26 @@ public:
         rewrittenInput.squeeze();
 
 #ifdef HAVE_QTEXTCODEC
-        return codec == nullptr ? rewrittenInput.toUtf8() : codec->fromUnicode(rewrittenInput);
+        const QByteArray outputData = codec == nullptr ? rewrittenInput.toUtf8() : codec->fromUnicode(rewrittenInput);
 #else // HAVE_QTEXTCODEC
-        uConvErrorCode = U_ZERO_ERROR;
-        UConverter *uconv{uconvGetterForEncoding(encoding)};
-        if (uconv == nullptr)
-            return  rewrittenInput.toUtf8();
-        else {
-            static const size_t buffer_size{1 << 24};
-            static char buffer[buffer_size];
-#if (ICU_MAJOR_VERSION >= 76)
-            icu::UnicodeString text {icu::UnicodeString(rewrittenInput.toStdU16String())};
-#else // ICU_MAJOR_VERSION < 76
-            icu::UnicodeString text {icu::UnicodeString::fromUTF8(rewrittenInput.toUtf8().constData())};
-#endif // ICU_MAJOR_VERSION
-            uConvErrorCode = U_ZERO_ERROR;
-            const int32_t len{ucnv_fromUChars(uconv, buffer, buffer_size, text.getBuffer(), text.length(), &uConvErrorCode)};
-            if (U_FAILURE(uConvErrorCode) || (len == 0 && text.length() > 0)) {
-                qWarning() << "Conversion to" << encoding << "failed: " << u_errorName(uConvErrorCode);
-                return rewrittenInput.toUtf8();
-            } else
-                return QByteArray(buffer, len);
-        }
+        UConverter *uconv{encoding == QStringLiteral("utf-8") ? nullptr : uconvGetterForEncoding(encoding)};
+        if (uconv != nullptr)
+            return writeConverted(uconv, rewrittenInput, iodevice);
+        /// UTF-8 needs no converter, which is also the fallback if none could be created
+        const QByteArray outputData = rewrittenInput.toUtf8();
 #endif // HAVE_QTEXTCODEC
+        if (outputData.isEmpty()) {
+            qCWarning(LOG_KBIBTEX_IO) << "outputData.length() is" << outputData.length();
+            return false;
+        }
+        return iodevice->write(outputData) == outputData.length();
     }
 
     bool writeOutString(const QString &outputString, QIODevice *iodevice) {
         bool result = outputString.length() > 0;
 
         if (result) {
-            const QByteArray outputData = applyEncoding(outputString);
-            result &= outputData.length() > 0;
-            if (!result)
-                qCWarning(LOG_KBIBTEX_IO) << "outputData.length() is" << outputData.length();
-            if (result)
-                result &= iodevice->write(outputData) == outputData.length();
+            result &= applyEncoding(outputString, iodevice);
             if (!result)
                 qCWarning(LOG_KBIBTEX_IO) << "Writing data to IO device failed, not everything was written";
         } else
@@ -894,6 +1034,7 @@ QString FileExporterBibTeX::toString(const File *bibtexfile)
 
 bool FileExporterBibTeX::save(QIODevice *iodevice, const File *bibtexfile)
 {
+    KBIBTEX_TRACE_SCOPE("io", "FileExporterBibTeX::save");
     d->cancelFlag = false;
 
     check_if_bibtexfile_or_iodevice_invalid(bibtexfile, iodevice);
@@ -909,6 +1050,7 @@ bool FileExporterBibTeX::save(QIODevice *iodevice, const File *bibtexfile)
 
 bool FileExporterBibTeX::save(QIODevice *iodevice, const QSharedPointer<const Element> &element, const File *bibtexfile)
 {
+    KBIBTEX_TRACE_SCOPE("io", "FileExporterBibTeX::save (element)");
     d->cancelFlag = false;
 
     check_if_iodevice_invalid(iodevice);
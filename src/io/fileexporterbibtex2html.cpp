@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -67,7 +67,8 @@ public:
         args << QStringLiteral("-debug"); /// verbose mode (to find incorrect BibTeX entries)
         args << bibTeXFilename;
 
-        bool result = p->runProcess(QStringLiteral("bibtex2html"), args) && p->writeFileToIODevice(outputFilename, iodevice);
+        const ToolchainStep bibtex2html {QStringLiteral("bibtex2html"), args, {bibTeXFilename}, {outputFilename}};
+        bool result = p->runSteps({bibtex2html}) && p->writeFileToIODevice(outputFilename, iodevice);
 
         return result;
     }
@@ -111,7 +112,7 @@ public:
 };
 
 FileExporterBibTeX2HTML::FileExporterBibTeX2HTML(QObject *parent)
-        : FileExporterToolchain(parent), d(new FileExporterBibTeX2HTMLPrivate(this, tempDir.path()))
+        : FileExporterToolchain(parent), d(new FileExporterBibTeX2HTMLPrivate(this, workingDirectory()))
 {
     /// nothing
 }
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -38,7 +38,7 @@ FileExporterBibTeXOutput::FileExporterBibTeXOutput(OutputType outputType, QObjec
         : FileExporterToolchain(parent), m_outputType(outputType)
 {
     m_fileBasename = QStringLiteral("bibtex-to-output");
-    m_fileStem = tempDir.path() + QDir::separator() + m_fileBasename;
+    m_fileStem = workingDirectory() + QDir::separator() + m_fileBasename;
 }
 
 FileExporterBibTeXOutput::~FileExporterBibTeXOutput()
@@ -92,13 +92,28 @@ bool FileExporterBibTeXOutput::save(QIODevice *iodevice, const QSharedPointer<co
     return result;
 }
 
-bool FileExporterBibTeXOutput::generateOutput()
+void FileExporterBibTeXOutput::setLaTeXLanguage(const QString &language)
 {
-    const QStringList cmdLinesBeforeBibTeX {QStringLiteral("pdflatex -halt-on-error ") + m_fileBasename + KBibTeX::extensionTeX};
-    const QStringList bibTeXarguments {m_fileBasename + KBibTeX::extensionAux};
-    const QStringList cmdLinesAfterBibTeX {};
+    m_laTeXLanguage = language;
+}
 
-    if (writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runProcesses(cmdLinesBeforeBibTeX) && runProcess(QStringLiteral("bibtex"), bibTeXarguments, true) && runProcesses(cmdLinesAfterBibTeX))
+void FileExporterBibTeXOutput::setLaTeXBibliographyStyle(const QString &bibStyle)
+{
+    m_laTeXBibliographyStyle = bibStyle;
+}
+
+bool FileExporterBibTeXOutput::generateOutput()
+{
+    const QString texFilename = m_fileBasename + KBibTeX::extensionTeX;
+    const QString auxFilename = m_fileBasename + KBibTeX::extensionAux;
+    /// With \nocite{*}, the .aux file does not depend on the bibliography,
+    /// so LaTeX has to run only once per working directory. BibTeX is
+    /// skipped if the bibliography did not change since the last export,
+    /// so its messages are only reliably available from the .blg file
+    const ToolchainStep latex {QStringLiteral("pdflatex"), {QStringLiteral("-halt-on-error"), texFilename}, {texFilename}, {auxFilename}};
+    const ToolchainStep bibtex {QStringLiteral("bibtex"), {auxFilename}, {auxFilename, m_fileBasename + KBibTeX::extensionBibTeX}, {m_fileBasename + KBibTeX::extensionBBL, m_fileBasename + KBibTeX::extensionBLG}};
+
+    if (writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runSteps({latex}) && runSteps({bibtex}, true))
         return true;
     else {
         qCWarning(LOG_KBIBTEX_IO) << "Generating BibTeX output failed";
@@ -121,12 +136,12 @@ bool FileExporterBibTeXOutput::writeLatexFile(const QString &filename)
         ts << "\\usepackage[T1]{fontenc}\n";
         ts << "\\usepackage[utf8]{inputenc}\n";
         if (kpsewhich(QStringLiteral("babel.sty")))
-            ts << "\\usepackage[" << Preferences::instance().laTeXBabelLanguage() << "]{babel}\n";
+            ts << "\\usepackage[" << (m_laTeXLanguage.isEmpty() ? Preferences::instance().laTeXBabelLanguage() : m_laTeXLanguage) << "]{babel}\n";
         if (kpsewhich(QStringLiteral("hyperref.sty")))
             ts << "\\usepackage[pdfproducer={KBibTeX: https://userbase.kde.org/KBibTeX},pdftex]{hyperref}\n";
         else if (kpsewhich(QStringLiteral("url.sty")))
             ts << "\\usepackage{url}\n";
-        const QString latexBibStyle = Preferences::instance().bibTeXBibliographyStyle();
+        const QString latexBibStyle = m_laTeXBibliographyStyle.isEmpty() ? Preferences::instance().bibTeXBibliographyStyle() : m_laTeXBibliographyStyle;
         ts << "\\bibliographystyle{" << latexBibStyle << "}\n";
         ts << "\\begin{document}\n";
         ts << "\\nocite{*}\n";
@@ -43,10 +43,17 @@ public:
     bool save(QIODevice *iodevice, const File *bibtexfile) override;
     bool save(QIODevice *iodevice, const QSharedPointer<const Element> &element, const File *bibtexfile) override;
 
+    /// Language for LaTeX's babel package; if not set, taken from the preferences
+    void setLaTeXLanguage(const QString &language);
+    /// BibTeX style to use; if not set, taken from the preferences
+    void setLaTeXBibliographyStyle(const QString &bibStyle);
+
 private:
     OutputType m_outputType;
     QString m_fileBasename;
     QString m_fileStem;
+    QString m_laTeXLanguage;
+    QString m_laTeXBibliographyStyle;
 
     bool generateOutput();
     bool writeLatexFile(const QString &filename);
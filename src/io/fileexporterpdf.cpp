@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -38,7 +38,7 @@ FileExporterPDF::FileExporterPDF(QObject *parent)
         : FileExporterToolchain(parent)
 {
     m_fileBasename = QStringLiteral("bibtex-to-pdf");
-    m_fileStem = tempDir.path() + QDir::separator() + m_fileBasename;
+    m_fileStem = workingDirectory() + QDir::separator() + m_fileBasename;
 
     setFileEmbedding(FileExporterPDF::FileEmbedding::BibTeXFileAndReferences);
 }
@@ -112,9 +112,19 @@ void FileExporterPDF::setFileEmbedding(const FileEmbeddings fileEmbedding) {
 
 bool FileExporterPDF::generatePDF(QIODevice *iodevice)
 {
-    QStringList cmdLines {QStringLiteral("pdflatex -halt-on-error ") + m_fileStem + KBibTeX::extensionTeX, QStringLiteral("bibtex ") + m_fileStem + KBibTeX::extensionAux, QStringLiteral("pdflatex -halt-on-error ") + m_fileStem + KBibTeX::extensionTeX, QStringLiteral("pdflatex -halt-on-error ") + m_fileStem + KBibTeX::extensionTeX};
-
-    return writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runProcesses(cmdLines) && writeFileToIODevice(m_fileStem + KBibTeX::extensionPDF, iodevice);
+    const QString texFilename = m_fileBasename + KBibTeX::extensionTeX;
+    const QString auxFilename = m_fileBasename + KBibTeX::extensionAux;
+    const QString bblFilename = m_fileBasename + KBibTeX::extensionBBL;
+    /// Embedded files become part of the PDF document,
+    /// so a change in them requires another LaTeX pass
+    QStringList latexInputFiles {texFilename, auxFilename, bblFilename};
+    for (const QString &embeddedFile : const_cast<const QStringList &>(m_embeddedFileList))
+        latexInputFiles.append(embeddedFile.section(QStringLiteral("|"), 1, 1));
+
+    const ToolchainStep latex {QStringLiteral("pdflatex"), {QStringLiteral("-halt-on-error"), texFilename}, latexInputFiles, {m_fileBasename + KBibTeX::extensionPDF}};
+    const ToolchainStep bibtex {QStringLiteral("bibtex"), {auxFilename}, {auxFilename, m_fileBasename + KBibTeX::extensionBibTeX}, {bblFilename}};
+
+    return writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runSteps({latex, bibtex, latex, latex}) && writeFileToIODevice(m_fileStem + KBibTeX::extensionPDF, iodevice);
 }
 
 bool FileExporterPDF::writeLatexFile(const QString &filename)
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -34,7 +34,7 @@ FileExporterPS::FileExporterPS(QObject *parent)
         : FileExporterToolchain(parent)
 {
     m_fileBasename = QStringLiteral("bibtex-to-ps");
-    m_fileStem = tempDir.path() + QDir::separator() + m_fileBasename;
+    m_fileStem = workingDirectory() + QDir::separator() + m_fileBasename;
 }
 
 FileExporterPS::~FileExporterPS()
@@ -84,9 +84,11 @@ bool FileExporterPS::save(QIODevice *iodevice, const QSharedPointer<const Elemen
 
 bool FileExporterPS::generatePS(QIODevice *iodevice)
 {
-    QStringList cmdLines {QStringLiteral("latex -halt-on-error bibtex-to-ps.tex"), QStringLiteral("bibtex bibtex-to-ps"), QStringLiteral("latex -halt-on-error bibtex-to-ps.tex"), QStringLiteral("latex -halt-on-error bibtex-to-ps.tex"), QStringLiteral("dvips -R2 -o bibtex-to-ps.ps bibtex-to-ps.dvi")};
+    const ToolchainStep latex {QStringLiteral("latex"), {QStringLiteral("-halt-on-error"), QStringLiteral("bibtex-to-ps.tex")}, {QStringLiteral("bibtex-to-ps.tex"), QStringLiteral("bibtex-to-ps.aux"), QStringLiteral("bibtex-to-ps.bbl")}, {QStringLiteral("bibtex-to-ps.dvi")}};
+    const ToolchainStep bibtex {QStringLiteral("bibtex"), {QStringLiteral("bibtex-to-ps")}, {QStringLiteral("bibtex-to-ps.aux"), QStringLiteral("bibtex-to-ps.bib")}, {QStringLiteral("bibtex-to-ps.bbl")}};
+    const ToolchainStep dvips {QStringLiteral("dvips"), {QStringLiteral("-R2"), QStringLiteral("-o"), QStringLiteral("bibtex-to-ps.ps"), QStringLiteral("bibtex-to-ps.dvi")}, {QStringLiteral("bibtex-to-ps.dvi")}, {QStringLiteral("bibtex-to-ps.ps")}};
 
-    return writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runProcesses(cmdLines) && beautifyPostscriptFile(m_fileStem + KBibTeX::extensionPostScript, QStringLiteral("Exported Bibliography")) && writeFileToIODevice(m_fileStem + KBibTeX::extensionPostScript, iodevice);
+    return writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runSteps({latex, bibtex, latex, latex, dvips}) && beautifyPostscriptFile(m_fileStem + KBibTeX::extensionPostScript, QStringLiteral("Exported Bibliography")) && writeFileToIODevice(m_fileStem + KBibTeX::extensionPostScript, iodevice);
 }
 
 bool FileExporterPS::writeLatexFile(const QString &filename)
@@ -164,7 +166,7 @@ bool FileExporterPS::beautifyPostscriptFile(const QString &filename, const QStri
         while (!(line = ts.readLine()).isNull()) {
             if (i < 32 && line.startsWith(QStringLiteral("%%Title:")))
                 line = QStringLiteral("%%Title: ") + title;
-            else if (i < 32 && line.startsWith(QStringLiteral("%%Creator:")))
+            else if (i < 32 && line.startsWith(QStringLiteral("%%Creator:")) && !line.contains(QStringLiteral("exported from within KBibTeX"))) ///< file may have been beautified in an earlier export
                 line += QStringLiteral("; exported from within KBibTeX: https://userbase.kde.org/KBibTeX");
             lines += line;
             ++i;
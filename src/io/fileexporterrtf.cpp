@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -35,7 +35,7 @@ FileExporterRTF::FileExporterRTF(QObject *parent)
         : FileExporterToolchain(parent)
 {
     m_fileBasename = QStringLiteral("bibtex-to-rtf");
-    m_fileStem = tempDir.path() + QDir::separator() + m_fileBasename;
+    m_fileStem = workingDirectory() + QDir::separator() + m_fileBasename;
 }
 
 FileExporterRTF::~FileExporterRTF()
@@ -85,9 +85,12 @@ bool FileExporterRTF::save(QIODevice *iodevice, const QSharedPointer<const Eleme
 
 bool FileExporterRTF::generateRTF(QIODevice *iodevice)
 {
-    QStringList cmdLines {QStringLiteral("latex -halt-on-error bibtex-to-rtf.tex"), QStringLiteral("bibtex bibtex-to-rtf"), QStringLiteral("latex -halt-on-error bibtex-to-rtf.tex"), QString(QStringLiteral("latex2rtf -i %1 bibtex-to-rtf.tex")).arg(Preferences::instance().laTeXBabelLanguage())};
+    const QStringList latexInputFiles {QStringLiteral("bibtex-to-rtf.tex"), QStringLiteral("bibtex-to-rtf.aux"), QStringLiteral("bibtex-to-rtf.bbl")};
+    const ToolchainStep latex {QStringLiteral("latex"), {QStringLiteral("-halt-on-error"), QStringLiteral("bibtex-to-rtf.tex")}, latexInputFiles, {QStringLiteral("bibtex-to-rtf.dvi")}};
+    const ToolchainStep bibtex {QStringLiteral("bibtex"), {QStringLiteral("bibtex-to-rtf")}, {QStringLiteral("bibtex-to-rtf.aux"), QStringLiteral("bibtex-to-rtf.bib")}, {QStringLiteral("bibtex-to-rtf.bbl")}};
+    const ToolchainStep latex2rtf {QStringLiteral("latex2rtf"), {QStringLiteral("-i"), Preferences::instance().laTeXBabelLanguage(), QStringLiteral("bibtex-to-rtf.tex")}, latexInputFiles, {QStringLiteral("bibtex-to-rtf.rtf")}};
 
-    return writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runProcesses(cmdLines) && writeFileToIODevice(m_fileStem + KBibTeX::extensionRTF, iodevice);
+    return writeLatexFile(m_fileStem + KBibTeX::extensionTeX) && runSteps({latex, bibtex, latex, latex2rtf}) && writeFileToIODevice(m_fileStem + KBibTeX::extensionRTF, iodevice);
 }
 
 bool FileExporterRTF::writeLatexFile(const QString &filename)
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2022 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -22,8 +22,14 @@
 #include <QCoreApplication>
 #include <QStringList>
 #include <QFile>
+#include <QFileInfo>
 #include <QDir>
 #include <QHash>
+#include <QMutex>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QCryptographicHash>
+#include <QAtomicInteger>
 #include <QTextStream>
 #include <QProcess>
 #include <QProcessEnvironment>
@@ -36,12 +42,185 @@
 #define i18n(text) QObject::tr(text)
 #endif // HAVE_KFI18N
 
+#include <KBibTeX>
+#include <Tracing>
+
 #include "logging_io.h"
 
+class ToolchainWorkingDirectory
+{
+public:
+    QTemporaryDir temporaryDir;
+    /// Fingerprints of the inputs of each step that last ran
+    /// successfully in this directory, keyed by its command line
+    QHash<QString, QByteArray> stamps;
+
+    ToolchainWorkingDirectory() {
+        temporaryDir.setAutoRemove(true);
+    }
+};
+
+/**
+ * Working directories not used by any exporter at the moment.
+ * Only a few directories are kept, as usually exports happen
+ * one at a time or in a small number of worker threads.
+ */
+class ToolchainWorkingDirectoryPool
+{
+public:
+    static ToolchainWorkingDirectoryPool &instance() {
+        static ToolchainWorkingDirectoryPool singleton;
+        return singleton;
+    }
+
+    QSharedPointer<ToolchainWorkingDirectory> acquire() {
+        if (persistent.loadAcquire() != 0) {
+            QMutexLocker locker(&mutex);
+            while (!idle.isEmpty()) {
+                QSharedPointer<ToolchainWorkingDirectory> directory = idle.takeLast();
+                if (directory->temporaryDir.isValid() && QFileInfo::exists(directory->temporaryDir.path()))
+                    return directory;
+            }
+        }
+        return QSharedPointer<ToolchainWorkingDirectory>(new ToolchainWorkingDirectory());
+    }
+
+    void release(const QSharedPointer<ToolchainWorkingDirectory> &directory) {
+        if (persistent.loadAcquire() == 0 || !directory->temporaryDir.isValid())
+            return;
+        QMutexLocker locker(&mutex);
+        if (idle.size() < qMax(2, QThread::idealThreadCount()))
+            idle.append(directory);
+    }
+
+    void setPersistent(bool _persistent) {
+        persistent.storeRelease(_persistent ? 1 : 0);
+        if (!_persistent) {
+            QMutexLocker locker(&mutex);
+            idle.clear();
+        }
+    }
+
+    bool isPersistent() const {
+        return persistent.loadAcquire() != 0;
+    }
+
+private:
+    QMutex mutex;
+    QVector<QSharedPointer<ToolchainWorkingDirectory>> idle;
+    QAtomicInteger<int> persistent;
+
+    ToolchainWorkingDirectoryPool()
+            : persistent(1) {
+        /// nothing
+    }
+};
+
 FileExporterToolchain::FileExporterToolchain(QObject *parent)
-        : FileExporter(parent)
+        : FileExporter(parent), m_workingDirectory(ToolchainWorkingDirectoryPool::instance().acquire())
+{
+    /// nothing
+}
+
+FileExporterToolchain::~FileExporterToolchain()
+{
+    ToolchainWorkingDirectoryPool::instance().release(m_workingDirectory);
+}
+
+void FileExporterToolchain::setPersistentWorkingDirectories(bool persistent)
+{
+    ToolchainWorkingDirectoryPool::instance().setPersistent(persistent);
+}
+
+bool FileExporterToolchain::persistentWorkingDirectories()
+{
+    return ToolchainWorkingDirectoryPool::instance().isPersistent();
+}
+
+QString FileExporterToolchain::workingDirectory() const
+{
+    return m_workingDirectory->temporaryDir.path();
+}
+
+QByteArray FileExporterToolchain::fingerprint(const ToolchainStep &step) const
 {
-    tempDir.setAutoRemove(true);
+    static const QByteArray missingFile = QByteArrayLiteral("\0missing");
+    /// BibTeX reads only a few commands from .aux files, ignoring
+    /// for example the \bibcite lines LaTeX adds in later passes
+    static const QVector<QByteArray> bibTeXAuxCommands {QByteArrayLiteral("\\citation"), QByteArrayLiteral("\\bibdata"), QByteArrayLiteral("\\bibstyle"), QByteArrayLiteral("\\@input")};
+    const bool isBibTeX = step.program == QStringLiteral("bibtex");
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(step.program.toUtf8());
+    for (const QString &argument : step.arguments) {
+        hash.addData("\0", 1);
+        hash.addData(argument.toUtf8());
+    }
+    const QDir dir(workingDirectory());
+    for (const QString &inputFile : step.inputFiles) {
+        hash.addData("\0", 1);
+        hash.addData(inputFile.toUtf8());
+        QFile file(dir.absoluteFilePath(inputFile));
+        if (!file.open(QIODevice::ReadOnly)) {
+            hash.addData(missingFile);
+            continue;
+        }
+        if (isBibTeX && inputFile.endsWith(KBibTeX::extensionAux)) {
+            while (!file.atEnd()) {
+                const QByteArray line = file.readLine();
+                for (const QByteArray &command : bibTeXAuxCommands)
+                    if (line.startsWith(command)) {
+                        hash.addData(line);
+                        break;
+                    }
+            }
+        } else
+            hash.addData(&file);
+        file.close();
+    }
+    return hash.result();
+}
+
+/// Keep the user interface responsive while external programs are running.
+/// Exporters used in worker threads must not process events there, which
+/// may e.g. delete objects scheduled for deletion while still being used
+static void processEventsInMainThread()
+{
+    const QCoreApplication *application = QCoreApplication::instance();
+    if (application != nullptr && QThread::currentThread() == application->thread())
+        QCoreApplication::processEvents();
+}
+
+bool FileExporterToolchain::runSteps(const QVector<ToolchainStep> &steps, bool doEmitProcessOutput)
+{
+    bool result = true;
+    int i = 0;
+    const QDir dir(workingDirectory());
+
+    Q_EMIT progress(0, steps.size());
+    for (const ToolchainStep &step : steps) {
+        processEventsInMainThread();
+
+        const QString commandLine = step.program + QStringLiteral(" ") + step.arguments.join(QStringLiteral(" "));
+        const QByteArray stamp = fingerprint(step);
+        bool upToDate = m_workingDirectory->stamps.value(commandLine) == stamp;
+        for (const QString &outputFile : step.outputFiles)
+            upToDate &= QFileInfo::exists(dir.absoluteFilePath(outputFile));
+
+        if (upToDate)
+            qCDebug(LOG_KBIBTEX_IO) << "Skipping command" << commandLine << "as its inputs did not change";
+        else if (runProcess(step.program, step.arguments, doEmitProcessOutput))
+            m_workingDirectory->stamps.insert(commandLine, stamp);
+        else {
+            m_workingDirectory->stamps.remove(commandLine);
+            result = false;
+            break;
+        }
+
+        Q_EMIT progress(++i, steps.size());
+    }
+    processEventsInMainThread();
+    return result;
 }
 
 bool FileExporterToolchain::runProcesses(const QStringList &progs, bool doEmitProcessOutput)
@@ -51,31 +230,33 @@ bool FileExporterToolchain::runProcesses(const QStringList &progs, bool doEmitPr
 
     Q_EMIT progress(0, progs.size());
     for (QStringList::ConstIterator it = progs.constBegin(); result && it != progs.constEnd(); ++it) {
-        QCoreApplication::instance()->processEvents();
+        processEventsInMainThread();
         QStringList args = (*it).split(QStringLiteral(" "));
         QString cmd = args.first();
         args.erase(args.begin());
         result &= runProcess(cmd, args, doEmitProcessOutput);
         Q_EMIT progress(i++, progs.size());
     }
-    QCoreApplication::instance()->processEvents();
+    processEventsInMainThread();
     return result;
 }
 
 bool FileExporterToolchain::runProcess(const QString &cmd, const QStringList &args, bool doEmitProcessOutput)
 {
+    Tracing::Scope traceScope("io", "FileExporterToolchain::runProcess");
     QProcess process(this);
     QProcessEnvironment processEnvironment = QProcessEnvironment::systemEnvironment();
     /// Avoid some paranoid security settings in BibTeX
     processEnvironment.insert(QStringLiteral("openout_any"), QStringLiteral("r"));
     /// Make applications use working directory as temporary directory
-    processEnvironment.insert(QStringLiteral("TMPDIR"), tempDir.path());
-    processEnvironment.insert(QStringLiteral("TEMPDIR"), tempDir.path());
+    processEnvironment.insert(QStringLiteral("TMPDIR"), workingDirectory());
+    processEnvironment.insert(QStringLiteral("TEMPDIR"), workingDirectory());
     process.setProcessEnvironment(processEnvironment);
-    process.setWorkingDirectory(tempDir.path());
+    process.setWorkingDirectory(workingDirectory());
     /// Assemble the full command line (program name + arguments)
     /// for use in log messages and debug output
     const QString fullCommandLine = cmd + QStringLiteral(" ") + args.join(QStringLiteral(" "));
+    traceScope.setDetail(fullCommandLine);
 
     qCInfo(LOG_KBIBTEX_IO) << "Running command" << fullCommandLine << "using working directory" << process.workingDirectory();
     process.start(cmd, args);
@@ -162,6 +343,9 @@ QString FileExporterToolchain::pageSizeToLaTeXName(const Preferences::PageSize p
 bool FileExporterToolchain::kpsewhich(const QString &filename)
 {
     static QHash<QString, bool> kpsewhichMap;
+    /// Exporters may run in several worker threads at the same time
+    static QMutex kpsewhichMutex;
+    QMutexLocker locker(&kpsewhichMutex);
     if (kpsewhichMap.contains(filename))
         return kpsewhichMap.value(filename, false);
 
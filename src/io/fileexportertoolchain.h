@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2022 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -20,7 +20,9 @@
 #ifndef KBIBTEX_IO_FILEEXPORTERTOOLCHAIN_H
 #define KBIBTEX_IO_FILEEXPORTERTOOLCHAIN_H
 
-#include <QTemporaryDir>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
 
 #include <FileExporter>
 #include <Preferences>
@@ -31,6 +33,8 @@
 
 class QString;
 
+class ToolchainWorkingDirectory;
+
 /**
 @author Thomas Fischer
  */
@@ -40,21 +44,53 @@ class KBIBTEXIO_EXPORT FileExporterToolchain : public FileExporter
 
 public:
     explicit FileExporterToolchain(QObject *parent);
+    ~FileExporterToolchain() override;
 
     static bool kpsewhich(const QString &filename);
 
+    /**
+     * Control whether working directories are kept after an exporter
+     * got destroyed and handed to the next exporter created. Together
+     * with the input fingerprints remembered for each directory, this
+     * allows to skip LaTeX or BibTeX passes whose inputs did not change
+     * since the last export, e.g. when repeatedly previewing the same
+     * entry. Enabled by default.
+     */
+    static void setPersistentWorkingDirectories(bool persistent);
+    static bool persistentWorkingDirectories();
+
 Q_SIGNALS:
     void processStandardOut(const QString);
     void processStandardError(const QString);
 
 protected:
-    QTemporaryDir tempDir;
+    /**
+     * A single program invocation in a toolchain. Relative file names
+     * are resolved against the working directory. A step is skipped
+     * if it ran successfully before in the same working directory with
+     * identical arguments and identical input file contents, and all
+     * its output files still exist.
+     */
+    typedef struct {
+        QString program;
+        QStringList arguments;
+        QStringList inputFiles;
+        QStringList outputFiles;
+    } ToolchainStep;
+
+    QString workingDirectory() const;
 
+    bool runSteps(const QVector<ToolchainStep> &steps, bool doEmitProcessOutput = false);
     bool runProcesses(const QStringList &progs, bool doEmitProcessOutput = false);
     bool runProcess(const QString &cmd, const QStringList &args, bool doEmitProcessOutput = false);
     bool writeFileToIODevice(const QString &filename, QIODevice *device);
 
     QString pageSizeToLaTeXName(const Preferences::PageSize pageSize) const;
+
+private:
+    QSharedPointer<ToolchainWorkingDirectory> m_workingDirectory;
+
+    QByteArray fingerprint(const ToolchainStep &step) const;
 };
 
 #endif // KBIBTEX_IO_FILEEXPORTERTOOLCHAIN_H
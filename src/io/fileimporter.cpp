@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2022 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -63,6 +63,8 @@ FileImporter *FileImporter::factory(const QFileInfo &fileInfo, QObject *parent)
         } else {
             FileImporterBibTeX *fileImporterBibTeX = new FileImporterBibTeX(parent);
             fileImporterBibTeX->setCommentHandling(FileImporterBibTeX::CommentHandling::Keep);
+            fileImporterBibTeX->setSnapshotCaching(true);
+            fileImporterBibTeX->setDeferredFieldDecoding(true);
             return fileImporterBibTeX;
         }
 }
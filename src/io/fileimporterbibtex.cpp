@@ -27,9 +27,16 @@
 #include <QTextCodec>
 #endif // HAVE_QTEXTCODEC
 #include <QIODevice>
+#include <QFile>
 #include <QRegularExpression>
 #include <QCoreApplication>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 #include <QStringList>
+#include <QStringView>
+#include <QVarLengthArray>
+#include <QAtomicInt>
 
 #include <BibTeXEntries>
 #include <BibTeXFields>
@@ -41,8 +48,10 @@
 #include <Entry>
 #include <Element>
 #include <Value>
+#include <Tracing>
 #include "encoder.h"
 #include "encoderlatex.h"
+#include "filesnapshot.h"
 #include "fileimporter_p.h"
 #include "logging_io.h"
 
@@ -58,6 +67,12 @@ public:
 
     /// Set via @see setCommentHandling
     CommentHandling commentHandling;
+    /// Set via @see setSnapshotCaching
+    bool snapshotCaching;
+    /// Set via @see setDeferredFieldDecoding
+    bool deferredFieldDecoding;
+    /// Smaller bibliographies get parsed faster than a snapshot is checked
+    static const int minimumSizeForSnapshot = 1 << 16;
 
     enum class Token {
         At = 1, BracketOpen = 2, BracketClose = 3, AlphaNumText = 4, Comma = 5, Assign = 6, Doublecross = 7, EndOfFile = 0xffff, Unknown = -1
@@ -85,6 +100,20 @@ public:
         }
     } Statistics;
 
+    /// Raw text of one part of a field's value, parts are concatenated using '#'
+    typedef struct {
+        QString rawText;
+        bool isStringKey;
+    } RawValuePart;
+
+    /// Field of an entry whose raw text has been read, but not yet decoded into a Value
+    typedef struct {
+        Entry *entry;
+        QString key;
+        QVector<RawValuePart> parts;
+        int lineNo;
+    } DeferredField;
+
     typedef struct State {
         QTextStream *textStream;
         /// Low-level character operations
@@ -93,22 +122,61 @@ public:
         int lineNo;
         QString prevLine, currentLine;
         QSet<QString> knownElementIds;
+        /// If not null, entries' fields get collected here instead of being decoded immediately
+        QVector<DeferredField> *deferredFields;
 
         State(QTextStream *_textStream)
-                : textStream(_textStream), lineNo(1)
+                : textStream(_textStream), lineNo(1), deferredFields(nullptr)
         {
             /// nothing
         }
     } State;
 
+    /// Set while decoding deferred fields to collect messages instead of emitting them
+    static thread_local QVector<QPair<FileImporter::MessageSeverity, QString>> *collectedMessages;
+
+    /// Decodes a range of deferred fields, possibly in a worker thread,
+    /// and releases one resource of @p _finished when done
+    class DeferredFieldsDecoder : public QRunnable
+    {
+    public:
+        DeferredFieldsDecoder(FileImporterBibTeX *_parent, const QVector<DeferredField> &_fields, int _begin, int _end, QSemaphore &_finished)
+                : parent(_parent), fields(_fields), begin(_begin), end(_end), finished(_finished) {
+            setAutoDelete(false);
+        }
+
+        void run() override {
+            collectedMessages = &messages;
+            for (int i = begin; i < end; ++i) {
+                const DeferredField &field = fields[i];
+                decodeValue((*field.entry)[field.key], field.key, field.parts, field.lineNo, statistics, parent);
+            }
+            collectedMessages = nullptr;
+            finished.release();
+        }
+
+        Statistics statistics;
+        QVector<QPair<FileImporter::MessageSeverity, QString>> messages;
+
+    private:
+        FileImporterBibTeX *const parent;
+        const QVector<DeferredField> &fields;
+        const int begin, end;
+        QSemaphore &finished;
+    };
+
     Private(FileImporterBibTeX *p)
-            : parent(p), commentHandling(CommentHandling::Ignore)
+            : parent(p), commentHandling(CommentHandling::Ignore), snapshotCaching(false), deferredFieldDecoding(false)
     {
         // TODO
     }
 
     static inline bool message(FileImporter::MessageSeverity messageSeverity, const QString &messageText, QObject *_parent)
     {
+        if (collectedMessages != nullptr) {
+            collectedMessages->append(qMakePair(messageSeverity, messageText));
+            return true;
+        }
         FileImporterBibTeX *parent{qobject_cast<FileImporterBibTeX*>(_parent)};
         if (parent != nullptr) {
             // Only send message if parent is a FileImporterBibTeX object
@@ -218,20 +286,81 @@ public:
         return result;
     }
 
-// FIXME duplicate
+    /// Tokens of a person list refer to the list's text instead of being copies of it
+    typedef QVector<QStringView> NameTokens;
+    /// Tokens forming one part of a name, e.g. all tokens before the first comma
+    typedef QVarLengthArray<QStringView, 8> NameParts;
+
+    /**
+     * Split @p text into white-space separated chunks like
+     * @see FileImporterBibTeX::contextSensitiveSplit, but without copying
+     * any text. The chunks stay valid as long as @p text does.
+     */
+    static void contextSensitiveSplit(QStringView text, NameTokens &tokens)
+    {
+        tokens.clear();
+        int bracketCounter = 0; ///< keep track of opening and closing brackets: {...}
+        int tokenStart = -1; ///< position where current token started, or -1 if between tokens
+        const int len = text.length();
+        for (int pos = 0; pos < len; ++pos) {
+            const QChar c = text[pos];
+            if (c == u'{')
+                ++bracketCounter;
+            else if (c == u'}')
+                --bracketCounter;
+
+            if (c.isSpace() && bracketCounter == 0) {
+                if (tokenStart >= 0) {
+                    tokens.append(text.mid(tokenStart, pos - tokenStart));
+                    tokenStart = -1;
+                }
+            } else if (tokenStart < 0)
+                tokenStart = pos;
+        }
+
+        if (tokenStart >= 0)
+            tokens.append(text.mid(tokenStart));
+    }
+
+    /// Concatenate tokens, separated by single spaces, into a string of exactly the required size
+    static QString joinTokens(const QStringView *begin, const QStringView *end)
+    {
+        if (begin == end)
+            return QString();
+
+        int length = -1;
+        for (const QStringView *it = begin; it != end; ++it)
+            length += it->length() + 1;
+        QString result;
+        result.reserve(length);
+        for (const QStringView *it = begin; it != end; ++it) {
+            if (it != begin)
+                result.append(u' ');
+            result.append(it->data(), it->length());
+        }
+        return result;
+    }
+
+    static inline QString joinTokens(const NameParts &parts)
+    {
+        return joinTokens(parts.constData(), parts.constData() + parts.size());
+    }
+
     static void parsePersonList(const QString &text, Value &value, CommaContainment *comma, const int line_number, QObject *parent)
     {
-        static const QString tokenAnd = QStringLiteral("and");
-        static const QString tokenOthers = QStringLiteral("others");
-        static QStringList tokens;
+        static const QLatin1String tokenAnd("and");
+        static const QLatin1String tokenOthers("others");
+        NameTokens tokens;
         contextSensitiveSplit(text, tokens);
+        const int tokenCount = tokens.count();
+        const QStringView *const firstToken = tokens.constData();
 
-        if (tokens.count() > 0) {
+        if (tokenCount > 0) {
             if (tokens[0] == tokenAnd) {
                 qCInfo(LOG_KBIBTEX_IO) << "Person list starts with" << tokenAnd << "near line" << line_number;
                 if (parent != nullptr)
                     message(MessageSeverity::Warning, QString(QStringLiteral("Person list starts with 'and' near line %1")).arg(line_number), parent);
-            } else if (tokens.count() > 1 && tokens[tokens.count() - 1] == tokenAnd) {
+            } else if (tokenCount > 1 && tokens[tokenCount - 1] == tokenAnd) {
                 qCInfo(LOG_KBIBTEX_IO) << "Person list ends with" << tokenAnd << "near line" << line_number;
                 if (parent != nullptr)
                     message(MessageSeverity::Warning, QString(QStringLiteral("Person list ends with 'and' near line %1")).arg(line_number), parent);
@@ -240,7 +369,7 @@ public:
                 qCInfo(LOG_KBIBTEX_IO) << "Person list starts with" << tokenOthers << "near line" << line_number;
                 if (parent != nullptr)
                     message(MessageSeverity::Warning, QString(QStringLiteral("Person list starts with 'others' near line %1")).arg(line_number), parent);
-            } else if (tokens[tokens.count() - 1] == tokenOthers && (tokens.count() < 3 || tokens[tokens.count() - 2] != tokenAnd)) {
+            } else if (tokens[tokenCount - 1] == tokenOthers && (tokenCount < 3 || tokens[tokenCount - 2] != tokenAnd)) {
                 qCInfo(LOG_KBIBTEX_IO) << "Person list ends with" << tokenOthers << "but is not preceded with name and" << tokenAnd << "near line" << line_number;
                 if (parent != nullptr)
                     message(MessageSeverity::Warning, QString(QStringLiteral("Person list ends with 'others' but is not preceded with name and 'and' near line %1")).arg(line_number), parent);
@@ -248,21 +377,23 @@ public:
         }
 
         int nameStart = 0;
-        QString prevToken;
-        for (int i = 0; i < tokens.count(); ++i) {
-            if (tokens[i] == tokenAnd) {
-                if (prevToken == tokenAnd) {
+        bool prevTokenIsAnd = false;
+        for (int i = 0; i < tokenCount; ++i) {
+            const bool tokenIsAnd = tokens[i] == tokenAnd;
+            if (tokenIsAnd) {
+                if (prevTokenIsAnd) {
                     qCInfo(LOG_KBIBTEX_IO) << "Two subsequent" << tokenAnd << "found in person list near line" << line_number;
                     if (parent != nullptr)
                         message(MessageSeverity::Warning, QString(QStringLiteral("Two subsequent 'and' found in person list near line %1")).arg(line_number), parent);
                 } else if (nameStart < i) {
-                    const QSharedPointer<Person> person = personFromTokenList(tokens.mid(nameStart, i - nameStart), comma, line_number, parent);
+                    const QSharedPointer<Person> person = personFromTokens(firstToken + nameStart, firstToken + i, comma, line_number, parent);
                     if (!person.isNull())
                         value.append(person);
                     else {
-                        qCInfo(LOG_KBIBTEX_IO) << "Text" << tokens.mid(nameStart, i - nameStart).join(u' ') << "does not form a name near line" << line_number;
+                        const QString nameText = joinTokens(firstToken + nameStart, firstToken + i);
+                        qCInfo(LOG_KBIBTEX_IO) << "Text" << nameText << "does not form a name near line" << line_number;
                         if (parent != nullptr)
-                            message(MessageSeverity::Warning, QString(QStringLiteral("Text '%1' does not form a name near line %2")).arg(tokens.mid(nameStart, i - nameStart).join(u' ')).arg(line_number), parent);
+                            message(MessageSeverity::Warning, QString(QStringLiteral("Text '%1' does not form a name near line %2")).arg(nameText).arg(line_number), parent);
                     }
                 } else {
                     qCInfo(LOG_KBIBTEX_IO) << "Found" << tokenAnd << "but no name before it near line" << line_number;
@@ -271,40 +402,54 @@ public:
                 }
                 nameStart = i + 1;
             } else if (tokens[i] == tokenOthers) {
-                if (i < tokens.count() - 1) {
+                if (i < tokenCount - 1) {
                     qCInfo(LOG_KBIBTEX_IO) << "Special word" << tokenOthers << "found before last position in person name near line" << line_number;
                     if (parent != nullptr)
                         message(MessageSeverity::Warning, QString(QStringLiteral("Special word 'others' found before last position in person name near line %1")).arg(line_number), parent);
                 } else
                     value.append(QSharedPointer<PlainText>(new PlainText(QStringLiteral("others"))));
-                nameStart = tokens.count() + 1;
+                nameStart = tokenCount + 1;
             }
-            prevToken = tokens[i];
+            prevTokenIsAnd = tokenIsAnd;
         }
 
-        if (nameStart < tokens.count()) {
-            const QSharedPointer<Person> person = personFromTokenList(tokens.mid(nameStart), comma, line_number, parent);
+        if (nameStart < tokenCount) {
+            const QSharedPointer<Person> person = personFromTokens(firstToken + nameStart, firstToken + tokenCount, comma, line_number, parent);
             if (!person.isNull())
                 value.append(person);
             else {
-                qCInfo(LOG_KBIBTEX_IO) << "Text" << tokens.mid(nameStart).join(u' ') << "does not form a name near line" << line_number;
+                const QString nameText = joinTokens(firstToken + nameStart, firstToken + tokenCount);
+                qCInfo(LOG_KBIBTEX_IO) << "Text" << nameText << "does not form a name near line" << line_number;
                 if (parent != nullptr)
-                    message(MessageSeverity::Warning, QString(QStringLiteral("Text '%1' does not form a name near line %2")).arg(tokens.mid(nameStart).join(u' ')).arg(line_number), parent);
+                    message(MessageSeverity::Warning, QString(QStringLiteral("Text '%1' does not form a name near line %2")).arg(nameText).arg(line_number), parent);
             }
         }
     }
 
-    Token readValue(Value &value, const QString &key, Statistics &statistics, State &state)
+    Token readRawValue(QVector<RawValuePart> &parts, Statistics &statistics, State &state)
     {
         Token token = Token::Unknown;
-        const QString iKey = key.toLower();
-        static const QSet<QString> verbatimKeys {Entry::ftColor.toLower(), Entry::ftCrossRef.toLower(), Entry::ftXData.toLower()};
-
         do {
             bool isStringKey = false;
             const QString rawText = readString(isStringKey, statistics, state);
             if (rawText.isNull())
                 return Token::EndOfFile;
+            parts.append(RawValuePart{rawText, isStringKey});
+            token = nextToken(state);
+        } while (token == Token::Doublecross);
+
+        return token;
+    }
+
+    /// Turn a field's raw text into value items, e.g. by decoding LaTeX or splitting person names
+    static void decodeValue(Value &value, const QString &key, const QVector<RawValuePart> &parts, const int lineNo, Statistics &statistics, QObject *parent)
+    {
+        const QString iKey = key.toLower();
+        static const QSet<QString> verbatimKeys {Entry::ftColor.toLower(), Entry::ftCrossRef.toLower(), Entry::ftXData.toLower()};
+
+        for (const RawValuePart &part : parts) {
+            const QString &rawText = part.rawText;
+            const bool isStringKey = part.isStringKey;
             QString text = EncoderLaTeX::instance().decode(rawText);
             /// For all entries except for abstracts and a few more 'verbatim-y' fields ...
             if (iKey != Entry::ftAbstract && !(iKey.startsWith(Entry::ftUrl) && !iKey.startsWith(Entry::ftUrlDate)) && !iKey.startsWith(Entry::ftLocalFile) && !iKey.startsWith(Entry::ftFile)) {
@@ -328,7 +473,7 @@ public:
                     value.append(QSharedPointer<MacroKey>(new MacroKey(text)));
                 else {
                     CommaContainment comma = CommaContainment::Contains;
-                    parsePersonList(text, value, &comma, state.lineNo, parent);
+                    parsePersonList(text, value, &comma, lineNo, parent);
 
                     /// Update statistics on name formatting
                     if (comma == CommaContainment::Contains)
@@ -440,11 +585,7 @@ public:
                 else
                     value.append(QSharedPointer<PlainText>(new PlainText(text)));
             }
-
-            token = nextToken(state);
-        } while (token == Token::Doublecross);
-
-        return token;
+        }
     }
 
     QString readBracketString(State &state)
@@ -885,6 +1026,8 @@ public:
         state.knownElementIds.insert(id);
 
         Entry *entry = new Entry(BibTeXEntries::instance().format(typeString), id);
+        /// Recorded only once the entry has been read successfully
+        QVector<DeferredField> deferredFieldsOfEntry;
 
         token = nextToken(state);
         do {
@@ -1003,7 +1146,8 @@ public:
                 }
             }
 
-            token = readValue(value, keyName, statistics, state);
+            QVector<RawValuePart> rawValueParts;
+            token = readRawValue(rawValueParts, statistics, state);
             if (token != Token::BracketClose && token != Token::Comma) {
 #if QT_VERSION >= 0x050e00
                 qCWarning(LOG_KBIBTEX_IO) << "Failed to read value in entry" << id << ", field name" << keyName << "near line" << state.lineNo  << "(" << state.prevLine << Qt::endl << state.currentLine << ")";
@@ -1015,12 +1159,69 @@ public:
                 return nullptr;
             }
 
+            if (state.deferredFields != nullptr)
+                deferredFieldsOfEntry.append(DeferredField{entry, keyName, rawValueParts, state.lineNo});
+            else
+                decodeValue(value, keyName, rawValueParts, state.lineNo, statistics, parent);
             entry->insert(keyName, value);
         } while (true);
 
+        if (state.deferredFields != nullptr)
+            state.deferredFields->append(deferredFieldsOfEntry);
         return entry;
     }
 
+    /**
+     * Decode the fields collected while reading entries. Fields are split
+     * into chunks decoded in parallel, keeping all fields of an entry in the
+     * same chunk. Statistics and messages are merged in the fields' order.
+     * Chunks run on the global thread pool, so that importers running in
+     * several threads at once do not start a set of threads each. Chunks
+     * not yet picked up by the pool are decoded in the calling thread, which
+     * therefore never waits for threads it may be occupying itself.
+     */
+    void decodeDeferredFields(const QVector<DeferredField> &fields, Statistics &statistics)
+    {
+        KBIBTEX_TRACE_SCOPE("io", "FileImporterBibTeX::decodeDeferredFields");
+        /// Initialize shared data before worker threads use it
+        EncoderLaTeX::instance();
+
+        static const int fieldsPerChunk = 4096;
+        QSemaphore finished;
+        QVector<DeferredFieldsDecoder *> decoders;
+        for (int begin = 0; begin < fields.count();) {
+            int end = qMin(begin + fieldsPerChunk, fields.count());
+            while (end < fields.count() && fields[end].entry == fields[end - 1].entry)
+                ++end;
+            decoders.append(new DeferredFieldsDecoder(parent, fields, begin, end, finished));
+            begin = end;
+        }
+
+        if (decoders.count() == 1)
+            decoders.first()->run();
+        else if (decoders.count() > 1) {
+            QThreadPool *pool = QThreadPool::globalInstance();
+            for (DeferredFieldsDecoder *decoder : const_cast<const QVector<DeferredFieldsDecoder *> &>(decoders))
+                pool->start(decoder);
+            for (DeferredFieldsDecoder *decoder : const_cast<const QVector<DeferredFieldsDecoder *> &>(decoders))
+                if (pool->tryTake(decoder))
+                    decoder->run();
+        }
+        finished.acquire(decoders.count());
+
+        for (const DeferredFieldsDecoder *decoder : const_cast<const QVector<DeferredFieldsDecoder *> &>(decoders)) {
+            statistics.countProtectedTitle += decoder->statistics.countProtectedTitle;
+            statistics.countUnprotectedTitle += decoder->statistics.countUnprotectedTitle;
+            statistics.countFirstNameFirst += decoder->statistics.countFirstNameFirst;
+            statistics.countLastNameFirst += decoder->statistics.countLastNameFirst;
+            if (!decoder->statistics.mostRecentListSeparator.isEmpty())
+                statistics.mostRecentListSeparator = decoder->statistics.mostRecentListSeparator;
+            for (const auto &collectedMessage : decoder->messages)
+                message(collectedMessage.first, collectedMessage.second);
+        }
+        qDeleteAll(decoders);
+    }
+
     Element *nextElement(Statistics &statistics, State &state)
     {
         Token token = nextToken(state);
@@ -1100,34 +1301,39 @@ public:
 
     static QSharedPointer<Person> personFromString(const QString &name, CommaContainment *comma, const int line_number, QObject *parent)
     {
-        // TODO Merge with FileImporter::splitName and FileImporterBibTeX::contextSensitiveSplit
-        static QStringList tokens;
+        // TODO Merge with FileImporter::splitName
+        NameTokens tokens;
         contextSensitiveSplit(name, tokens);
-        return personFromTokenList(tokens, comma, line_number, parent);
+        return personFromTokens(tokens.constData(), tokens.constData() + tokens.count(), comma, line_number, parent);
     }
 
-    static QSharedPointer<Person> personFromTokenList(const QStringList &tokens, CommaContainment *comma, const int line_number, QObject *parent)
+    /**
+     * Construct a Person object from the tokens in range [@p begin, @p end).
+     * Tokens are views on the original text, so that only the resulting
+     * Person's first name, last name, and suffix get allocated.
+     */
+    static QSharedPointer<Person> personFromTokens(const QStringView *begin, const QStringView *end, CommaContainment *comma, const int line_number, QObject *parent)
     {
         if (comma != nullptr) *comma = CommaContainment::None;
 
         /// Simple case: provided list of tokens is empty, return invalid Person
-        if (tokens.isEmpty())
+        if (begin == end)
             return QSharedPointer<Person>();
 
         /**
          * The sequence of tokens may contain in up to two of its elements one comma each:
-         * {"Tuckwell,", "Peter,", "Jr."}. In this case, fill three string lists:
+         * {"Tuckwell,", "Peter,", "Jr."}. In this case, fill three lists of tokens:
          * one with tokens before the first comma, one with tokens after the second commas,
          * and one with tokens after the second commas. If commas appear in the middle of a
-         * token, split token into two new tokens and add them to two different string lists.
-         * The comma itself will not be part of any string in the string lists.
+         * token, split token into two new tokens and add them to two different lists.
+         * The comma itself will not be part of any token in the lists.
          * Example:
          * partA = ( "Tuckwell" );  partB = ( "Peter" );  partC = ( "Jr." )
-         * If a comma was found, boolean variable gotComma is set.
          */
-        QStringList partA, partB, partC;
+        NameParts partA, partB, partC;
         int commaCount = 0;
-        for (const QString &token : tokens) {
+        for (const QStringView *it = begin; it != end; ++it) {
+            const QStringView &token = *it;
             /// Position where comma was found, or -1 if no comma in token
             int p = -1;
             if (commaCount < 2) {
@@ -1172,7 +1378,7 @@ public:
         }
         if (commaCount > 0) {
             if (comma != nullptr) *comma = CommaContainment::Contains;
-            return QSharedPointer<Person>(new Person(partC.isEmpty() ? partB.join(u' ') : partC.join(u' '), partA.join(u' '), partC.isEmpty() ? QString() : partB.join(u' ')));
+            return QSharedPointer<Person>(new Person(partC.isEmpty() ? joinTokens(partB) : joinTokens(partC), joinTokens(partA), partC.isEmpty() ? QString() : joinTokens(partB)));
         }
 
         /**
@@ -1182,21 +1388,12 @@ public:
          * So, check how many single capital letters are at the end of
          * the given token list
          */
-        partA.clear(); partB.clear();
-        bool singleCapitalLetters = true;
-        QStringList::ConstIterator it = tokens.constEnd();
-        while (it != tokens.constBegin()) {
-            --it;
-            if (singleCapitalLetters && it->length() == 1 && it->at(0).isUpper())
-                partB.prepend(*it);
-            else {
-                singleCapitalLetters = false;
-                partA.prepend(*it);
-            }
-        }
-        if (!partB.isEmpty()) {
+        const QStringView *firstCapitalLetter = end;
+        while (firstCapitalLetter != begin && (firstCapitalLetter - 1)->length() == 1 && (firstCapitalLetter - 1)->at(0).isUpper())
+            --firstCapitalLetter;
+        if (firstCapitalLetter != end) {
             /// Name was actually given in PubMed format
-            return QSharedPointer<Person>(new Person(partB.join(u' '), partA.join(u' ')));
+            return QSharedPointer<Person>(new Person(joinTokens(firstCapitalLetter, end), joinTokens(begin, firstCapitalLetter)));
         }
 
         /**
@@ -1208,35 +1405,46 @@ public:
          * (example: "Di Cosmo").
          * Exception: Special keywords such as "Jr." can be appended to the
          * name, not counted as part of the last name.
+         * Tokens are assigned to parts going backwards, but get appended
+         * to parts in their original order afterwards.
          */
-        partA.clear(); partB.clear(); partC.clear();
-        static const QSet<QString> capitalCaseLastNameFragments {QStringLiteral("Di")};
-        it = tokens.constEnd();
-        while (it != tokens.constBegin()) {
+        static const QLatin1String capitalCaseLastNameFragment("Di");
+        QVarLengthArray<char, 16> assignedPart(static_cast<int>(end - begin));
+        bool lastNameFound = false;
+        for (const QStringView *it = end; it != begin;) {
             --it;
-            if (partB.isEmpty() && (it->toLower().startsWith(QStringLiteral("jr")) || it->toLower().startsWith(QStringLiteral("sr")) || it->toLower().startsWith(QStringLiteral("iii"))))
+            char &part = assignedPart[static_cast<int>(it - begin)];
+            if (!lastNameFound && (it->startsWith(QLatin1String("jr"), Qt::CaseInsensitive) || it->startsWith(QLatin1String("sr"), Qt::CaseInsensitive) || it->startsWith(QLatin1String("iii"), Qt::CaseInsensitive)))
                 /// handle name suffices like "Jr" or "III."
-                partC.prepend(*it);
-            else if (partB.isEmpty() || it->at(0).isLower() || capitalCaseLastNameFragments.contains(*it))
-                partB.prepend(*it);
-            else
-                partA.prepend(*it);
+                part = 'C';
+            else if (!lastNameFound || it->at(0).isLower() || *it == capitalCaseLastNameFragment) {
+                part = 'B';
+                lastNameFound = true;
+            } else
+                part = 'A';
         }
-        if (!partB.isEmpty()) {
+        if (lastNameFound) {
             /// Name was actually like "Peter Ole van der Tuckwell",
             /// split into "Peter Ole" and "van der Tuckwell"
-            return QSharedPointer<Person>(new Person(partA.join(u' '), partB.join(u' '), partC.isEmpty() ? QString() : partC.join(u' ')));
+            partA.clear(); partB.clear(); partC.clear();
+            for (const QStringView *it = begin; it != end; ++it) {
+                const char part = assignedPart[static_cast<int>(it - begin)];
+                (part == 'A' ? partA : (part == 'B' ? partB : partC)).append(*it);
+            }
+            return QSharedPointer<Person>(new Person(joinTokens(partA), joinTokens(partB), partC.isEmpty() ? QString() : joinTokens(partC)));
         }
 
-        qCWarning(LOG_KBIBTEX_IO) << "Don't know how to handle name" << tokens.join(u' ') << "near line" << line_number;
+        const QString nameText = joinTokens(begin, end);
+        qCWarning(LOG_KBIBTEX_IO) << "Don't know how to handle name" << nameText << "near line" << line_number;
         if (parent != nullptr)
-            message(MessageSeverity::Warning, QString(QStringLiteral("Don't know how to handle name '%1' near line %2")).arg(tokens.join(u' ')).arg(line_number), parent);
+            message(MessageSeverity::Warning, QString(QStringLiteral("Don't know how to handle name '%1' near line %2")).arg(nameText).arg(line_number), parent);
         return QSharedPointer<Person>();
     }
 
 };
 
 const QStringList FileImporterBibTeX::Private::keysForPersonDetection {Entry::ftAuthor, Entry::ftEditor, QStringLiteral("bookauthor") /** used by JSTOR */};
+thread_local QVector<QPair<FileImporter::MessageSeverity, QString>> *FileImporterBibTeX::Private::collectedMessages = nullptr;
 
 
 FileImporterBibTeX::FileImporterBibTeX(QObject *parent)
@@ -1252,6 +1460,7 @@ FileImporterBibTeX::~FileImporterBibTeX()
 
 File *FileImporterBibTeX::fromString(const QString &rawText)
 {
+    KBIBTEX_TRACE_SCOPE("io", "FileImporterBibTeX::fromString");
     if (rawText.isEmpty()) {
         qCInfo(LOG_KBIBTEX_IO) << "BibTeX data converted to string is empty";
         Q_EMIT message(MessageSeverity::Warning, QStringLiteral("BibTeX data converted to string is empty"));
@@ -1273,6 +1482,9 @@ File *FileImporterBibTeX::fromString(const QString &rawText)
 
     Private::Statistics statistics;
     Private::State state(new QTextStream(&internalRawText, QIODevice::ReadOnly));
+    QVector<Private::DeferredField> deferredFields;
+    if (d->deferredFieldDecoding)
+        state.deferredFields = &deferredFields;
     d->readChar(state);
 
     bool gotAtLeastOneElement = false;
@@ -1319,6 +1531,9 @@ File *FileImporterBibTeX::fromString(const QString &rawText)
 
     delete state.textStream;
 
+    if (result != nullptr && !deferredFields.isEmpty())
+        d->decodeDeferredFields(deferredFields, statistics);
+
     if (result != nullptr) {
         /// Set the file's preferences for string delimiters
         /// deduced from statistics built while parsing the file
@@ -1362,6 +1577,7 @@ File *FileImporterBibTeX::fromString(const QString &rawText)
 
 File *FileImporterBibTeX::load(QIODevice *iodevice)
 {
+    KBIBTEX_TRACE_SCOPE("io", "FileImporterBibTeX::load");
     m_cancelFlag = false;
 
     check_if_iodevice_invalid(iodevice);
@@ -1369,6 +1585,20 @@ File *FileImporterBibTeX::load(QIODevice *iodevice)
     QByteArray rawData = iodevice->readAll();
     iodevice->close();
 
+    /// Reuse the result of loading the same local file before, if still valid
+    FileSnapshot::Source snapshotSource;
+    const QFile *sourceFile = d->snapshotCaching && rawData.size() >= Private::minimumSizeForSnapshot ? qobject_cast<QFile *>(iodevice) : nullptr;
+    if (sourceFile != nullptr && !sourceFile->fileName().isEmpty()) {
+        /// Loading depends on these settings as well
+        const QString variant {QString(QStringLiteral("%1|%2|%3|%4|%5")).arg(QString::number(static_cast<int>(d->commentHandling)), Preferences::instance().bibTeXEncoding(), QString::number(static_cast<int>(Preferences::instance().bibTeXCommentContext())), Preferences::instance().bibTeXCommentPrefix(), QString::number(static_cast<int>(Preferences::instance().bibTeXKeywordCasing())))};
+        snapshotSource = FileSnapshot::source(sourceFile->fileName(), rawData, variant);
+        File *result = FileSnapshot::load(snapshotSource, FileSnapshot::cacheFilename(snapshotSource.path));
+        if (result != nullptr) {
+            Q_EMIT progress(100, 100);
+            return result;
+        }
+    }
+
     bool encodingMayGetDeterminedByRawData = true;
     QString encoding(Preferences::instance().bibTeXEncoding()); ///< default value taken from Preferences
     if (rawData.length() >= 8 && rawData.at(0) != 0 && rawData.at(1) == 0 && rawData.at(2) == 0 && rawData.at(3) == 0 && rawData.at(4) != 0 && rawData.at(5) == 0 && rawData.at(6) == 0 && rawData.at(7) == 0) {
@@ -1563,9 +1793,28 @@ File *FileImporterBibTeX::load(QIODevice *iodevice)
             rawText = rawText.left(posPersonNameFormatting) + rawText.mid(endOfPersonNameFormatting + 1);
     }
 
+    /// Snapshots do not record messages, so a bibliography whose parsing
+    /// reported warnings or errors must be parsed again on every load
+    bool parsingReportedProblems = false;
+    const QMetaObject::Connection problemsConnection = connect(this, &FileImporter::message, this, [&parsingReportedProblems](const FileImporter::MessageSeverity severity, const QString &) {
+        if (severity != FileImporter::MessageSeverity::Info)
+            parsingReportedProblems = true;
+    }, Qt::DirectConnection);
     File *result = fromString(rawText);
-    /// In the File object's property, store the encoding used to load the data
-    result->setProperty(File::Encoding, encoding);
+    disconnect(problemsConnection);
+    if (result != nullptr) {
+        /// In the File object's property, store the encoding used to load the data
+        result->setProperty(File::Encoding, encoding);
+
+        if (!snapshotSource.path.isEmpty() && !parsingReportedProblems) {
+            if (!FileSnapshot::save(*result, snapshotSource, FileSnapshot::cacheFilename(snapshotSource.path)))
+                qCDebug(LOG_KBIBTEX_IO) << "Could not write snapshot for" << snapshotSource.path;
+            /// Checking the snapshots' total size and age once per session is sufficient
+            static QAtomicInt snapshotsPruned(0);
+            if (snapshotsPruned.testAndSetRelaxed(0, 1))
+                FileSnapshot::prune(FileSnapshot::cacheDirectory());
+        }
+    }
 
     return result;
 }
@@ -1645,15 +1894,26 @@ QList<QSharedPointer<Person> > FileImporterBibTeX::splitNames(const QString &tex
     for (const auto &invalidChar : invalidChars)
         /// Replacing daggers with commas ensures that they act as persons' names separator
         internalText = internalText.replace(invalidChar, u',');
+    /// Regular expressions below are only applied if the text contains
+    /// characters they require, as most lists of names don't need any cleanup
+    bool containsDigit = false;
+    for (const QChar &c : const_cast<const QString &>(internalText))
+        if (c.isDigit()) {
+            containsDigit = true;
+            break;
+        }
     /// Remove numbers to footnotes
     static const QRegularExpression numberFootnoteRegExp(QStringLiteral("(\\w)\\d+\\b"));
-    internalText = internalText.replace(numberFootnoteRegExp, QStringLiteral("\\1"));
+    if (containsDigit)
+        internalText = internalText.replace(numberFootnoteRegExp, QStringLiteral("\\1"));
     /// Remove academic degrees
     static const QRegularExpression academicDegreesRegExp(QStringLiteral("(,\\s*)?(MA|PhD)\\b"));
-    internalText = internalText.remove(academicDegreesRegExp);
+    if (internalText.contains(QStringLiteral("MA")) || internalText.contains(QStringLiteral("PhD")))
+        internalText = internalText.remove(academicDegreesRegExp);
     /// Remove email addresses
     static const QRegularExpression emailAddressRegExp(QStringLiteral("\\b[a-zA-Z0-9][a-zA-Z0-9._-]+[a-zA-Z0-9]@[a-z0-9][a-z0-9-]*([.][a-z0-9-]+)*([.][a-z]+)+\\b"));
-    internalText = internalText.remove(emailAddressRegExp);
+    if (internalText.contains(u'@'))
+        internalText = internalText.remove(emailAddressRegExp);
 
     /// Split input string into tokens which are either name components (first or last name)
     /// or full names (composed of first and last name), depending on the input string's structure
@@ -1710,29 +1970,13 @@ void FileImporterBibTeX::parsePersonList(const QString &text, Value &value, cons
 
 void FileImporterBibTeX::contextSensitiveSplit(const QString &text, QStringList &segments)
 {
-    // TODO Merge with FileImporter::splitName and FileImporterBibTeX::personFromString
-    int bracketCounter = 0; ///< keep track of opening and closing brackets: {...}
-    QString buffer;
-    int len = text.length();
+    // TODO Merge with FileImporter::splitName
+    Private::NameTokens tokens;
+    Private::contextSensitiveSplit(text, tokens);
     segments.clear(); ///< empty list for results before proceeding
-
-    for (int pos = 0; pos < len; ++pos) {
-        if (text[pos] == u'{')
-            ++bracketCounter;
-        else if (text[pos] == u'}')
-            --bracketCounter;
-
-        if (text[pos].isSpace() && bracketCounter == 0) {
-            if (!buffer.isEmpty()) {
-                segments.append(buffer);
-                buffer.clear();
-            }
-        } else
-            buffer.append(text[pos]);
-    }
-
-    if (!buffer.isEmpty())
-        segments.append(buffer);
+    segments.reserve(tokens.count());
+    for (const QStringView &token : const_cast<const Private::NameTokens &>(tokens))
+        segments.append(token.toString());
 }
 
 QString FileImporterBibTeX::bibtexAwareSimplify(const QString &text)
@@ -1776,3 +2020,11 @@ QString FileImporterBibTeX::rstrip(const QString &text)
 void FileImporterBibTeX::setCommentHandling(CommentHandling commentHandling) {
     d->commentHandling = commentHandling;
 }
+
+void FileImporterBibTeX::setSnapshotCaching(bool snapshotCaching) {
+    d->snapshotCaching = snapshotCaching;
+}
+
+void FileImporterBibTeX::setDeferredFieldDecoding(bool deferredFieldDecoding) {
+    d->deferredFieldDecoding = deferredFieldDecoding;
+}
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -109,6 +109,26 @@ public:
 
     void setCommentHandling(CommentHandling commentHandling);
 
+    /**
+     * Keep a binary snapshot of each loaded bibliography in the user's
+     * cache directory and use it instead of parsing when loading the same,
+     * unchanged file again. Applies only to sufficiently large bibliographies
+     * read from a QFile. Disabled by default.
+     * @see FileSnapshot
+     */
+    void setSnapshotCaching(bool snapshotCaching);
+
+    /**
+     * Only tokenize entries' fields while reading the input and turn their
+     * raw texts into values afterwards, with fields of different entries
+     * being decoded in parallel on the global thread pool. The resulting
+     * File object is the same as without this option. Decoding is not
+     * lazy: all fields are decoded before load() or fromString() return,
+     * so this shortens the total loading time, not just the time until
+     * the first entries can be shown. Disabled by default.
+     */
+    void setDeferredFieldDecoding(bool deferredFieldDecoding);
+
 public Q_SLOTS:
     void cancel() override;
 
@@ -19,6 +19,8 @@
 
 #include "fileinfo.h"
 
+#include <algorithm>
+
 #ifdef HAVE_POPPLERQT5
 #include <poppler-qt5.h>
 #else // not HAVE_POPPLERQT5
@@ -35,6 +37,19 @@
 #include <QTextStream>
 #include <QStandardPaths>
 #include <QRegularExpression>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QBitArray>
+#include <QElapsedTimer>
 
 #include <KBibTeX>
 #include <Entry>
@@ -105,133 +120,270 @@ QMimeType FileInfo::mimeTypeForUrl(const QUrl &url)
     return result;
 }
 
-void FileInfo::urlsInText(const QString &text, const TestExistence testExistence, const QString &baseDirectory, QSet<QUrl> &result)
+/**
+ * Answers whether files or directories exist by listing each directory
+ * once instead of querying the file system for each path individually.
+ * Listings expire after a few seconds so that new files get noticed.
+ */
+class DirectoryListingCache
+{
+public:
+    enum class Kind { Missing, File, Directory };
+
+    static DirectoryListingCache &instance() {
+        static DirectoryListingCache singleton;
+        return singleton;
+    }
+
+    Kind kind(const QString &absoluteFilePath) {
+        const QString path = QDir::cleanPath(absoluteFilePath);
+        const int p = path.lastIndexOf(QLatin1Char('/'));
+        if (p < 0 || p == path.length() - 1) {
+            /// Root directory or not an absolute path, cannot be answered from a listing
+            const QFileInfo fi(path);
+            return fi.isFile() ? Kind::File : (fi.isDir() ? Kind::Directory : Kind::Missing);
+        }
+        const QString directory = p == 0 ? QStringLiteral("/") : path.left(p);
+        const QString name = caseNormalized(path.mid(p + 1));
+
+        QMutexLocker locker(&mutex);
+        auto it = listings.find(directory);
+        if (it == listings.end() || it->age.hasExpired(maxAgeMilliseconds)) {
+            if (listings.count() >= maxListings)
+                listings.clear();
+            Listing listing;
+            listing.age.start();
+            const QDir dir(directory);
+            if (dir.exists()) {
+                const QStringList fileNames = dir.entryList(QDir::Files | QDir::Hidden | QDir::System);
+                for (const QString &fileName : fileNames)
+                    listing.files.insert(caseNormalized(fileName));
+                const QStringList directoryNames = dir.entryList(QDir::Dirs | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+                for (const QString &directoryName : directoryNames)
+                    listing.directories.insert(caseNormalized(directoryName));
+            }
+            it = listings.insert(directory, listing);
+        }
+        return it->files.contains(name) ? Kind::File : (it->directories.contains(name) ? Kind::Directory : Kind::Missing);
+    }
+
+    inline bool isFile(const QString &absoluteFilePath) {
+        return kind(absoluteFilePath) == Kind::File;
+    }
+
+    inline bool exists(const QString &absoluteFilePath) {
+        return kind(absoluteFilePath) != Kind::Missing;
+    }
+
+private:
+    static const qint64 maxAgeMilliseconds = 3000;
+    static const int maxListings = 256;
+
+    struct Listing {
+        QElapsedTimer age;
+        QSet<QString> files;
+        QSet<QString> directories;
+    };
+
+    QMutex mutex;
+    QHash<QString, Listing> listings;
+
+    static inline QString caseNormalized(const QString &name) {
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+        return name.toCaseFolded();
+#else // not defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+        return name;
+#endif // defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    }
+};
+
+/// Character used to blank out parts of the text already consumed by a match,
+/// never matched by any of the regular expressions and not a word character
+static const QChar consumedChar = QLatin1Char('{');
+
+static inline void consume(QString &workingText, QBitArray &consumed, int start, int length)
+{
+    for (int i = start + length - 1; i >= start; --i) {
+        workingText[i] = consumedChar;
+        consumed.setBit(i);
+    }
+}
+
+static inline bool containsAt(const QString &text, int pos, QLatin1String needle)
+{
+    if (pos < 0 || pos + needle.size() > text.length()) return false;
+    for (int i = needle.size() - 1; i >= 0; --i)
+        if (text[pos + i] != needle[i]) return false;
+    return true;
+}
+
+/**
+ * Find an URL like 'http://doi.example.org/' right before a DOI, equivalent to
+ * matching 'http[s]?://[a-z0-9./-]+/$' against the text preceding the DOI.
+ * @return position where the URL starts or -1 if there is no such URL
+ */
+static int doiUrlPrefixStart(const QString &text, int doiStart)
+{
+    if (doiStart < 1 || text[doiStart - 1] != QLatin1Char('/')) return -1;
+    int p = doiStart - 2;
+    while (p >= 0) {
+        const ushort c = text[p].unicode();
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '.' || c == '/' || c == '-')
+            --p;
+        else
+            break;
+    }
+    /// Text between '://' and trailing slash must not be empty
+    if (p < 4 || text[p] != QLatin1Char(':') || doiStart - 1 - (p + 3) < 1 || !containsAt(text, p + 1, QLatin1String("//"))) return -1;
+    if (containsAt(text, p - 5, QLatin1String("https"))) return p - 5;
+    if (containsAt(text, p - 4, QLatin1String("http"))) return p - 4;
+    return -1;
+}
+
+QVector<FileInfo::UrlSpan> FileInfo::urlSpansInText(const QString &text, const TestExistence testExistence, const QString &baseDirectory)
 {
+    QVector<UrlSpan> result;
     if (text.isEmpty())
-        return;
+        return result;
+
+    /// Instead of cutting away matches from the text, which requires to copy
+    /// the remaining text for each match, matched characters get blanked out
+    /// in a single working copy. Thus, positions remain valid for the original
+    /// text and each regular expression needs to scan the text only once.
+    QString workingText = text;
+    QBitArray consumed(text.length());
+    DirectoryListingCache &directoryListingCache = DirectoryListingCache::instance();
 
     /// DOI identifiers have to extracted first as KBibTeX::fileListSeparatorRegExp
     /// contains characters that can be part of a DOI (e.g. ';') and thus could split
     /// a DOI in between.
-    QString internalText = text;
     int pos = 0;
     QRegularExpressionMatch doiRegExpMatch;
-    while ((doiRegExpMatch = KBibTeX::doiRegExp.match(internalText, pos)).hasMatch()) {
+    while ((doiRegExpMatch = KBibTeX::doiRegExp.match(workingText, pos)).hasMatch()) {
         pos = doiRegExpMatch.capturedStart(QStringLiteral("doi"));
         QString doiMatch = doiRegExpMatch.captured(QStringLiteral("doi"));
         const int semicolonHttpPos = doiMatch.indexOf(QStringLiteral(";http"));
         if (semicolonHttpPos > 0) doiMatch = doiMatch.left(semicolonHttpPos);
         const QUrl url(KBibTeX::doiUrlPrefix + QString(doiMatch).remove(QStringLiteral("\\")));
-        if (url.isValid() && !result.contains(url))
-            result << url;
-        /// remove match from internal text to avoid duplicates
 
-        /// Cut away any URL that may be right before found DOI number:
+        /// Also consume any URL that may be right before found DOI number:
         /// For example, if DOI '10.1000/38-abc' was found in
         ///   'Lore ipsum http://doi.example.org/10.1000/38-abc Lore ipsum'
-        /// also remove 'http://doi.example.org/' from the text, keeping only
+        /// also consume 'http://doi.example.org/', keeping only
         ///   'Lore ipsum  Lore ipsum'
-        static const QRegularExpression genericDoiUrlPrefix(QStringLiteral("http[s]?://[a-z0-9./-]+/$")); ///< looks like an URL
-        const QRegularExpressionMatch genericDoiUrlPrefixMatch = genericDoiUrlPrefix.match(internalText.left(pos));
-        if (genericDoiUrlPrefixMatch.hasMatch())
-            /// genericDoiUrlPrefixMatch.captured(0) may contain (parts of) DOI
-            internalText = internalText.left(genericDoiUrlPrefixMatch.capturedStart(0)) + internalText.mid(pos + doiMatch.length());
-        else
-            internalText = internalText.left(pos) + internalText.mid(pos + doiMatch.length());
-    }
-
-#if QT_VERSION >= 0x050e00
-    const QStringList fileList = internalText.split(KBibTeX::fileListSeparatorRegExp, Qt::SkipEmptyParts);
-#else // QT_VERSION < 0x050e00
-    const QStringList fileList = internalText.split(KBibTeX::fileListSeparatorRegExp, QString::SkipEmptyParts);
-#endif // QT_VERSION >= 0x050e00
-    for (const QString &text : fileList) {
-        internalText = text;
-
-        /// If testing for the actual existence of a filename found in the text ...
-        if (testExistence == TestExistence::Yes) {
-            /// If a base directory (e.g. the location of the parent .bib file) is given
-            /// and the potential filename fragment is NOT an absolute path, ...
-            if (internalText.startsWith(QStringLiteral("~") + QDir::separator())) {
-                const QString fullFilename = QDir::homePath() + internalText.mid(1);
-                const QFileInfo fileInfo(fullFilename);
-                const QUrl url = QUrl::fromLocalFile(fileInfo.absoluteFilePath());
-                if (fileInfo.exists() && fileInfo.isFile() && url.isValid() && !result.contains(url)) {
-                    result << url;
-                    /// Stop searching for URLs or filenames in current internal text
-                    continue;
-                }
-            } else if (!baseDirectory.isEmpty() &&
-                       // TODO the following test assumes that absolute paths start
-                       // with a dir separator, which may only be true on Unix/Linux,
-                       // but not Windows. May be a test for 'first character is a letter,
-                       // second is ":", third is "\"' may be necessary.
-                       !internalText.startsWith(QDir::separator())) {
+        const int prefixStart = doiUrlPrefixStart(workingText, pos);
+        const int start = prefixStart >= 0 ? prefixStart : pos;
+        const int length = pos + doiMatch.length() - start;
+        if (url.isValid())
+            result.append(UrlSpan {UrlSpan::Type::DOI, start, length, url});
+        consume(workingText, consumed, start, length);
+        pos += doiMatch.length();
+    }
+
+    /// Blank out separators between filenames or URLs, so that no match crosses them
+    QRegularExpressionMatchIterator separatorIt = KBibTeX::fileListSeparatorRegExp.globalMatch(workingText);
+    QVector<QPair<int, int>> segments; ///< start and end position of text between separators
+    int segmentStart = 0;
+    while (separatorIt.hasNext()) {
+        const QRegularExpressionMatch separatorMatch = separatorIt.next();
+        if (separatorMatch.capturedLength(0) == 0) continue;
+        if (separatorMatch.capturedStart(0) > segmentStart)
+            segments.append(qMakePair(segmentStart, separatorMatch.capturedStart(0)));
+        segmentStart = separatorMatch.capturedEnd(0);
+    }
+    if (segmentStart < workingText.length())
+        segments.append(qMakePair(segmentStart, workingText.length()));
+    for (int i = 1; i < segments.count(); ++i)
+        consume(workingText, consumed, segments[i - 1].second, segments[i].first - segments[i - 1].second);
+    if (!segments.isEmpty()) {
+        consume(workingText, consumed, 0, segments.first().first);
+        consume(workingText, consumed, segments.last().second, workingText.length() - segments.last().second);
+    }
+
+    /// If testing for the actual existence of a filename found in the text,
+    /// check if a segment between separators as a whole is a filename
+    if (testExistence == TestExistence::Yes)
+        for (const auto &segment : const_cast<const QVector<QPair<int, int>> &>(segments)) {
+            QString segmentText;
+            segmentText.reserve(segment.second - segment.first);
+            for (int i = segment.first; i < segment.second; ++i)
+                if (!consumed.testBit(i)) segmentText.append(text[i]);
+            if (segmentText.isEmpty()) continue;
+
+            QString fullFilename;
+            if (segmentText.startsWith(QStringLiteral("~") + QDir::separator()))
+                fullFilename = QDir::homePath() + segmentText.mid(1);
+            else if (!baseDirectory.isEmpty() &&
+                     // TODO the following test assumes that absolute paths start
+                     // with a dir separator, which may only be true on Unix/Linux,
+                     // but not Windows. May be a test for 'first character is a letter,
+                     // second is ":", third is "\"' may be necessary.
+                     !segmentText.startsWith(QDir::separator()))
                 /// To get the absolute path, prepend filename fragment with base directory
-                const QString fullFilename = baseDirectory + QDir::separator() + internalText;
-                const QFileInfo fileInfo(fullFilename);
-                const QUrl url = QUrl::fromLocalFile(fileInfo.absoluteFilePath());
-                if (fileInfo.exists() && fileInfo.isFile() && url.isValid() && !result.contains(url)) {
-                    result << url;
-                    /// Stop searching for URLs or filenames in current internal text
-                    continue;
-                }
-            } else {
+                fullFilename = baseDirectory + QDir::separator() + segmentText;
+            else
                 /// Either the filename fragment is an absolute path OR no base directory
                 /// was given (current working directory is assumed), ...
-                const QFileInfo fileInfo(internalText);
-                const QUrl url = QUrl::fromLocalFile(fileInfo.absoluteFilePath());
-                if (fileInfo.exists() && fileInfo.isFile() && url.isValid() && !result.contains(url)) {
-                    result << url;
-                    /// stop searching for URLs or filenames in current internal text
-                    continue;
-                }
+                fullFilename = segmentText;
+
+            const QString absoluteFilePath = QFileInfo(fullFilename).absoluteFilePath();
+            const QUrl url = QUrl::fromLocalFile(absoluteFilePath);
+            if (url.isValid() && directoryListingCache.isFile(absoluteFilePath)) {
+                result.append(UrlSpan {UrlSpan::Type::File, segment.first, segment.second - segment.first, url});
+                /// Stop searching for URLs or filenames in this segment
+                consume(workingText, consumed, segment.first, segment.second - segment.first);
             }
         }
 
-        /// extract URL from current field
-        pos = 0;
-        QRegularExpressionMatch urlRegExpMatch;
-        while ((urlRegExpMatch = KBibTeX::urlRegExp.match(internalText, pos)).hasMatch()) {
-            pos = urlRegExpMatch.capturedStart(0);
-            const QString match = urlRegExpMatch.captured(0);
-            QUrl url(match);
-            if (url.isValid() && (testExistence == TestExistence::No || !url.isLocalFile() || QFileInfo::exists(url.toLocalFile())) && !result.contains(url))
-                result << url;
-            /// remove match from internal text to avoid duplicates
-            internalText = internalText.left(pos) + internalText.mid(pos + match.length());
-        }
+    /// Extract URLs
+    QRegularExpressionMatchIterator urlIt = KBibTeX::urlRegExp.globalMatch(workingText);
+    while (urlIt.hasNext()) {
+        const QRegularExpressionMatch urlRegExpMatch = urlIt.next();
+        const QUrl url(urlRegExpMatch.captured(0));
+        if (url.isValid() && (testExistence == TestExistence::No || !url.isLocalFile() || directoryListingCache.exists(QFileInfo(url.toLocalFile()).absoluteFilePath())))
+            result.append(UrlSpan {UrlSpan::Type::Url, urlRegExpMatch.capturedStart(0), urlRegExpMatch.capturedLength(0), url});
+        consume(workingText, consumed, urlRegExpMatch.capturedStart(0), urlRegExpMatch.capturedLength(0));
+    }
 
-        /// explicitly check URL entry, may be an URL even if http:// or alike is missing
-        pos = 0;
-        QRegularExpressionMatch domainNameRegExpMatch;
-        while ((domainNameRegExpMatch = KBibTeX::domainNameRegExp.match(internalText, pos)).hasMatch()) {
-            pos = domainNameRegExpMatch.capturedStart(0);
-            /// URL ends either at space or at string's end
-            int pos2 = internalText.indexOf(QStringLiteral(" "), pos + 1);
-            if (pos2 < 0) pos2 = internalText.length();
-            QString match = internalText.mid(pos, pos2 - pos);
-            const QUrl url(QStringLiteral("https://") + match);
-            if (url.isValid() && !result.contains(url))
-                result << url;
-            /// remove match from internal text to avoid duplicates
-            internalText = internalText.left(pos) + internalText.mid(pos + match.length());
-        }
+    /// Explicitly check for domain names, may be an URL even if http:// or alike is missing
+    pos = 0;
+    QRegularExpressionMatch domainNameRegExpMatch;
+    while ((domainNameRegExpMatch = KBibTeX::domainNameRegExp.match(workingText, pos)).hasMatch()) {
+        pos = domainNameRegExpMatch.capturedStart(0);
+        /// URL ends either at space or at end of segment
+        int end = pos + 1;
+        while (end < workingText.length() && !consumed.testBit(end) && workingText[end] != QLatin1Char(' '))
+            ++end;
+        const QUrl url(QStringLiteral("https://") + text.mid(pos, end - pos));
+        if (url.isValid())
+            result.append(UrlSpan {UrlSpan::Type::DomainName, pos, end - pos, url});
+        consume(workingText, consumed, pos, end - pos);
+        pos = end;
+    }
 
-        /// extract general file-like patterns
-        pos = 0;
-        QRegularExpressionMatch fileRegExpMatch;
-        while ((fileRegExpMatch = KBibTeX::fileRegExp.match(internalText, pos)).hasMatch()) {
-            pos = fileRegExpMatch.capturedStart(0);
-            const QString match = fileRegExpMatch.captured(0);
-            const QFileInfo fi(match);
-            const QUrl url = QUrl::fromLocalFile(!match.startsWith(QStringLiteral("/")) && !match.startsWith(QStringLiteral("http")) && fi.isRelative() && !baseDirectory.isEmpty() ? baseDirectory + QStringLiteral("/") + match : match);
-            if (url.isValid() && (testExistence == TestExistence::No || QFileInfo::exists(url.toLocalFile())) && !result.contains(url))
-                result << url;
-            /// remove match from internal text to avoid duplicates
-            internalText = internalText.left(pos) + internalText.mid(pos + match.length());
-        }
+    /// Extract general file-like patterns
+    QRegularExpressionMatchIterator fileIt = KBibTeX::fileRegExp.globalMatch(workingText);
+    while (fileIt.hasNext()) {
+        const QRegularExpressionMatch fileRegExpMatch = fileIt.next();
+        const QString match = fileRegExpMatch.captured(0);
+        const QFileInfo fi(match);
+        const QUrl url = QUrl::fromLocalFile(!match.startsWith(QStringLiteral("/")) && !match.startsWith(QStringLiteral("http")) && fi.isRelative() && !baseDirectory.isEmpty() ? baseDirectory + QStringLiteral("/") + match : match);
+        if (url.isValid() && (testExistence == TestExistence::No || directoryListingCache.exists(QFileInfo(url.toLocalFile()).absoluteFilePath())))
+            result.append(UrlSpan {UrlSpan::Type::File, fileRegExpMatch.capturedStart(0), fileRegExpMatch.capturedLength(0), url});
+        consume(workingText, consumed, fileRegExpMatch.capturedStart(0), fileRegExpMatch.capturedLength(0));
     }
+
+    std::sort(result.begin(), result.end(), [](const UrlSpan &a, const UrlSpan &b) {
+        return a.start < b.start;
+    });
+    return result;
+}
+
+void FileInfo::urlsInText(const QString &text, const TestExistence testExistence, const QString &baseDirectory, QSet<QUrl> &result)
+{
+    const QVector<UrlSpan> spans = urlSpansInText(text, testExistence, baseDirectory);
+    for (const UrlSpan &span : spans)
+        result.insert(span.url);
 }
 
 QSet<QUrl> FileInfo::entryUrls(const QSharedPointer<const Entry> &entry, const QUrl &bibTeXUrl, TestExistence testExistence)
@@ -297,6 +449,7 @@ QSet<QUrl> FileInfo::entryUrls(const QSharedPointer<const Entry> &entry, const Q
     }
 
     if (!baseDirectory.isEmpty()) {
+        DirectoryListingCache &directoryListingCache = DirectoryListingCache::instance();
         /// File types supported by "document preview"
         static const QStringList documentFileExtensions {QStringLiteral(".pdf"), QStringLiteral(".pdf.gz"), QStringLiteral(".pdf.bz2"), QStringLiteral(".ps"), QStringLiteral(".ps.gz"), QStringLiteral(".ps.bz2"), QStringLiteral(".eps"), QStringLiteral(".eps.gz"), QStringLiteral(".eps.bz2"), QStringLiteral(".html"), QStringLiteral(".xhtml"), QStringLiteral(".htm"), QStringLiteral(".dvi"), QStringLiteral(".djvu"), QStringLiteral(".wwf"), QStringLiteral(".jpeg"), QStringLiteral(".jpg"), QStringLiteral(".png"), QStringLiteral(".gif"), QStringLiteral(".tif"), QStringLiteral(".tiff")};
         result.reserve(result.size() + documentFileExtensions.size() * 2);
@@ -305,7 +458,7 @@ QSet<QUrl> FileInfo::entryUrls(const QSharedPointer<const Entry> &entry, const Q
         /// a PDF file exists which filename is based on the entry's id
         for (const QString &extension : documentFileExtensions) {
             const QFileInfo fi(baseDirectory + QDir::separator() + entry->id() + extension);
-            if (fi.exists()) {
+            if (directoryListingCache.exists(fi.absoluteFilePath())) {
                 const QUrl url = QUrl::fromLocalFile(fi.absoluteFilePath());
                 if (!result.contains(url))
                     result << url;
@@ -319,11 +472,10 @@ QSet<QUrl> FileInfo::entryUrls(const QSharedPointer<const Entry> &entry, const Q
         const QString ending = filenameInfo.completeSuffix();
         QString directory = baseDirectory + QDir::separator() + bibTeXUrl.fileName();
         directory.chop(ending.length() + 1);
-        const QFileInfo fi(directory);
-        if (fi.isDir())
+        if (directoryListingCache.kind(QFileInfo(directory).absoluteFilePath()) == DirectoryListingCache::Kind::Directory)
             for (const QString &extension : documentFileExtensions) {
                 const QFileInfo fi(directory + QDir::separator() + entry->id() + extension);
-                if (fi.exists()) {
+                if (directoryListingCache.exists(fi.absoluteFilePath())) {
                     const QUrl url = QUrl::fromLocalFile(fi.absoluteFilePath());
                     if (!result.contains(url))
                         result << url;
@@ -334,86 +486,474 @@ QSet<QUrl> FileInfo::entryUrls(const QSharedPointer<const Entry> &entry, const Q
     return result;
 }
 
+QSharedPointer<const Entry> FileInfo::plainTextCopy(const QSharedPointer<const Entry> &entry)
+{
+    QSharedPointer<Entry> entryCopy(new Entry(entry->type(), entry->id()));
+    for (Entry::ConstIterator it = entry->constBegin(); it != entry->constEnd(); ++it) {
+        if (it.key().toLower() == Entry::ftAbstract) continue; ///< skipped by entryUrls anyway
+        Value value;
+        for (const auto &valueItem : it.value())
+            value.append(QSharedPointer<PlainText>(new PlainText(PlainTextValue::text(*valueItem))));
+        entryCopy->insert(it.key(), value);
+    }
+    return entryCopy;
+}
+
 #ifdef HAVE_POPPLERQT
-QString FileInfo::pdfToText(const QString &pdfFilename)
+/**
+ * Cache of plain text extracted from PDF files. Each PDF file's text is
+ * stored in a text file named after the SHA-1 hash of the PDF file's
+ * content, so that modified PDF files get extracted again and different
+ * PDF files never share a text file. Hashes are memorized together with
+ * each PDF file's modification time and size and only get recomputed if
+ * either of both changes. Fingerprints are persisted next to the text
+ * files, so hashes survive restarts.
+ * Once per process, fingerprints of PDF files that no longer exist or
+ * have changed get dropped. Text files no longer referenced by any
+ * fingerprint and, if the cache grows too large, the oldest text files
+ * get deleted in the background.
+ * Text gets extracted either in the calling thread or by a pool of
+ * background workers bounded by the number of CPU cores, which get
+ * stopped once the application is about to quit. Each PDF file gets
+ * extracted only once, even if requested by several threads at once.
+ */
+class PDFTextCache
 {
-    const QString cacheLocation {QStandardPaths::writableLocation(QStandardPaths::CacheLocation)};
-    if (!QDir(cacheLocation).exists() && !QDir::home().mkdir(cacheLocation)) {
-        /// Could not create cache directory
-        qCWarning(LOG_KBIBTEX_IO) << "Could not create cache location:" << cacheLocation;
-        return QString();
+public:
+    static PDFTextCache &instance() {
+        static PDFTextCache singleton;
+        return singleton;
     }
-    /// Build filename for text file where PDF file's plain text is cached
-    const QString cacheDirectory {cacheLocation + QStringLiteral("/pdftotext")};
-    if (!QDir(cacheDirectory).exists() && !QDir::home().mkdir(cacheDirectory)) {
-        /// Could not create cache directory
-        qCWarning(LOG_KBIBTEX_IO) << "Could not create cache directory:" << cacheDirectory;
-        return QString();
+
+    ~PDFTextCache() {
+        /// Usually done already when the application was about to quit
+        shutDown();
+    }
+
+    /**
+     * Stop all background work and save the fingerprints. Called when the
+     * application is about to quit, as waiting for workers while static
+     * objects get destroyed may block the process from exiting.
+     */
+    void shutDown() {
+        if (!shuttingDown.testAndSetRelaxed(0, 1))
+            return;
+        /// Do not start any pending prefetching when shutting down
+        workerPool.clear();
+        workerPool.waitForDone();
+        saveFingerprints();
+    }
+
+    QString cacheFilename(const QString &pdfFilename) {
+        const QFileInfo pdfFileInfo(pdfFilename);
+        if (!pdfFileInfo.isFile())
+            return QString();
+        if (directory.isEmpty())
+            return QString();
+
+        const QString absoluteFilePath = pdfFileInfo.absoluteFilePath();
+        const QDateTime lastModified = pdfFileInfo.lastModified();
+        const qint64 size = pdfFileInfo.size();
+        QString hash;
+        {
+            QMutexLocker locker(&mutex);
+            const auto it = fingerprints.constFind(absoluteFilePath);
+            if (it != fingerprints.constEnd() && it->lastModified == lastModified && it->size == size)
+                hash = it->hash;
+        }
+        if (hash.isEmpty()) {
+            QFile pdfFile(absoluteFilePath);
+            if (!pdfFile.open(QFile::ReadOnly)) {
+                qCWarning(LOG_KBIBTEX_IO) << "Could not read PDF file to determine its hash:" << absoluteFilePath;
+                return QString();
+            }
+            QCryptographicHash contentHash(QCryptographicHash::Sha1);
+            contentHash.addData(&pdfFile);
+            pdfFile.close();
+            hash = QString::fromLatin1(contentHash.result().toHex());
+
+            bool saveNow = false;
+            {
+                QMutexLocker locker(&mutex);
+                fingerprints.insert(absoluteFilePath, Fingerprint {lastModified, size, hash});
+                saveNow = ++unsavedFingerprints >= fingerprintsSaveInterval;
+            }
+            /// Do not lose too many hashes if the program does not terminate regularly
+            if (saveNow)
+                saveFingerprints();
+        }
+
+        return directory + QStringLiteral("/") + hash + QStringLiteral(".txt");
     }
-    static const QRegularExpression invalidChars(QStringLiteral("[^-a-z0-9_]"), QRegularExpression::CaseInsensitiveOption);
-    const QString textFilename = QString(pdfFilename).remove(invalidChars).append(QStringLiteral(".txt")).prepend(QStringLiteral("/")).prepend(cacheDirectory);
 
-    /// First, check if there is a cache text file
-    if (QFileInfo::exists(textFilename)) {
+    QString text(const QString &pdfFilename, const QString &cacheFilename, bool textNeeded) {
+        {
+            QMutexLocker locker(&mutex);
+            /// If another thread is extracting this file's text already, wait for it instead of extracting twice
+            while (extractionsInProgress.contains(cacheFilename))
+                extractionFinished.wait(&mutex);
+            if (!QFileInfo::exists(cacheFilename)) {
+                extractionsInProgress.insert(cacheFilename);
+                locker.unlock();
+                const QString text = extract(pdfFilename, cacheFilename);
+                locker.relock();
+                extractionsInProgress.remove(cacheFilename);
+                extractionFinished.wakeAll();
+                return text;
+            }
+        }
+
+        if (!textNeeded)
+            return QString();
         /// Load text from cache file
-        QFile f(textFilename);
+        QFile f(cacheFilename);
         if (f.open(QFile::ReadOnly)) {
             const QString text = QString::fromUtf8(f.readAll());
             f.close();
             return text;
         } else
             return QString();
-    } else {
-        return extractPDFTextToCache(pdfFilename, textFilename);
     }
-}
 
-QString FileInfo::extractPDFTextToCache(const QString &pdfFilename, const QString &cacheFilename) {
-    /// In case of multiple calls, skip text extraction if cache file already exists
-    if (QFile(cacheFilename).exists())
-        return QString();
+    void forget(const QString &pdfFilename) {
+        QMutexLocker locker(&mutex);
+        if (fingerprints.remove(QFileInfo(pdfFilename).absoluteFilePath()) > 0)
+            ++unsavedFingerprints;
+    }
+
+    void prefetch(const QStringList &pdfFilenames);
+    void prefetch(const QVector<QSharedPointer<const Entry>> &entries, const QUrl &bibTeXUrl);
+
+    void evict();
+
+private:
+    friend class PDFTextPrefetchRunnable;
+
+    /// Number of new or removed fingerprints after which fingerprints get saved
+    static const int fingerprintsSaveInterval;
+    /// Total size of text files above which the oldest ones get deleted
+    static const qint64 maxCacheSize;
+    /// Unreferenced text files younger than this may belong to another running instance
+    static const qint64 minUnreferencedAgeSeconds;
+
+    struct Fingerprint {
+        QDateTime lastModified;
+        qint64 size;
+        QString hash;
+    };
+
+    QMutex mutex;
+    QWaitCondition extractionFinished;
+    const QString directory;
+    /// Absolute filenames of PDF files mapped to their last known fingerprint
+    QHash<QString, Fingerprint> fingerprints;
+    int unsavedFingerprints;
+    QSet<QString> extractionsInProgress;
+    /// Absolute filenames of PDF files waiting to be prefetched
+    QSet<QString> prefetchQueue;
+    QThreadPool workerPool;
+    /// Once set, no more background work gets started
+    QAtomicInt shuttingDown;
+
+    PDFTextCache();
+
+    QString fingerprintsFilename() const {
+        return directory + QStringLiteral("/fingerprints");
+    }
+
+    void loadFingerprints() {
+        QFile f(fingerprintsFilename());
+        if (!f.open(QFile::ReadOnly))
+            return;
+        /// Each line consists of hash, size, modification time, and filename, separated by tabulators
+        while (!f.atEnd()) {
+            QByteArray line = f.readLine();
+            if (line.endsWith('\n'))
+                line.chop(1);
+            const int sizeSeparator = line.indexOf('\t');
+            const int lastModifiedSeparator = line.indexOf('\t', sizeSeparator + 1);
+            const int filenameSeparator = line.indexOf('\t', lastModifiedSeparator + 1);
+            if (sizeSeparator != 40 || lastModifiedSeparator < 0 || filenameSeparator < 0)
+                continue;
+            bool sizeOk = false, lastModifiedOk = false;
+            const qint64 size = line.mid(sizeSeparator + 1, lastModifiedSeparator - sizeSeparator - 1).toLongLong(&sizeOk);
+            const qint64 lastModified = line.mid(lastModifiedSeparator + 1, filenameSeparator - lastModifiedSeparator - 1).toLongLong(&lastModifiedOk);
+            if (sizeOk && lastModifiedOk)
+                fingerprints.insert(QString::fromUtf8(line.mid(filenameSeparator + 1)), Fingerprint {QDateTime::fromMSecsSinceEpoch(lastModified), size, QString::fromLatin1(line.left(sizeSeparator))});
+        }
+        f.close();
+    }
+
+    void saveFingerprints() {
+        QMutexLocker locker(&mutex);
+        if (unsavedFingerprints == 0 || directory.isEmpty())
+            return;
+        QSaveFile f(fingerprintsFilename());
+        if (!f.open(QFile::WriteOnly)) {
+            qCWarning(LOG_KBIBTEX_IO) << "Could not write PDF file fingerprints:" << f.fileName();
+            return;
+        }
+        for (auto it = fingerprints.constBegin(); it != fingerprints.constEnd(); ++it) {
+            const QByteArray line = it->hash.toLatin1() + '\t' + QByteArray::number(it->size) + '\t' + QByteArray::number(it->lastModified.toMSecsSinceEpoch()) + '\t' + it.key().toUtf8() + '\n';
+            f.write(line);
+        }
+        if (f.commit())
+            unsavedFingerprints = 0;
+        else
+            qCWarning(LOG_KBIBTEX_IO) << "Could not write PDF file fingerprints:" << f.fileName();
+    }
+
+    static QString cacheDirectory() {
+        const QString cacheLocation {QStandardPaths::writableLocation(QStandardPaths::CacheLocation)};
+        if (!QDir(cacheLocation).exists() && !QDir::home().mkpath(cacheLocation)) {
+            /// Could not create cache directory
+            qCWarning(LOG_KBIBTEX_IO) << "Could not create cache location:" << cacheLocation;
+            return QString();
+        }
+        /// Directory for text files where PDF files' plain text is cached
+        const QString cacheDirectory {cacheLocation + QStringLiteral("/pdftotext")};
+        if (!QDir(cacheDirectory).exists() && !QDir::home().mkpath(cacheDirectory)) {
+            /// Could not create cache directory
+            qCWarning(LOG_KBIBTEX_IO) << "Could not create cache directory:" << cacheDirectory;
+            return QString();
+        }
+        return cacheDirectory;
+    }
 
-    QString text;
-    QStringList msgList;
+    static QString extract(const QString &pdfFilename, const QString &cacheFilename) {
+        QString text;
+        QStringList msgList;
 
-    /// Load PDF file through Poppler
+        /// Load PDF file through Poppler
 #ifdef HAVE_POPPLERQT5
-    QScopedPointer<Poppler::Document> doc(Poppler::Document::load(pdfFilename));
+        QScopedPointer<Poppler::Document> doc(Poppler::Document::load(pdfFilename));
 #else // not HAVE_POPPLERQT5
 #ifdef HAVE_POPPLERQT6
-    std::unique_ptr<Poppler::Document> doc = Poppler::Document::load(pdfFilename);
+        std::unique_ptr<Poppler::Document> doc = Poppler::Document::load(pdfFilename);
 #endif // HAVE_POPPLERQT6
 #endif // HAVE_POPPLERQT5
 
-    if (!doc)
-        msgList << QStringLiteral("### Skipped as file could not be opened as PDF file ###");
-    else {
-        static const int maxPages = 64;
-        /// Build text by appending each page's text
-        for (int i = 0; i < qMin(maxPages, doc->numPages()); ++i)
-            text.append(doc->page(i)->text(QRect())).append(QStringLiteral("\n\n"));
-        if (doc->numPages() > maxPages)
-            msgList << QString(QStringLiteral("### Skipped %1 pages as PDF file contained too many pages (limit is %2 pages) ###")).arg(doc->numPages() - maxPages).arg(maxPages);
-    }
-
-    /// Save text in cache file
-    QFile f(cacheFilename);
-    if (f.open(QFile::WriteOnly)) {
-        static const int maxCharacters = 1 << 18;
-        f.write(text.left(maxCharacters).toUtf8()); ///< keep only the first 2^18 many characters
-
-        if (text.length() > maxCharacters)
-            msgList << QString(QStringLiteral("### Text too long, skipping %1 characters ###")).arg(text.length() - maxCharacters);
-        /// Write all messages (warnings) to end of text file
-        for (const QString &msg : const_cast<const QStringList &>(msgList)) {
-            static const char linebreak = '\n';
-            f.write(&linebreak, 1);
-            f.write(msg.toUtf8());
+        if (!doc)
+            msgList << QStringLiteral("### Skipped as file could not be opened as PDF file ###");
+        else {
+            static const int maxPages = 64;
+            /// Build text by appending each page's text
+            for (int i = 0; i < qMin(maxPages, doc->numPages()); ++i)
+                text.append(doc->page(i)->text(QRect())).append(QStringLiteral("\n\n"));
+            if (doc->numPages() > maxPages)
+                msgList << QString(QStringLiteral("### Skipped %1 pages as PDF file contained too many pages (limit is %2 pages) ###")).arg(doc->numPages() - maxPages).arg(maxPages);
         }
 
-        f.close();
+        /// Save text in cache file, which becomes visible only once completely written
+        QSaveFile f(cacheFilename);
+        if (f.open(QFile::WriteOnly)) {
+            static const int maxCharacters = 1 << 18;
+            f.write(text.left(maxCharacters).toUtf8()); ///< keep only the first 2^18 many characters
+
+            if (text.length() > maxCharacters)
+                msgList << QString(QStringLiteral("### Text too long, skipping %1 characters ###")).arg(text.length() - maxCharacters);
+            /// Write all messages (warnings) to end of text file
+            for (const QString &msg : const_cast<const QStringList &>(msgList)) {
+                static const char linebreak = '\n';
+                f.write(&linebreak, 1);
+                f.write(msg.toUtf8());
+            }
+
+            if (!f.commit())
+                qCWarning(LOG_KBIBTEX_IO) << "Could not write cache file:" << cacheFilename;
+        }
+
+        return text;
+    }
+};
+
+/// Background task to either warm the cache for a single PDF file or to locate PDF files of entries
+class PDFTextPrefetchRunnable : public QRunnable
+{
+public:
+    explicit PDFTextPrefetchRunnable(const QString &pdfFilename)
+            : pdfFilename(pdfFilename) {
+        /// nothing
+    }
+
+    PDFTextPrefetchRunnable(const QVector<QSharedPointer<const Entry>> &entries, const QUrl &bibTeXUrl)
+            : entries(entries), bibTeXUrl(bibTeXUrl) {
+        /// nothing
     }
 
-    return text;
+    void run() override {
+        PDFTextCache &cache = PDFTextCache::instance();
+        if (!pdfFilename.isEmpty()) {
+            {
+                QMutexLocker locker(&cache.mutex);
+                cache.prefetchQueue.remove(pdfFilename);
+            }
+            const QString cacheFilename = cache.cacheFilename(pdfFilename);
+            if (!cacheFilename.isEmpty())
+                cache.text(pdfFilename, cacheFilename, false);
+        } else {
+            /// Testing for existence of files is too slow to be done in the calling thread
+            QStringList pdfFilenames;
+            for (const QSharedPointer<const Entry> &entry : const_cast<const QVector<QSharedPointer<const Entry>> &>(entries)) {
+                if (cache.shuttingDown.loadRelaxed() != 0)
+                    return;
+                const auto entryUrlList = FileInfo::entryUrls(entry, bibTeXUrl, FileInfo::TestExistence::Yes);
+                for (const QUrl &url : entryUrlList)
+                    if (url.isLocalFile() && url.fileName().endsWith(QStringLiteral(".pdf"), Qt::CaseInsensitive))
+                        pdfFilenames.append(url.toLocalFile());
+            }
+            cache.prefetch(pdfFilenames);
+        }
+    }
+
+private:
+    const QString pdfFilename;
+    const QVector<QSharedPointer<const Entry>> entries;
+    const QUrl bibTeXUrl;
+};
+
+/// Background task to clean up the cache once per process
+class PDFTextCacheEvictionRunnable : public QRunnable
+{
+public:
+    explicit PDFTextCacheEvictionRunnable(PDFTextCache *cache)
+            : cache(cache) {
+        /// nothing
+    }
+
+    void run() override {
+        cache->evict();
+    }
+
+private:
+    PDFTextCache *const cache;
+};
+
+const int PDFTextCache::fingerprintsSaveInterval = 64;
+const qint64 PDFTextCache::maxCacheSize = Q_INT64_C(512) << 20;
+const qint64 PDFTextCache::minUnreferencedAgeSeconds = 24 * 3600;
+
+PDFTextCache::PDFTextCache()
+        : directory(cacheDirectory()), unsavedFingerprints(0), shuttingDown(0)
+{
+    workerPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    if (QCoreApplication::instance() != nullptr)
+        QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, [this]() {
+            shutDown();
+        });
+    if (!directory.isEmpty()) {
+        loadFingerprints();
+        /// Cleaning up has lower priority than prefetching
+        workerPool.start(new PDFTextCacheEvictionRunnable(this), -2);
+    }
+}
+
+void PDFTextCache::evict()
+{
+    /// Testing PDF files happens on a copy, so that extractions are not blocked meanwhile
+    QHash<QString, Fingerprint> knownFingerprints;
+    {
+        QMutexLocker locker(&mutex);
+        knownFingerprints = fingerprints;
+    }
+    QSet<QString> referencedHashes;
+    QStringList outdatedFilenames;
+    for (auto it = knownFingerprints.constBegin(); it != knownFingerprints.constEnd(); ++it) {
+        const QFileInfo pdfFileInfo(it.key());
+        if (pdfFileInfo.isFile() && pdfFileInfo.lastModified() == it->lastModified && pdfFileInfo.size() == it->size)
+            referencedHashes.insert(it->hash);
+        else
+            outdatedFilenames.append(it.key());
+    }
+    {
+        QMutexLocker locker(&mutex);
+        for (const QString &filename : const_cast<const QStringList &>(outdatedFilenames)) {
+            /// Fingerprint may have been updated in the meantime
+            const auto it = fingerprints.find(filename);
+            if (it != fingerprints.end() && it->hash == knownFingerprints.value(filename).hash) {
+                fingerprints.erase(it);
+                ++unsavedFingerprints;
+            }
+        }
+        /// Text files of fingerprints added in the meantime must be kept as well
+        for (auto it = fingerprints.constBegin(); it != fingerprints.constEnd(); ++it)
+            referencedHashes.insert(it->hash);
+    }
+    saveFingerprints();
+
+    /// Oldest text files first
+    const QFileInfoList textFiles = QDir(directory).entryInfoList(QStringList() << QStringLiteral("*.txt"), QDir::Files, QDir::Time | QDir::Reversed);
+    const QDateTime now = QDateTime::currentDateTime();
+    QFileInfoList remainingTextFiles;
+    qint64 totalSize = 0;
+    int removedCount = 0;
+    for (const QFileInfo &textFile : textFiles) {
+        if (!referencedHashes.contains(textFile.completeBaseName()) && textFile.lastModified().secsTo(now) > minUnreferencedAgeSeconds && QFile::remove(textFile.absoluteFilePath()))
+            ++removedCount;
+        else {
+            remainingTextFiles.append(textFile);
+            totalSize += textFile.size();
+        }
+    }
+    for (auto it = remainingTextFiles.constBegin(); totalSize > maxCacheSize && it != remainingTextFiles.constEnd(); ++it) {
+        QMutexLocker locker(&mutex);
+        if (extractionsInProgress.contains(it->absoluteFilePath()) || !QFile::remove(it->absoluteFilePath()))
+            continue;
+        totalSize -= it->size();
+        ++removedCount;
+    }
+
+    if (removedCount > 0)
+        qCDebug(LOG_KBIBTEX_IO) << "Removed" << removedCount << "text files from PDF text cache, remaining size is" << totalSize << "bytes";
+}
+
+void PDFTextCache::prefetch(const QStringList &pdfFilenames)
+{
+    if (shuttingDown.loadRelaxed() != 0) return;
+    QMutexLocker locker(&mutex);
+    for (const QString &pdfFilename : pdfFilenames) {
+        const QString absoluteFilePath = QFileInfo(pdfFilename).absoluteFilePath();
+        if (prefetchQueue.contains(absoluteFilePath)) continue;
+        prefetchQueue.insert(absoluteFilePath);
+        /// Prefetching has lower priority than locating PDF files
+        workerPool.start(new PDFTextPrefetchRunnable(absoluteFilePath), -1);
+    }
+}
+
+void PDFTextCache::prefetch(const QVector<QSharedPointer<const Entry>> &entries, const QUrl &bibTeXUrl)
+{
+    if (shuttingDown.loadRelaxed() != 0) return;
+    /// Entries may get modified while the background task is running,
+    /// so hand over copies of their values reduced to plain text
+    QVector<QSharedPointer<const Entry>> snapshot;
+    snapshot.reserve(entries.count());
+    for (const QSharedPointer<const Entry> &entry : entries)
+        if (!entry.isNull())
+            snapshot.append(FileInfo::plainTextCopy(entry));
+    workerPool.start(new PDFTextPrefetchRunnable(snapshot, bibTeXUrl));
+}
+
+QString FileInfo::pdfToText(const QString &pdfFilename)
+{
+    PDFTextCache &cache = PDFTextCache::instance();
+    const QString cacheFilename = cache.cacheFilename(pdfFilename);
+    if (cacheFilename.isEmpty())
+        return QString();
+    return cache.text(pdfFilename, cacheFilename, true);
+}
+
+void FileInfo::prefetchPDFText(const QStringList &pdfFilenames)
+{
+    PDFTextCache::instance().prefetch(pdfFilenames);
+}
+
+void FileInfo::prefetchPDFText(const QVector<QSharedPointer<const Entry>> &entries, const QUrl &bibTeXUrl)
+{
+    PDFTextCache::instance().prefetch(entries, bibTeXUrl);
+}
+
+void FileInfo::invalidatePDFTextCache(const QString &pdfFilename)
+{
+    PDFTextCache::instance().forget(pdfFilename);
 }
 #endif // HAVE_POPPLERQT
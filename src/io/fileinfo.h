@@ -22,6 +22,8 @@
 
 #include <QSet>
 #include <QUrl>
+#include <QVector>
+#include <QStringList>
 #include <QMimeType>
 #include <QSharedPointer>
 
@@ -60,6 +62,30 @@ public:
      */
     static QMimeType mimeTypeForUrl(const QUrl &url);
 
+    /**
+     * Reference to a DOI, an URL, a domain name, or a file found in a text.
+     */
+    struct UrlSpan {
+        enum class Type { DOI, Url, DomainName, File };
+        Type type;
+        int start; ///< position of first character in the text
+        int length; ///< number of characters in the text
+        QUrl url; ///< URL the span refers to, e.g. DOI resolver's URL for a DOI
+    };
+
+    /**
+     * Find all file or URL references in the given text, similar to
+     * @see urlsInText, without modifying or copying the text for each
+     * found reference. Found spans do not overlap and are sorted by
+     * their position in the text. Existence of files gets tested by
+     * listing each involved directory only once.
+     * @param text text to scan for filenames or URLs
+     * @param testExistence shall be tested for file existence?
+     * @param baseDirectory base directory for tests on relative path names
+     * @return spans of found references
+     */
+    static QVector<UrlSpan> urlSpansInText(const QString &text, const TestExistence testExistence, const QString &baseDirectory);
+
     /**
      * Find all file or URL references in the given text. Found filenames or
      * URLs are appended to the addTo list (duplicates are avoided).
@@ -88,24 +114,57 @@ public:
      */
     static QSet<QUrl> entryUrls(const QSharedPointer<const Entry> &entry, const QUrl &bibTeXUrl, TestExistence testExistence);
 
+    /**
+     * Create a copy of the given entry with all values reduced to plain
+     * text, skipping the abstract. The copy can be handed to a background
+     * thread calling @see entryUrls while the original entry may get
+     * modified.
+     * @param entry entry to copy
+     * @return plain-text copy of the entry
+     */
+    static QSharedPointer<const Entry> plainTextCopy(const QSharedPointer<const Entry> &entry);
+
 #ifdef HAVE_POPPLERQT
     /**
      * Load the given PDF file and return the contained plain text.
      * Makes use of Poppler to load and parse the file. All text
-     * will be cached and loaded from cache if possible.
+     * will be cached and loaded from cache if possible. The cache
+     * is keyed on the PDF file's content, so modified PDF files
+     * get their text extracted again.
      * @param pdfFilename PDF file to load and extract text from
      * @return extracted plain text, either directly from PDF file or from cache OR QString() if there was an error
      */
     static QString pdfToText(const QString &pdfFilename);
+
+    /**
+     * Extract the plain text of the given PDF files into the cache
+     * in the background, so that later calls to @see pdfToText
+     * can be answered from the cache. Returns immediately.
+     * @param pdfFilenames PDF files to extract text from
+     */
+    static void prefetchPDFText(const QStringList &pdfFilenames);
+
+    /**
+     * Locate all PDF files associated with the given entries and
+     * extract their plain text into the cache in the background.
+     * Returns immediately, as even locating the files is done in
+     * the background on a copy of the entries.
+     * @param entries entries whose PDF files shall be prefetched
+     * @param bibTeXUrl base directory/URL for tests on relative path names
+     */
+    static void prefetchPDFText(const QVector<QSharedPointer<const Entry>> &entries, const QUrl &bibTeXUrl);
+
+    /**
+     * Forget what is known about the given PDF file, for example if
+     * the PDF file has been modified. Next call to @see pdfToText
+     * will determine which text from the cache to use again.
+     * @param pdfFilename PDF file that has been modified
+     */
+    static void invalidatePDFTextCache(const QString &pdfFilename);
 #endif // HAVE_POPPLERQT
 
 protected:
     FileInfo();
-
-private:
-#ifdef HAVE_POPPLERQT
-    static QString extractPDFTextToCache(const QString &pdfFilename, const QString &cacheFilename);
-#endif // HAVE_POPPLERQT
 };
 
 #endif // KBIBTEX_IO_FILEINFO_H
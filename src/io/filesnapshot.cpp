@@ -0,0 +1,498 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "filesnapshot.h"
+
+#include <cstring>
+
+#include <QHash>
+#include <QVector>
+#include <QVariant>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+
+#include <Preferences>
+#include <File>
+#include <Entry>
+#include <Macro>
+#include <Comment>
+#include <Preamble>
+#include <Value>
+#include <Tracing>
+
+#include "logging_io.h"
+
+namespace {
+
+/// Layout of a snapshot file. All numbers are stored in the
+/// machine's native byte order, as snapshots are a local cache only.
+struct SnapshotHeader {
+    char magic[4];
+    quint32 formatVersion;
+    /// Size and modification time of the bibliography file the snapshot was created from
+    qint64 sourceSize;
+    qint64 sourceModified;
+    /// SHA-1 hash of the bibliography file's raw content
+    char sourceHash[20];
+    /// Indices into the string table
+    quint32 sourcePathString, variantString;
+    quint32 stringCount, wordCount;
+    /// Byte offsets of string table, words, and string pool
+    quint64 stringTableOffset, wordsOffset, stringPoolOffset;
+    /// Length of the string pool in UTF-16 code units
+    quint64 stringPoolLength;
+};
+
+/// One string in the string pool (in UTF-16 code units)
+struct StringRecord {
+    quint32 pos, len;
+};
+
+static const char snapshotMagic[4] = {'K', 'B', 'S', 'N'};
+static const quint32 snapshotFormatVersion = 1;
+
+/// Type tags for elements, value items, and property values as stored in the words
+enum class Tag : quint32 {
+    Entry = 1, Macro = 2, Comment = 3, Preamble = 4,
+    PlainText = 16, VerbatimText = 17, MacroKey = 18, Person = 19, Keyword = 20,
+    PropertyString = 32, PropertyInt = 33, PropertyBool = 34
+};
+
+class SnapshotWriter
+{
+public:
+    QVector<quint32> words;
+    QVector<StringRecord> stringTable;
+    QVector<QChar> pool;
+
+    quint32 string(const QString &text) {
+        const auto it = stringIndices.constFind(text);
+        if (it != stringIndices.constEnd())
+            return it.value();
+        const quint32 index = static_cast<quint32>(stringTable.count());
+        stringTable.append(StringRecord{static_cast<quint32>(pool.count()), static_cast<quint32>(text.length())});
+        pool.resize(pool.count() + text.length());
+        memcpy(pool.data() + pool.count() - text.length(), text.constData(), text.length() * sizeof(QChar));
+        stringIndices.insert(text, index);
+        return index;
+    }
+
+    void word(quint32 w) {
+        words.append(w);
+    }
+
+    void tag(Tag t) {
+        words.append(static_cast<quint32>(t));
+    }
+
+    bool value(const Value &value) {
+        word(static_cast<quint32>(value.count()));
+        for (const QSharedPointer<ValueItem> &item : value) {
+            if (PlainText::isPlainText(*item)) {
+                tag(Tag::PlainText);
+                word(string(static_cast<const PlainText *>(item.data())->text()));
+            } else if (Person::isPerson(*item)) {
+                const Person *person = static_cast<const Person *>(item.data());
+                tag(Tag::Person);
+                word(string(person->firstName()));
+                word(string(person->lastName()));
+                word(string(person->suffix()));
+            } else if (Keyword::isKeyword(*item)) {
+                tag(Tag::Keyword);
+                word(string(static_cast<const Keyword *>(item.data())->text()));
+            } else if (MacroKey::isMacroKey(*item)) {
+                tag(Tag::MacroKey);
+                word(string(static_cast<const MacroKey *>(item.data())->text()));
+            } else if (VerbatimText::isVerbatimText(*item)) {
+                const VerbatimText *verbatimText = static_cast<const VerbatimText *>(item.data());
+                tag(Tag::VerbatimText);
+                word(string(verbatimText->text()));
+                word(verbatimText->hasComment() ? 1 : 0);
+                word(string(verbatimText->comment()));
+            } else
+                return false; ///< unknown type of value item
+        }
+        return true;
+    }
+
+    bool element(const QSharedPointer<Element> &element) {
+        const Entry *entry = dynamic_cast<const Entry *>(element.data());
+        if (entry != nullptr) {
+            tag(Tag::Entry);
+            word(string(entry->type()));
+            word(string(entry->id()));
+            word(static_cast<quint32>(entry->count()));
+            for (Entry::ConstIterator it = entry->constBegin(); it != entry->constEnd(); ++it) {
+                word(string(it.key()));
+                if (!value(it.value()))
+                    return false;
+            }
+            return true;
+        }
+        const Macro *macro = dynamic_cast<const Macro *>(element.data());
+        if (macro != nullptr) {
+            tag(Tag::Macro);
+            word(string(macro->key()));
+            return value(macro->value());
+        }
+        const Comment *comment = dynamic_cast<const Comment *>(element.data());
+        if (comment != nullptr) {
+            tag(Tag::Comment);
+            word(string(comment->text()));
+            word(static_cast<quint32>(comment->context()));
+            word(string(comment->prefix()));
+            return true;
+        }
+        const Preamble *preamble = dynamic_cast<const Preamble *>(element.data());
+        if (preamble != nullptr) {
+            tag(Tag::Preamble);
+            return value(preamble->value());
+        }
+        return false; ///< unknown type of element
+    }
+
+private:
+    QHash<QString, quint32> stringIndices;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(const quint32 *_words, quint32 _wordCount, const QVector<QString> &_strings)
+            : ok(true), words(_words), wordCount(_wordCount), pos(0), strings(_strings) {
+        /// nothing
+    }
+
+    bool ok;
+
+    quint32 word() {
+        if (pos >= wordCount) {
+            ok = false;
+            return 0;
+        }
+        return words[pos++];
+    }
+
+    const QString &string() {
+        static const QString invalid;
+        const quint32 index = word();
+        if (index >= static_cast<quint32>(strings.count())) {
+            ok = false;
+            return invalid;
+        }
+        return strings[static_cast<int>(index)];
+    }
+
+    /// Upper bound for counts read from words, as each counted item takes at least one word
+    bool plausibleCount(quint32 count) {
+        if (count > wordCount - pos)
+            ok = false;
+        return ok;
+    }
+
+    Value value() {
+        Value result;
+        const quint32 count = word();
+        if (!plausibleCount(count))
+            return result;
+        result.reserve(static_cast<int>(count));
+        for (quint32 i = 0; i < count && ok; ++i) {
+            switch (static_cast<Tag>(word())) {
+            case Tag::PlainText:
+                result.append(QSharedPointer<PlainText>(new PlainText(string())));
+                break;
+            case Tag::Person: {
+                const QString &firstName = string();
+                const QString &lastName = string();
+                result.append(QSharedPointer<Person>(new Person(firstName, lastName, string())));
+                break;
+            }
+            case Tag::Keyword:
+                result.append(QSharedPointer<Keyword>(new Keyword(string())));
+                break;
+            case Tag::MacroKey:
+                result.append(QSharedPointer<MacroKey>(new MacroKey(string())));
+                break;
+            case Tag::VerbatimText: {
+                QSharedPointer<VerbatimText> verbatimText(new VerbatimText(string()));
+                const bool hasComment = word() != 0;
+                const QString &comment = string();
+                if (hasComment)
+                    verbatimText->setComment(comment);
+                result.append(verbatimText);
+                break;
+            }
+            default:
+                ok = false;
+            }
+        }
+        return result;
+    }
+
+    QSharedPointer<Element> element() {
+        switch (static_cast<Tag>(word())) {
+        case Tag::Entry: {
+            const QString &type = string();
+            QSharedPointer<Entry> entry(new Entry(type, string()));
+            const quint32 count = word();
+            if (!plausibleCount(count))
+                return QSharedPointer<Element>();
+            for (quint32 i = 0; i < count && ok; ++i) {
+                const QString &key = string();
+                entry->insert(key, value());
+            }
+            return entry;
+        }
+        case Tag::Macro: {
+            const QString &key = string();
+            return QSharedPointer<Macro>(new Macro(key, value()));
+        }
+        case Tag::Comment: {
+            const QString &text = string();
+            const quint32 context = word();
+            if (context > static_cast<quint32>(Preferences::CommentContext::Command)) {
+                ok = false;
+                return QSharedPointer<Element>();
+            }
+            return QSharedPointer<Comment>(new Comment(text, static_cast<Preferences::CommentContext>(context), string()));
+        }
+        case Tag::Preamble:
+            return QSharedPointer<Preamble>(new Preamble(value()));
+        default:
+            ok = false;
+            return QSharedPointer<Element>();
+        }
+    }
+
+private:
+    const quint32 *words;
+    const quint32 wordCount;
+    quint32 pos;
+    const QVector<QString> &strings;
+};
+
+}
+
+FileSnapshot::Source FileSnapshot::source(const QString &filename, const QByteArray &content, const QString &variant)
+{
+    const QFileInfo fileInfo(filename);
+    const QString canonicalPath = fileInfo.canonicalFilePath();
+    return Source {canonicalPath.isEmpty() ? fileInfo.absoluteFilePath() : canonicalPath, fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch(), QCryptographicHash::hash(content, QCryptographicHash::Sha1), variant};
+}
+
+QString FileSnapshot::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/snapshots");
+}
+
+QString FileSnapshot::cacheFilename(const QString &sourcePath)
+{
+    return cacheDirectory() + QStringLiteral("/") + QString::fromLatin1(QCryptographicHash::hash(sourcePath.toUtf8(), QCryptographicHash::Sha1).toHex()) + QStringLiteral(".snapshot");
+}
+
+void FileSnapshot::prune(const QString &directory, qint64 maxTotalSize, int maxAgeDays)
+{
+    /// Least recently used snapshots first
+    QFileInfoList snapshots = QDir(directory).entryInfoList({QStringLiteral("*.snapshot")}, QDir::Files, QDir::Time | QDir::Reversed);
+    const QDateTime oldestKept = QDateTime::currentDateTime().addDays(-maxAgeDays);
+    qint64 totalSize = 0;
+    for (const QFileInfo &snapshot : const_cast<const QFileInfoList &>(snapshots))
+        totalSize += snapshot.size();
+
+    int numRemoved = 0;
+    for (const QFileInfo &snapshot : const_cast<const QFileInfoList &>(snapshots)) {
+        if (totalSize <= maxTotalSize && snapshot.lastModified() >= oldestKept)
+            break;
+        if (QFile::remove(snapshot.filePath())) {
+            totalSize -= snapshot.size();
+            ++numRemoved;
+        }
+    }
+    if (numRemoved > 0)
+        qCDebug(LOG_KBIBTEX_IO) << "Removed" << numRemoved << "snapshots from" << directory;
+}
+
+bool FileSnapshot::save(const File &file, const Source &source, const QString &snapshotFilename)
+{
+    KBIBTEX_TRACE_SCOPE("io", "FileSnapshot::save");
+    if (source.contentHash.size() != static_cast<int>(sizeof(SnapshotHeader::sourceHash)))
+        return false;
+
+    SnapshotWriter writer;
+    const quint32 sourcePathString = writer.string(source.path);
+    const quint32 variantString = writer.string(source.variant);
+
+    /// File properties determined when loading a bibliography
+    const QStringList snapshotProperties {File::Encoding, File::StringDelimiter, File::CommentContext, File::CommentPrefix, File::KeywordCasing, File::ProtectCasing, File::NameFormatting, File::ListSeparator, File::SortedByIdentifier};
+    QVector<QPair<QString, QVariant>> properties;
+    for (const QString &key : snapshotProperties)
+        if (file.hasProperty(key))
+            properties.append(qMakePair(key, file.property(key)));
+    writer.word(static_cast<quint32>(properties.count()));
+    for (const auto &property : const_cast<const QVector<QPair<QString, QVariant>> &>(properties)) {
+        writer.word(writer.string(property.first));
+        switch (property.second.userType()) {
+        case QMetaType::Bool:
+            writer.tag(Tag::PropertyBool);
+            writer.word(property.second.toBool() ? 1 : 0);
+            break;
+        case QMetaType::Int:
+            writer.tag(Tag::PropertyInt);
+            writer.word(static_cast<quint32>(property.second.toInt()));
+            break;
+        default:
+            writer.tag(Tag::PropertyString);
+            writer.word(writer.string(property.second.toString()));
+        }
+    }
+
+    writer.word(static_cast<quint32>(file.count()));
+    for (const QSharedPointer<Element> &element : file)
+        if (!writer.element(element)) {
+            qCInfo(LOG_KBIBTEX_IO) << "Bibliography contains elements which cannot be stored in a snapshot";
+            return false;
+        }
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(SnapshotHeader));
+    memcpy(h.magic, snapshotMagic, sizeof(snapshotMagic));
+    h.formatVersion = snapshotFormatVersion;
+    h.sourceSize = source.size;
+    h.sourceModified = source.lastModified;
+    memcpy(h.sourceHash, source.contentHash.constData(), sizeof(h.sourceHash));
+    h.sourcePathString = sourcePathString;
+    h.variantString = variantString;
+    h.stringCount = static_cast<quint32>(writer.stringTable.count());
+    h.wordCount = static_cast<quint32>(writer.words.count());
+    h.stringTableOffset = sizeof(SnapshotHeader);
+    h.wordsOffset = h.stringTableOffset + h.stringCount * sizeof(StringRecord);
+    h.stringPoolOffset = h.wordsOffset + h.wordCount * sizeof(quint32);
+    h.stringPoolLength = static_cast<quint64>(writer.pool.count());
+
+    QDir().mkpath(QFileInfo(snapshotFilename).absolutePath());
+    QSaveFile snapshotFile(snapshotFilename);
+    if (!snapshotFile.open(QFile::WriteOnly))
+        return false;
+    snapshotFile.write(reinterpret_cast<const char *>(&h), sizeof(SnapshotHeader));
+    snapshotFile.write(reinterpret_cast<const char *>(writer.stringTable.constData()), writer.stringTable.count() * sizeof(StringRecord));
+    snapshotFile.write(reinterpret_cast<const char *>(writer.words.constData()), writer.words.count() * sizeof(quint32));
+    snapshotFile.write(reinterpret_cast<const char *>(writer.pool.constData()), writer.pool.count() * sizeof(QChar));
+    return snapshotFile.commit();
+}
+
+File *FileSnapshot::load(const Source &source, const QString &snapshotFilename)
+{
+    KBIBTEX_TRACE_SCOPE("io", "FileSnapshot::load");
+    QFile snapshotFile(snapshotFilename);
+    if (source.contentHash.size() != static_cast<int>(sizeof(SnapshotHeader::sourceHash)) || !snapshotFile.open(QFile::ReadOnly))
+        return nullptr;
+
+    const qint64 size = snapshotFile.size();
+    uchar *data = size >= static_cast<qint64>(sizeof(SnapshotHeader)) ? snapshotFile.map(0, size) : nullptr;
+    if (data == nullptr)
+        return nullptr;
+
+    const SnapshotHeader *h = reinterpret_cast<const SnapshotHeader *>(data);
+    const quint64 usize = static_cast<quint64>(size);
+    const bool valid = memcmp(h->magic, snapshotMagic, sizeof(snapshotMagic)) == 0 && h->formatVersion == snapshotFormatVersion
+                       && h->sourceSize == source.size && h->sourceModified == source.lastModified
+                       && memcmp(h->sourceHash, source.contentHash.constData(), sizeof(h->sourceHash)) == 0
+                       && h->stringTableOffset == sizeof(SnapshotHeader)
+                       && h->wordsOffset == h->stringTableOffset + static_cast<quint64>(h->stringCount) * sizeof(StringRecord)
+                       && h->stringPoolOffset == h->wordsOffset + static_cast<quint64>(h->wordCount) * sizeof(quint32)
+                       && h->stringPoolOffset <= usize && h->stringPoolLength <= (usize - h->stringPoolOffset) / sizeof(QChar);
+    if (!valid) {
+        snapshotFile.unmap(data);
+        snapshotFile.close();
+        /// Will not become valid again, as the source changed meanwhile
+        snapshotFile.remove();
+        return nullptr;
+    }
+
+    /// Materialize each distinct string once, all occurrences share its data
+    const StringRecord *stringTable = reinterpret_cast<const StringRecord *>(data + h->stringTableOffset);
+    const QChar *stringPool = reinterpret_cast<const QChar *>(data + h->stringPoolOffset);
+    QVector<QString> strings;
+    strings.reserve(static_cast<int>(h->stringCount));
+    bool ok = true;
+    for (quint32 i = 0; ok && i < h->stringCount; ++i) {
+        const StringRecord &record = stringTable[i];
+        ok = static_cast<quint64>(record.pos) + record.len <= h->stringPoolLength;
+        if (ok)
+            strings.append(QString(stringPool + record.pos, static_cast<int>(record.len)));
+    }
+    ok = ok && h->sourcePathString < h->stringCount && h->variantString < h->stringCount && strings[static_cast<int>(h->sourcePathString)] == source.path && strings[static_cast<int>(h->variantString)] == source.variant;
+
+    File *result = nullptr;
+    if (ok) {
+        SnapshotReader reader(reinterpret_cast<const quint32 *>(data + h->wordsOffset), h->wordCount, strings);
+        result = new File();
+
+        const quint32 propertyCount = reader.word();
+        reader.plausibleCount(propertyCount);
+        for (quint32 i = 0; i < propertyCount && reader.ok; ++i) {
+            const QString &key = reader.string();
+            switch (static_cast<Tag>(reader.word())) {
+            case Tag::PropertyBool:
+                result->setProperty(key, reader.word() != 0);
+                break;
+            case Tag::PropertyInt:
+                result->setProperty(key, static_cast<int>(reader.word()));
+                break;
+            case Tag::PropertyString:
+                result->setProperty(key, reader.string());
+                break;
+            default:
+                reader.ok = false;
+            }
+        }
+
+        const quint32 elementCount = reader.word();
+        if (reader.plausibleCount(elementCount)) {
+            result->reserve(static_cast<int>(elementCount));
+            for (quint32 i = 0; i < elementCount && reader.ok; ++i) {
+                const QSharedPointer<Element> element = reader.element();
+                if (reader.ok)
+                    result->append(element);
+            }
+        }
+
+        if (!reader.ok) {
+            qCWarning(LOG_KBIBTEX_IO) << "Snapshot" << snapshotFilename << "is corrupt";
+            delete result;
+            result = nullptr;
+        }
+    }
+
+    snapshotFile.unmap(data);
+    snapshotFile.close();
+    if (result == nullptr)
+        snapshotFile.remove();
+    else if (snapshotFile.open(QFile::Append)) {
+        /// Mark snapshot as recently used, access times are often not maintained
+        snapshotFile.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        snapshotFile.close();
+    }
+    return result;
+}
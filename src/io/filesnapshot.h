@@ -0,0 +1,102 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_IO_FILESNAPSHOT_H
+#define KBIBTEX_IO_FILESNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+
+#ifdef HAVE_KF
+#include "kbibtexio_export.h"
+#endif // HAVE_KF
+
+class File;
+
+/**
+ * Binary snapshots of File objects as loaded from a bibliography file,
+ * allowing to skip parsing when the same file gets opened again.
+ *
+ * A snapshot consists of a header identifying the source file, a table
+ * of all distinct strings (field names, person names, texts, ...), a
+ * sequence of numbers describing elements and values with type tags and
+ * indices into the string table, and a pool of the strings' characters
+ * in UTF-16. Snapshots are memory-mapped for loading, so that loading
+ * comes down to copying each distinct string once and assembling the
+ * elements. As snapshots are local caches only, numbers are stored in the
+ * machine's native byte order.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXIO_EXPORT FileSnapshot
+{
+public:
+    /// Identifies the data a snapshot was created from
+    struct Source {
+        /// Canonical path of the bibliography file
+        QString path;
+        qint64 size;
+        /// Modification time in milliseconds since the epoch
+        qint64 lastModified;
+        /// SHA-1 hash of the file's raw content
+        QByteArray contentHash;
+        /// Description of settings which affect the loaded File object, e.g. the importer's configuration
+        QString variant;
+    };
+
+    /**
+     * Describe a bibliography file for use with @see load and @see save.
+     * @param filename file the data was read from
+     * @param content raw data as read from the file
+     * @param variant settings affecting how the raw data is turned into a File object
+     */
+    static Source source(const QString &filename, const QByteArray &content, const QString &variant);
+
+    /// Directory in the user's cache directory where @see cacheFilename places snapshots
+    static QString cacheDirectory();
+    /// Location in the user's cache directory where to keep the snapshot for a given source path
+    static QString cacheFilename(const QString &sourcePath);
+
+    /**
+     * Limit the space taken by snapshots of bibliographies which got moved,
+     * deleted, or are no longer opened. First, snapshots not used for
+     * @p maxAgeDays days get deleted, then the least recently used ones
+     * until the remaining snapshots take at most @p maxTotalSize bytes.
+     * @param directory directory to prune, usually @see cacheDirectory
+     */
+    static void prune(const QString &directory, qint64 maxTotalSize = 256 << 20, int maxAgeDays = 30);
+
+    /**
+     * Write a snapshot of @p file, replacing any previous snapshot at @p snapshotFilename.
+     * @return true if the snapshot was written, false if writing failed or @p file contains elements that cannot be stored
+     */
+    static bool save(const File &file, const Source &source, const QString &snapshotFilename);
+
+    /**
+     * Restore a File object from a snapshot if the snapshot exists and was
+     * created from the same source (path, size, modification time, content,
+     * and variant) using the same snapshot format. Outdated or corrupt
+     * snapshots get deleted, used ones get their modification time updated
+     * to tell @see prune that they are still in use.
+     * @return newly created File object or @c nullptr if the snapshot is missing, outdated, or corrupt
+     */
+    static File *load(const Source &source, const QString &snapshotFilename);
+};
+
+#endif // KBIBTEX_IO_FILESNAPSHOT_H
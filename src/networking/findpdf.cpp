@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -26,7 +26,10 @@
 #include <QTemporaryFile>
 #include <QUrlQuery>
 #include <QStandardPaths>
+#include <QQueue>
+#include <QHash>
 #include <QDir>
+#include <QPointer>
 #ifdef HAVE_SCIHUB
 #include <QRandomGenerator>
 #endif // HAVE_SCIHUB
@@ -48,9 +51,22 @@
 #include "logging_networking.h"
 
 static const int maxDepth = 5;
+/// Number of downloads running concurrently, further requests get queued
+static const int maxParallelDownloads = 8;
+/// Number of bytes at the beginning of a download inspected to tell PDF and HTML data apart
+static const int sniffLength = 1024;
+/// Largest single download accepted, larger documents are aborted
+static const qint64 maxBytesPerDownload = 32 * 1024 * 1024;
+/// Default for the total number of bytes all downloads of a single search may consume
+static const qint64 defaultByteBudget = 128 * 1024 * 1024;
+/// Only the first few pages of a PDF document are used for the text preview
+static const int maxPreviewPages = 3;
 static const char *depthProperty = "depth";
 static const char *termProperty = "term";
 static const char *originProperty = "origin";
+static const char *sniffedProperty = "sniffed";
+static const char *bytesReceivedProperty = "bytesreceived";
+static const char *abortReasonProperty = "abortreason";
 
 
 class FindPDF::Private
@@ -72,15 +88,26 @@ private:
             return u;
     }
 
+    typedef struct {
+        QUrl url;
+        QString term;
+        QString origin;
+        int depth;
+    } PendingDownload;
+
 public:
     int aliveCounter;
     QList<ResultItem> result;
     Entry currentEntry;
     QSet<QUrl> knownUrls;
     QSet<QNetworkReply *> runningDownloads;
+    QQueue<PendingDownload> pendingDownloads;
+    qint64 byteBudget, bytesReceived;
+    /// Set once aborting the whole search has been scheduled
+    bool abortScheduled;
 
     Private(FindPDF *parent)
-            : p(parent), aliveCounter(0)
+            : p(parent), aliveCounter(0), byteBudget(defaultByteBudget), bytesReceived(0), abortScheduled(false)
     {
         /// nothing
     }
@@ -89,22 +116,107 @@ public:
     {
         const QUrl sanitizedUrl{removeFragment(url)};
 
-        if (!knownUrls.contains(sanitizedUrl) && depth > 0) {
+        if (!knownUrls.contains(sanitizedUrl) && depth > 0 && bytesReceived < byteBudget) {
             knownUrls.insert(sanitizedUrl);
-            QNetworkRequest request = QNetworkRequest(sanitizedUrl);
-            QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
-            InternalNetworkAccessManager::instance().setNetworkReplyTimeout(reply, 15); ///< set a timeout on network connections
-            reply->setProperty(depthProperty, QVariant::fromValue<int>(depth));
-            reply->setProperty(termProperty, term);
-            reply->setProperty(originProperty, origin);
-            runningDownloads.insert(reply);
-            connect(reply, &QNetworkReply::finished, p, &FindPDF::downloadFinished);
             ++aliveCounter;
+            if (runningDownloads.count() < maxParallelDownloads)
+                startDownload(sanitizedUrl, term, origin, depth);
+            else
+                pendingDownloads.enqueue(PendingDownload{sanitizedUrl, term, origin, depth});
             return true;
         } else
             return false;
     }
 
+    void startDownload(const QUrl &url, const QString &term, const QString &origin, int depth)
+    {
+        QNetworkRequest request = QNetworkRequest(url);
+        QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
+        InternalNetworkAccessManager::instance().setNetworkReplyTimeout(reply, 15); ///< set a timeout on network connections
+        reply->setProperty(depthProperty, QVariant::fromValue<int>(depth));
+        reply->setProperty(termProperty, term);
+        reply->setProperty(originProperty, origin);
+        runningDownloads.insert(reply);
+        connect(reply, &QNetworkReply::readyRead, p, &FindPDF::downloadReadyRead);
+        connect(reply, &QNetworkReply::downloadProgress, p, &FindPDF::downloadProgress);
+        connect(reply, &QNetworkReply::finished, p, &FindPDF::downloadFinished);
+    }
+
+    /**
+     * Start queued downloads as long as there are free slots
+     * and the byte budget is not exhausted yet.
+     */
+    void startPendingDownloads()
+    {
+        while (!pendingDownloads.isEmpty() && runningDownloads.count() < maxParallelDownloads) {
+            const PendingDownload pd = pendingDownloads.dequeue();
+            if (bytesReceived < byteBudget)
+                startDownload(pd.url, pd.term, pd.origin, pd.depth);
+            else
+                --aliveCounter;
+        }
+    }
+
+    void dropPendingDownloads()
+    {
+        aliveCounter -= pendingDownloads.count();
+        pendingDownloads.clear();
+    }
+
+    void abortDownload(QNetworkReply *reply, const char *reason)
+    {
+        reply->setProperty(abortReasonProperty, QString::fromLatin1(reason));
+        reply->abort();
+    }
+
+    /**
+     * Like @see abortDownload, but for use in handlers of signals emitted
+     * by @p reply itself: aborting gets delayed until control returns to
+     * the event loop, so that the reply is not aborted while emitting.
+     */
+    void scheduleAbortDownload(QNetworkReply *reply, const char *reason)
+    {
+        if (reply->property(abortReasonProperty).isValid())
+            return; ///< abort already scheduled
+        reply->setProperty(abortReasonProperty, QString::fromLatin1(reason));
+        const QPointer<QNetworkReply> guardedReply(reply);
+        QMetaObject::invokeMethod(p, [guardedReply]() {
+            if (!guardedReply.isNull() && guardedReply->isRunning())
+                guardedReply->abort();
+        }, Qt::QueuedConnection);
+    }
+
+    /**
+     * Inspect the first bytes of a download to tell whether
+     * it is a PDF document, an HTML page, or something else.
+     * @param reply reply to inspect, data is only peeked at, not consumed
+     * @return @c 1 if data looks like PDF or HTML, @c 0 if data is neither, @c -1 if not enough data is available yet to decide
+     */
+    int sniffReply(QNetworkReply *reply) const
+    {
+        /// Redirections and the like get handled once the reply is finished
+        const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if ((httpStatus >= 300 && httpStatus < 400) || reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl().isValid())
+            return 1;
+
+        /// Trust the server if it says it is sending either PDF or HTML
+        const QByteArray contentType = reply->header(QNetworkRequest::ContentTypeHeader).toByteArray().toLower();
+        if (contentType.contains("application/pdf") || contentType.contains("text/html") || contentType.contains("application/xhtml"))
+            return 1;
+
+        const QByteArray head = reply->peek(sniffLength);
+        if (isPDForHTML(head))
+            return 1;
+        return head.length() >= sniffLength ? 0 : -1;
+    }
+
+    static inline bool isPDForHTML(const QByteArray &head) {
+        if (head.contains("%PDF-"))
+            return true;
+        const QByteArray lowerHead{head.toLower()};
+        return lowerHead.contains("<html") || lowerHead.contains("<!doctype html");
+    }
+
     void processGeneralHTML(QNetworkReply *reply, const QString &text)
     {
         /// fetch some properties from Reply object
@@ -267,6 +379,11 @@ public:
 #endif // HAVE_POPPLERQT6
 #endif // HAVE_POPPLERQT5
 
+            if (!doc) {
+                qCWarning(LOG_KBIBTEX_NETWORKING) << "Failed to load PDF document from" << url.toDisplayString();
+                return false;
+            }
+
             ResultItem resultItem;
             resultItem.tempFilename = new QTemporaryFile(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + QDir::separator() + QStringLiteral("kbibtex_findpdf_XXXXXX.pdf"));
             resultItem.tempFilename->setAutoRemove(true);
@@ -288,7 +405,8 @@ public:
             resultItem.url = url;
             resultItem.textPreview = doc->info(QStringLiteral("Title")).simplified();
             static const int maxTextLen = 1024;
-            for (int i = 0; i < doc->numPages() && resultItem.textPreview.length() < maxTextLen; ++i) {
+            const int numPages = qMin(doc->numPages(), maxPreviewPages);
+            for (int i = 0; i < numPages && resultItem.textPreview.length() < maxTextLen; ++i) {
 #ifdef HAVE_POPPLERQT5
                 QScopedPointer<Poppler::Page> page(doc->page(i));
 #else // not HAVE_POPPLERQT5
@@ -344,6 +462,9 @@ bool FindPDF::search(const Entry &entry)
 
     d->knownUrls.clear();
     d->result.clear();
+    d->pendingDownloads.clear();
+    d->bytesReceived = 0;
+    d->abortScheduled = false;
     d->currentEntry = entry;
 
     Q_EMIT progress(0, d->aliveCounter, 0);
@@ -442,12 +563,24 @@ QList<FindPDF::ResultItem> FindPDF::results()
     }
 }
 
+void FindPDF::setByteBudget(qint64 byteBudget)
+{
+    d->byteBudget = byteBudget > 0 ? byteBudget : defaultByteBudget;
+}
+
+qint64 FindPDF::byteBudget() const
+{
+    return d->byteBudget;
+}
+
 void FindPDF::abort() {
+    /// Drop queued downloads first, so that aborted downloads do not start them
+    d->dropPendingDownloads();
     QSet<QNetworkReply *>::Iterator it = d->runningDownloads.begin();
     while (it != d->runningDownloads.end()) {
         QNetworkReply *reply = *it;
         it = d->runningDownloads.erase(it);
-        reply->abort();
+        d->abortDownload(reply, "search aborted");
     }
 }
 
@@ -460,7 +593,9 @@ void FindPDF::downloadFinished()
     Q_EMIT progress(d->knownUrls.count(), d->aliveCounter, d->result.count());
 
     QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
     d->runningDownloads.remove(reply);
+    d->startPendingDownloads();
     const QString term = reply->property(termProperty).toString();
     const QString origin = reply->property(originProperty).toString();
     bool depthOk = false;
@@ -524,7 +659,9 @@ void FindPDF::downloadFinished()
             const QString text = QString::fromUtf8(data.constData());
             qCWarning(LOG_KBIBTEX_NETWORKING) << "don't know how to handle " << text.left(256);
         }
-    } else
+    } else if (reply->property(abortReasonProperty).isValid())
+        qCDebug(LOG_KBIBTEX_NETWORKING) << "aborted download of" << reply->url().toDisplayString() << ":" << reply->property(abortReasonProperty).toString();
+    else
         qCWarning(LOG_KBIBTEX_NETWORKING) << "error from reply: " << reply->errorString() << "(" << reply->url().toDisplayString() << ")" << "  term=" << term << "  origin=" << origin << "  depth=" << depth;
 
     if (d->aliveCounter == 0) {
@@ -532,3 +669,141 @@ void FindPDF::downloadFinished()
         Q_EMIT finished();
     }
 }
+
+void FindPDF::downloadReadyRead()
+{
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    if (reply->property(sniffedProperty).toBool())
+        return;
+
+    const int sniffResult = d->sniffReply(reply);
+    if (sniffResult > 0)
+        reply->setProperty(sniffedProperty, true);
+    else if (sniffResult == 0) {
+        /// Neither PDF nor HTML, no need to download the remainder,
+        /// but do not abort the reply emitting this signal from within its signal handler
+        d->scheduleAbortDownload(reply, "neither PDF nor HTML");
+    }
+}
+
+void FindPDF::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    if (!d->runningDownloads.contains(reply))
+        return;
+
+    /// Account only for the bytes received since the last notification
+    const qint64 previouslyReceived = reply->property(bytesReceivedProperty).toLongLong();
+    reply->setProperty(bytesReceivedProperty, bytesReceived);
+    d->bytesReceived += bytesReceived - previouslyReceived;
+
+    if (bytesTotal > maxBytesPerDownload || bytesReceived > maxBytesPerDownload)
+        d->scheduleAbortDownload(reply, "download too large");
+    else if (d->bytesReceived >= d->byteBudget && !d->abortScheduled) {
+        qCInfo(LOG_KBIBTEX_NETWORKING) << "Byte budget of" << d->byteBudget << "exhausted, stopping search";
+        /// Do not abort the reply emitting this signal from within its signal handler
+        d->abortScheduled = true;
+        QMetaObject::invokeMethod(this, &FindPDF::abort, Qt::QueuedConnection);
+    }
+}
+
+
+class FindPDFBatch::Private
+{
+private:
+    FindPDFBatch *p;
+
+public:
+    int maxParallelSearches;
+    qint64 byteBudget;
+    QQueue<QSharedPointer<Entry> > queuedEntries;
+    QHash<FindPDF *, QSharedPointer<Entry> > runningSearches;
+    int finishedEntries, totalEntries;
+
+    Private(FindPDFBatch *parent)
+            : p(parent), maxParallelSearches(4), byteBudget(defaultByteBudget), finishedEntries(0), totalEntries(0)
+    {
+        /// nothing
+    }
+
+    void startNextSearches()
+    {
+        while (!queuedEntries.isEmpty() && runningSearches.count() < maxParallelSearches) {
+            const QSharedPointer<Entry> entry = queuedEntries.dequeue();
+            FindPDF *findPDF = new FindPDF(p);
+            findPDF->setByteBudget(byteBudget);
+            runningSearches.insert(findPDF, entry);
+            /// Queued connection, as FindPDF::search may emit 'finished' before returning
+            connect(findPDF, &FindPDF::finished, p, [this, findPDF]() {
+                searchFinished(findPDF);
+            }, Qt::QueuedConnection);
+            findPDF->search(*entry);
+        }
+    }
+
+    void searchFinished(FindPDF *findPDF)
+    {
+        const QSharedPointer<Entry> entry = runningSearches.take(findPDF);
+        if (entry.isNull()) return;
+        const QList<FindPDF::ResultItem> results = findPDF->results();
+        findPDF->deleteLater();
+
+        ++finishedEntries;
+        Q_EMIT p->entryFinished(entry, results);
+        Q_EMIT p->progress(finishedEntries, totalEntries);
+
+        startNextSearches();
+        if (runningSearches.isEmpty() && queuedEntries.isEmpty())
+            Q_EMIT p->finished();
+    }
+};
+
+FindPDFBatch::FindPDFBatch(QObject *parent)
+        : QObject(parent), d(new Private(this))
+{
+    /// nothing
+}
+
+FindPDFBatch::~FindPDFBatch()
+{
+    abort();
+    delete d;
+}
+
+void FindPDFBatch::setMaxParallelSearches(int maxParallelSearches)
+{
+    d->maxParallelSearches = qMax(1, maxParallelSearches);
+}
+
+void FindPDFBatch::setByteBudget(qint64 byteBudget)
+{
+    d->byteBudget = byteBudget > 0 ? byteBudget : defaultByteBudget;
+}
+
+bool FindPDFBatch::search(const QVector<QSharedPointer<Entry> > &entries)
+{
+    if (!d->runningSearches.isEmpty() || !d->queuedEntries.isEmpty()) return false;
+
+    d->finishedEntries = 0;
+    for (const QSharedPointer<Entry> &entry : entries)
+        if (!entry.isNull())
+            d->queuedEntries.enqueue(entry);
+    d->totalEntries = d->queuedEntries.count();
+
+    Q_EMIT progress(0, d->totalEntries);
+    if (d->queuedEntries.isEmpty())
+        Q_EMIT finished();
+    else
+        d->startNextSearches();
+
+    return true;
+}
+
+void FindPDFBatch::abort()
+{
+    d->queuedEntries.clear();
+    /// Aborted searches will still report their (partial) results via 'entryFinished'
+    const QList<FindPDF *> findPDFs = d->runningSearches.keys();
+    for (FindPDF *findPDF : findPDFs)
+        findPDF->abort();
+}
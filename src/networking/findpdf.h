@@ -26,6 +26,8 @@
 #include <QList>
 #include <QSet>
 #include <QUrl>
+#include <QSharedPointer>
+#include <QVector>
 
 #include <Entry>
 
@@ -79,6 +81,18 @@ public:
      */
     QList<ResultItem> results();
 
+    /**
+     * Set the maximum number of bytes all downloads of a single search
+     * may consume together. Once exhausted, running downloads get aborted
+     * and no further candidates are fetched.
+     * Downloads whose first bytes are neither PDF nor HTML are aborted
+     * right away and thus do not eat up the budget.
+     *
+     * @param byteBudget number of bytes, non-positive values restore the default
+     */
+    void setByteBudget(qint64 byteBudget);
+    qint64 byteBudget() const;
+
 Q_SIGNALS:
     /**
      * A search initiated by @see search has been finished.
@@ -102,6 +116,8 @@ public Q_SLOTS:
     void abort();
 
 private Q_SLOTS:
+    void downloadReadyRead();
+    void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
     void downloadFinished();
 
 private:
@@ -109,4 +125,72 @@ private:
     Private *const d;
 };
 
+/**
+ * Search for PDF files for many entries in one go.
+ * Several searches (@see FindPDF) run concurrently and share
+ * the same network access manager, i.e. the same connection pool.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXNETWORKING_EXPORT FindPDFBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FindPDFBatch(QObject *parent = nullptr);
+    ~FindPDFBatch() override;
+
+    /**
+     * Set how many entries are searched for concurrently.
+     * Has to be set before calling @see search.
+     * @param maxParallelSearches number of concurrent searches, at least 1
+     */
+    void setMaxParallelSearches(int maxParallelSearches);
+
+    /**
+     * Byte budget applied to each single entry's search,
+     * @see FindPDF::setByteBudget
+     */
+    void setByteBudget(qint64 byteBudget);
+
+    /**
+     * Initiate searches for PDF files for all given entries.
+     *
+     * @param entries entries to search PDF files for
+     * @return @c true if the searches could be started @c false if another batch is still running
+     */
+    bool search(const QVector<QSharedPointer<Entry> > &entries);
+
+Q_SIGNALS:
+    /**
+     * The search for a single entry is complete. The receiver
+     * takes ownership of the temporary files in the result items.
+     *
+     * @param entry entry as passed to @see search
+     * @param results PDF files found for this entry
+     */
+    void entryFinished(const QSharedPointer<Entry> &entry, const QList<FindPDF::ResultItem> &results);
+
+    /**
+     * @param finishedEntries number of entries whose search is complete
+     * @param totalEntries number of entries in this batch
+     */
+    void progress(int finishedEntries, int totalEntries);
+
+    /**
+     * Searches for all entries have been finished or aborted.
+     */
+    void finished();
+
+public Q_SLOTS:
+    /**
+     * Abort all running searches and drop queued entries.
+     */
+    void abort();
+
+private:
+    class Private;
+    Private *const d;
+};
+
 #endif // KBIBTEX_NETWORKING_FINDPDF_H
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2020 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -45,6 +45,7 @@
 #include <KProtocolManager>
 #endif // HAVE_KF
 
+#include <Tracing>
 #include "logging_networking.h"
 
 #if QT_VERSION >= 0x050a00
@@ -159,7 +160,15 @@ QNetworkReply *InternalNetworkAccessManager::get(QNetworkRequest &request, const
     request.setRawHeader(QByteArray("User-Agent"), userAgent().toLatin1());
     if (oldUrl.isValid())
         request.setRawHeader(QByteArray("Referer"), removeApiKey(oldUrl).toDisplayString().toLatin1());
+    const qint64 traceStart = Tracing::isEnabled() ? Tracing::timestamp() : -1;
     QNetworkReply *reply = QNetworkAccessManager::get(request);
+    if (traceStart >= 0) {
+        /// Requests overlap on the main thread, so record them as asynchronous events
+        const QString host = request.url().host();
+        connect(reply, &QNetworkReply::finished, this, [reply, traceStart, host]() {
+            Tracing::recordAsync("networking", "network request", reinterpret_cast<quintptr>(reply), traceStart, Tracing::timestamp() - traceStart, host);
+        });
+    }
 
     /// Log SSL errors
     connect(reply, &QNetworkReply::sslErrors, this, &InternalNetworkAccessManager::logSslErrors);
@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "cache.h"
+
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QStandardPaths>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+
+#include "zotero/api.h"
+#include "logging_networking.h"
+
+using namespace Zotero;
+
+static const QString versionKey{QStringLiteral("version")};
+static const QString dataKey{QStringLiteral("data")};
+
+class Zotero::Cache::Private
+{
+public:
+    const QString directory;
+
+    Private(QSharedPointer<Zotero::API> api)
+    /// Base URL's path looks like '/users/123456' or '/groups/123456'
+            : directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/zotero/") + api->baseUrl().path().mid(1).replace(u'/', u'-'))
+    {
+        /// nothing
+    }
+
+    inline QString fileName(const QString &name) const {
+        return directory + u'/' + name + QStringLiteral(".json");
+    }
+};
+
+Cache::Cache(QSharedPointer<Zotero::API> api)
+        : d(new Zotero::Cache::Private(api))
+{
+    /// nothing
+}
+
+Cache::~Cache()
+{
+    delete d;
+}
+
+QJsonObject Cache::load(const QString &name, qint64 *version) const
+{
+    if (version != nullptr) *version = 0;
+
+    QFile file(d->fileName(name));
+    if (!file.open(QFile::ReadOnly))
+        return QJsonObject();
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    file.close();
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        qCWarning(LOG_KBIBTEX_NETWORKING) << "Ignoring invalid Zotero cache file" << file.fileName() << ":" << parseError.errorString();
+        return QJsonObject();
+    }
+
+    const QJsonObject root = document.object();
+    if (version != nullptr)
+        *version = static_cast<qint64>(root.value(versionKey).toDouble(0));
+    return root.value(dataKey).toObject();
+}
+
+bool Cache::save(const QString &name, qint64 version, const QJsonObject &data) const
+{
+    if (!QDir().mkpath(d->directory)) {
+        qCWarning(LOG_KBIBTEX_NETWORKING) << "Cannot create directory for Zotero cache:" << d->directory;
+        return false;
+    }
+
+    QJsonObject root;
+    root.insert(versionKey, static_cast<double>(version));
+    root.insert(dataKey, data);
+
+    /// Write to a temporary file first, so that a crash never leaves a truncated cache behind
+    QSaveFile file(d->fileName(name));
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(LOG_KBIBTEX_NETWORKING) << "Cannot write Zotero cache file" << file.fileName();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+void Cache::setIfModifiedSinceVersion(QNetworkRequest &request, qint64 version)
+{
+    if (version > 0)
+        request.setRawHeader("If-Modified-Since-Version", QByteArray::number(version));
+}
+
+qint64 Cache::lastModifiedVersion(const QNetworkReply *reply)
+{
+    if (!reply->hasRawHeader("Last-Modified-Version"))
+        return 0;
+    bool ok = false;
+    const qint64 version = reply->rawHeader("Last-Modified-Version").toLongLong(&ok);
+    return ok ? version : 0;
+}
+
+bool Cache::notModified(const QNetworkReply *reply)
+{
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304;
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_NETWORKING_ZOTERO_CACHE_H
+#define KBIBTEX_NETWORKING_ZOTERO_CACHE_H
+
+#include <QSharedPointer>
+#include <QJsonObject>
+
+#ifdef HAVE_KF
+#include "kbibtexnetworking_export.h"
+#endif // HAVE_KF
+
+class QNetworkRequest;
+class QNetworkReply;
+
+namespace Zotero
+{
+
+class API;
+
+/**
+ * Persistent local copy of data retrieved from a Zotero library.
+ * Each cached object is stored together with the library version
+ * it was retrieved at. This version can be sent back to Zotero
+ * in an 'If-Modified-Since-Version' header, so that unchanged
+ * data does not have to be downloaded again.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXNETWORKING_EXPORT Cache
+{
+public:
+    explicit Cache(QSharedPointer<Zotero::API> api);
+    ~Cache();
+
+    /**
+     * Load a previously stored object from the cache.
+     * @param name name of the object, must be a valid file name
+     * @param version if not @c nullptr, will be set to the library version the object was stored with, or 0 if nothing was cached
+     * @return the cached object, empty if nothing was cached
+     */
+    QJsonObject load(const QString &name, qint64 *version = nullptr) const;
+
+    /**
+     * Store an object in the cache, replacing any previously stored object of the same name.
+     * @param name name of the object, must be a valid file name
+     * @param version library version as reported by Zotero when retrieving this object
+     * @param data object to store
+     * @return @c true if storing the object succeeded
+     */
+    bool save(const QString &name, qint64 version, const QJsonObject &data) const;
+
+    /**
+     * Set the 'If-Modified-Since-Version' header on a request if a version is known.
+     * @param request request to modify
+     * @param version library version of cached data, ignored if not positive
+     */
+    static void setIfModifiedSinceVersion(QNetworkRequest &request, qint64 version);
+
+    /**
+     * @param reply reply from Zotero
+     * @return library version as found in the reply's 'Last-Modified-Version' header, 0 if not set
+     */
+    static qint64 lastModifiedVersion(const QNetworkReply *reply);
+
+    /**
+     * @param reply reply from Zotero to a request carrying an 'If-Modified-Since-Version' header
+     * @return @c true if Zotero reported that the library did not change ('304 Not Modified')
+     */
+    static bool notModified(const QNetworkReply *reply);
+
+private:
+    Q_DISABLE_COPY(Cache)
+
+    class Private;
+    Private *const d;
+};
+
+} // end of namespace Zotero
+
+#endif // KBIBTEX_NETWORKING_ZOTERO_CACHE_H
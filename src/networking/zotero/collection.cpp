@@ -25,10 +25,13 @@
 #include <QNetworkReply>
 #include <QXmlStreamReader>
 #include <QTimer>
+#include <QJsonObject>
+#include <QJsonArray>
 
 #include <KLocalizedString>
 
 #include "zotero/api.h"
+#include "zotero/cache.h"
 #include "internalnetworkaccessmanager.h"
 #include "logging_networking.h"
 
@@ -41,16 +44,20 @@ private:
 
 public:
     QSharedPointer<Zotero::API> api;
+    Zotero::Cache cache;
 
     static const QString top;
+    static const QString cacheName;
 
     Private(QSharedPointer<Zotero::API> a, Zotero::Collection *parent)
-            : p(parent), api(a) {
+            : p(parent), api(a), cache(a) {
         initialized = false;
         busy = false;
+        cachedVersion = libraryVersion = 0;
     }
 
     bool initialized, busy;
+    qint64 cachedVersion, libraryVersion;
 
     QQueue<QString> downloadQueue;
 
@@ -58,11 +65,13 @@ public:
     QHash<QString, QString> collectionToParent;
     QHash<QString, QVector<QString> > collectionToChildren;
 
-    QNetworkReply *requestZoteroUrl(const QUrl &url) {
-        busy = true;
+    QNetworkReply *requestZoteroUrl(const QUrl &url, qint64 ifModifiedSinceVersion = 0) {
+        /// Validating a cached copy in the background does not make this object busy
+        busy = ifModifiedSinceVersion <= 0;
         QUrl internalUrl = url;
         api->addLimitToUrl(internalUrl);
         QNetworkRequest request = api->request(internalUrl);
+        Cache::setIfModifiedSinceVersion(request, ifModifiedSinceVersion);
         QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
         connect(reply, &QNetworkReply::finished, p, &Zotero::Collection::finishedFetchingCollection);
         return reply;
@@ -83,12 +92,62 @@ public:
                 requestZoteroUrl(url);
         } else {
             initialized = true;
+            saveToCache();
             p->emitFinishedLoading();
         }
     }
+
+    bool loadFromCache() {
+        const QJsonObject cached = cache.load(cacheName, &cachedVersion);
+        if (cached.isEmpty()) return false;
+
+        const QJsonObject labels = cached.value(QStringLiteral("labels")).toObject();
+        for (QJsonObject::ConstIterator it = labels.constBegin(); it != labels.constEnd(); ++it)
+            collectionToLabel.insert(it.key(), it.value().toString());
+        const QJsonObject parents = cached.value(QStringLiteral("parents")).toObject();
+        for (QJsonObject::ConstIterator it = parents.constBegin(); it != parents.constEnd(); ++it)
+            collectionToParent.insert(it.key(), it.value().toString());
+        const QJsonObject children = cached.value(QStringLiteral("children")).toObject();
+        for (QJsonObject::ConstIterator it = children.constBegin(); it != children.constEnd(); ++it) {
+            QVector<QString> vec;
+            const QJsonArray array = it.value().toArray();
+            for (const QJsonValue &child : array)
+                vec.append(child.toString());
+            collectionToChildren.insert(it.key(), vec);
+        }
+        return true;
+    }
+
+    void saveToCache() {
+        QJsonObject labels, parents, children;
+        for (QHash<QString, QString>::ConstIterator it = collectionToLabel.constBegin(); it != collectionToLabel.constEnd(); ++it)
+            labels.insert(it.key(), it.value());
+        for (QHash<QString, QString>::ConstIterator it = collectionToParent.constBegin(); it != collectionToParent.constEnd(); ++it)
+            parents.insert(it.key(), it.value());
+        for (QHash<QString, QVector<QString> >::ConstIterator it = collectionToChildren.constBegin(); it != collectionToChildren.constEnd(); ++it) {
+            QJsonArray array;
+            for (const QString &child : it.value())
+                array.append(child);
+            children.insert(it.key(), array);
+        }
+        QJsonObject object;
+        object.insert(QStringLiteral("labels"), labels);
+        object.insert(QStringLiteral("parents"), parents);
+        object.insert(QStringLiteral("children"), children);
+        cache.save(cacheName, libraryVersion, object);
+    }
+
+    void clear() {
+        downloadQueue.clear();
+        collectionToLabel.clear();
+        collectionToParent.clear();
+        collectionToChildren.clear();
+        collectionToLabel[top] = i18n("Library");
+    }
 };
 
 const QString Zotero::Collection::Private::top = QStringLiteral("top");
+const QString Zotero::Collection::Private::cacheName = QStringLiteral("collections");
 
 Collection::Collection(QSharedPointer<Zotero::API> api, QObject *parent)
         : QObject(parent), d(new Zotero::Collection::Private(api, this))
@@ -98,13 +157,22 @@ Collection::Collection(QSharedPointer<Zotero::API> api, QObject *parent)
     QUrl url = api->baseUrl();
     url = url.adjusted(QUrl::StripTrailingSlash);
     url.setPath(url.path() + QStringLiteral("/collections/top"));
+
+    /// If there is a local copy, publish it right away and ask Zotero only for changes
+    qint64 ifModifiedSinceVersion = 0;
+    if (d->loadFromCache()) {
+        d->initialized = true;
+        ifModifiedSinceVersion = d->cachedVersion;
+        QTimer::singleShot(0, this, &Collection::emitFinishedLoading);
+    }
+
     if (api->inBackoffMode())
         /// If Zotero asked to 'back off', wait until this period is over before issuing the next request
         QTimer::singleShot((api->backoffSecondsLeft() + 1) * 1000, this, [ = ]() {
-        d->requestZoteroUrl(url);
+        d->requestZoteroUrl(url, ifModifiedSinceVersion);
     });
     else
-        d->requestZoteroUrl(url);
+        d->requestZoteroUrl(url, ifModifiedSinceVersion);
 }
 
 Collection::~Collection()
@@ -184,7 +252,21 @@ void Collection::finishedFetchingCollection()
         d->api->startBackoff(time);
     }
 
-    if (reply->error() == QNetworkReply::NoError) {
+    if (reply->error() == QNetworkReply::NoError && Cache::notModified(reply)) {
+        /// Cached collections are still up-to-date and already published
+        d->busy = false;
+    } else if (reply->error() == QNetworkReply::NoError) {
+        if (!d->busy) {
+            /// Cached collections are outdated, replace them by what Zotero sends
+            Q_EMIT startedLoading();
+            d->busy = true;
+            d->initialized = false;
+            d->clear();
+        }
+        /// Use version of the first response, later responses may reflect later changes
+        if (d->libraryVersion <= 0)
+            d->libraryVersion = Cache::lastModifiedVersion(reply);
+
         QString nextPage;
         QXmlStreamReader xmlReader(reply);
         while (!xmlReader.atEnd() && !xmlReader.hasError()) {
@@ -242,8 +324,11 @@ void Collection::finishedFetchingCollection()
     } else {
         const QByteArray data{reply->readAll()};
         qCWarning(LOG_KBIBTEX_NETWORKING) << "Fetching collections from URL" << reply->url().toDisplayString() << "failed with code" << reply->error() << "and message" << reply->errorString() << "and data" << data.left(64);
-        d->initialized = false;
-        emitFinishedLoading();
+        if (d->busy) {
+            d->initialized = false;
+            emitFinishedLoading();
+        }
+        /// Otherwise only validating the cached collections failed, keep using them
     }
 }
 
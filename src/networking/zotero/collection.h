@@ -54,6 +54,11 @@ public:
     QString collectionFromNumericId(quintptr numericId) const;
 
 Q_SIGNALS:
+    /**
+     * Previously published collections (e.g. from the local cache) are
+     * outdated and will be replaced. Followed by @see finishedLoading.
+     */
+    void startedLoading();
     void finishedLoading();
 
 private:
@@ -45,6 +45,9 @@ CollectionModel::CollectionModel(Collection *collection, QObject *parent)
         : QAbstractItemModel(parent), d(new Zotero::CollectionModel::Private(collection, this))
 {
     beginResetModel();
+    connect(collection, &Collection::startedLoading, this, [this]() {
+        beginResetModel();
+    });
     connect(collection, &Collection::finishedLoading, this, [this]() {
         endResetModel();
     });
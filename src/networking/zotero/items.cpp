@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2018 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -21,18 +21,34 @@
 
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QXmlStreamReader>
 #include <QUrlQuery>
 #include <QTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QVector>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
 
 #include <File>
 #include <FileImporterBibTeX>
 #include "zotero/api.h"
+#include "zotero/cache.h"
 #include "internalnetworkaccessmanager.h"
 #include "logging_networking.h"
 
 using namespace Zotero;
 
+static const char *stageProperty = "stage";
+static const char *generationProperty = "generation";
+static const char *chunkProperty = "chunk";
+static const QString stageVersions{QStringLiteral("versions")};
+static const QString stageItems{QStringLiteral("items")};
+static const QString versionKey{QStringLiteral("version")};
+static const QString bibtexKey{QStringLiteral("bibtex")};
+
 class Zotero::Items::Private
 {
 private:
@@ -40,37 +56,204 @@ private:
 
 public:
     QSharedPointer<Zotero::API> api;
+    Zotero::Cache cache;
+
+    /// Identifies the current retrieval, replies belonging to earlier retrievals get ignored
+    int generation;
+    QString cacheName;
+    qint64 libraryVersion;
+    /// Maps Zotero item keys to objects holding the item's version and BibTeX code
+    QJsonObject items;
+    /// Keys of items that are either new or have changed since they got cached,
+    /// split into chunks each fetched by a single request
+    QVector<QStringList> chunks;
+    int nextChunk, runningRequests, receivedChunks, maxParallelRequests;
+    bool backoffTimerRunning;
+    /// Elements parsed from chunks, waiting to be published in chunk order
+    QHash<int, QVector<QSharedPointer<Element> > > parsedElements;
+    int nextChunkToPublish;
+    bool emittedFromCache;
 
     Private(QSharedPointer<Zotero::API> a, Zotero::Items *parent)
-            : p(parent), api(a) {
+            : p(parent), api(a), cache(a), generation(0), libraryVersion(0), nextChunk(0), runningRequests(0), receivedChunks(0), maxParallelRequests(1), backoffTimerRunning(false), nextChunkToPublish(0), emittedFromCache(false) {
         /// nothing
     }
 
-    QNetworkReply *requestZoteroUrl(const QUrl &url) {
-        QUrl internalUrl = url;
-        api->addLimitToUrl(internalUrl);
-        QNetworkRequest request = api->request(internalUrl);
-        QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
-        connect(reply, &QNetworkReply::finished, p, &Zotero::Items::finishedFetchingItems);
-        return reply;
+    static QVector<QSharedPointer<Element> > parseBibTeX(const QString &bibTeXcode) {
+        QVector<QSharedPointer<Element> > result;
+        if (bibTeXcode.isEmpty()) return result;
+
+        FileImporterBibTeX importer(nullptr);
+        /// Parse text into bibliography object
+        File *bibtexFile = importer.fromString(bibTeXcode);
+        if (bibtexFile != nullptr) {
+            result.reserve(bibtexFile->count());
+            for (const QSharedPointer<Element> &element : const_cast<const File &>(*bibtexFile))
+                result.append(element);
+            delete bibtexFile;
+        }
+        return result;
+    }
+
+    void emitElements(const QString &bibTeXcode) {
+        const QVector<QSharedPointer<Element> > elements = parseBibTeX(bibTeXcode);
+        for (const QSharedPointer<Element> &element : elements)
+            Q_EMIT p->foundElement(element); ///< ... and publish result
+    }
+
+    QString cachedBibTeX() const {
+        QString bibTeXcode;
+        for (QJsonObject::ConstIterator it = items.constBegin(); it != items.constEnd(); ++it) {
+            const QString itemBibTeX = it.value().toObject().value(bibtexKey).toString();
+            if (!itemBibTeX.isEmpty())
+                bibTeXcode.append(itemBibTeX).append(u'\n');
+        }
+        return bibTeXcode;
+    }
+
+    /**
+     * Parse BibTeX code on a worker thread. Once done, the elements
+     * get published in the order of @p sequence, not in the order
+     * parsing finished.
+     */
+    void parseInBackground(int sequence, const QString &bibTeXcode) {
+        if (bibTeXcode.isEmpty()) {
+            parsedElements.insert(sequence, QVector<QSharedPointer<Element> >());
+            publishParsedElements();
+            return;
+        }
+
+        const int parseGeneration = generation;
+        QFutureWatcher<QVector<QSharedPointer<Element> > > *watcher = new QFutureWatcher<QVector<QSharedPointer<Element> > >(p);
+        connect(watcher, &QFutureWatcherBase::finished, p, [this, watcher, sequence, parseGeneration]() {
+            watcher->deleteLater();
+            if (parseGeneration != generation) return;
+            parsedElements.insert(sequence, watcher->result());
+            publishParsedElements();
+        });
+        watcher->setFuture(QtConcurrent::run(&Zotero::Items::Private::parseBibTeX, bibTeXcode));
+    }
+
+    void publishParsedElements() {
+        while (parsedElements.contains(nextChunkToPublish)) {
+            const QVector<QSharedPointer<Element> > elements = parsedElements.take(nextChunkToPublish);
+            /// Sequence number one past the last chunk marks the end of the retrieval
+            const bool isFinal = nextChunkToPublish == chunks.count();
+            if (isFinal && emittedFromCache) {
+                /// Elements shown from the outdated local copy have to be replaced
+                Q_EMIT p->invalidatedElements();
+            }
+            for (const QSharedPointer<Element> &element : elements)
+                Q_EMIT p->foundElement(element);
+            if (isFinal) {
+                Q_EMIT p->stoppedSearch(0); // TODO proper error codes
+                return;
+            }
+            ++nextChunkToPublish;
+        }
     }
 
-    void retrieveItems(const QUrl &url, int start) {
-        QUrl internalUrl = url;
+    void sendRequest(const QUrl &url, const QString &stage, qint64 ifModifiedSinceVersion, int requestGeneration) {
+        /// Retrieval may have been superseded while waiting for backoff to pass
+        if (requestGeneration != generation) return;
 
-        static const QString queryItemStart = QStringLiteral("start");
-        QUrlQuery query(internalUrl);
-        query.removeQueryItem(queryItemStart);
-        query.addQueryItem(queryItemStart, QString::number(start));
-        internalUrl.setQuery(query);
+        QNetworkRequest request = api->request(url);
+        Cache::setIfModifiedSinceVersion(request, ifModifiedSinceVersion);
+        QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
+        reply->setProperty(stageProperty, stage);
+        reply->setProperty(generationProperty, requestGeneration);
+        connect(reply, &QNetworkReply::finished, p, &Zotero::Items::finishedFetchingItems);
+    }
 
+    void requestZoteroUrl(const QUrl &url, const QString &stage, qint64 ifModifiedSinceVersion = 0) {
+        const int requestGeneration = generation;
         if (api->inBackoffMode())
             /// If Zotero asked to 'back off', wait until this period is over before issuing the next request
             QTimer::singleShot((api->backoffSecondsLeft() + 1) * 1000, p, [ = ]() {
-                requestZoteroUrl(internalUrl);
+                sendRequest(url, stage, ifModifiedSinceVersion, requestGeneration);
             });
         else
-            requestZoteroUrl(internalUrl);
+            sendRequest(url, stage, ifModifiedSinceVersion, requestGeneration);
+    }
+
+    void retrieveItems(const QUrl &url, const QString &name) {
+        ++generation;
+        cacheName = name;
+        chunks.clear();
+        parsedElements.clear();
+        nextChunk = runningRequests = receivedChunks = nextChunkToPublish = 0;
+        qint64 cachedVersion = 0;
+        items = cache.load(cacheName, &cachedVersion);
+        libraryVersion = cachedVersion;
+
+        /// Show the local copy right away, it gets validated against Zotero below
+        emittedFromCache = !items.isEmpty();
+        if (emittedFromCache)
+            emitElements(cachedBibTeX());
+
+        /// Ask only for item keys and versions, which is cheap even for large libraries;
+        /// if nothing changed since the cached version, Zotero answers with '304 Not Modified'
+        QUrl versionsUrl = url;
+        QUrlQuery query(versionsUrl);
+        query.addQueryItem(QStringLiteral("format"), QStringLiteral("versions"));
+        versionsUrl.setQuery(query);
+        requestZoteroUrl(versionsUrl, stageVersions, emittedFromCache ? cachedVersion : 0);
+    }
+
+    void startFetchingItems(const QStringList &keysToFetch) {
+        for (int i = 0; i < keysToFetch.count(); i += Zotero::API::limit)
+            chunks.append(keysToFetch.mid(i, Zotero::API::limit));
+        if (chunks.isEmpty())
+            finishRetrieval();
+        else
+            fetchMoreItems();
+    }
+
+    /**
+     * Issue requests for further chunks of items as long as
+     * fewer than the allowed number of requests are running.
+     */
+    void fetchMoreItems() {
+        if (api->inBackoffMode()) {
+            /// If Zotero asked to 'back off', wait until this period is over before issuing further requests
+            if (!backoffTimerRunning) {
+                backoffTimerRunning = true;
+                const int requestGeneration = generation;
+                QTimer::singleShot((api->backoffSecondsLeft() + 1) * 1000, p, [this, requestGeneration]() {
+                    backoffTimerRunning = false;
+                    if (requestGeneration == generation)
+                        fetchMoreItems();
+                });
+            }
+            return;
+        }
+
+        while (nextChunk < chunks.count() && runningRequests < maxParallelRequests) {
+            QUrl url = api->baseUrl().adjusted(QUrl::StripTrailingSlash);
+            url.setPath(url.path() + QStringLiteral("/items"));
+            QUrlQuery query(url);
+            query.addQueryItem(QStringLiteral("itemKey"), chunks[nextChunk].join(QStringLiteral(",")));
+            query.addQueryItem(QStringLiteral("format"), QStringLiteral("json"));
+            query.addQueryItem(QStringLiteral("include"), bibtexKey);
+            url.setQuery(query);
+            api->addLimitToUrl(url);
+
+            QNetworkRequest request = api->request(url);
+            QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
+            reply->setProperty(stageProperty, stageItems);
+            reply->setProperty(generationProperty, generation);
+            reply->setProperty(chunkProperty, nextChunk);
+            connect(reply, &QNetworkReply::finished, p, &Zotero::Items::finishedFetchingItems);
+            ++nextChunk;
+            ++runningRequests;
+        }
+    }
+
+    void finishRetrieval() {
+        cache.save(cacheName, libraryVersion, items);
+        /// Final step after all chunks: either replace elements shown from
+        /// the outdated local copy or merely signal that the search is over
+        parseInBackground(chunks.count(), emittedFromCache ? cachedBibTeX() : QString());
     }
 };
 
@@ -85,6 +268,11 @@ Items::~Items()
     delete d;
 }
 
+void Items::setMaxParallelRequests(int maxParallelRequests)
+{
+    d->maxParallelRequests = qMax(1, maxParallelRequests);
+}
+
 void Items::retrieveItemsByCollection(const QString &collection)
 {
     QUrl url = d->api->baseUrl().adjusted(QUrl::StripTrailingSlash);
@@ -92,17 +280,8 @@ void Items::retrieveItemsByCollection(const QString &collection)
         url.setPath(url.path() + QStringLiteral("/items"));
     else
         url.setPath(url.path() + QString(QStringLiteral("/collections/%1/items")).arg(collection));
-    QUrlQuery query(url);
-    query.addQueryItem(QStringLiteral("format"), QStringLiteral("bibtex"));
-    url.setQuery(query);
 
-    if (d->api->inBackoffMode())
-        /// If Zotero asked to 'back off', wait until this period is over before issuing the next request
-        QTimer::singleShot((d->api->backoffSecondsLeft() + 1) * 1000, this, [ = ]() {
-            d->retrieveItems(url, 0);
-        });
-    else
-        d->retrieveItems(url, 0);
+    d->retrieveItems(url, collection.isEmpty() ? QStringLiteral("items-library") : QStringLiteral("items-collection-") + collection);
 }
 
 void Items::retrieveItemsByTag(const QString &tag)
@@ -112,24 +291,17 @@ void Items::retrieveItemsByTag(const QString &tag)
     if (!tag.isEmpty())
         query.addQueryItem(QStringLiteral("tag"), tag);
     url.setPath(url.path() + QStringLiteral("/items"));
-    query.addQueryItem(QStringLiteral("format"), QStringLiteral("bibtex"));
     url.setQuery(query);
 
-    if (d->api->inBackoffMode())
-        /// If Zotero asked to 'back off', wait until this period is over before issuing the next request
-        QTimer::singleShot((d->api->backoffSecondsLeft() + 1) * 1000, this, [ = ]() {
-            d->retrieveItems(url, 0);
-        });
-    else
-        d->retrieveItems(url, 0);
+    /// Tags may contain any character, so use a hash of the tag for the cache's file name
+    const QString tagHash = QString::fromLatin1(QCryptographicHash::hash(tag.toUtf8(), QCryptographicHash::Md5).toHex());
+    d->retrieveItems(url, QStringLiteral("items-tag-") + tagHash);
 }
 
 void Items::finishedFetchingItems()
 {
     QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
-    static const QString queryItemStart = QStringLiteral("start");
-    bool ok = false;
-    const int start = QUrlQuery(reply->url()).queryItemValue(queryItemStart).toInt(&ok);
+    reply->deleteLater();
 
     if (reply->hasRawHeader("Backoff")) {
         bool ok = false;
@@ -143,31 +315,96 @@ void Items::finishedFetchingItems()
         d->api->startBackoff(time);
     }
 
-    if (reply->error() == QNetworkReply::NoError && ok) {
-        const QString bibTeXcode = QString::fromUtf8(reply->readAll().constData());
-        /// Non-empty result?
-        if (!bibTeXcode.isEmpty()) {
-            FileImporterBibTeX importer(this);
-            /// Parse text into bibliography object
-            File *bibtexFile = importer.fromString(bibTeXcode);
-
-            /// Perform basic sanity checks ...
-            if (bibtexFile != nullptr && !bibtexFile->isEmpty()) {
-                for (const QSharedPointer<Element> &element : const_cast<const File &>(*bibtexFile)) {
-                    Q_EMIT foundElement(element); ///< ... and publish result
-                }
-            }
+    /// Ignore replies to retrievals which got superseded by a newer one
+    if (reply->property(generationProperty).toInt() != d->generation)
+        return;
 
-            delete bibtexFile;
+    if (reply->error() != QNetworkReply::NoError) {
+        qCWarning(LOG_KBIBTEX_NETWORKING) << reply->errorString(); ///< something went wrong
+        /// Ignore any further replies or parsing results of this retrieval
+        ++d->generation;
+        Q_EMIT stoppedSearch(1); // TODO proper error codes
+        return;
+    }
 
-            /// Non-empty result means there may be more ...
-            d->retrieveItems(reply->url(), start + Zotero::API::limit);
-        } else {
-            /// Done retrieving BibTeX code
+    const QString stage = reply->property(stageProperty).toString();
+    if (stage == stageVersions) {
+        if (Cache::notModified(reply)) {
+            /// Library did not change since cached copy was made, which has already been published
+            qCDebug(LOG_KBIBTEX_NETWORKING) << "Zotero library unchanged since version" << d->libraryVersion;
             Q_EMIT stoppedSearch(0); // TODO proper error codes
+            return;
         }
-    } else {
-        qCWarning(LOG_KBIBTEX_NETWORKING) << reply->errorString(); ///< something went wrong
-        Q_EMIT stoppedSearch(1); // TODO proper error codes
+
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(reply->readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+            qCWarning(LOG_KBIBTEX_NETWORKING) << "Failed to parse item versions from" << reply->url().toDisplayString() << ":" << parseError.errorString();
+            Q_EMIT stoppedSearch(1); // TODO proper error codes
+            return;
+        }
+        d->libraryVersion = Cache::lastModifiedVersion(reply);
+        const QJsonObject versions = document.object();
+
+        /// Drop cached items which got deleted or are no longer part of this collection or tag
+        bool removedItems = false;
+        for (QJsonObject::Iterator it = d->items.begin(); it != d->items.end();) {
+            if (!versions.contains(it.key())) {
+                it = d->items.erase(it);
+                removedItems = true;
+            } else
+                ++it;
+        }
+
+        /// Determine which items are new or have a newer version than the cached one
+        QStringList keysToFetch;
+        for (QJsonObject::ConstIterator it = versions.constBegin(); it != versions.constEnd(); ++it) {
+            const double cachedVersion = d->items.value(it.key()).toObject().value(versionKey).toDouble(-1);
+            if (it.value().toDouble(0) > cachedVersion)
+                keysToFetch.append(it.key());
+        }
+        qCDebug(LOG_KBIBTEX_NETWORKING) << "Zotero library at version" << d->libraryVersion << ":" << keysToFetch.count() << "of" << versions.count() << "items to fetch";
+
+        if (keysToFetch.isEmpty() && !removedItems) {
+            /// Only unrelated parts of the library changed, remember new version
+            d->cache.save(d->cacheName, d->libraryVersion, d->items);
+            Q_EMIT stoppedSearch(0); // TODO proper error codes
+        } else
+            d->startFetchingItems(keysToFetch);
+    } else if (stage == stageItems) {
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(reply->readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError || !document.isArray()) {
+            qCWarning(LOG_KBIBTEX_NETWORKING) << "Failed to parse items from" << reply->url().toDisplayString() << ":" << parseError.errorString();
+            ++d->generation;
+            Q_EMIT stoppedSearch(1); // TODO proper error codes
+            return;
+        }
+
+        QString bibTeXcode;
+        const QJsonArray array = document.array();
+        for (const QJsonValue &value : array) {
+            const QJsonObject object = value.toObject();
+            const QString key = object.value(QStringLiteral("key")).toString();
+            if (key.isEmpty()) continue;
+            QJsonObject item;
+            item.insert(versionKey, object.value(versionKey));
+            /// Notes and attachments have no BibTeX representation, but are cached nevertheless to know their versions
+            const QString itemBibTeX = object.value(bibtexKey).toString();
+            item.insert(bibtexKey, itemBibTeX);
+            d->items.insert(key, item);
+            if (!itemBibTeX.isEmpty())
+                bibTeXcode.append(itemBibTeX).append(u'\n');
+        }
+
+        --d->runningRequests;
+        ++d->receivedChunks;
+        /// Without a local copy, publish elements as soon as they are parsed
+        d->parseInBackground(reply->property(chunkProperty).toInt(), d->emittedFromCache ? QString() : bibTeXcode);
+
+        if (d->receivedChunks == d->chunks.count())
+            d->finishRetrieval();
+        else
+            d->fetchMoreItems();
     }
 }
@@ -36,6 +36,14 @@ namespace Zotero
 class API;
 
 /**
+ * Retrieve items from a Zotero library as BibTeX elements.
+ * Retrieved items are kept in a local cache (@see Cache). When
+ * retrieving items again, cached items are published immediately,
+ * then only items that changed since are downloaded.
+ * Items get downloaded in chunks, optionally several chunks
+ * concurrently (@see setMaxParallelRequests). Chunks are parsed
+ * on a worker thread, but published in the order they were requested.
+ *
  * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
  */
 class KBIBTEXNETWORKING_EXPORT Items : public QObject
@@ -45,11 +53,25 @@ public:
     explicit Items(QSharedPointer<Zotero::API> api, QObject *parent = nullptr);
     ~Items() override;
 
+    /**
+     * Set how many requests for chunks of items may run concurrently.
+     * Zotero's 'Backoff' and 'Retry-After' requests are respected
+     * nevertheless. Default is 1, i.e. one chunk after another.
+     * @param maxParallelRequests number of concurrent requests, at least 1
+     */
+    void setMaxParallelRequests(int maxParallelRequests);
+
     void retrieveItemsByCollection(const QString &collectionId);
     void retrieveItemsByTag(const QString &tag);
 
 Q_SIGNALS:
     void foundElement(QSharedPointer<Element>);
+    /**
+     * Elements previously published via @see foundElement from the local
+     * cache are outdated. All of them should be discarded, as the
+     * up-to-date set of elements is about to be published.
+     */
+    void invalidatedElements();
     void stoppedSearch(int);
 
 private:
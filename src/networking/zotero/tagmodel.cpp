@@ -43,6 +43,9 @@ TagModel::TagModel(Tags *tags, QObject *parent)
         : QAbstractItemModel(parent), d(new Zotero::TagModel::Private(tags, this))
 {
     beginResetModel();
+    connect(tags, &Tags::startedLoading, this, [this]() {
+        beginResetModel();
+    });
     connect(tags, &Tags::finishedLoading, this, [this]() {
         endResetModel();
     });
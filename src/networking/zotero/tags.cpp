@@ -23,9 +23,11 @@
 #include <QXmlStreamReader>
 #include <QUrl>
 #include <QTimer>
+#include <QJsonObject>
 
 #include "internalnetworkaccessmanager.h"
 #include "zotero/api.h"
+#include "zotero/cache.h"
 #include "logging_networking.h"
 
 using namespace Zotero;
@@ -37,28 +39,52 @@ private:
 
 public:
     QSharedPointer<Zotero::API> api;
+    Zotero::Cache cache;
+
+    static const QString cacheName;
 
     Private(QSharedPointer<Zotero::API> a, Zotero::Tags *parent)
-            : p(parent), api(a) {
+            : p(parent), api(a), cache(a) {
         initialized = false;
         busy = false;
+        cachedVersion = libraryVersion = 0;
     }
 
     bool initialized, busy;
+    qint64 cachedVersion, libraryVersion;
 
     QMap<QString, int> tags;
 
-    QNetworkReply *requestZoteroUrl(const QUrl &url) {
-        busy = true;
+    QNetworkReply *requestZoteroUrl(const QUrl &url, qint64 ifModifiedSinceVersion = 0) {
+        /// Validating a cached copy in the background does not make this object busy
+        busy = ifModifiedSinceVersion <= 0;
         QUrl internalUrl = url;
         api->addLimitToUrl(internalUrl);
         QNetworkRequest request = api->request(internalUrl);
+        Cache::setIfModifiedSinceVersion(request, ifModifiedSinceVersion);
         QNetworkReply *reply = InternalNetworkAccessManager::instance().get(request);
         connect(reply, &QNetworkReply::finished, p, &Zotero::Tags::finishedFetchingTags);
         return reply;
     }
+
+    bool loadFromCache() {
+        const QJsonObject cached = cache.load(cacheName, &cachedVersion);
+        if (cached.isEmpty()) return false;
+        for (QJsonObject::ConstIterator it = cached.constBegin(); it != cached.constEnd(); ++it)
+            tags.insert(it.key(), it.value().toInt());
+        return true;
+    }
+
+    void saveToCache() {
+        QJsonObject object;
+        for (QMap<QString, int>::ConstIterator it = tags.constBegin(); it != tags.constEnd(); ++it)
+            object.insert(it.key(), it.value());
+        cache.save(cacheName, libraryVersion, object);
+    }
 };
 
+const QString Zotero::Tags::Private::cacheName = QStringLiteral("tags");
+
 Tags::Tags(QSharedPointer<Zotero::API> api, QObject *parent)
         : QObject(parent), d(new Zotero::Tags::Private(api, this))
 {
@@ -66,13 +92,21 @@ Tags::Tags(QSharedPointer<Zotero::API> api, QObject *parent)
     url = url.adjusted(QUrl::StripTrailingSlash);
     url.setPath(url.path() + QStringLiteral("/tags"));
 
+    /// If there is a local copy, publish it right away and ask Zotero only for changes
+    qint64 ifModifiedSinceVersion = 0;
+    if (d->loadFromCache()) {
+        d->initialized = true;
+        ifModifiedSinceVersion = d->cachedVersion;
+        QTimer::singleShot(0, this, &Tags::finishedLoading);
+    }
+
     if (api->inBackoffMode())
         /// If Zotero asked to 'back off', wait until this period is over before issuing the next request
         QTimer::singleShot((d->api->backoffSecondsLeft() + 1) * 1000, this, [ = ]() {
-            d->requestZoteroUrl(url);
+            d->requestZoteroUrl(url, ifModifiedSinceVersion);
         });
     else
-        d->requestZoteroUrl(url);
+        d->requestZoteroUrl(url, ifModifiedSinceVersion);
 }
 
 Tags::~Tags()
@@ -111,7 +145,20 @@ void Tags::finishedFetchingTags()
         d->api->startBackoff(time);
     }
 
-    if (reply->error() == QNetworkReply::NoError) {
+    if (reply->error() == QNetworkReply::NoError && Cache::notModified(reply)) {
+        /// Cached tags are still up-to-date and already published
+        d->busy = false;
+    } else if (reply->error() == QNetworkReply::NoError) {
+        if (!d->busy) {
+            /// Cached tags are outdated, replace them by what Zotero sends
+            Q_EMIT startedLoading();
+            d->busy = true;
+            d->tags.clear();
+        }
+        /// Use version of the first page, later pages may reflect later changes
+        if (d->libraryVersion <= 0)
+            d->libraryVersion = Cache::lastModifiedVersion(reply);
+
         QString nextPage;
         QXmlStreamReader xmlReader(reply);
         while (!xmlReader.atEnd() && !xmlReader.hasError()) {
@@ -152,13 +199,17 @@ void Tags::finishedFetchingTags()
         } else {
             d->busy = false;
             d->initialized = true;
+            d->saveToCache();
             Q_EMIT finishedLoading();
         }
     } else {
         const QByteArray data{reply->readAll()};
         qCWarning(LOG_KBIBTEX_NETWORKING) << "Fetching tags from URL" << reply->url().toDisplayString() << "failed with code" << reply->error() << "and message" << reply->errorString() << "and data" << data.left(64);
-        d->busy = false;
-        d->initialized = false;
-        Q_EMIT finishedLoading();
+        if (d->busy) {
+            d->busy = false;
+            d->initialized = false;
+            Q_EMIT finishedLoading();
+        }
+        /// Otherwise only validating the cached tags failed, keep using them
     }
 }
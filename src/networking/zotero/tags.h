@@ -49,6 +49,11 @@ public:
     QMap<QString, int> tags() const;
 
 Q_SIGNALS:
+    /**
+     * Previously published tags (e.g. from the local cache) are
+     * outdated and will be replaced. Followed by @see finishedLoading.
+     */
+    void startedLoading();
     void finishedLoading();
 
 private:
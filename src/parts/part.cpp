@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -40,6 +40,7 @@
 #include <QTimer>
 #include <QStandardPaths>
 #include <QFlags>
+#include <QSet>
 
 #include <kio_version.h>
 #include <KMessageBox> // FIXME deprecated
@@ -376,6 +377,18 @@ public:
         if (url.isLocalFile())
             fileSystemWatcher.addPath(url.toLocalFile());
 
+#ifdef HAVE_POPPLERQT
+        /// Extract text of associated PDF files in the background,
+        /// so that searching in PDF files does not have to wait for it
+        QVector<QSharedPointer<const Entry>> entries;
+        for (const QSharedPointer<Element> &element : const_cast<const File &>(*bibTeXFile)) {
+            const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+            if (!entry.isNull())
+                entries.append(entry);
+        }
+        FileInfo::prefetchPDFText(entries, url);
+#endif // HAVE_POPPLERQT
+
         p->setModified(false);
         qApp->restoreOverrideCursor();
 
@@ -1064,22 +1077,36 @@ void KBibTeXPart::applyDefaultFormatString()
     FileModel *model = d->partWidget != nullptr && d->partWidget->fileView() != nullptr ? d->partWidget->fileView()->fileModel() : nullptr;
     if (model == nullptr) return;
 
-    bool documentModified = false;
+    const QString formatString = Preferences::instance().activeIdSuggestionFormatString();
+    if (formatString.isEmpty()) {
+        KMessageBox::information(widget(), i18n("Cannot apply default formatting for entry ids: No default format specified."), i18n("Cannot Apply Default Formatting"));
+        return;
+    }
+
+    QVector<QSharedPointer<Entry>> selectedEntries;
+    QSet<const Entry *> selectedEntryPointers;
     const QModelIndexList mil = d->partWidget->fileView()->selectionModel()->selectedRows();
+    selectedEntries.reserve(mil.count());
     for (const QModelIndex &index : mil) {
         QSharedPointer<Entry> entry = model->element(d->partWidget->fileView()->sortFilterProxyModel()->mapToSource(index).row()).dynamicCast<Entry>();
         if (!entry.isNull()) {
-            static IdSuggestions idSuggestions;
-            bool success = idSuggestions.applyDefaultFormatId(*entry.data());
-            documentModified |= success;
-            if (!success) {
-                KMessageBox::information(widget(), i18n("Cannot apply default formatting for entry ids: No default format specified."), i18n("Cannot Apply Default Formatting"));
-                break;
-            }
+            selectedEntries.append(entry);
+            selectedEntryPointers.insert(entry.data());
         }
     }
+    if (selectedEntries.isEmpty()) return;
+
+    /// Newly generated ids must not clash with the ids of entries that are not re-keyed
+    QSet<QString> reservedIds;
+    const File *file = model->bibliographyFile();
+    for (const QSharedPointer<Element> &element : *file) {
+        const QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+        if (!entry.isNull() && !selectedEntryPointers.contains(entry.data()))
+            reservedIds.insert(entry->id());
+    }
 
-    if (documentModified)
+    const IdSuggestions::BulkFormatIdResult result = IdSuggestions::applyFormatId(selectedEntries, formatString, reservedIds);
+    if (result.changedIds > 0)
         d->partWidget->fileView()->externalModification();
 }
 
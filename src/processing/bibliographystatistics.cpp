@@ -0,0 +1,359 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "bibliographystatistics.h"
+
+#include <algorithm>
+
+#include <QtConcurrentMap>
+#include <QStringList>
+
+#include <Preferences>
+#include <Entry>
+#include <Comment>
+#include <Macro>
+#include <Preamble>
+#include <models/FileModel>
+#include "logging_processing.h"
+
+/// Fewer elements than this are inspected without spawning worker threads
+static const int minElementsForParallelExtraction = 256;
+
+/**
+ * What a single element adds to the statistics, extracted once and
+ * memorized so that it can be subtracted again when the element
+ * changes or gets removed.
+ */
+struct Contribution
+{
+    enum class Kind : quint8 { Entry, Comment, Macro, Preamble, Other };
+
+    Kind kind;
+    int year;
+    QString type;
+    QString venue;
+    QStringList authors;
+    QStringList fields;
+
+    Contribution()
+            : kind(Kind::Other), year(0) {
+        /// nothing
+    }
+
+    /// Must not access preferences, as it runs in worker threads
+    static Contribution of(const QSharedPointer<Element> &element, const QString &personNameFormat) {
+        Contribution result;
+        if (element.isNull())
+            return result;
+
+        if (Entry::isEntry(*element)) {
+            const Entry &entry = static_cast<const Entry &>(*element);
+            result.kind = Kind::Entry;
+            result.type = entry.type().toLower();
+
+            bool ok = false;
+            const QString yearText = PlainTextValue::text(entry.value(Entry::ftYear), personNameFormat);
+            const int year = yearText.left(4).toInt(&ok);
+            if (ok && year > 0) result.year = year;
+
+            QString venue = PlainTextValue::text(entry.value(Entry::ftJournal), personNameFormat).simplified();
+            if (venue.isEmpty())
+                venue = PlainTextValue::text(entry.value(Entry::ftBookTitle), personNameFormat).simplified();
+            result.venue = venue;
+
+            const Value authors = entry.value(Entry::ftAuthor);
+            for (const QSharedPointer<ValueItem> &valueItem : authors) {
+                const QSharedPointer<const Person> person = valueItem.dynamicCast<const Person>();
+                if (person.isNull()) continue;
+                result.authors.append(person->firstName().isEmpty() ? person->lastName() : person->lastName() + QStringLiteral(", ") + person->firstName());
+            }
+
+            result.fields.reserve(entry.count());
+            for (Entry::ConstIterator it = entry.constBegin(); it != entry.constEnd(); ++it)
+                if (!it.value().isEmpty())
+                    result.fields.append(it.key().toLower());
+        } else if (Comment::isComment(*element))
+            result.kind = Kind::Comment;
+        else if (Macro::isMacro(*element))
+            result.kind = Kind::Macro;
+        else if (Preamble::isPreamble(*element))
+            result.kind = Kind::Preamble;
+
+        return result;
+    }
+};
+
+/// Extracts contributions with preferences read once beforehand in the calling thread
+struct ContributionExtractor
+{
+    typedef Contribution result_type;
+
+    const QString personNameFormat;
+
+    ContributionExtractor()
+            : personNameFormat(Preferences::instance().personNameFormat()) {
+        /// nothing
+    }
+
+    Contribution operator()(const QSharedPointer<Element> &element) const {
+        return Contribution::of(element, personNameFormat);
+    }
+};
+
+static inline void addCount(QHash<QString, int> &counts, const QString &key, int delta)
+{
+    auto it = counts.find(key);
+    if (it == counts.end()) {
+        if (delta > 0) counts.insert(key, delta);
+    } else if ((it.value() += delta) <= 0)
+        counts.erase(it);
+}
+
+/// Add (sign is +1) or subtract (sign is -1) an element's contribution
+static void accumulate(BibliographyStatistics::Summary &summary, const Contribution &contribution, int sign)
+{
+    summary.numElements += sign;
+    switch (contribution.kind) {
+    case Contribution::Kind::Entry: {
+        summary.numEntries += sign;
+        addCount(summary.entryTypes, contribution.type, sign);
+        if (contribution.year > 0) {
+            auto it = summary.years.find(contribution.year);
+            if (it == summary.years.end()) {
+                if (sign > 0) summary.years.insert(contribution.year, sign);
+            } else if ((it.value() += sign) <= 0)
+                summary.years.erase(it);
+        }
+        if (!contribution.venue.isEmpty())
+            addCount(summary.venues, contribution.venue, sign);
+        for (const QString &author : contribution.authors)
+            addCount(summary.authors, author, sign);
+        for (const QString &field : contribution.fields)
+            addCount(summary.fields, field, sign);
+        break;
+    }
+    case Contribution::Kind::Comment:
+        summary.numComments += sign;
+        break;
+    case Contribution::Kind::Macro:
+        summary.numMacros += sign;
+        break;
+    case Contribution::Kind::Preamble:
+        summary.numPreambles += sign;
+        break;
+    case Contribution::Kind::Other:
+        break;
+    }
+}
+
+BibliographyStatistics::Summary::Summary()
+        : numElements(0), numEntries(0), numComments(0), numMacros(0), numPreambles(0)
+{
+    /// nothing
+}
+
+double BibliographyStatistics::Summary::fillRate(const QString &field) const
+{
+    if (numEntries <= 0) return 0.0;
+    return static_cast<double>(fields.value(field.toLower(), 0)) / numEntries;
+}
+
+QVector<QPair<QString, int>> BibliographyStatistics::Summary::top(const QHash<QString, int> &counts, int n)
+{
+    QVector<QPair<QString, int>> result;
+    result.reserve(counts.count());
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it)
+        result.append(qMakePair(it.key(), it.value()));
+    const auto byFrequency = [](const QPair<QString, int> &a, const QPair<QString, int> &b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+    if (n >= 0 && n < result.count()) {
+        std::partial_sort(result.begin(), result.begin() + n, result.end(), byFrequency);
+        result.resize(n);
+    } else
+        std::sort(result.begin(), result.end(), byFrequency);
+    return result;
+}
+
+class BibliographyStatistics::Private
+{
+private:
+    BibliographyStatistics *p;
+
+public:
+    FileModel *fileModel;
+    Summary summary;
+    QHash<const Element *, Contribution> contributions;
+
+    Private(BibliographyStatistics *parent)
+            : p(parent), fileModel(nullptr) {
+        /// nothing
+    }
+
+    static QVector<Contribution> extract(const QVector<QSharedPointer<Element>> &elements) {
+        /// Runs in parallel, but blocks until done, so the model cannot change meanwhile
+        const ContributionExtractor extractor;
+        if (elements.count() < minElementsForParallelExtraction) {
+            QVector<Contribution> result;
+            result.reserve(elements.count());
+            for (const QSharedPointer<Element> &element : elements)
+                result.append(extractor(element));
+            return result;
+        } else
+            return QtConcurrent::blockingMapped<QVector<Contribution>>(elements, extractor);
+    }
+
+    void add(const QVector<QSharedPointer<Element>> &elements) {
+        const QVector<Contribution> extracted = extract(elements);
+        for (int i = 0; i < elements.count(); ++i) {
+            const Element *element = elements[i].data();
+            auto it = contributions.find(element);
+            if (it != contributions.end())
+                accumulate(summary, it.value(), -1);
+            accumulate(summary, extracted[i], +1);
+            contributions.insert(element, extracted[i]);
+        }
+    }
+
+    void remove(const Element *element) {
+        auto it = contributions.find(element);
+        if (it != contributions.end()) {
+            accumulate(summary, it.value(), -1);
+            contributions.erase(it);
+        }
+    }
+
+    QVector<QSharedPointer<Element>> rows(int first, int last) const {
+        QVector<QSharedPointer<Element>> result;
+        if (fileModel == nullptr) return result;
+        result.reserve(last - first + 1);
+        for (int row = first; row <= last; ++row) {
+            const QSharedPointer<Element> element = fileModel->element(row);
+            if (!element.isNull())
+                result.append(element);
+        }
+        return result;
+    }
+
+    void rebuild() {
+        summary = Summary();
+        contributions.clear();
+        if (fileModel == nullptr || fileModel->rowCount() == 0) return;
+
+        const QVector<QSharedPointer<Element>> elements = rows(0, fileModel->rowCount() - 1);
+        contributions.reserve(elements.count());
+        add(elements);
+    }
+
+    void rowsInserted(int first, int last) {
+        add(rows(first, last));
+        Q_EMIT p->changed();
+    }
+
+    void rowsAboutToBeRemoved(int first, int last) {
+        for (int row = first; row <= last; ++row)
+            remove(fileModel->element(row).data());
+        /// Signal once the rows are actually gone
+    }
+
+    void dataChanged(int first, int last) {
+        if (fileModel == nullptr) return;
+        /// Only the changed rows need to be inspected again, as memorized
+        /// contributions of all other elements are still valid
+        add(rows(first, last));
+        Q_EMIT p->changed();
+    }
+};
+
+BibliographyStatistics::BibliographyStatistics(QObject *parent)
+        : QObject(parent), d(new Private(this))
+{
+    /// nothing
+}
+
+BibliographyStatistics::~BibliographyStatistics()
+{
+    delete d;
+}
+
+void BibliographyStatistics::setFileModel(FileModel *fileModel)
+{
+    if (fileModel == d->fileModel) return;
+
+    if (d->fileModel != nullptr)
+        disconnect(d->fileModel, nullptr, this, nullptr);
+    d->fileModel = fileModel;
+    if (d->fileModel != nullptr) {
+        connect(d->fileModel, &FileModel::rowsInserted, this, [this](const QModelIndex &, int first, int last) {
+            d->rowsInserted(first, last);
+        });
+        connect(d->fileModel, &FileModel::rowsAboutToBeRemoved, this, [this](const QModelIndex &, int first, int last) {
+            d->rowsAboutToBeRemoved(first, last);
+        });
+        connect(d->fileModel, &FileModel::rowsRemoved, this, &BibliographyStatistics::changed);
+        connect(d->fileModel, &FileModel::dataChanged, this, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+            d->dataChanged(topLeft.row(), bottomRight.row());
+        });
+        connect(d->fileModel, &FileModel::modelReset, this, [this]() {
+            d->rebuild();
+            Q_EMIT changed();
+        });
+        connect(d->fileModel, &QObject::destroyed, this, [this]() {
+            d->fileModel = nullptr;
+            d->rebuild();
+            Q_EMIT changed();
+        });
+    }
+
+    d->rebuild();
+    Q_EMIT changed();
+}
+
+FileModel *BibliographyStatistics::fileModel() const
+{
+    return d->fileModel;
+}
+
+const BibliographyStatistics::Summary &BibliographyStatistics::summary() const
+{
+    return d->summary;
+}
+
+BibliographyStatistics::Summary BibliographyStatistics::summary(const QList<QSharedPointer<Element>> &elements) const
+{
+    Summary result;
+    QVector<QSharedPointer<Element>> unknownElements;
+    for (const QSharedPointer<Element> &element : elements) {
+        const auto it = d->contributions.constFind(element.data());
+        if (it != d->contributions.constEnd())
+            accumulate(result, it.value(), +1);
+        else
+            unknownElements.append(element);
+    }
+
+    /// Elements not part of the model have to be inspected now
+    if (!unknownElements.isEmpty()) {
+        qCDebug(LOG_KBIBTEX_PROCESSING) << "Computing statistics for" << unknownElements.count() << "elements not in model";
+        const QVector<Contribution> extracted = Private::extract(unknownElements);
+        for (const Contribution &contribution : extracted)
+            accumulate(result, contribution, +1);
+    }
+
+    return result;
+}
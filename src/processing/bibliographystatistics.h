@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2018 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_PROCESSING_BIBLIOGRAPHYSTATISTICS_H
+#define KBIBTEX_PROCESSING_BIBLIOGRAPHYSTATISTICS_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <QPair>
+#include <QSharedPointer>
+
+#ifdef HAVE_KF
+#include "kbibtexprocessing_export.h"
+#endif // HAVE_KF
+
+class Element;
+class FileModel;
+
+/**
+ * Aggregate statistics on a bibliography, such as the number of entries
+ * per type and year, the most frequent venues and authors, and how many
+ * entries have a value for each field.
+ *
+ * Once a FileModel is set, each element's contribution to the statistics
+ * gets extracted in parallel and memorized. Afterwards, the statistics are
+ * kept up-to-date incrementally by following the model's signals, so that
+ * only changed elements have to be inspected again. Statistics on any
+ * subset of elements, e.g. the current selection, are summed up from the
+ * memorized contributions.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXPROCESSING_EXPORT BibliographyStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Summary {
+        int numElements;
+        int numEntries;
+        int numComments;
+        int numMacros;
+        int numPreambles;
+        /// Lower-case entry type to number of entries of this type
+        QHash<QString, int> entryTypes;
+        /// Year to number of entries published in this year
+        QMap<int, int> years;
+        /// Journal or book title to number of entries published there
+        QHash<QString, int> venues;
+        /// Author in the form 'Last, First' to number of entries by this author
+        QHash<QString, int> authors;
+        /// Lower-case field name to number of entries having this field
+        QHash<QString, int> fields;
+
+        Summary();
+
+        /// Fraction of entries having a value for the given field, between 0.0 and 1.0
+        double fillRate(const QString &field) const;
+
+        /// The up to @p n most frequent keys in @p counts, most frequent first
+        static QVector<QPair<QString, int>> top(const QHash<QString, int> &counts, int n);
+    };
+
+    explicit BibliographyStatistics(QObject *parent = nullptr);
+    ~BibliographyStatistics() override;
+
+    void setFileModel(FileModel *fileModel);
+    FileModel *fileModel() const;
+
+    /// Statistics on all elements of the current model
+    const Summary &summary() const;
+
+    /// Statistics on the given elements, e.g. the current selection
+    Summary summary(const QList<QSharedPointer<Element>> &elements) const;
+
+Q_SIGNALS:
+    /// Statistics have changed due to modifications in the model
+    void changed();
+
+private:
+    class Private;
+    Private *const d;
+};
+
+#endif // KBIBTEX_PROCESSING_BIBLIOGRAPHYSTATISTICS_H
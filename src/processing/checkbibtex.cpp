@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2019 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -19,20 +19,191 @@
 
 #include "checkbibtex.h"
 
-#include <QApplication>
 #include <QBuffer>
-#include <QTextStream>
+#include <QMap>
+#include <QSet>
 #include <QRegularExpression>
 
-#include <KLocalizedString>
+#ifdef HAVE_QTWIDGETS
+#include <QApplication>
+
 #include <KMessageBox>
+#endif // HAVE_QTWIDGETS
+
+#ifdef HAVE_KFI18N
+#include <KLocalizedString>
+#else // HAVE_KFI18N
+#define i18n(text, ...) QString(QStringLiteral(text)).arg(__VA_ARGS__)
+#endif // HAVE_KFI18N
 
 #include <File>
 #include <Entry>
 #include <Element>
 #include <Macro>
+#include <Preferences>
+#include <FileExporterBibTeX>
 #include <FileExporterBibTeXOutput>
 
+/// Describe a BibTeX warning, i.e. the text following 'Warning--' in BibTeX's log
+static QString describeWarning(const QString &warning)
+{
+    static const QRegularExpression warningEmptyField(QStringLiteral("empty (\\w+) in "));
+    static const QRegularExpression warningEmptyField2(QStringLiteral("empty (\\w+) or (\\w+) in "));
+    static const QRegularExpression warningThereIsBut(QStringLiteral("there's a (\\w+) but no (\\w+) in"));
+    static const QRegularExpression warningCantUseBoth(QStringLiteral("can't use both (\\w+) and (\\w+) fields"));
+    static const QRegularExpression warningSort2(QStringLiteral("to sort, need (\\w+) or (\\w+) in "));
+    static const QRegularExpression warningSort3(QStringLiteral("to sort, need (\\w+), (\\w+), or (\\w+) in "));
+
+    QRegularExpressionMatch match;
+    if ((match = warningEmptyField.match(warning)).hasMatch()) {
+        /// empty/missing field
+        return i18n("Field <b>%1</b> is empty", match.captured(1));
+    } else if ((match = warningEmptyField2.match(warning)).hasMatch()) {
+        /// two empty/missing fields
+        return i18n("Fields <b>%1</b> and <b>%2</b> are empty, but at least one is required", match.captured(1), match.captured(2));
+    } else if ((match = warningThereIsBut.match(warning)).hasMatch()) {
+        /// there is a field which exists but another does not exist
+        return i18n("Field <b>%1</b> exists, but <b>%2</b> does not exist", match.captured(1), match.captured(2));
+    } else if ((match = warningCantUseBoth.match(warning)).hasMatch()) {
+        /// there are two conflicting fields, only one may be used
+        return i18n("Fields <b>%1</b> and <b>%2</b> cannot be used at the same time", match.captured(1), match.captured(2));
+    } else if ((match = warningSort2.match(warning)).hasMatch()) {
+        /// one out of two fields missing for sorting
+        return i18n("Fields <b>%1</b> or <b>%2</b> are required to sort entry", match.captured(1), match.captured(2));
+    } else if ((match = warningSort3.match(warning)).hasMatch()) {
+        /// one out of three fields missing for sorting
+        return i18n("Fields <b>%1</b>, <b>%2</b>, <b>%3</b> are required to sort entry", match.captured(1), match.captured(2), match.captured(3));
+    } else {
+        /// generic/unknown warning
+        return i18n("Unknown warning: %1", warning.toHtmlEscaped());
+    }
+}
+
+/// Determine the id of the entry a BibTeX warning refers to
+static QString warningEntryId(const QString &warning)
+{
+    /// Most warnings end like "... in someid", a few
+    /// quote the id like in "... for "someid" ..."
+    static const QRegularExpression trailingId(QStringLiteral(" in (\\S+)$"));
+    static const QRegularExpression quotedId(QStringLiteral("for \"([^\"]+)\""));
+
+    QRegularExpressionMatch match;
+    if ((match = trailingId.match(warning)).hasMatch())
+        return match.captured(1);
+    else if ((match = quotedId.match(warning)).hasMatch())
+        return match.captured(1);
+    return QString();
+}
+
+CheckBibTeX::Settings CheckBibTeX::settingsFromPreferences()
+{
+    return Settings {Preferences::instance().laTeXBabelLanguage(), Preferences::instance().bibTeXBibliographyStyle()};
+}
+
+CheckBibTeX::CheckBibTeXResult CheckBibTeX::checkBibTeX(const File *file, QVector<Diagnostic> &diagnostics)
+{
+    return checkBibTeX(file, settingsFromPreferences(), diagnostics);
+}
+
+CheckBibTeX::CheckBibTeXResult CheckBibTeX::checkBibTeX(const File *file, const Settings &settings, QVector<Diagnostic> &diagnostics)
+{
+    diagnostics.clear();
+    if (file == nullptr)
+        return CheckBibTeXResult::InvalidData;
+
+    /// Serialize the bibliography the same way as FileExporterBibTeXOutput
+    /// does to know in which line of the .bib file each entry starts,
+    /// as BibTeX refers to errors only by line number
+    QByteArray bibTeXSource;
+    QBuffer sourceBuffer(&bibTeXSource);
+    sourceBuffer.open(QIODevice::WriteOnly);
+    FileExporterBibTeX bibTeXExporter(nullptr);
+    bibTeXExporter.setEncoding(QStringLiteral("utf-8"));
+    bibTeXExporter.save(&sourceBuffer, file);
+    sourceBuffer.close();
+
+    QSet<QString> entryIds;
+    for (const auto &element : *file) {
+        const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+        if (!entry.isNull())
+            entryIds.insert(entry->id());
+    }
+
+    /// Run BibTeX once on the whole bibliography; its log file
+    /// is written as the exporter's output
+    QStringList processOutput;
+    QByteArray bibTeXLog;
+    QBuffer logBuffer(&bibTeXLog);
+    logBuffer.open(QIODevice::WriteOnly);
+    FileExporterBibTeXOutput exporter(FileExporterBibTeXOutput::OutputType::BibTeXLogFile, nullptr);
+    exporter.setLaTeXLanguage(settings.babelLanguage);
+    exporter.setLaTeXBibliographyStyle(settings.bibliographyStyle);
+    QObject::connect(&exporter, &FileExporterBibTeXOutput::processStandardOut, [&processOutput](const QString & line) {
+        processOutput.append(line);
+    });
+    QObject::connect(&exporter, &FileExporterBibTeXOutput::processStandardError, [&processOutput](const QString & line) {
+        processOutput.append(line);
+    });
+    const bool exporterResult = exporter.save(&logBuffer, file);
+    logBuffer.close();
+
+    if (!exporterResult) {
+        for (const QString &line : const_cast<const QStringList &>(processOutput))
+            diagnostics.append({Diagnostic::Severity::Error, QString(), line.toHtmlEscaped()});
+        return CheckBibTeXResult::FailedToCheck;
+    }
+
+    return parseBibTeXLog(QString::fromUtf8(bibTeXLog), QString::fromUtf8(bibTeXSource), entryIds, diagnostics);
+}
+
+CheckBibTeX::CheckBibTeXResult CheckBibTeX::parseBibTeXLog(const QString &bibTeXLog, const QString &bibTeXSource, const QSet<QString> &entryIds, QVector<Diagnostic> &diagnostics)
+{
+    const QStringList sourceLines = bibTeXSource.split(QLatin1Char('\n'));
+    static const QRegularExpression entryStart(QStringLiteral("^@\\w+\\s*[{(]\\s*([^,\\s]+)\\s*,"));
+    QMap<int, QString> entryStartLines; ///< maps line numbers as used by BibTeX, starting at 1, to entry ids
+    for (int i = 0; i < sourceLines.size(); ++i) {
+        if (!sourceLines[i].startsWith(QLatin1Char('@')))
+            continue;
+        const QRegularExpressionMatch match = entryStart.match(sourceLines[i]);
+        if (match.hasMatch() && entryIds.contains(match.captured(1)))
+            entryStartLines.insert(i + 1, match.captured(1));
+    }
+
+    /// define variables how to parse BibTeX's log
+    static const QString warningStart = QStringLiteral("Warning--");
+    static const QRegularExpression errorLine(QStringLiteral("^(.*)---line (\\d+) of file"));
+
+    /// go line-by-line through BibTeX's log and collect warnings/errors
+    CheckBibTeXResult result = CheckBibTeXResult::NoProblem;
+    const QStringList logLines = bibTeXLog.split(QLatin1Char('\n'));
+    for (const QString &line : logLines) {
+        QRegularExpressionMatch match;
+        if ((match = errorLine.match(line)).hasMatch()) {
+            bool ok = false;
+            const int lineNumber = match.captured(2).toInt(&ok);
+            QString id;
+            QString sourceLine;
+            if (ok && lineNumber >= 1 && lineNumber <= sourceLines.size()) {
+                auto it = entryStartLines.upperBound(lineNumber);
+                if (it != entryStartLines.begin())
+                    id = (--it).value();
+                sourceLine = sourceLines[lineNumber - 1].trimmed();
+            }
+            const QString message = sourceLine.isEmpty() ? match.captured(1).toHtmlEscaped() : i18n("%1 in line <tt>%2</tt>", match.captured(1).toHtmlEscaped(), sourceLine.toHtmlEscaped());
+            diagnostics.append({Diagnostic::Severity::Error, id, message});
+            result = CheckBibTeXResult::BibTeXError;
+        } else if (line.startsWith(warningStart)) {
+            const QString warning = line.mid(warningStart.length()).trimmed();
+            diagnostics.append({Diagnostic::Severity::Warning, warningEntryId(warning), describeWarning(warning)});
+            if (result == CheckBibTeXResult::NoProblem)
+                result = CheckBibTeXResult::BibTeXWarning;
+        }
+    }
+
+    return result;
+}
+
+#ifdef HAVE_QTWIDGETS
 CheckBibTeX::CheckBibTeXResult CheckBibTeX::checkBibTeX(QSharedPointer<Element> &element, const File *file, QWidget *parent)
 {
     /// only entries are supported, no macros, preambles, ...
@@ -72,88 +243,23 @@ CheckBibTeX::CheckBibTeXResult CheckBibTeX::checkBibTeX(QSharedPointer<Entry> &e
             if (Macro::isMacro(*element))
                 dummyFile << element;
 
-    /// run special exporter to get BibTeX's output
-    QStringList bibtexOutput;
-    QByteArray ba;
-    QBuffer buffer(&ba);
-    buffer.open(QIODevice::WriteOnly);
-    FileExporterBibTeXOutput exporter(FileExporterBibTeXOutput::OutputType::BibTeXLogFile, parent);
-    QObject::connect(&exporter, &FileExporterBibTeXOutput::processStandardOut, parent, [&bibtexOutput](const QString & line) {
-        bibtexOutput.append(line);
-    });
-    QObject::connect(&exporter, &FileExporterBibTeXOutput::processStandardError, parent, [&bibtexOutput](const QString & line) {
-        bibtexOutput.append(line);
-    });
-    bool exporterResult = exporter.save(&buffer, &dummyFile);
-    buffer.close();
-
-    if (!exporterResult) {
-        QApplication::restoreOverrideCursor();
-        KMessageBox::errorList(parent, i18n("Running BibTeX failed.\n\nSee the following output to trace the error:"), bibtexOutput, i18n("Running BibTeX failed."));
-        return CheckBibTeXResult::FailedToCheck;
-    }
-
-    /// define variables how to parse BibTeX's output
-    static const QString warningStart = QStringLiteral("Warning--");
-    static const QRegularExpression warningEmptyField(QStringLiteral("empty (\\w+) in "));
-    static const QRegularExpression warningEmptyField2(QStringLiteral("empty (\\w+) or (\\w+) in "));
-    static const QRegularExpression warningThereIsBut(QStringLiteral("there's a (\\w+) but no (\\w+) in"));
-    static const QRegularExpression warningCantUseBoth(QStringLiteral("can't use both (\\w+) and (\\w+) fields"));
-    static const QRegularExpression warningSort2(QStringLiteral("to sort, need (\\w+) or (\\w+) in "));
-    static const QRegularExpression warningSort3(QStringLiteral("to sort, need (\\w+), (\\w+), or (\\w+) in "));
-    static const QRegularExpression errorLine(QStringLiteral("---line (\\d+)"));
+    QVector<Diagnostic> diagnostics;
+    const CheckBibTeXResult result = checkBibTeX(&dummyFile, diagnostics);
+    QApplication::restoreOverrideCursor();
 
-    /// go line-by-line through BibTeX output and collect warnings/errors
-    QStringList warnings;
-    QString errorPlainText;
-    for (const QString &line : const_cast<const QStringList &>(bibtexOutput)) {
-        QRegularExpressionMatch match;
-        if ((match = errorLine.match(line)).hasMatch()) {
-            buffer.open(QIODevice::ReadOnly);
-            QTextStream ts(&buffer);
-            bool ok = false;
-            for (int i = match.captured(1).toInt(&ok); ok && i > 1; --i) {
-                errorPlainText = ts.readLine();
-                buffer.close();
-            }
-        } else if (line.startsWith(QStringLiteral("Warning--"))) {
-            /// is a warning ...
-
-            if ((match = warningEmptyField.match(line)).hasMatch()) {
-                /// empty/missing field
-                warnings << i18n("Field <b>%1</b> is empty", match.captured(1));
-            } else if ((match = warningEmptyField2.match(line)).hasMatch()) {
-                /// two empty/missing fields
-                warnings << i18n("Fields <b>%1</b> and <b>%2</b> are empty, but at least one is required", match.captured(1), match.captured(2));
-            } else if ((match = warningThereIsBut.match(line)).hasMatch()) {
-                /// there is a field which exists but another does not exist
-                warnings << i18n("Field <b>%1</b> exists, but <b>%2</b> does not exist", match.captured(1), match.captured(2));
-            } else if ((match = warningCantUseBoth.match(line)).hasMatch()) {
-                /// there are two conflicting fields, only one may be used
-                warnings << i18n("Fields <b>%1</b> and <b>%2</b> cannot be used at the same time", match.captured(1), match.captured(2));
-            } else if ((match = warningSort2.match(line)).hasMatch()) {
-                /// one out of two fields missing for sorting
-                warnings << i18n("Fields <b>%1</b> or <b>%2</b> are required to sort entry", match.captured(1), match.captured(2));
-            } else if ((match = warningSort3.match(line)).hasMatch()) {
-                /// one out of three fields missing for sorting
-                warnings << i18n("Fields <b>%1</b>, <b>%2</b>, <b>%3</b> are required to sort entry", match.captured(1), match.captured(2), match.captured(3));
-            } else {
-                /// generic/unknown warning
-                warnings << i18n("Unknown warning: %1", line.mid(warningStart.length()));
-            }
-        }
-    }
+    QStringList errors, warnings;
+    for (const Diagnostic &diagnostic : const_cast<const QVector<Diagnostic> &>(diagnostics))
+        (diagnostic.severity == Diagnostic::Severity::Error ? errors : warnings).append(diagnostic.message);
 
-    CheckBibTeXResult result = CheckBibTeXResult::NoProblem;
-    QApplication::restoreOverrideCursor();
-    if (!errorPlainText.isEmpty()) {
-        result = CheckBibTeXResult::BibTeXWarning;
-        KMessageBox::information(parent, i18n("<qt><p>The following error was found:</p><pre>%1</pre></qt>", errorPlainText), i18n("Errors found"));
-    } else if (!warnings.isEmpty()) {
+    if (result == CheckBibTeXResult::FailedToCheck)
+        KMessageBox::errorList(parent, i18n("Running BibTeX failed.\n\nSee the following output to trace the error:"), errors, i18n("Running BibTeX failed."));
+    else if (!errors.isEmpty())
+        KMessageBox::informationList(parent, i18n("The following errors were found:"), errors, i18n("Errors found"));
+    else if (!warnings.isEmpty())
         KMessageBox::informationList(parent, i18n("The following warnings were found:"), warnings, i18n("Warnings found"));
-        result = CheckBibTeXResult::BibTeXError;
-    } else
+    else
         KMessageBox::information(parent, i18n("No warnings or errors were found.%1", crossRefStr.isEmpty() ? QString() : i18n("\n\nSome fields missing in this entry were taken from the crossref'ed entry '%1'.", crossRefStr)), i18n("No Errors or Warnings"));
 
     return result;
 }
+#endif // HAVE_QTWIDGETS
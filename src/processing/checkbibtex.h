@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2019 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -21,12 +21,17 @@
 #define KBIBTEX_PROCESSING_CHECKBIBTEX_H
 
 #include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <QSet>
 
 #ifdef HAVE_KF
 #include "kbibtexprocessing_export.h"
 #endif // HAVE_KF
 
+#ifdef HAVE_QTWIDGETS
 class QWidget;
+#endif // HAVE_QTWIDGETS
 
 class Entry;
 class Element;
@@ -40,8 +45,65 @@ class KBIBTEXPROCESSING_EXPORT CheckBibTeX
 public:
     enum class CheckBibTeXResult { NoProblem, BibTeXWarning, BibTeXError, InvalidData, FailedToCheck };
 
+    /// A single warning or error as reported by BibTeX
+    typedef struct {
+        enum class Severity { Warning, Error };
+        Severity severity;
+        /// Id of the entry this diagnostic refers to, empty if unknown
+        QString id;
+        /// Human-readable description, may contain rich text markup
+        QString message;
+    } Diagnostic;
+
+    /// Preferences a check depends on
+    typedef struct {
+        /// Language for LaTeX's babel package
+        QString babelLanguage;
+        /// BibTeX style whose requirements are checked
+        QString bibliographyStyle;
+    } Settings;
+
+    /**
+     * Read the settings a check depends on from the preferences.
+     * Call this in the main thread and hand the result to checks
+     * running in worker threads.
+     */
+    static Settings settingsFromPreferences();
+
+    /**
+     * Validate all entries of a bibliography in a single BibTeX run.
+     * Warnings and errors in BibTeX's log are mapped back to the entries
+     * they refer to. No user interface is shown and no events are processed.
+     * The preferences are not read either if @p file has all its properties
+     * set, as any File created in the main thread has, so then this
+     * function may be called from worker threads.
+     * @param file bibliography to check
+     * @param settings settings to check with, see settingsFromPreferences
+     * @param diagnostics receives all warnings and errors, in the order
+     * reported by BibTeX; if BibTeX could not be run, receives its output
+     * @return FailedToCheck if BibTeX could not be run, BibTeXError if
+     * any error was reported, BibTeXWarning if only warnings were reported
+     */
+    static CheckBibTeXResult checkBibTeX(const File *file, const Settings &settings, QVector<Diagnostic> &diagnostics);
+    /// Same as above, but with settings read from the preferences, so call this only in the main thread
+    static CheckBibTeXResult checkBibTeX(const File *file, QVector<Diagnostic> &diagnostics);
+
+    /**
+     * Collect warnings and errors from BibTeX's log. Warnings name the
+     * entry they refer to, errors are mapped to the entry starting at or
+     * before the line of the .bib file they refer to.
+     * @param bibTeXLog content of BibTeX's log (.blg) file
+     * @param bibTeXSource content of the .bib file BibTeX was run on
+     * @param entryIds ids of all entries in the .bib file
+     * @param diagnostics all warnings and errors get appended to this list, in the order reported by BibTeX
+     * @return BibTeXError if any error was reported, BibTeXWarning if only warnings were reported, else NoProblem
+     */
+    static CheckBibTeXResult parseBibTeXLog(const QString &bibTeXLog, const QString &bibTeXSource, const QSet<QString> &entryIds, QVector<Diagnostic> &diagnostics);
+
+#ifdef HAVE_QTWIDGETS
     static CheckBibTeXResult checkBibTeX(QSharedPointer<Element> &element, const File *file, QWidget *parent);
     static CheckBibTeXResult checkBibTeX(QSharedPointer<Entry> &entry, const File *file, QWidget *parent);
+#endif // HAVE_QTWIDGETS
 };
 
 #endif // KBIBTEX_PROCESSING_CHECKBIBTEX_H
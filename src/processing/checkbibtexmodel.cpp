@@ -0,0 +1,349 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "checkbibtexmodel.h"
+
+#include <algorithm>
+
+#include <QAtomicInteger>
+#include <QEventLoop>
+#include <QHash>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+
+#ifdef HAVE_KFI18N
+#include <KLocalizedString>
+#else // HAVE_KFI18N
+#define i18n(text) QStringLiteral(text)
+#endif // HAVE_KFI18N
+
+#include <File>
+#include <Entry>
+#include <Macro>
+#include <Preamble>
+#include <Preferences>
+#include "logging_processing.h"
+
+/// Fewer entries per shard would make starting BibTeX dominate the run time
+static const int minEntriesPerShard = 512;
+
+/// Rank check results by severity to determine the overall result
+static int severityRank(CheckBibTeX::CheckBibTeXResult result)
+{
+    switch (result) {
+    case CheckBibTeX::CheckBibTeXResult::NoProblem: return 0;
+    case CheckBibTeX::CheckBibTeXResult::BibTeXWarning: return 1;
+    case CheckBibTeX::CheckBibTeXResult::BibTeXError: return 2;
+    case CheckBibTeX::CheckBibTeXResult::InvalidData: return 3;
+    case CheckBibTeX::CheckBibTeXResult::FailedToCheck: return 4;
+    }
+    return 0;
+}
+
+class CheckBibTeXModel::Private
+{
+public:
+    class ShardRunnable : public QRunnable
+    {
+    public:
+        ShardRunnable(Private *d, const File &shard, const QSet<QString> &ownIds, const CheckBibTeX::Settings &settings, int generation)
+                : d(d), shard(shard), ownIds(ownIds), settings(settings), generation(generation) {
+            /// nothing
+        }
+
+        void run() override {
+            /// Skip shards of a check that got cancelled or restarted meanwhile
+            if (d->generation.loadAcquire() != generation)
+                return;
+
+            QVector<CheckBibTeX::Diagnostic> diagnostics;
+            const CheckBibTeX::CheckBibTeXResult result = CheckBibTeX::checkBibTeX(&shard, settings, diagnostics);
+            /// Cross-referenced entries are part of several shards,
+            /// but their diagnostics shall be reported only once
+            diagnostics.erase(std::remove_if(diagnostics.begin(), diagnostics.end(), [this](const CheckBibTeX::Diagnostic & diagnostic) {
+                return !diagnostic.id.isEmpty() && !ownIds.contains(diagnostic.id);
+            }), diagnostics.end());
+
+            Private *d = this->d;
+            const int generation = this->generation;
+            QMetaObject::invokeMethod(d->p, [d, generation, result, diagnostics]() {
+                d->shardFinished(generation, result, diagnostics);
+            }, Qt::QueuedConnection);
+        }
+
+    private:
+        Private *d;
+        const File shard;
+        const QSet<QString> ownIds;
+        const CheckBibTeX::Settings settings;
+        const int generation;
+    };
+
+    CheckBibTeXModel *p;
+    QThreadPool shardPool;
+    /// Incremented whenever a check gets started or cancelled
+    QAtomicInteger<int> generation;
+    QVector<CheckBibTeX::Diagnostic> diagnostics;
+    QHash<QString, QVector<int>> rowsById;
+    CheckBibTeX::CheckBibTeXResult result;
+    int numShards, numFinishedShards;
+    bool running;
+
+    Private(CheckBibTeXModel *parent)
+            : p(parent), generation(0), result(CheckBibTeX::CheckBibTeXResult::NoProblem), numShards(0), numFinishedShards(0), running(false) {
+        shardPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    }
+
+    ~Private() {
+        generation.fetchAndAddOrdered(1);
+        shardPool.clear();
+        shardPool.waitForDone();
+    }
+
+    void shardFinished(int shardGeneration, CheckBibTeX::CheckBibTeXResult shardResult, const QVector<CheckBibTeX::Diagnostic> &shardDiagnostics) {
+        if (shardGeneration != generation.loadAcquire())
+            return;
+
+        if (!shardDiagnostics.isEmpty()) {
+            const int firstRow = diagnostics.size();
+            p->beginInsertRows(QModelIndex(), firstRow, firstRow + shardDiagnostics.size() - 1);
+            for (const CheckBibTeX::Diagnostic &diagnostic : shardDiagnostics) {
+                rowsById[diagnostic.id].append(diagnostics.size());
+                diagnostics.append(diagnostic);
+            }
+            p->endInsertRows();
+        }
+        if (severityRank(shardResult) > severityRank(result))
+            result = shardResult;
+
+        ++numFinishedShards;
+        Q_EMIT p->progress(numFinishedShards, numShards);
+        if (numFinishedShards >= numShards) {
+            running = false;
+            Q_EMIT p->finished();
+        }
+    }
+};
+
+CheckBibTeXModel::CheckBibTeXModel(QObject *parent)
+        : QAbstractTableModel(parent), d(new CheckBibTeXModel::Private(this))
+{
+    /// nothing
+}
+
+CheckBibTeXModel::~CheckBibTeXModel()
+{
+    delete d;
+}
+
+void CheckBibTeXModel::check(const File &file, int numShards)
+{
+    cancel();
+    const int generation = d->generation.loadAcquire();
+
+    beginResetModel();
+    d->diagnostics.clear();
+    d->rowsById.clear();
+    d->result = CheckBibTeX::CheckBibTeXResult::NoProblem;
+    endResetModel();
+
+    /// Shards are copied and the preferences are read here, as
+    /// neither may happen in the worker threads checking the shards
+    const QVector<Shard> shards = splitIntoShards(file, numShards);
+    const CheckBibTeX::Settings settings = CheckBibTeX::settingsFromPreferences();
+    d->numShards = shards.size();
+    d->numFinishedShards = 0;
+    d->running = true;
+    for (const Shard &shard : shards)
+        d->shardPool.start(new CheckBibTeXModel::Private::ShardRunnable(d, shard.file, shard.ownIds, settings, generation));
+
+    if (d->numShards == 0) {
+        /// Nothing to check, but still let listeners know the check is over
+        d->numShards = 1;
+        QMetaObject::invokeMethod(this, [this, generation]() {
+            d->shardFinished(generation, CheckBibTeX::CheckBibTeXResult::NoProblem, QVector<CheckBibTeX::Diagnostic>());
+        }, Qt::QueuedConnection);
+    }
+}
+
+void CheckBibTeXModel::cancel()
+{
+    d->generation.fetchAndAddOrdered(1);
+    d->shardPool.clear();
+    if (d->running) {
+        d->running = false;
+        Q_EMIT finished();
+    }
+}
+
+bool CheckBibTeXModel::isRunning() const
+{
+    return d->running;
+}
+
+bool CheckBibTeXModel::waitForFinished(int msecs)
+{
+    if (!d->running)
+        return true;
+
+    QEventLoop eventLoop;
+    connect(this, &CheckBibTeXModel::finished, &eventLoop, &QEventLoop::quit);
+    if (msecs >= 0)
+        QTimer::singleShot(msecs, &eventLoop, &QEventLoop::quit);
+    eventLoop.exec();
+    return !d->running;
+}
+
+QVector<CheckBibTeXModel::Shard> CheckBibTeXModel::splitIntoShards(const File &file, int numShards)
+{
+    /// Work on copies of all elements not sharing any values with the originals,
+    /// as those may get modified while BibTeX is running in the background
+    QVector<QSharedPointer<Entry>> entries;
+    QHash<QString, QSharedPointer<Entry>> entriesByLowerCaseId;
+    /// Every shard gets all of the bibliography's properties, so that
+    /// exporting a shard does not need to fall back to the preferences
+    File definitions;
+    static const QStringList copiedProperties {File::Encoding, File::StringDelimiter, File::CommentContext, File::CommentPrefix, File::KeywordCasing, File::ProtectCasing, File::NameFormatting, File::ListSeparator, File::SortedByIdentifier};
+    for (const QString &key : copiedProperties)
+        if (file.hasProperty(key))
+            definitions.setProperty(key, file.property(key));
+    /// An empty name formatting means to use the preferences' one
+    if (definitions.property(File::NameFormatting).toString().isEmpty())
+        definitions.setProperty(File::NameFormatting, Preferences::instance().personNameFormat());
+    for (const auto &element : file) {
+        const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+        if (!entry.isNull()) {
+            const QSharedPointer<Entry> copy(new Entry(*entry));
+            for (Entry::Iterator it = copy->begin(); it != copy->end(); ++it)
+                it.value() = it.value().deepCopy();
+            entries.append(copy);
+            entriesByLowerCaseId.insert(copy->id().toLower(), copy);
+            continue;
+        }
+        const QSharedPointer<const Macro> macro = element.dynamicCast<const Macro>();
+        if (!macro.isNull()) {
+            definitions << QSharedPointer<Macro>(new Macro(macro->key(), macro->value().deepCopy()));
+            continue;
+        }
+        const QSharedPointer<const Preamble> preamble = element.dynamicCast<const Preamble>();
+        if (!preamble.isNull())
+            definitions << QSharedPointer<Preamble>(new Preamble(preamble->value().deepCopy()));
+    }
+
+    const int requestedShards = numShards;
+    if (numShards <= 0)
+        numShards = QThread::idealThreadCount();
+    numShards = qBound(1, numShards, qMax(1, entries.size() / minEntriesPerShard));
+    if (requestedShards > numShards)
+        qCInfo(LOG_KBIBTEX_PROCESSING) << "Using" << numShards << "instead of" << requestedShards << "shards to check" << entries.size() << "entries, as each shard should have at least" << minEntriesPerShard << "entries";
+    else
+        qCDebug(LOG_KBIBTEX_PROCESSING) << "Checking" << entries.size() << "entries in" << numShards << "shards";
+    const int shardSize = (entries.size() + numShards - 1) / numShards;
+
+    QVector<Shard> shards;
+    shards.reserve(numShards);
+    for (int begin = 0; begin < entries.size(); begin += shardSize) {
+        const int end = qMin(begin + shardSize, entries.size());
+        Shard shard;
+        shard.file = definitions;
+        for (int i = begin; i < end; ++i) {
+            shard.file << entries[i];
+            shard.ownIds.insert(entries[i]->id());
+        }
+        /// BibTeX resolves cross-references only to entries in the
+        /// same file that are located after the referencing entry
+        QSet<QString> addedCrossRefs;
+        for (int i = begin; i < end; ++i) {
+            const QString crossRef = PlainTextValue::text(entries[i]->value(Entry::ftCrossRef)).toLower();
+            if (crossRef.isEmpty() || addedCrossRefs.contains(crossRef))
+                continue;
+            const QSharedPointer<Entry> target = entriesByLowerCaseId.value(crossRef);
+            if (!target.isNull() && !shard.ownIds.contains(target->id())) {
+                shard.file << target;
+                addedCrossRefs.insert(crossRef);
+            }
+        }
+        shards.append(shard);
+    }
+
+    return shards;
+}
+
+CheckBibTeX::CheckBibTeXResult CheckBibTeXModel::result() const
+{
+    return d->result;
+}
+
+QVector<CheckBibTeX::Diagnostic> CheckBibTeXModel::diagnostics(const QString &id) const
+{
+    QVector<CheckBibTeX::Diagnostic> result;
+    const QVector<int> rows = d->rowsById.value(id);
+    result.reserve(rows.size());
+    for (const int row : rows)
+        result.append(d->diagnostics[row]);
+    return result;
+}
+
+int CheckBibTeXModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : d->diagnostics.size();
+}
+
+int CheckBibTeXModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 3;
+}
+
+QVariant CheckBibTeXModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= d->diagnostics.size())
+        return QVariant();
+
+    const CheckBibTeX::Diagnostic &diagnostic = d->diagnostics[index.row()];
+    if (role == IdRole)
+        return diagnostic.id;
+    else if (role == SeverityRole)
+        return static_cast<int>(diagnostic.severity);
+    else if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
+        switch (index.column()) {
+        case ColumnId: return diagnostic.id;
+        case ColumnSeverity: return diagnostic.severity == CheckBibTeX::Diagnostic::Severity::Error ? i18n("Error") : i18n("Warning");
+        case ColumnMessage: return diagnostic.message;
+        default: return QVariant();
+        }
+    }
+
+    return QVariant();
+}
+
+QVariant CheckBibTeXModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+
+    switch (section) {
+    case ColumnId: return i18n("Id");
+    case ColumnSeverity: return i18n("Severity");
+    case ColumnMessage: return i18n("Message");
+    default: return QVariant();
+    }
+}
@@ -0,0 +1,130 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_PROCESSING_CHECKBIBTEXMODEL_H
+#define KBIBTEX_PROCESSING_CHECKBIBTEXMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QSet>
+
+#include <File>
+#include <CheckBibTeX>
+
+#ifdef HAVE_KF
+#include "kbibtexprocessing_export.h"
+#endif // HAVE_KF
+
+/**
+ * Validate a whole bibliography with BibTeX and collect the reported
+ * warnings and errors as rows of this model, one row per diagnostic.
+ *
+ * The bibliography's entries are split into shards of consecutive
+ * entries, each accompanied by all macros, preambles and cross-referenced
+ * entries it may need. Shards are checked concurrently, each by its own
+ * BibTeX process in its own working directory. Diagnostics are added
+ * to the model as soon as their shard is finished, so views can show
+ * first results while large bibliographies are still being checked.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class KBIBTEXPROCESSING_EXPORT CheckBibTeXModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { ColumnId = 0, ColumnSeverity = 1, ColumnMessage = 2 };
+    enum Roles {
+        /// Id of the entry a diagnostic refers to, as QString
+        IdRole = Qt::UserRole + 8101,
+        /// Severity of a diagnostic, as int of CheckBibTeX::Diagnostic::Severity
+        SeverityRole = Qt::UserRole + 8102
+    };
+
+    /// Part of a bibliography to be checked by a single BibTeX process
+    typedef struct {
+        /// Copies of all macros and preambles, followed by copies of this
+        /// shard's entries and of entries they cross-reference elsewhere;
+        /// no values are shared with the original bibliography, whose
+        /// properties are all set on this file
+        File file;
+        /// Ids of this shard's own entries, i.e. without cross-referenced ones
+        QSet<QString> ownIds;
+    } Shard;
+
+    explicit CheckBibTeXModel(QObject *parent = nullptr);
+    ~CheckBibTeXModel() override;
+
+    /**
+     * Start checking the given bibliography, discarding any diagnostics
+     * of a previous check. The bibliography's elements are copied, so
+     * it may be modified or destroyed while the check is running.
+     * Call this in the main thread, as the preferences are read here
+     * and not in the threads running BibTeX.
+     * @param file bibliography to check
+     * @param numShards number of BibTeX processes to run concurrently,
+     * or 0 to choose based on the number of CPU cores; reduced for small
+     * bibliographies as explained at splitIntoShards
+     */
+    void check(const File &file, int numShards = 0);
+    /// Stop a running check; diagnostics collected so far are kept
+    void cancel();
+    bool isRunning() const;
+    /**
+     * Wait for the running check to finish while processing events,
+     * e.g. for use in command line tools.
+     * @param msecs maximum time to wait, or -1 to wait without limit
+     * @return true if no check is running anymore
+     */
+    bool waitForFinished(int msecs = -1);
+
+    /**
+     * Split a bibliography's entries into shards of consecutive entries.
+     * Each entry is owned by exactly one shard. As starting BibTeX takes
+     * longer than checking a few hundred entries, each shard gets at least
+     * 512 entries: fewer shards than requested are returned for smaller
+     * bibliographies, and a single one for less than 1024 entries.
+     * No shard is returned for a bibliography without entries.
+     * @param file bibliography to split
+     * @param numShards number of shards requested, or 0 to choose based on
+     * the number of CPU cores
+     * @return shards in the order of the bibliography's entries
+     */
+    static QVector<Shard> splitIntoShards(const File &file, int numShards);
+
+    /// Most severe outcome over all shards checked so far
+    CheckBibTeX::CheckBibTeXResult result() const;
+    /// All diagnostics referring to the entry with the given id
+    QVector<CheckBibTeX::Diagnostic> diagnostics(const QString &id) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+Q_SIGNALS:
+    void progress(int finishedShards, int numShards);
+    void finished();
+
+private:
+    class Private;
+    Private *const d;
+};
+
+#endif // KBIBTEX_PROCESSING_CHECKBIBTEXMODEL_H
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -19,7 +19,11 @@
 
 #include "idsuggestions.h"
 
+#include <algorithm>
+
 #include <QRegularExpression>
+#include <QElapsedTimer>
+#include <QtConcurrentMap>
 
 #ifdef HAVE_KFI18N
 #include <KLocalizedString>
@@ -29,13 +33,14 @@
 #endif // HAVE_KFI18N
 
 #include <Preferences>
+#include <File>
 #include <Encoder>
 #include "journalabbreviations.h"
 
 class IdSuggestions::IdSuggestionsPrivate
 {
 private:
-    static const QStringList smallWords;
+    static const QSet<QString> smallWords;
 
 public:
 
@@ -248,29 +253,49 @@ public:
         }
     }
 
-    static QString translateToken(const Entry &entry, const QString &token) {
+    static FormatProgram::Instruction compileToken(const QString &token) {
+        FormatProgram::Instruction instruction;
+        instruction.type = token[0];
         switch (token[0].unicode()) {
         case 'a': ///< deprecated but still supported case
-        {
-            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo ati
-            struct IdSuggestionTokenInfo ati = IdSuggestions::evalToken(token.mid(1));
-            ati.startWord = ati.endWord = 0; ///< only first author
-            return translateAuthorsToken(entry, ati);
-        }
-        case 'A': {
-            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo ati
-            const struct IdSuggestionTokenInfo ati = IdSuggestions::evalToken(token.mid(1));
-            return translateAuthorsToken(entry, ati);
-        }
+            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo
+            instruction.info = IdSuggestions::evalToken(token.mid(1));
+            instruction.info.startWord = instruction.info.endWord = 0; ///< only first author
+            instruction.type = QLatin1Char('A');
+            break;
         case 'z': ///< deprecated but still supported case
-        {
-            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo ati
-            struct IdSuggestionTokenInfo ati = IdSuggestions::evalToken(token.mid(1));
+            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo
+            instruction.info = IdSuggestions::evalToken(token.mid(1));
             /// All but first author
-            ati.startWord = 1;
-            ati.endWord = std::numeric_limits<int>::max();
-            return translateAuthorsToken(entry, ati);
+            instruction.info.startWord = 1;
+            instruction.info.endWord = std::numeric_limits<int>::max();
+            instruction.type = QLatin1Char('A');
+            break;
+        case 'A':
+        case 't':
+        case 'T':
+        case 'j':
+        case 'J':
+        case 'e':
+            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo
+            instruction.info = IdSuggestions::evalToken(token.mid(1));
+            break;
+        case '"':
+            /// Literal text, stored in field 'inBetween' for lack of a better place
+            instruction.info = IdSuggestions::evalToken(QString());
+            instruction.info.inBetween = token.mid(1);
+            break;
+        default:
+            /// Tokens without parameters like 'y' or 'p', or unknown tokens
+            instruction.info = IdSuggestions::evalToken(QString());
         }
+        return instruction;
+    }
+
+    static QString translateInstruction(const Entry &entry, const FormatProgram::Instruction &instruction) {
+        switch (instruction.type.unicode()) {
+        case 'A':
+            return translateAuthorsToken(entry, instruction.info);
         case 'y': {
             int year = numberFromEntry(entry, Entry::ftYear);
             if (year > -1)
@@ -284,29 +309,18 @@ public:
             break;
         }
         case 't':
-        case 'T': {
-            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo jti
-            const struct IdSuggestionTokenInfo tti = IdSuggestions::evalToken(token.mid(1));
-            return translateTitleToken(entry, tti, token[0].isUpper());
-        }
+        case 'T':
+            return translateTitleToken(entry, instruction.info, instruction.type.isUpper());
         case 'j':
-        case 'J': {
-            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo jti
-            const struct IdSuggestionTokenInfo jti = IdSuggestions::evalToken(token.mid(1));
-            return translateJournalToken(entry, jti, token[0].isUpper());
-        }
-        case 'e': {
-            /// Evaluate the token string, store information in struct IdSuggestionTokenInfo eti
-            const struct IdSuggestionTokenInfo eti = IdSuggestions::evalToken(token.mid(1));
-            return translateTypeToken(entry, eti);
-        }
-        case 'v': {
+        case 'J':
+            return translateJournalToken(entry, instruction.info, instruction.type.isUpper());
+        case 'e':
+            return translateTypeToken(entry, instruction.info);
+        case 'v':
             return normalizeText(PlainTextValue::text(entry.value(Entry::ftVolume)));
-        }
-        case 'p': {
+        case 'p':
             return pageNumberFromEntry(entry);
-        }
-        case '"': return token.mid(1);
+        case '"': return instruction.info.inBetween;
         }
 
         return QString();
@@ -315,29 +329,51 @@ public:
 
 /// List of small words taken from OCLC:
 /// https://www.oclc.org/developer/develop/web-services/worldcat-search-api/bibliographic-resource.en.html
-const QStringList IdSuggestions::IdSuggestionsPrivate::smallWords = i18nc("Small words that can be removed from titles when generating id suggestions; separated by pipe symbol", "a|als|am|an|are|as|at|auf|aus|be|but|by|das|dass|de|der|des|dich|dir|du|er|es|for|from|had|have|he|her|his|how|ihr|ihre|ihres|im|in|is|ist|it|kein|la|le|les|mein|mich|mir|mit|of|on|sein|sie|that|the|this|to|un|une|von|was|wer|which|wie|wird|with|yousie|that|the|this|to|un|une|von|was|wer|which|wie|wird|with|you|und|and|ein|eine|einer|eines").split(QStringLiteral("|"),
+const QSet<QString> IdSuggestions::IdSuggestionsPrivate::smallWords = []() {
+    const QStringList words = i18nc("Small words that can be removed from titles when generating id suggestions; separated by pipe symbol", "a|als|am|an|are|as|at|auf|aus|be|but|by|das|dass|de|der|des|dich|dir|du|er|es|for|from|had|have|he|her|his|how|ihr|ihre|ihres|im|in|is|ist|it|kein|la|le|les|mein|mich|mir|mit|of|on|sein|sie|that|the|this|to|un|une|von|was|wer|which|wie|wird|with|yousie|that|the|this|to|un|une|von|was|wer|which|wie|wird|with|you|und|and|ein|eine|einer|eines").split(QStringLiteral("|"),
 #if QT_VERSION >= 0x050e00
-  Qt::SkipEmptyParts
+                              Qt::SkipEmptyParts
 #else // QT_VERSION < 0x050e00
-  QString::SkipEmptyParts
+                              QString::SkipEmptyParts
 #endif // QT_VERSION >= 0x050e00
-);
+                              );
+#if QT_VERSION >= 0x050e00
+    return QSet<QString>(words.constBegin(), words.constEnd());
+#else // QT_VERSION < 0x050e00
+    return words.toSet();
+#endif // QT_VERSION >= 0x050e00
+}();
 
-QString IdSuggestions::formatId(const Entry &entry, const QString &formatStr)
+IdSuggestions::FormatProgram::FormatProgram(const QString &formatStr)
 {
-    QString id;
 #if QT_VERSION >= 0x050e00
     const QStringList tokenList = formatStr.split(QStringLiteral("|"), Qt::SkipEmptyParts);
 #else // QT_VERSION < 0x050e00
     const QStringList tokenList = formatStr.split(QStringLiteral("|"), QString::SkipEmptyParts);
 #endif // QT_VERSION >= 0x050e00
-    for (const QString &token : tokenList) {
-        id.append(IdSuggestionsPrivate::translateToken(entry, token));
-    }
+    instructions.reserve(tokenList.count());
+    for (const QString &token : tokenList)
+        instructions.append(IdSuggestionsPrivate::compileToken(token));
+}
 
+QString IdSuggestions::FormatProgram::apply(const Entry &entry) const
+{
+    QString id;
+    for (const Instruction &instruction : instructions)
+        id.append(IdSuggestionsPrivate::translateInstruction(entry, instruction));
     return id;
 }
 
+bool IdSuggestions::FormatProgram::isEmpty() const
+{
+    return instructions.isEmpty();
+}
+
+QString IdSuggestions::formatId(const Entry &entry, const QString &formatStr)
+{
+    return FormatProgram(formatStr).apply(entry);
+}
+
 QString IdSuggestions::defaultFormatId(const Entry &entry)
 {
     return formatId(entry, Preferences::instance().activeIdSuggestionFormatString());
@@ -358,6 +394,85 @@ bool IdSuggestions::applyDefaultFormatId(Entry &entry)
         return false;
 }
 
+IdSuggestions::BulkFormatIdResult IdSuggestions::applyFormatId(const QVector<QSharedPointer<Entry>> &entries, const QString &formatStr, const QSet<QString> &reservedIds)
+{
+    QElapsedTimer timer;
+    timer.start();
+    BulkFormatIdResult result{0, 0, 0, 0};
+
+    struct WorkItem {
+        QSharedPointer<Entry> entry;
+        QString newId;
+    };
+    QVector<WorkItem> workItems;
+    workItems.reserve(entries.count());
+    for (const QSharedPointer<Entry> &entry : entries)
+        if (!entry.isNull())
+            workItems.append(WorkItem{entry, QString()});
+
+    /// Generating ids is independent for each entry, so do it in parallel
+    /// unless there are too few entries to make up for the threading overhead
+    const FormatProgram program(formatStr);
+    const auto generateId = [&program](WorkItem & workItem) {
+        workItem.newId = program.apply(*workItem.entry);
+    };
+    static const int minimumEntriesForParallelProcessing = 64;
+    if (workItems.count() >= minimumEntriesForParallelProcessing)
+        QtConcurrent::blockingMap(workItems, generateId);
+    else
+        std::for_each(workItems.begin(), workItems.end(), generateId);
+
+    /// Apply ids sequentially in the entries' order, so that collisions
+    /// get resolved the same way each time
+    QSet<QString> takenIds(reservedIds);
+    takenIds.reserve(reservedIds.count() + workItems.count());
+    /// Entries without a generated id keep their current id, so reserve
+    /// those ids first to prevent any other entry from getting re-keyed to them
+    for (const WorkItem &workItem : const_cast<const QVector<WorkItem> &>(workItems))
+        if (workItem.newId.isEmpty()) {
+            ++result.emptyIds;
+            takenIds.insert(workItem.entry->id());
+        }
+    for (const WorkItem &workItem : const_cast<const QVector<WorkItem> &>(workItems)) {
+        if (workItem.newId.isEmpty())
+            continue;
+        QString newId = workItem.newId;
+        if (takenIds.contains(newId)) {
+            ++result.resolvedCollisions;
+            for (int i = 0; takenIds.contains(newId); ++i)
+                newId = workItem.newId + collisionSuffix(i);
+        }
+        takenIds.insert(newId);
+        if (newId != workItem.entry->id()) {
+            workItem.entry->setId(newId);
+            ++result.changedIds;
+        }
+    }
+
+    result.elapsedMilliseconds = timer.elapsed();
+    return result;
+}
+
+IdSuggestions::BulkFormatIdResult IdSuggestions::applyFormatId(File &file, const QString &formatStr)
+{
+    QVector<QSharedPointer<Entry>> entries;
+    entries.reserve(file.count());
+    for (const QSharedPointer<Element> &element : const_cast<const File &>(file)) {
+        const QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+        if (!entry.isNull())
+            entries.append(entry);
+    }
+    return applyFormatId(entries, formatStr);
+}
+
+QString IdSuggestions::collisionSuffix(int index)
+{
+    QString result;
+    for (++index; index > 0; index = (index - 1) / 26)
+        result.prepend(QChar(u'a' + (index - 1) % 26));
+    return result;
+}
+
 QStringList IdSuggestions::formatIdList(const Entry &entry)
 {
     const QStringList formatStrings = Preferences::instance().idSuggestionFormatStrings();
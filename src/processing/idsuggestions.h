@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2019 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -20,12 +20,17 @@
 #ifndef KBIBTEX_PROCESSING_IDSUGGESTIONS_H
 #define KBIBTEX_PROCESSING_IDSUGGESTIONS_H
 
+#include <QVector>
+#include <QSet>
+
 #include <Entry>
 
 #ifdef HAVE_KF
 #include "kbibtexprocessing_export.h"
 #endif // HAVE_KF
 
+class File;
+
 /**
  * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
  */
@@ -42,6 +47,42 @@ public:
         QString inBetween;
     };
 
+    /**
+     * A format string like "A|y|T" compiled into a sequence of tokens
+     * whose parameters have been evaluated already. Applying a compiled
+     * program to many entries avoids re-parsing the format string for
+     * each entry. Programs are immutable and may be applied concurrently.
+     */
+    class KBIBTEXPROCESSING_EXPORT FormatProgram
+    {
+    public:
+        explicit FormatProgram(const QString &formatStr = QString());
+
+        QString apply(const Entry &entry) const;
+        bool isEmpty() const;
+
+        struct Instruction {
+            /// Token type, i.e. the token's first character
+            QChar type;
+            /// Evaluated token parameters; for literal text tokens, the text is stored in 'inBetween'
+            IdSuggestionTokenInfo info;
+        };
+
+    private:
+        QVector<Instruction> instructions;
+    };
+
+    struct BulkFormatIdResult {
+        /// Number of entries whose id got changed
+        int changedIds;
+        /// Number of generated ids that had to be modified to be unique
+        int resolvedCollisions;
+        /// Number of entries for which the format string generated an empty id; those entries remain unchanged
+        int emptyIds;
+        /// Time it took to generate and apply all ids
+        qint64 elapsedMilliseconds;
+    };
+
     static QString formatId(const Entry &entry, const QString &formatStr);
     static QString defaultFormatId(const Entry &entry);
     static bool hasDefaultFormat();
@@ -58,6 +99,34 @@ public:
       */
     static bool applyDefaultFormatId(Entry &entry);
 
+    /**
+      * Re-key many entries at once using the same format string.
+      * Ids are generated in parallel, then applied in the entries' order.
+      * If a generated id is already taken, either by an entry processed
+      * before or by one of the reserved ids, a suffix 'a', 'b', ..., 'z',
+      * 'aa', 'ab', ... gets appended to make it unique. Entries for which
+      * the format string generates an empty id keep their id, which no
+      * other entry's new id will collide with.
+      *
+      * @param entries entries whose ids are to be changed
+      * @param formatStr format string to apply
+      * @param reservedIds ids that must not be generated, e.g. those of other entries in the same file
+      * @return statistics on the changes made
+      */
+    static BulkFormatIdResult applyFormatId(const QVector<QSharedPointer<Entry>> &entries, const QString &formatStr, const QSet<QString> &reservedIds = QSet<QString>());
+    /**
+      * Re-key all entries in the given file using the same format string.
+      * @see applyFormatId
+      */
+    static BulkFormatIdResult applyFormatId(File &file, const QString &formatStr);
+
+    /**
+      * Suffix to append to an id to tell it apart from other entries' ids:
+      * 'a', 'b', ..., 'z', 'aa', 'ab', ... for index 0, 1, ..., 25, 26, 27, ...
+      * Callers try increasing indices until the suffixed id is unique.
+      */
+    static QString collisionSuffix(int index);
+
     static QStringList formatIdList(const Entry &entry);
 
     static QStringList formatStrToHuman(const QString &formatStr);
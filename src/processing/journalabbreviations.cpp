@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2018 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -19,28 +19,86 @@
 
 #include "journalabbreviations.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include <QHash>
+#include <QVector>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDir>
+#include <QDateTime>
+#include <QMutex>
 #include <QTextStream>
 #include <QRegularExpression>
 #include <QStandardPaths>
 
+#include <File>
+#include <Entry>
+#include <Value>
+
 #include "logging_processing.h"
 
+namespace {
+
+/// Layout of the compiled index file. All numbers are stored in the
+/// machine's native byte order, as the index is a local cache only.
+struct IndexHeader {
+    char magic[4];
+    quint32 formatVersion;
+    /// Size and modification time of the text list the index was compiled from
+    qint64 sourceSize;
+    qint64 sourceModified;
+    quint32 leftToRightCount, rightToLeftCount;
+    /// Byte offsets of both record tables and the string pool
+    quint32 leftToRightOffset, rightToLeftOffset, stringPoolOffset;
+    /// Length of the string pool in UTF-16 code units
+    quint32 stringPoolLength;
+};
+
+/// One mapping, both strings referring to the string pool (in UTF-16 code units)
+struct IndexRecord {
+    quint32 keyPos, keyLen, valuePos, valueLen;
+};
+
+static const char indexMagic[4] = {'K', 'B', 'J', 'A'};
+static const quint32 indexFormatVersion = 1;
+
+}
+
 class JournalAbbreviations::Private
 {
 private:
     const QString journalFilename;
+    const QString indexFilename;
 
+    /// Used only if no compiled index could be written or mapped
     QHash<QString, QString> leftToRightMap, rightToLeftMap;
 
+    QMutex mutex;
+    bool initialized;
+
+    QFile indexFile;
+    const uchar *mapped;
+    const IndexHeader *header;
+    const IndexRecord *leftToRightRecords, *rightToLeftRecords;
+    const QChar *stringPool;
+
 public:
     Private(JournalAbbreviations *parent)
-            : journalFilename(QStandardPaths::locate(QStandardPaths::GenericDataLocation, QStringLiteral("kbibtex/jabref_journalabbrevlist.txt")))
+            : journalFilename(QStandardPaths::locate(QStandardPaths::GenericDataLocation, QStringLiteral("kbibtex/jabref_journalabbrevlist.txt"))),
+          indexFilename(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/journalabbreviations.idx")),
+          initialized(false), mapped(nullptr), header(nullptr), leftToRightRecords(nullptr), rightToLeftRecords(nullptr), stringPool(nullptr)
     {
         Q_UNUSED(parent)
     }
 
+    ~Private() {
+        if (mapped != nullptr)
+            indexFile.unmap(const_cast<uchar *>(mapped));
+    }
+
     bool loadMapping() {
         leftToRightMap.clear();
         rightToLeftMap.clear();
@@ -101,15 +159,149 @@ public:
         }
     }
 
+    /**
+     * Map the compiled index file into memory if it exists and
+     * was compiled from the current journal abbreviation list.
+     */
+    bool mapIndex(const QFileInfo &sourceInfo) {
+        indexFile.setFileName(indexFilename);
+        if (!indexFile.open(QFile::ReadOnly))
+            return false;
+
+        const qint64 size = indexFile.size();
+        uchar *data = size >= static_cast<qint64>(sizeof(IndexHeader)) ? indexFile.map(0, size) : nullptr;
+        if (data == nullptr) {
+            indexFile.close();
+            return false;
+        }
+
+        const IndexHeader *h = reinterpret_cast<const IndexHeader *>(data);
+        const bool valid = memcmp(h->magic, indexMagic, sizeof(indexMagic)) == 0 && h->formatVersion == indexFormatVersion
+                           && h->sourceSize == sourceInfo.size() && h->sourceModified == sourceInfo.lastModified().toMSecsSinceEpoch()
+                           && static_cast<qint64>(h->leftToRightOffset) + static_cast<qint64>(h->leftToRightCount) * static_cast<qint64>(sizeof(IndexRecord)) <= size
+                           && static_cast<qint64>(h->rightToLeftOffset) + static_cast<qint64>(h->rightToLeftCount) * static_cast<qint64>(sizeof(IndexRecord)) <= size
+                           && static_cast<qint64>(h->stringPoolOffset) + static_cast<qint64>(h->stringPoolLength) * 2 <= size;
+        if (!valid) {
+            indexFile.unmap(data);
+            indexFile.close();
+            return false;
+        }
+
+        mapped = data;
+        header = h;
+        leftToRightRecords = reinterpret_cast<const IndexRecord *>(data + h->leftToRightOffset);
+        rightToLeftRecords = reinterpret_cast<const IndexRecord *>(data + h->rightToLeftOffset);
+        stringPool = reinterpret_cast<const QChar *>(data + h->stringPoolOffset);
+        /// Mapping stays valid after closing the file
+        indexFile.close();
+        return true;
+    }
+
+    /**
+     * Compile the mappings loaded by @see loadMapping into a binary index:
+     * two tables of records sorted by key, followed by a pool of all
+     * strings in UTF-16, so that lookups can compare strings in place.
+     */
+    bool writeIndex(const QFileInfo &sourceInfo) const {
+        QVector<QChar> pool;
+        QHash<QString, quint32> poolPositions;
+        const auto poolPosition = [&pool, &poolPositions](const QString &text) -> quint32 {
+            const auto it = poolPositions.constFind(text);
+            if (it != poolPositions.constEnd())
+                return it.value();
+            const quint32 pos = static_cast<quint32>(pool.count());
+            for (const QChar &c : text)
+                pool.append(c);
+            poolPositions.insert(text, pos);
+            return pos;
+        };
+        const auto buildTable = [&poolPosition](const QHash<QString, QString> &map) {
+            QVector<QString> keys;
+            keys.reserve(map.count());
+            for (QHash<QString, QString>::ConstIterator it = map.constBegin(); it != map.constEnd(); ++it)
+                keys.append(it.key());
+            /// QString's operator< compares UTF-16 code units, just as QStringView::compare used for lookups
+            std::sort(keys.begin(), keys.end());
+            QVector<IndexRecord> table;
+            table.reserve(keys.count());
+            for (const QString &key : const_cast<const QVector<QString> &>(keys)) {
+                const QString value = map.value(key);
+                table.append(IndexRecord{poolPosition(key), static_cast<quint32>(key.length()), poolPosition(value), static_cast<quint32>(value.length())});
+            }
+            return table;
+        };
+
+        const QVector<IndexRecord> leftToRightTable = buildTable(leftToRightMap);
+        const QVector<IndexRecord> rightToLeftTable = buildTable(rightToLeftMap);
+
+        IndexHeader h;
+        memcpy(h.magic, indexMagic, sizeof(indexMagic));
+        h.formatVersion = indexFormatVersion;
+        h.sourceSize = sourceInfo.size();
+        h.sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+        h.leftToRightCount = static_cast<quint32>(leftToRightTable.count());
+        h.rightToLeftCount = static_cast<quint32>(rightToLeftTable.count());
+        h.leftToRightOffset = sizeof(IndexHeader);
+        h.rightToLeftOffset = h.leftToRightOffset + h.leftToRightCount * sizeof(IndexRecord);
+        h.stringPoolOffset = h.rightToLeftOffset + h.rightToLeftCount * sizeof(IndexRecord);
+        h.stringPoolLength = static_cast<quint32>(pool.count());
+
+        QDir().mkpath(QFileInfo(indexFilename).absolutePath());
+        QSaveFile file(indexFilename);
+        if (!file.open(QFile::WriteOnly))
+            return false;
+        file.write(reinterpret_cast<const char *>(&h), sizeof(IndexHeader));
+        file.write(reinterpret_cast<const char *>(leftToRightTable.constData()), leftToRightTable.count() * sizeof(IndexRecord));
+        file.write(reinterpret_cast<const char *>(rightToLeftTable.constData()), rightToLeftTable.count() * sizeof(IndexRecord));
+        file.write(reinterpret_cast<const char *>(pool.constData()), pool.count() * sizeof(QChar));
+        return file.commit();
+    }
+
+    void initialize() {
+        QMutexLocker locker(&mutex);
+        if (initialized) return;
+        initialized = true;
+
+        const QFileInfo sourceInfo(journalFilename);
+        if (!sourceInfo.exists()) {
+            qCWarning(LOG_KBIBTEX_PROCESSING) << "Cannot find journal abbreviation list file";
+            return;
+        }
+
+        if (mapIndex(sourceInfo))
+            return;
+
+        /// No valid index yet, so compile one from the text list
+        if (loadMapping() && writeIndex(sourceInfo) && mapIndex(sourceInfo)) {
+            /// Index is used from now on, no need to keep the hashes in memory
+            leftToRightMap.clear();
+            rightToLeftMap.clear();
+        } else
+            qCInfo(LOG_KBIBTEX_PROCESSING) << "Cannot use compiled journal abbreviation index at" << indexFilename << ", falling back to in-memory mapping";
+    }
+
+    QString lookup(const IndexRecord *records, quint32 count, const QString &key) const {
+        const QStringView keyView(key);
+        const IndexRecord *end = records + count;
+        const IndexRecord *it = std::lower_bound(records, end, keyView, [this](const IndexRecord & record, QStringView k) {
+            return QStringView(stringPool + record.keyPos, record.keyLen).compare(k) < 0;
+        });
+        if (it != end && QStringView(stringPool + it->keyPos, it->keyLen).compare(keyView) == 0)
+            return QString(stringPool + it->valuePos, it->valueLen);
+        return key;
+    }
+
     QString leftToRight(const QString &left) {
-        if (leftToRightMap.isEmpty())
-            loadMapping(); ///< lazy loading of mapping, i.e. only when data gets requested the first time
+        initialize(); ///< lazy loading of mapping, i.e. only when data gets requested the first time
+        if (header != nullptr)
+            return lookup(leftToRightRecords, header->leftToRightCount, left);
         return leftToRightMap.value(left, left);
     }
 
     QString rightToLeft(const QString &right) {
-        if (rightToLeftMap.isEmpty())
-            loadMapping(); ///< lazy loading of mapping, i.e. only when data gets requested the first time
+        initialize(); ///< lazy loading of mapping, i.e. only when data gets requested the first time
+        if (header != nullptr)
+            return lookup(rightToLeftRecords, header->rightToLeftCount, right);
         return rightToLeftMap.value(right, right);
     }
 };
@@ -138,3 +330,28 @@ QString JournalAbbreviations::toShortName(const QString &longName) const {
 QString JournalAbbreviations::toLongName(const QString &shortName) const {
     return d->rightToLeft(shortName);
 }
+
+int JournalAbbreviations::convertJournals(File &file, Direction direction) const {
+    int count = 0;
+    for (const QSharedPointer<Element> &element : const_cast<const File &>(file)) {
+        QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+        if (entry.isNull()) continue;
+
+        /// Only plain journal names get converted, not macros or composed values
+        const Value value = entry->value(Entry::ftJournal);
+        if (value.count() != 1) continue;
+        const QSharedPointer<PlainText> plainText = value.first().dynamicCast<PlainText>();
+        if (plainText.isNull()) continue;
+
+        const QString text = plainText->text();
+        const QString converted = direction == Direction::ToShortName ? d->leftToRight(text) : d->rightToLeft(text);
+        if (converted != text) {
+            Value convertedValue;
+            convertedValue.append(QSharedPointer<PlainText>(new PlainText(converted)));
+            entry->remove(Entry::ftJournal);
+            entry->insert(Entry::ftJournal, convertedValue);
+            ++count;
+        }
+    }
+    return count;
+}
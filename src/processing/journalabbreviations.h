@@ -26,7 +26,14 @@
 #include "kbibtexprocessing_export.h"
 #endif // HAVE_KF
 
+class File;
+
 /**
+ * Map journal names to their abbreviations and back.
+ * The list of abbreviations is compiled into a binary index on first
+ * use, which is kept in the cache directory and memory-mapped by later
+ * processes, so that the text list does not have to be parsed again.
+ *
  * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
  */
 class KBIBTEXPROCESSING_EXPORT JournalAbbreviations
@@ -37,6 +44,18 @@ public:
     QString toShortName(const QString &longName) const;
     QString toLongName(const QString &shortName) const;
 
+    enum class Direction { ToShortName, ToLongName };
+
+    /**
+     * Abbreviate or expand the journal names of all entries in a file.
+     * Only journal fields consisting of plain text are considered,
+     * macros are left untouched.
+     * @param file bibliography to modify in place
+     * @param direction whether to abbreviate or to expand journal names
+     * @return number of entries whose journal name has been changed
+     */
+    int convertJournals(File &file, Direction direction) const;
+
 protected:
     explicit JournalAbbreviations();
     ~JournalAbbreviations();
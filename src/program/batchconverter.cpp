@@ -0,0 +1,456 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "batchconverter.h"
+
+#include <iostream>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+
+#include <Entry>
+#include <Macro>
+#include <File>
+#include <Value>
+#include <FileImporter>
+#include <FileExporter>
+#include <FileExporterBibTeX>
+#include <IdSuggestions>
+
+/// Everything known about one input file, filled by a worker and read once all workers finished
+typedef struct {
+    QString inputFilename;
+    /// Input file's path relative to the directory it was found in
+    QString relativeFilename;
+    /// Only set if files are written separately into an output directory
+    QString outputFilename;
+    /// Loaded file waiting to be merged, owned by this report
+    File *file;
+    QString errorMessage;
+    int numElements;
+    int changedIds;
+    /// Timings, -1 if the step has not been performed
+    qint64 loadMilliseconds;
+    qint64 processMilliseconds;
+    qint64 saveMilliseconds;
+} FileReport;
+
+class ConversionRunnable : public QRunnable
+{
+public:
+    ConversionRunnable(const BatchConverter::Options &_options, FileReport *_report)
+            : options(_options), report(_report) {
+        /// nothing
+    }
+
+    void run() override {
+        QElapsedTimer timer;
+        timer.start();
+
+        const QFileInfo inputFileInfo(report->inputFilename);
+        if (!inputFileInfo.exists() || inputFileInfo.size() <= 0 || !inputFileInfo.isFile() || !inputFileInfo.isReadable()) {
+            report->errorMessage = QStringLiteral("Not an existing, readable, non-empty file");
+            return;
+        }
+        QFile inputFile(inputFileInfo.filePath());
+        if (!inputFile.open(QFile::ReadOnly)) {
+            report->errorMessage = QStringLiteral("Cannot read from file");
+            return;
+        }
+        QScopedPointer<FileImporter> importer(FileImporter::factory(inputFileInfo, nullptr));
+        QScopedPointer<File> file(importer->load(&inputFile));
+        inputFile.close();
+        report->loadMilliseconds = timer.restart();
+        if (file.isNull()) {
+            report->errorMessage = QStringLiteral("Failed to load file");
+            return;
+        }
+        report->numElements = file->count();
+
+        if (!options.formatIdString.isEmpty()) {
+            const IdSuggestions::BulkFormatIdResult result{IdSuggestions::applyFormatId(*file, options.formatIdString)};
+            report->changedIds = result.changedIds;
+            if (result.emptyIds > 0) {
+                report->errorMessage = QString(QStringLiteral("New ids generated from %1 entries and the format string are empty")).arg(result.emptyIds);
+                return;
+            }
+        }
+        report->processMilliseconds = timer.restart();
+
+        if (report->outputFilename.isEmpty()) {
+            /// File will be merged with all other files once all workers are done
+            report->file = file.take();
+            return;
+        }
+
+        const QFileInfo outputFileInfo(report->outputFilename);
+        if (!QDir().mkpath(outputFileInfo.absolutePath())) {
+            report->errorMessage = QStringLiteral("Cannot create directory ") + outputFileInfo.absolutePath();
+            return;
+        }
+        QFile outputFile(outputFileInfo.filePath());
+        if (!outputFile.open(QFile::WriteOnly)) {
+            report->errorMessage = QStringLiteral("Cannot write to file ") + outputFileInfo.filePath();
+            return;
+        }
+        QScopedPointer<FileExporter> exporter(FileExporter::factory(outputFileInfo, BatchConverter::exporterClassHint(outputFileInfo, options.outputFormat), nullptr));
+        const bool ok = exporter->save(&outputFile, file.data());
+        outputFile.close();
+        report->saveMilliseconds = timer.elapsed();
+        if (!ok)
+            report->errorMessage = QStringLiteral("Failed to write to file ") + outputFileInfo.filePath();
+    }
+
+private:
+    const BatchConverter::Options &options;
+    FileReport *const report;
+};
+
+class BatchConverter::Private
+{
+public:
+    const BatchConverter::Options options;
+    QVector<FileReport> reports;
+
+    explicit Private(const BatchConverter::Options &_options)
+            : options(_options) {
+        /// nothing
+    }
+
+    ~Private() {
+        for (const FileReport &report : const_cast<const QVector<FileReport> &>(reports))
+            delete report.file;
+    }
+
+    bool collectInputs() {
+        bool ok = true;
+        QSet<QString> knownFilenames;
+        const auto addInput = [this, &knownFilenames](const QString &filename, const QString &relativeFilename) {
+            /// The same file may be reached through different paths
+            const QString canonicalFilename = QFileInfo(filename).canonicalFilePath();
+            const QString key = canonicalFilename.isEmpty() ? filename : canonicalFilename;
+            if (knownFilenames.contains(key)) return;
+            knownFilenames.insert(key);
+            reports.append(FileReport {filename, relativeFilename, QString(), nullptr, QString(), 0, 0, -1, -1, -1});
+        };
+
+        for (const QString &input : options.inputs) {
+            const QFileInfo inputFileInfo(input);
+            if (inputFileInfo.isDir()) {
+                const QDir dir(input);
+                QStringList filenames;
+                QDirIterator it(input, options.nameFilters, QDir::Files | QDir::Readable, options.recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+                while (it.hasNext())
+                    filenames.append(it.next());
+                /// Process files in a deterministic order, independent of the file system
+                filenames.sort();
+                if (filenames.isEmpty())
+                    std::cerr << "No matching files in directory: " << input.toLocal8Bit().constData() << std::endl;
+                for (const QString &filename : const_cast<const QStringList &>(filenames))
+                    addInput(filename, dir.relativeFilePath(filename));
+            } else if (!inputFileInfo.exists() && (input.contains(u'*') || input.contains(u'?') || input.contains(u'['))) {
+                /// Wildcard patterns not expanded by the shell, e.g. when quoted or on Windows
+                const QDir dir = inputFileInfo.dir();
+                const QStringList filenames = dir.entryList({inputFileInfo.fileName()}, QDir::Files | QDir::Readable, QDir::Name);
+                if (filenames.isEmpty()) {
+                    std::cerr << "No files match pattern: " << input.toLocal8Bit().constData() << std::endl;
+                    ok = false;
+                }
+                for (const QString &filename : filenames)
+                    addInput(dir.filePath(filename), filename);
+            } else
+                addInput(input, inputFileInfo.fileName());
+        }
+
+        if (reports.isEmpty()) {
+            std::cerr << "No files to read from" << std::endl;
+            ok = false;
+        }
+        return ok;
+    }
+
+    bool assignOutputFilenames() {
+        const QDir outputDirectory(options.outputDirectory);
+        QString outputSuffix = options.outputSuffix;
+        if (outputSuffix.startsWith(u'.'))
+            outputSuffix = outputSuffix.mid(1);
+
+        QHash<QString, QString> inputForOutput;
+        for (FileReport &report : reports) {
+            QString relativeFilename = report.relativeFilename;
+            if (!outputSuffix.isEmpty()) {
+                const QString suffix = QFileInfo(relativeFilename).suffix();
+                if (!suffix.isEmpty())
+                    relativeFilename.chop(suffix.length() + 1);
+                relativeFilename.append(u'.').append(outputSuffix);
+            }
+            report.outputFilename = QDir::cleanPath(outputDirectory.absoluteFilePath(relativeFilename));
+
+            const auto it = inputForOutput.constFind(report.outputFilename);
+            if (it != inputForOutput.constEnd()) {
+                std::cerr << "Both " << it.value().toLocal8Bit().constData() << " and " << report.inputFilename.toLocal8Bit().constData() << " would be written to " << report.outputFilename.toLocal8Bit().constData() << std::endl;
+                return false;
+            }
+            inputForOutput.insert(report.outputFilename, report.inputFilename);
+        }
+        return true;
+    }
+
+    void processAll() {
+        QThreadPool pool;
+        pool.setMaxThreadCount(options.numJobs > 0 ? options.numJobs : QThread::idealThreadCount());
+        /// Each worker writes only into its own report; the vector itself must not change until all are done
+        for (FileReport &report : reports)
+            pool.start(new ConversionRunnable(options, &report));
+        pool.waitForDone();
+    }
+
+    bool merge(File &merged) {
+        static const QStringList copiedProperties {File::Encoding, File::StringDelimiter, File::CommentContext, File::CommentPrefix, File::KeywordCasing, File::ProtectCasing, File::NameFormatting, File::ListSeparator};
+
+        /// Positions of entries and macros in the merged file by their lower-case ids or keys,
+        /// as BibTeX compares both case-insensitively
+        QHash<QString, int> entryPositions, macroPositions;
+        int numRenamed = 0, numDropped = 0, numReplaced = 0, numDuplicates = 0;
+        bool propertiesCopied = false;
+
+        for (const FileReport &report : const_cast<const QVector<FileReport> &>(reports)) {
+            if (report.file == nullptr) continue;
+
+            if (!propertiesCopied) {
+                /// Formatting of the output follows the first file
+                for (const QString &key : copiedProperties)
+                    if (report.file->hasProperty(key))
+                        merged.setProperty(key, report.file->property(key));
+                propertiesCopied = true;
+            }
+
+            QHash<QString, QString> renamedIds;
+            for (const QSharedPointer<Element> &element : const_cast<const File &>(*report.file)) {
+                const QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+                const QSharedPointer<Macro> macro = entry.isNull() ? element.dynamicCast<Macro>() : QSharedPointer<Macro>();
+                if (!entry.isNull()) {
+                    const auto it = entryPositions.constFind(entry->id().toLower());
+                    if (it == entryPositions.constEnd()) {
+                        entryPositions.insert(entry->id().toLower(), merged.count());
+                        merged.append(element);
+                        continue;
+                    }
+
+                    switch (options.duplicateIdPolicy) {
+                    case DuplicateIdPolicy::Rename: {
+                        QString newId;
+                        for (int i = 0; newId.isEmpty() || entryPositions.contains(newId.toLower()); ++i)
+                            newId = entry->id() + IdSuggestions::collisionSuffix(i);
+                        renamedIds.insert(entry->id().toLower(), newId);
+                        entry->setId(newId);
+                        entryPositions.insert(newId.toLower(), merged.count());
+                        merged.append(element);
+                        ++numRenamed;
+                        break;
+                    }
+                    case DuplicateIdPolicy::KeepFirst:
+                        ++numDropped;
+                        break;
+                    case DuplicateIdPolicy::KeepLast:
+                        merged[it.value()] = element;
+                        ++numReplaced;
+                        break;
+                    case DuplicateIdPolicy::KeepAll:
+                        merged.append(element);
+                        ++numDuplicates;
+                        break;
+                    case DuplicateIdPolicy::Fail:
+                        std::cerr << "Entry id '" << entry->id().toLocal8Bit().constData() << "' in " << report.inputFilename.toLocal8Bit().constData() << " is already used by another entry" << std::endl;
+                        return false;
+                    }
+                } else if (!macro.isNull()) {
+                    const auto it = macroPositions.constFind(macro->key().toLower());
+                    if (it == macroPositions.constEnd()) {
+                        macroPositions.insert(macro->key().toLower(), merged.count());
+                        merged.append(element);
+                    } else if (merged.at(it.value()).dynamicCast<Macro>()->value() == macro->value()) {
+                        /// Same definition in several files, keep only one
+                    } else if (options.duplicateIdPolicy == DuplicateIdPolicy::Fail) {
+                        std::cerr << "Macro '" << macro->key().toLocal8Bit().constData() << "' in " << report.inputFilename.toLocal8Bit().constData() << " is already defined differently" << std::endl;
+                        return false;
+                    } else if (options.duplicateIdPolicy == DuplicateIdPolicy::KeepLast)
+                        merged[it.value()] = element;
+                    else if (options.duplicateIdPolicy == DuplicateIdPolicy::KeepAll)
+                        merged.append(element);
+                    else
+                        std::cerr << "Macro '" << macro->key().toLocal8Bit().constData() << "' in " << report.inputFilename.toLocal8Bit().constData() << " is already defined differently, keeping first definition" << std::endl;
+                } else
+                    merged.append(element);
+            }
+
+            /// Cross-references inside the same file have to follow renamed entries
+            if (!renamedIds.isEmpty())
+                for (const QSharedPointer<Element> &element : const_cast<const File &>(*report.file)) {
+                    const QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+                    if (entry.isNull()) continue;
+                    const QString crossRef = PlainTextValue::text(entry->value(Entry::ftCrossRef));
+                    const auto it = renamedIds.constFind(crossRef.toLower());
+                    if (it != renamedIds.constEnd()) {
+                        entry->remove(Entry::ftCrossRef);
+                        entry->insert(Entry::ftCrossRef, Value() << QSharedPointer<VerbatimText>(new VerbatimText(it.value())));
+                    }
+                }
+        }
+
+        if (numRenamed > 0)
+            std::cerr << "Renamed " << numRenamed << " entries whose ids were already used" << std::endl;
+        if (numDropped > 0)
+            std::cerr << "Dropped " << numDropped << " entries whose ids were already used" << std::endl;
+        if (numReplaced > 0)
+            std::cerr << "Replaced " << numReplaced << " entries by later entries with the same id" << std::endl;
+        if (numDuplicates > 0)
+            std::cerr << "Kept " << numDuplicates << " entries with duplicate ids" << std::endl;
+        return true;
+    }
+
+    bool writeMerged(const File &merged) {
+        QScopedPointer<FileExporter> exporter;
+        QFile outputFile;
+        if (options.outputFilename.isEmpty()) {
+            /// Write BibTeX code directly to stdout instead of assembling a copy of it in memory first
+            FileExporterBibTeX *bibTeXExporter = new FileExporterBibTeX(nullptr);
+            bibTeXExporter->setEncoding(QStringLiteral("utf-8"));
+            exporter.reset(bibTeXExporter);
+            if (!outputFile.open(stdout, QFile::WriteOnly)) {
+                std::cerr << "Cannot write to stdout" << std::endl;
+                return false;
+            }
+        } else {
+            const QFileInfo outputFileInfo(options.outputFilename);
+            exporter.reset(FileExporter::factory(outputFileInfo, exporterClassHint(outputFileInfo, options.outputFormat), nullptr));
+            outputFile.setFileName(outputFileInfo.filePath());
+            if (!outputFile.open(QFile::WriteOnly)) {
+                std::cerr << "Cannot write to this file: " << outputFileInfo.filePath().toLocal8Bit().constData() << std::endl;
+                return false;
+            }
+        }
+
+        /// The exporter refuses to write empty output, but if all input
+        /// files are empty or failed to load, there is nothing to write
+        /// (failures got reported already)
+        const bool ok = merged.isEmpty() || exporter->save(&outputFile, &merged);
+        outputFile.close();
+        if (!ok)
+            std::cerr << "Failed to write merged bibliography" << std::endl;
+        return ok;
+    }
+
+    void printSummary(qint64 elapsedMilliseconds) const {
+        const auto formatMilliseconds = [](qint64 ms) {
+            return ms < 0 ? QStringLiteral("-") : QString::number(ms);
+        };
+
+        std::cerr << QString(QStringLiteral("%1 %2 %3 %4 %5  %6")).arg(QStringLiteral("Elements"), 8).arg(QStringLiteral("Load ms"), 8).arg(QStringLiteral("Ids ms"), 8).arg(QStringLiteral("Save ms"), 8).arg(QStringLiteral("Status"), 7).arg(QStringLiteral("File")).toLocal8Bit().constData() << std::endl;
+        int numFailed = 0, numElements = 0;
+        qint64 sumMilliseconds = 0;
+        for (const FileReport &report : reports) {
+            const bool ok = report.errorMessage.isEmpty();
+            if (!ok) ++numFailed;
+            numElements += report.numElements;
+            sumMilliseconds += qMax<qint64>(0, report.loadMilliseconds) + qMax<qint64>(0, report.processMilliseconds) + qMax<qint64>(0, report.saveMilliseconds);
+            std::cerr << QString(QStringLiteral("%1 %2 %3 %4 %5  %6")).arg(report.numElements, 8).arg(formatMilliseconds(report.loadMilliseconds), 8).arg(formatMilliseconds(report.processMilliseconds), 8).arg(formatMilliseconds(report.saveMilliseconds), 8).arg(ok ? QStringLiteral("ok") : QStringLiteral("failed"), 7).arg(report.inputFilename).toLocal8Bit().constData() << std::endl;
+        }
+        std::cerr << reports.count() << " files (" << numFailed << " failed), " << numElements << " elements, " << sumMilliseconds << " ms in workers, " << elapsedMilliseconds << " ms in total" << std::endl;
+    }
+};
+
+BatchConverter::BatchConverter(const Options &options)
+        : d(new BatchConverter::Private(options))
+{
+    /// nothing
+}
+
+BatchConverter::~BatchConverter()
+{
+    delete d;
+}
+
+int BatchConverter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!d->collectInputs())
+        return 1;
+    if (!d->options.outputDirectory.isEmpty() && !d->assignOutputFilenames())
+        return 1;
+
+    d->processAll();
+
+    int exitCode = 0;
+    for (const FileReport &report : const_cast<const QVector<FileReport> &>(d->reports))
+        if (!report.errorMessage.isEmpty()) {
+            std::cerr << report.inputFilename.toLocal8Bit().constData() << ": " << report.errorMessage.toLocal8Bit().constData() << std::endl;
+            exitCode = 1;
+        }
+
+    if (d->options.outputDirectory.isEmpty()) {
+        /// Files that failed to load are reported above, merge all others nevertheless
+        File merged;
+        if (!d->merge(merged) || !d->writeMerged(merged))
+            exitCode = 1;
+    }
+
+    if (d->options.printSummary)
+        d->printSummary(timer.elapsed());
+
+    return exitCode;
+}
+
+bool BatchConverter::duplicateIdPolicyFromString(const QString &text, DuplicateIdPolicy &policy)
+{
+    static const QHash<QString, DuplicateIdPolicy> policies {
+        {QStringLiteral("rename"), DuplicateIdPolicy::Rename},
+        {QStringLiteral("keep-first"), DuplicateIdPolicy::KeepFirst},
+        {QStringLiteral("keep-last"), DuplicateIdPolicy::KeepLast},
+        {QStringLiteral("keep-all"), DuplicateIdPolicy::KeepAll},
+        {QStringLiteral("fail"), DuplicateIdPolicy::Fail}
+    };
+    const auto it = policies.constFind(text.toLower());
+    if (it == policies.constEnd())
+        return false;
+    policy = it.value();
+    return true;
+}
+
+QString BatchConverter::exporterClassHint(const QFileInfo &outputFileInfo, const QString &outputFormat)
+{
+    if (outputFormat.isEmpty())
+        return QString();
+    const auto ec {FileExporter::exporterClasses(outputFileInfo)};
+    for (const QString &exporterClass : ec)
+        if (exporterClass.contains(outputFormat, Qt::CaseInsensitive))
+            return exporterClass;
+    return QString();
+}
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_PROGRAM_BATCHCONVERTER_H
+#define KBIBTEX_PROGRAM_BATCHCONVERTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFileInfo;
+
+/**
+ * Converts many bibliography files in one go for kbibtex-cli.
+ *
+ * Input files are loaded (and optionally re-keyed) in parallel. Then,
+ * either each file is written to an output directory on its own,
+ * or all files are merged in the order given into a single output file
+ * or stdout, resolving clashing entry ids as requested.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class BatchConverter
+{
+public:
+    /// How to handle an entry whose id was already used by an entry merged before
+    enum class DuplicateIdPolicy {
+        Rename, ///< Append a suffix 'a', 'b', ... to the later entry's id
+        KeepFirst, ///< Drop the later entry
+        KeepLast, ///< Replace the earlier entry by the later one
+        KeepAll, ///< Keep both entries, resulting in duplicate ids
+        Fail ///< Stop merging with an error
+    };
+
+    struct Options {
+        /// Files, directories, or wildcard patterns to read from
+        QStringList inputs;
+        /// File name patterns like '*.bib' to pick files from directories
+        QStringList nameFilters;
+        /// Descend into subdirectories of directories given as input
+        bool recursive;
+        /// If not empty, write each input file separately into this directory
+        QString outputDirectory;
+        /// Suffix for files written into 'outputDirectory', input file's suffix if empty
+        QString outputSuffix;
+        /// File to merge all inputs into, stdout if empty (and no 'outputDirectory' given)
+        QString outputFilename;
+        /// Part of the exporter's class name to prefer, e.g. 'bibtex' or 'ris'
+        QString outputFormat;
+        /// If not empty, re-key all entries in each file using this format string
+        QString formatIdString;
+        DuplicateIdPolicy duplicateIdPolicy;
+        /// Number of files to process in parallel, ideal number of threads if less than 1
+        int numJobs;
+        /// Print timings for each file to stderr when finished
+        bool printSummary;
+    };
+
+    explicit BatchConverter(const Options &options);
+    ~BatchConverter();
+
+    /**
+     * Perform the conversion as configured. Problems are reported on stderr.
+     * @return exit code for the program, 0 on success
+     */
+    int run();
+
+    static bool duplicateIdPolicyFromString(const QString &text, DuplicateIdPolicy &policy);
+
+    /**
+     * Determine the exporter class to use for a given output file, preferring
+     * classes whose name contains @p outputFormat (case-insensitive).
+     * @return the exporter class' name or an empty string to use the default
+     */
+    static QString exporterClassHint(const QFileInfo &outputFileInfo, const QString &outputFormat);
+
+private:
+    Q_DISABLE_COPY(BatchConverter)
+
+    class Private;
+    Private *const d;
+};
+
+#endif // KBIBTEX_PROGRAM_BATCHCONVERTER_H
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2022-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2022-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -21,16 +21,14 @@
 
 #include <QCoreApplication>
 #include <QCommandLineParser>
-#include <QSet>
 #include <QFile>
 #include <QFileInfo>
+#include <QRegularExpression>
 #include <QTimer>
 
 #include "kbibtex-version.h"
-#include <File>
-#include <FileImporter>
-#include <FileExporter>
-#include <FileExporterBibTeX>
+#include "batchconverter.h"
+#include "commandlineserver.h"
 #include <IdSuggestions>
 
 int main(int argc, char *argv[])
@@ -49,7 +47,31 @@ int main(int argc, char *argv[])
     cmdLineParser.addOption(outputformatCLI);
     QCommandLineOption idSuggestionFormatStringCLO{{QStringLiteral("format-id")}, QStringLiteral("Reformat all entry ids using this format string"), QStringLiteral("formatstring")};
     cmdLineParser.addOption(idSuggestionFormatStringCLO);
-    cmdLineParser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Read from this file"));
+    QCommandLineOption outputDirectoryCLO{{QStringLiteral("d"), QStringLiteral("output-directory")}, QStringLiteral("Write each input file separately into this directory instead of merging all input files"), QStringLiteral("directory")};
+    cmdLineParser.addOption(outputDirectoryCLO);
+    QCommandLineOption outputSuffixCLO{{QStringLiteral("output-suffix")}, QStringLiteral("Suffix for files written into the output directory, e.g. 'ris' (default: keep input file's suffix)"), QStringLiteral("suffix")};
+    cmdLineParser.addOption(outputSuffixCLO);
+    QCommandLineOption includeCLO{{QStringLiteral("include")}, QStringLiteral("Pattern for files to read from directories given as input, may be given multiple times (default: *.bib)"), QStringLiteral("pattern")};
+    cmdLineParser.addOption(includeCLO);
+    QCommandLineOption recursiveCLO{{QStringLiteral("r"), QStringLiteral("recursive")}, QStringLiteral("Read files from subdirectories of directories given as input, too")};
+    cmdLineParser.addOption(recursiveCLO);
+    QCommandLineOption jobsCLO{{QStringLiteral("j"), QStringLiteral("jobs")}, QStringLiteral("Number of input files to process in parallel (default: number of processor cores)"), QStringLiteral("number")};
+    cmdLineParser.addOption(jobsCLO);
+    QCommandLineOption duplicateIdCLO{{QStringLiteral("on-duplicate-id")}, QStringLiteral("When merging several input files, how to handle entries with an already used id: rename, keep-first, keep-last, keep-all, or fail (default: rename)"), QStringLiteral("policy")};
+    cmdLineParser.addOption(duplicateIdCLO);
+    QCommandLineOption summaryCLO{{QStringLiteral("summary")}, QStringLiteral("When processing several input files, print the time spent on each file")};
+    cmdLineParser.addOption(summaryCLO);
+    QCommandLineOption validateCLO{{QStringLiteral("validate")}, QStringLiteral("Check entries for missing required fields, duplicate ids, or dangling cross-references, and with BibTeX if available, instead of converting")};
+    cmdLineParser.addOption(validateCLO);
+    QCommandLineOption findDuplicatesCLO{{QStringLiteral("find-duplicates")}, QStringLiteral("List groups of entries with the same DOI or the same title and year instead of converting")};
+    cmdLineParser.addOption(findDuplicatesCLO);
+    QCommandLineOption serverCLO{{QStringLiteral("server")}, QStringLiteral("Keep running and process requests sent by other kbibtex-cli processes using  --connect")};
+    cmdLineParser.addOption(serverCLO);
+    QCommandLineOption connectCLO{{QStringLiteral("connect")}, QStringLiteral("Let a running  kbibtex-cli --server  process the single input file, falling back to processing it locally")};
+    cmdLineParser.addOption(connectCLO);
+    QCommandLineOption socketCLO{{QStringLiteral("socket")}, QStringLiteral("Name of the local socket used by  --server  and  --connect  (default: %1)").arg(CommandLineServer::defaultServerName()), QStringLiteral("name")};
+    cmdLineParser.addOption(socketCLO);
+    cmdLineParser.addPositionalArgument(QStringLiteral("files"), QStringLiteral("Read from these files, directories, or wildcard patterns; multiple inputs get merged unless an output directory is given"), QStringLiteral("file [files...]"));
 
     cmdLineParser.process(coreApp);
 
@@ -60,104 +82,119 @@ int main(int argc, char *argv[])
         if (pa.length() > 0)
             arguments.append(pa);
 
+    /// Several inputs, a directory, or an unexpanded wildcard pattern get processed in batch mode
+    const bool batchMode {arguments.length() > 1 || cmdLineParser.isSet(outputDirectoryCLO) || (arguments.length() == 1 && (QFileInfo(arguments.constFirst()).isDir() || (!QFileInfo::exists(arguments.constFirst()) && arguments.constFirst().contains(QRegularExpression(QStringLiteral("[*?[]"))))))};
+
+    const QString serverName {cmdLineParser.isSet(socketCLO) ? cmdLineParser.value(socketCLO) : CommandLineServer::defaultServerName()};
+
+    if (cmdLineParser.isSet(serverCLO)) {
+        if (!arguments.isEmpty()) {
+            std::cerr << "No files may be given when running as server" << std::endl;
+            return 1;
+        }
+        CommandLineServer server;
+        if (!server.listen(serverName))
+            return 1;
+        std::cerr << "Listening on " << serverName.toLocal8Bit().constData() << std::endl;
+        return coreApp.exec();
+    }
+
     if (arguments.length() < 1) {
         std::cerr << "No file to read from specified. Use  --help  for instructions." << std::endl;
         coreApp.exit(exitCode = 1);
-    } else if (arguments.length() > 1) {
-        std::cerr << "More than one input file specified. Use  --help  for instructions." << std::endl;
+    } else if (batchMode && (cmdLineParser.isSet(connectCLO) || cmdLineParser.isSet(validateCLO) || cmdLineParser.isSet(findDuplicatesCLO))) {
+        std::cerr << "Options  --connect,  --validate, and  --find-duplicates  accept a single input file only" << std::endl;
         coreApp.exit(exitCode = 1);
+    } else if (batchMode) {
+        BatchConverter::Options options;
+        options.inputs = QStringList(arguments.constBegin(), arguments.constEnd());
+        options.nameFilters = cmdLineParser.isSet(includeCLO) ? cmdLineParser.values(includeCLO) : QStringList {QStringLiteral("*.bib")};
+        options.recursive = cmdLineParser.isSet(recursiveCLO);
+        options.outputDirectory = cmdLineParser.value(outputDirectoryCLO);
+        options.outputSuffix = cmdLineParser.value(outputSuffixCLO);
+        options.outputFilename = options.outputDirectory.isEmpty() ? cmdLineParser.value(outputFileCLO) : QString();
+        options.outputFormat = cmdLineParser.value(outputformatCLI);
+        options.formatIdString = cmdLineParser.value(idSuggestionFormatStringCLO);
+        options.duplicateIdPolicy = BatchConverter::DuplicateIdPolicy::Rename;
+        options.numJobs = 0;
+        options.printSummary = cmdLineParser.isSet(summaryCLO);
+
+        bool ok = true;
+        if (cmdLineParser.isSet(jobsCLO)) {
+            options.numJobs = cmdLineParser.value(jobsCLO).toInt(&ok);
+            if (!ok || options.numJobs < 1) {
+                std::cerr << "Number of jobs must be a positive number" << std::endl;
+                ok = false;
+            }
+        }
+        if (ok && cmdLineParser.isSet(duplicateIdCLO) && !BatchConverter::duplicateIdPolicyFromString(cmdLineParser.value(duplicateIdCLO), options.duplicateIdPolicy)) {
+            std::cerr << "Unknown policy for duplicate ids: " << cmdLineParser.value(duplicateIdCLO).toLocal8Bit().constData() << std::endl;
+            ok = false;
+        }
+        if (ok && cmdLineParser.isSet(outputDirectoryCLO) && cmdLineParser.isSet(outputFileCLO)) {
+            std::cerr << "Either an output file or an output directory may be specified, but not both" << std::endl;
+            ok = false;
+        }
+        if (ok && cmdLineParser.isSet(idSuggestionFormatStringCLO) && options.formatIdString.isEmpty()) {
+            std::cerr << "Got empty format string" << std::endl;
+            ok = false;
+        }
+
+        if (ok) {
+            if (!options.formatIdString.isEmpty()) {
+                std::cerr << "Using the following format string:" << std::endl;
+                const auto fsth {IdSuggestions::formatStrToHuman(options.formatIdString)};
+                for (const QString &fse : fsth)
+                    std::cerr << " * " << fse.toLocal8Bit().constData() << std::endl;
+            }
+            BatchConverter batchConverter(options);
+            exitCode = batchConverter.run();
+        } else
+            exitCode = 1;
+        coreApp.exit(exitCode);
     } else {
-        const QFileInfo inputFileInfo{arguments.constFirst()};
-        if (!inputFileInfo.exists() || inputFileInfo.size() <= 0 || !inputFileInfo.isFile() || !inputFileInfo.isReadable()) {
-            std::cerr << "Argument is not an existing, readable, non-empty file: " << inputFileInfo.filePath().toLocal8Bit().constData() << std::endl;
+        CommandLineServer::Request request;
+        if (cmdLineParser.isSet(validateCLO))
+            request.command = CommandLineServer::Command::Validate;
+        else if (cmdLineParser.isSet(findDuplicatesCLO))
+            request.command = CommandLineServer::Command::FindDuplicates;
+        else
+            request.command = cmdLineParser.isSet(idSuggestionFormatStringCLO) ? CommandLineServer::Command::FormatIds : CommandLineServer::Command::Convert;
+        /// Server may run in a different working directory
+        request.inputFilename = QFileInfo(arguments.constFirst()).absoluteFilePath();
+        request.outputFilename = cmdLineParser.isSet(outputFileCLO) ? QFileInfo(cmdLineParser.value(outputFileCLO)).absoluteFilePath() : QString();
+        request.outputFormat = cmdLineParser.value(outputformatCLI).toLower();
+        request.formatIdString = cmdLineParser.value(idSuggestionFormatStringCLO);
+
+        if (request.command == CommandLineServer::Command::FormatIds && !request.formatIdString.isEmpty()) {
+            std::cerr << "Using the following format string:" << std::endl;
+            const auto fsth {IdSuggestions::formatStrToHuman(request.formatIdString)};
+            for (const QString &fse : fsth)
+                std::cerr << " * " << fse.toLocal8Bit().constData() << std::endl;
+        }
+
+        QFile stdoutFile;
+        if (!stdoutFile.open(stdout, QFile::WriteOnly)) {
+            std::cerr << "Cannot write to stdout" << std::endl;
             coreApp.exit(exitCode = 1);
         } else {
-            QFile inputFile(inputFileInfo.filePath());
-            if (inputFile.open(QFile::ReadOnly)) {
-                FileImporter *importer = FileImporter::factory(inputFileInfo, &coreApp);
-                File *file = importer->load(&inputFile);
-                inputFile.close();
-
-                if (file == nullptr) {
-                    std::cerr << "Failed to load file: " << inputFileInfo.filePath().toLocal8Bit().constData() << std::endl;
-                    coreApp.exit(exitCode = 1);
-                } else {
-                    if (cmdLineParser.isSet(idSuggestionFormatStringCLO)) {
-                        /// If the user requested applying a certain format string to all entry ids, perform this change here.
-                        QSet<QString> previousNewId; //< Track newly generated entry ids to detect duplicates
-                        const QString formatString{cmdLineParser.value(idSuggestionFormatStringCLO)}; //< extract format string from command line argument
-                        if (formatString.isEmpty()) {
-                            std::cerr << "Got empty format string" << std::endl;
-                            coreApp.exit(exitCode = 1);
-                        } else {
-                            std::cerr << "Using the following format string:" << std::endl;
-                            const auto fsth {IdSuggestions::formatStrToHuman(formatString)};
-                            for (const QString &fse : fsth)
-                                std::cerr << " * " << fse.toLocal8Bit().constData() << std::endl;
-                            for (QSharedPointer<Element> &element : *file) {
-                                /// For every element in the loaded bibliography file ...
-                                /// Check if element is an entry (something that has an 'id')
-                                QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
-                                if (!entry.isNull()) {
-                                    /// Generate new id based on entry and format string
-                                    const QString newId{IdSuggestions::formatId(*(entry.data()), formatString)};
-                                    if (newId.isEmpty()) {
-                                        std::cerr << "New id generated from entry '" << entry->id().toLocal8Bit().constData() << "' and format string '" << formatString.toLocal8Bit().constData() << "' is empty." << std::endl;
-                                        coreApp.exit(exitCode = 1);
-                                        break;
-                                    }
-                                    if (previousNewId.contains(newId))
-                                        std::cerr << "New entry id '" << newId.toLocal8Bit().constData() << "' generated from entry '" << entry->id().toLocal8Bit().constData() << "' and format string '" << formatString.toLocal8Bit().constData() << "' matches a previously generated id, but applying it anyway." << std::endl;
-                                    else
-                                        previousNewId.insert(newId);
-                                    /// Apply newly-generated entry id
-                                    entry->setId(newId);
-                                }
-                            }
-                        }
-                    }
-
-                    if (exitCode == 0) {
-                        if (cmdLineParser.isSet(outputFileCLO)) {
-                            const QFileInfo outputFileInfo{cmdLineParser.value(outputFileCLO)};
-                            QFile outputfile(outputFileInfo.filePath());
-                            if (outputfile.open(QFile::WriteOnly)) {
-                                QString exporterClassHint;
-                                if (cmdLineParser.isSet(outputformatCLI)) {
-                                    const QString cmpTo = cmdLineParser.value(outputformatCLI).toLower();
-                                    const auto ec {FileExporter::exporterClasses(outputFileInfo)};
-                                    for (const QString &exporterClass : ec)
-                                        if (exporterClass.contains(cmpTo, Qt::CaseInsensitive)) {
-                                            exporterClassHint = exporterClass;
-                                            std::cerr << "Choosing exporter " << exporterClassHint.toLocal8Bit().constData() << " based on --output-format=" << cmpTo.toLocal8Bit().constData() << std::endl;
-                                            break;
-                                        }
-                                }
-                                FileExporter *exporter = FileExporter::factory(outputFileInfo, exporterClassHint, &coreApp);
-                                const bool ok = exporter->save(&outputfile, file);
-                                outputfile.close();
-                                if (!ok) {
-                                    std::cerr << "Failed to write to this file: " << outputFileInfo.filePath().toLocal8Bit().constData() << std::endl;
-                                    coreApp.exit(exitCode = 1);
-                                }
-                            } else {
-                                std::cerr << "Cannot write to this file: " << outputFileInfo.filePath().toLocal8Bit().constData() << std::endl;
-                                coreApp.exit(exitCode = 1);
-                            }
-                        } else {
-                            /// No output filename specified, so dump BibTeX code to stdout
-                            FileExporter *exporter = new FileExporterBibTeX(&coreApp);
-                            const QString output{exporter->toString(file)};
-                            std::cout << output.toLocal8Bit().constData() << std::endl;
-                        }
-                    }
-
-                    delete file;
-                }
-            } else {
-                std::cerr << "Cannot read from file '" << inputFileInfo.filePath().toLocal8Bit().constData() << "'" << std::endl;
-                coreApp.exit(exitCode = 1);
+            CommandLineServer::Reply reply;
+            if (!cmdLineParser.isSet(connectCLO) || !CommandLineServer::sendRequest(serverName, request, reply)) {
+                if (cmdLineParser.isSet(connectCLO))
+                    std::cerr << "No server reachable on " << serverName.toLocal8Bit().constData() << ", processing locally" << std::endl;
+                /// Processing locally, BibTeX code can be written to stdout
+                /// without keeping another copy of the complete output in memory
+                reply = CommandLineServer::process(request, &stdoutFile);
+            }
+
+            for (const QString &message : const_cast<const QStringList &>(reply.messages))
+                std::cerr << message.toLocal8Bit().constData() << std::endl;
+            if (!reply.output.isEmpty() && stdoutFile.write(reply.output) != reply.output.size()) {
+                std::cerr << "Failed to write to stdout" << std::endl;
+                reply.exitCode = qMax(reply.exitCode, 1);
             }
+            stdoutFile.close();
+            coreApp.exit(exitCode = reply.exitCode);
         }
     }
 
@@ -0,0 +1,557 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "commandlineserver.h"
+
+#include <iostream>
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+
+#include <BibTeXEntries>
+#include <BibTeXFields>
+#include <Entry>
+#include <File>
+#include <Value>
+#include <EncoderLaTeX>
+#include <FileImporter>
+#include <FileExporter>
+#include <FileExporterBibTeX>
+#include <IdSuggestions>
+#include <CheckBibTeX>
+#include "batchconverter.h"
+
+/// 'KBCS', identifies messages between kbibtex-cli processes
+static const quint32 protocolMagic = 0x4b424353;
+/// To be increased whenever the message layout changes
+static const quint16 protocolVersion = 1;
+
+static void writeFrame(QIODevice *device, const QByteArray &payload)
+{
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_5_14);
+    stream << payload;
+}
+
+/// @return true if a complete frame was available, false if more data has to arrive first
+static bool readFrame(QIODevice *device, QByteArray &payload)
+{
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_5_14);
+    stream.startTransaction();
+    stream >> payload;
+    return stream.commitTransaction();
+}
+
+static QString commandName(CommandLineServer::Command command)
+{
+    switch (command) {
+    case CommandLineServer::Command::Convert: return QStringLiteral("convert");
+    case CommandLineServer::Command::FormatIds: return QStringLiteral("format-ids");
+    case CommandLineServer::Command::Validate: return QStringLiteral("validate");
+    case CommandLineServer::Command::FindDuplicates: return QStringLiteral("find-duplicates");
+    }
+    return QString();
+}
+
+class RequestRunnable : public QRunnable
+{
+public:
+    RequestRunnable(CommandLineServer *_server, QLocalSocket *_socket, const CommandLineServer::Request &_request, const CheckBibTeX::Settings &_checkSettings)
+            : server(_server), socket(_socket), request(_request), checkSettings(_checkSettings) {
+        /// nothing
+    }
+
+    void run() override {
+        QElapsedTimer timer;
+        timer.start();
+        const QByteArray payload = CommandLineServer::encodeReply(CommandLineServer::process(request, checkSettings));
+        /// Single write, so that lines of concurrent requests do not get mixed up
+        std::cerr << QString(QStringLiteral("Processed %1 request for %2 in %3 ms\n")).arg(commandName(request.command), request.inputFilename).arg(timer.elapsed()).toLocal8Bit().constData() << std::flush;
+
+        QPointer<QLocalSocket> guardedSocket = socket;
+        QMetaObject::invokeMethod(server, [guardedSocket, payload]() {
+            /// Client may have gone away in the meantime
+            if (guardedSocket.isNull()) return;
+            writeFrame(guardedSocket.data(), payload);
+            guardedSocket->disconnectFromServer();
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    CommandLineServer *const server;
+    QPointer<QLocalSocket> socket;
+    const CommandLineServer::Request request;
+    const CheckBibTeX::Settings checkSettings;
+};
+
+class CommandLineServer::Private
+{
+private:
+    CommandLineServer *p;
+
+public:
+    QLocalServer server;
+    QThreadPool pool;
+    /// Read from the preferences in the main thread when starting to listen
+    CheckBibTeX::Settings checkSettings;
+
+    Private(CommandLineServer *parent)
+            : p(parent) {
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+        QObject::connect(&server, &QLocalServer::newConnection, p, [this]() {
+            newConnection();
+        });
+    }
+
+    ~Private() {
+        server.close();
+        pool.waitForDone();
+    }
+
+    void newConnection() {
+        while (server.hasPendingConnections()) {
+            QLocalSocket *socket = server.nextPendingConnection();
+            QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            QObject::connect(socket, &QLocalSocket::readyRead, p, [this, socket]() {
+                readRequest(socket);
+            });
+        }
+    }
+
+    void readRequest(QLocalSocket *socket) {
+        QByteArray payload;
+        if (!readFrame(socket, payload))
+            return; ///< wait for the remainder of the request
+
+        /// Only one request per connection
+        QObject::disconnect(socket, &QLocalSocket::readyRead, p, nullptr);
+
+        Request request;
+        if (!decodeRequest(payload, request)) {
+            writeFrame(socket, encodeReply(Reply {2, QByteArray(), {QStringLiteral("Malformed request or incompatible version of kbibtex-cli")}}));
+            socket->disconnectFromServer();
+            return;
+        }
+        pool.start(new RequestRunnable(p, socket, request, checkSettings));
+    }
+
+    static bool convert(const Request &request, File &file, Reply &reply, QIODevice *standardOutput) {
+        if (request.command == Command::FormatIds && request.formatIdString.isEmpty()) {
+            reply.messages.append(QStringLiteral("Got empty format string"));
+            return false;
+        }
+        if (!request.formatIdString.isEmpty()) {
+            /// Generate new ids for all entries, making duplicates unique by appending suffixes
+            const IdSuggestions::BulkFormatIdResult result{IdSuggestions::applyFormatId(file, request.formatIdString)};
+            reply.messages.append(QString(QStringLiteral("Changed %1 entry ids in %2 ms")).arg(result.changedIds).arg(result.elapsedMilliseconds));
+            if (result.resolvedCollisions > 0)
+                reply.messages.append(QString(QStringLiteral("%1 generated ids matched previously generated ids and got a suffix appended")).arg(result.resolvedCollisions));
+            if (result.emptyIds > 0) {
+                reply.messages.append(QString(QStringLiteral("New ids generated from %1 entries and format string '%2' are empty.")).arg(result.emptyIds).arg(request.formatIdString));
+                return false;
+            }
+        }
+
+        if (request.outputFilename.isEmpty()) {
+            /// No output filename specified, so write BibTeX code to stdout
+            /// if possible, otherwise send it back as part of the reply
+            FileExporterBibTeX exporter(nullptr);
+            exporter.setEncoding(QStringLiteral("utf-8"));
+            QBuffer buffer(&reply.output);
+            QIODevice *device = standardOutput;
+            if (device == nullptr) {
+                buffer.open(QBuffer::WriteOnly);
+                device = &buffer;
+            }
+            /// The exporter refuses to write empty output, but
+            /// an empty bibliography is nothing to complain about
+            if (!file.isEmpty() && !exporter.save(device, &file)) {
+                reply.messages.append(QStringLiteral("Failed to write BibTeX code"));
+                return false;
+            }
+            return true;
+        }
+
+        const QFileInfo outputFileInfo(request.outputFilename);
+        const QString exporterClassHint = BatchConverter::exporterClassHint(outputFileInfo, request.outputFormat);
+        if (!exporterClassHint.isEmpty())
+            reply.messages.append(QString(QStringLiteral("Choosing exporter %1 based on --output-format=%2")).arg(exporterClassHint, request.outputFormat));
+        QFile outputFile(outputFileInfo.filePath());
+        if (!outputFile.open(QFile::WriteOnly)) {
+            reply.messages.append(QStringLiteral("Cannot write to this file: ") + outputFileInfo.filePath());
+            return false;
+        }
+        QScopedPointer<FileExporter> exporter(FileExporter::factory(outputFileInfo, exporterClassHint, nullptr));
+        const bool ok = exporter->save(&outputFile, &file);
+        outputFile.close();
+        if (!ok)
+            reply.messages.append(QStringLiteral("Failed to write to this file: ") + outputFileInfo.filePath());
+        return ok;
+    }
+
+    /// Diagnostics from BibTeX may contain rich text markup, unsuitable for a terminal
+    static QString toPlainText(const QString &richText) {
+        static const QRegularExpression tag(QStringLiteral("<[^>]*>"));
+        QString text = richText;
+        text.remove(tag);
+        return text.replace(QStringLiteral("&lt;"), QStringLiteral("<")).replace(QStringLiteral("&gt;"), QStringLiteral(">")).replace(QStringLiteral("&quot;"), QStringLiteral("\"")).replace(QStringLiteral("&amp;"), QStringLiteral("&"));
+    }
+
+    static bool validate(const File &file, const CheckBibTeX::Settings &checkSettings, Reply &reply) {
+        static const QRegularExpression alternativesSeparator(QStringLiteral("[|^]"));
+
+        QHash<QString, const EntryDescription *> entryDescriptions;
+        for (const EntryDescription &ed : BibTeXEntries::instance())
+            entryDescriptions.insert(ed.upperCamelCase.toLower(), &ed);
+
+        /// BibTeX treats ids case-insensitively
+        QHash<QString, QString> lowerCaseIds;
+        for (const QSharedPointer<Element> &element : file) {
+            const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+            if (!entry.isNull() && !entry->id().isEmpty() && !lowerCaseIds.contains(entry->id().toLower()))
+                lowerCaseIds.insert(entry->id().toLower(), entry->id());
+        }
+
+        /// Checks of the whole bibliography at once, independent of
+        /// BibTeX being available, and without BibTeX's limitations
+        int numProblems = 0, position = 0;
+        QSet<QString> seenLowerCaseIds;
+        for (const QSharedPointer<Element> &element : file) {
+            ++position;
+            const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+            if (entry.isNull()) continue;
+
+            const QString id = entry->id();
+            if (id.isEmpty()) {
+                reply.messages.append(QString(QStringLiteral("Entry #%1 of type '%2' has no id")).arg(position).arg(entry->type()));
+                ++numProblems;
+            } else if (seenLowerCaseIds.contains(id.toLower())) {
+                reply.messages.append(QString(QStringLiteral("Entry '%1': id is already used by entry '%2'")).arg(id, lowerCaseIds.value(id.toLower())));
+                ++numProblems;
+            } else
+                seenLowerCaseIds.insert(id.toLower());
+
+            const QString crossRef = PlainTextValue::text(entry->value(Entry::ftCrossRef));
+            if (!crossRef.isEmpty() && !lowerCaseIds.contains(crossRef.toLower())) {
+                reply.messages.append(QString(QStringLiteral("Entry '%1': cross-referenced entry '%2' does not exist")).arg(id, crossRef));
+                ++numProblems;
+            }
+
+            const auto edIt = entryDescriptions.constFind(entry->type().toLower());
+            if (edIt == entryDescriptions.constEnd()) continue;
+            /// Fields may be inherited from cross-referenced entries
+            const QSharedPointer<const Entry> resolvedEntry = crossRef.isEmpty() ? entry : entry->resolveCrossref(&file);
+            for (const QString &requiredItem : edIt.value()->requiredItems) {
+                const QStringList alternatives = requiredItem.trimmed().split(alternativesSeparator);
+                bool found = false;
+                for (const QString &fieldName : alternatives)
+                    if (!PlainTextValue::text(resolvedEntry->value(fieldName)).isEmpty()) {
+                        found = true;
+                        break;
+                    }
+                if (!found) {
+                    reply.messages.append(QString(QStringLiteral("Entry '%1': required field '%2' is missing")).arg(id, alternatives.join(QStringLiteral("' or '"))));
+                    ++numProblems;
+                }
+            }
+        }
+
+        /// Additionally let BibTeX check the bibliography in a single run,
+        /// as it will have to process it eventually. This request already
+        /// runs in a worker thread, so neither a model with its own event
+        /// loop nor further threads are used here
+        QVector<CheckBibTeX::Diagnostic> diagnostics;
+        const CheckBibTeX::CheckBibTeXResult result = CheckBibTeX::checkBibTeX(&file, checkSettings, diagnostics);
+        if (result == CheckBibTeX::CheckBibTeXResult::FailedToCheck)
+            reply.messages.append(QStringLiteral("Running BibTeX failed, so only ids, cross-references, and required fields were checked"));
+        else
+            for (const CheckBibTeX::Diagnostic &diagnostic : const_cast<const QVector<CheckBibTeX::Diagnostic> &>(diagnostics)) {
+                const QString severity = diagnostic.severity == CheckBibTeX::Diagnostic::Severity::Error ? QStringLiteral("Error") : QStringLiteral("Warning");
+                const QString message = toPlainText(diagnostic.message);
+                if (diagnostic.id.isEmpty())
+                    reply.messages.append(QString(QStringLiteral("BibTeX: %1: %2")).arg(severity, message));
+                else
+                    reply.messages.append(QString(QStringLiteral("Entry '%1': BibTeX: %2: %3")).arg(diagnostic.id, severity, message));
+                ++numProblems;
+            }
+
+        reply.messages.append(QString(QStringLiteral("Found %1 problems")).arg(numProblems));
+        return numProblems == 0;
+    }
+
+    static void findDuplicates(const File &file, Reply &reply) {
+        QVector<QSharedPointer<const Entry>> entries;
+        entries.reserve(file.count());
+        for (const QSharedPointer<Element> &element : file) {
+            const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+            if (!entry.isNull())
+                entries.append(entry);
+        }
+
+        /// Union-find over entries sharing a DOI or the same title in the same year
+        QVector<int> parent(entries.count());
+        for (int i = 0; i < parent.count(); ++i)
+            parent[i] = i;
+        const auto root = [&parent](int i) {
+            while (parent[i] != i)
+                i = parent[i] = parent[parent[i]];
+            return i;
+        };
+
+        QHash<QString, int> firstEntryForKey;
+        for (int i = 0; i < entries.count(); ++i) {
+            QStringList keys;
+            const QString doi = PlainTextValue::text(entries[i]->value(Entry::ftDOI)).trimmed().toLower();
+            if (!doi.isEmpty())
+                keys.append(QStringLiteral("doi:") + doi);
+            /// Ignore casing, punctuation, or spacing in titles
+            const QString title = PlainTextValue::text(entries[i]->value(Entry::ftTitle));
+            QString normalizedTitle;
+            normalizedTitle.reserve(title.length());
+            for (const QChar &c : title)
+                if (c.isLetterOrNumber())
+                    normalizedTitle.append(c.toLower());
+            if (!normalizedTitle.isEmpty())
+                keys.append(QStringLiteral("title:") + normalizedTitle + QStringLiteral(":") + PlainTextValue::text(entries[i]->value(Entry::ftYear)));
+
+            for (const QString &key : const_cast<const QStringList &>(keys)) {
+                const auto it = firstEntryForKey.constFind(key);
+                if (it == firstEntryForKey.constEnd())
+                    firstEntryForKey.insert(key, i);
+                else
+                    parent[root(i)] = root(it.value());
+            }
+        }
+
+        /// Groups ordered by their first entry's position in the file
+        QHash<int, int> groupForRoot;
+        QVector<QStringList> groups;
+        for (int i = 0; i < entries.count(); ++i) {
+            const int r = root(i);
+            auto it = groupForRoot.find(r);
+            if (it == groupForRoot.end()) {
+                it = groupForRoot.insert(r, groups.count());
+                groups.append(QStringList());
+            }
+            groups[it.value()].append(entries[i]->id());
+        }
+
+        int numGroups = 0;
+        for (const QStringList &group : const_cast<const QVector<QStringList> &>(groups))
+            if (group.count() > 1) {
+                /// One line per group of possible duplicates, listing their ids
+                reply.output.append(group.join(QLatin1Char(' ')).toUtf8()).append('\n');
+                ++numGroups;
+            }
+        reply.messages.append(QString(QStringLiteral("Found %1 groups of possible duplicates among %2 entries")).arg(numGroups).arg(entries.count()));
+    }
+};
+
+CommandLineServer::CommandLineServer(QObject *parent)
+        : QObject(parent), d(new CommandLineServer::Private(this))
+{
+    /// nothing
+}
+
+CommandLineServer::~CommandLineServer()
+{
+    delete d;
+}
+
+bool CommandLineServer::listen(const QString &serverName)
+{
+    {
+        QLocalSocket probe;
+        probe.connectToServer(serverName);
+        if (probe.waitForConnected(1000)) {
+            std::cerr << "Another server is already listening on " << serverName.toLocal8Bit().constData() << std::endl;
+            return false;
+        }
+    }
+    /// Remove socket left behind by a server that did not shut down properly
+    QLocalServer::removeServer(serverName);
+
+    /// Requests may read and write any of the user's files, so do not accept other users
+    d->server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!d->server.listen(serverName)) {
+        std::cerr << "Cannot listen on " << serverName.toLocal8Bit().constData() << ": " << d->server.errorString().toLocal8Bit().constData() << std::endl;
+        return false;
+    }
+
+    /// Initialize singletons now instead of during the first request
+    EncoderLaTeX::instance();
+    BibTeXEntries::instance();
+    BibTeXFields::instance();
+    d->checkSettings = CheckBibTeX::settingsFromPreferences();
+
+    return true;
+}
+
+QString CommandLineServer::defaultServerName()
+{
+    QString userName = qEnvironmentVariable("USER");
+    if (userName.isEmpty())
+        userName = qEnvironmentVariable("USERNAME");
+    return QStringLiteral("kbibtex-cli-") + userName;
+}
+
+CommandLineServer::Reply CommandLineServer::process(const Request &request, QIODevice *standardOutput)
+{
+    return process(request, CheckBibTeX::settingsFromPreferences(), standardOutput);
+}
+
+CommandLineServer::Reply CommandLineServer::process(const Request &request, const CheckBibTeX::Settings &checkSettings, QIODevice *standardOutput)
+{
+    Reply reply {0, QByteArray(), QStringList()};
+
+    const QFileInfo inputFileInfo(request.inputFilename);
+    if (!inputFileInfo.exists() || inputFileInfo.size() <= 0 || !inputFileInfo.isFile() || !inputFileInfo.isReadable()) {
+        reply.messages.append(QStringLiteral("Argument is not an existing, readable, non-empty file: ") + inputFileInfo.filePath());
+        reply.exitCode = 1;
+        return reply;
+    }
+    QFile inputFile(inputFileInfo.filePath());
+    if (!inputFile.open(QFile::ReadOnly)) {
+        reply.messages.append(QStringLiteral("Cannot read from file '") + inputFileInfo.filePath() + QStringLiteral("'"));
+        reply.exitCode = 1;
+        return reply;
+    }
+
+    QScopedPointer<FileImporter> importer(FileImporter::factory(inputFileInfo, nullptr));
+    int numImportErrors = 0;
+    if (request.command == Command::Validate)
+        QObject::connect(importer.data(), &FileImporter::message, [&reply, &numImportErrors](const FileImporter::MessageSeverity severity, const QString &messageText) {
+            if (severity == FileImporter::MessageSeverity::Info) return;
+            reply.messages.append(messageText);
+            if (severity == FileImporter::MessageSeverity::Error)
+                ++numImportErrors;
+        });
+    QScopedPointer<File> file(importer->load(&inputFile));
+    inputFile.close();
+    if (file.isNull()) {
+        reply.messages.append(QStringLiteral("Failed to load file: ") + inputFileInfo.filePath());
+        reply.exitCode = 1;
+        return reply;
+    }
+
+    switch (request.command) {
+    case Command::Convert:
+    case Command::FormatIds:
+        if (!Private::convert(request, *file, reply, standardOutput))
+            reply.exitCode = 1;
+        break;
+    case Command::Validate:
+        if (!Private::validate(*file, checkSettings, reply) || numImportErrors > 0)
+            reply.exitCode = 1;
+        break;
+    case Command::FindDuplicates:
+        Private::findDuplicates(*file, reply);
+        break;
+    }
+
+    return reply;
+}
+
+bool CommandLineServer::sendRequest(const QString &serverName, const Request &request, Reply &reply, int timeoutMilliseconds)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected(qMin(timeoutMilliseconds, 5000)))
+        return false;
+
+    writeFrame(&socket, encodeRequest(request));
+    while (socket.bytesToWrite() > 0)
+        if (!socket.waitForBytesWritten(qMax<int>(1, timeoutMilliseconds - timer.elapsed())))
+            return false;
+
+    QByteArray payload;
+    while (!readFrame(&socket, payload)) {
+        const int remainingMilliseconds = timeoutMilliseconds - static_cast<int>(timer.elapsed());
+        if (remainingMilliseconds <= 0 || !socket.waitForReadyRead(remainingMilliseconds))
+            return false;
+    }
+    return decodeReply(payload, reply);
+}
+
+QByteArray CommandLineServer::encodeRequest(const Request &request)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_14);
+    stream << protocolMagic << protocolVersion << static_cast<qint32>(request.command) << request.inputFilename << request.outputFilename << request.outputFormat << request.formatIdString;
+    return data;
+}
+
+bool CommandLineServer::decodeRequest(const QByteArray &data, Request &request)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_14);
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != protocolMagic || version != protocolVersion)
+        return false;
+    qint32 command = 0;
+    stream >> command >> request.inputFilename >> request.outputFilename >> request.outputFormat >> request.formatIdString;
+    if (stream.status() != QDataStream::Ok || command < static_cast<qint32>(Command::Convert) || command > static_cast<qint32>(Command::FindDuplicates))
+        return false;
+    request.command = static_cast<Command>(command);
+    return true;
+}
+
+QByteArray CommandLineServer::encodeReply(const Reply &reply)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_14);
+    stream << protocolMagic << protocolVersion << static_cast<qint32>(reply.exitCode) << reply.output << reply.messages;
+    return data;
+}
+
+bool CommandLineServer::decodeReply(const QByteArray &data, Reply &reply)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_14);
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != protocolMagic || version != protocolVersion)
+        return false;
+    qint32 exitCode = 0;
+    stream >> exitCode >> reply.output >> reply.messages;
+    reply.exitCode = exitCode;
+    return stream.status() == QDataStream::Ok;
+}
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef KBIBTEX_PROGRAM_COMMANDLINESERVER_H
+#define KBIBTEX_PROGRAM_COMMANDLINESERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QStringList>
+
+#include <CheckBibTeX>
+
+class QIODevice;
+
+/**
+ * Keeps kbibtex-cli running to serve requests from other kbibtex-cli
+ * processes through a local socket, saving repeated start-up costs like
+ * loading the configuration or building the LaTeX encoder's tables.
+ *
+ * Each connection carries exactly one request and its reply, both sent as
+ * a QByteArray through a QDataStream. Requests are processed in parallel
+ * on a thread pool.
+ *
+ * @author Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ */
+class CommandLineServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Command {
+        Convert = 1, ///< Write the input file in the requested format
+        FormatIds = 2, ///< Like Convert, but re-key all entries first
+        Validate = 3, ///< Check entries for missing required fields, duplicate ids, or dangling cross-references, and with BibTeX if available
+        FindDuplicates = 4 ///< List groups of entries that likely describe the same publication
+    };
+
+    typedef struct {
+        Command command;
+        /// Absolute path of the bibliography file to read
+        QString inputFilename;
+        /// Absolute path of the file to write to; if empty, BibTeX code is sent back in the reply
+        QString outputFilename;
+        /// Part of the exporter's class name to prefer, e.g. 'bibtex' or 'ris'
+        QString outputFormat;
+        QString formatIdString;
+    } Request;
+
+    typedef struct {
+        int exitCode;
+        /// Data to be written to stdout
+        QByteArray output;
+        /// Lines to be written to stderr
+        QStringList messages;
+    } Reply;
+
+    explicit CommandLineServer(QObject *parent = nullptr);
+    ~CommandLineServer() override;
+
+    /**
+     * Start listening for requests. Fails if another server is already
+     * listening using the same name.
+     * @param serverName name of the local socket, @see defaultServerName
+     * @return true if the server is listening
+     */
+    bool listen(const QString &serverName);
+
+    /// Name of the local socket unless specified otherwise, different for each user
+    static QString defaultServerName();
+
+    /**
+     * Process a single request in the current thread.
+     * @param checkSettings settings for validating with BibTeX, to be read
+     * from the preferences in the main thread beforehand
+     * @param standardOutput if given, BibTeX code to be written to stdout gets
+     * written to this device directly instead of being collected in the reply
+     */
+    static Reply process(const Request &request, const CheckBibTeX::Settings &checkSettings, QIODevice *standardOutput = nullptr);
+    /// Same as above, reading the settings for validating from the preferences, so call this only in the main thread
+    static Reply process(const Request &request, QIODevice *standardOutput = nullptr);
+
+    /**
+     * Send a request to a server and wait for its reply.
+     * @return true if a reply was received, false if the server could not be reached or did not answer in time
+     */
+    static bool sendRequest(const QString &serverName, const Request &request, Reply &reply, int timeoutMilliseconds = 300000);
+
+    /// Serialize a request, preceded by the protocol's magic number 'KBCS' and version
+    static QByteArray encodeRequest(const Request &request);
+    /// @return false if the data is malformed or uses another protocol or protocol version
+    static bool decodeRequest(const QByteArray &data, Request &request);
+    /// Serialize a reply, preceded by the protocol's magic number 'KBCS' and version
+    static QByteArray encodeReply(const Reply &reply);
+    /// @return false if the data is malformed or uses another protocol or protocol version
+    static bool decodeReply(const QByteArray &data, Reply &reply);
+
+private:
+    class Private;
+    Private *const d;
+};
+
+#endif // KBIBTEX_PROGRAM_COMMANDLINESERVER_H
@@ -40,7 +40,7 @@ public Q_SLOTS:
     void setElement(QSharedPointer<Element>, const File *);
 
 Q_SIGNALS:
-    void elementModified();
+    void elementModified(QSharedPointer<Element>);
 
 private:
     class ElementFormPrivate;
@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                              and contributors                           *
  *                                                                         *
  *   Contributions to this file were made by                               *
@@ -37,6 +37,13 @@
 #include <QFontDatabase>
 #include <QComboBox>
 #include <QPointer>
+#include <QCache>
+#include <QHash>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInteger>
+#include <QSortFilterProxyModel>
 
 #include <kio_version.h>
 #include <KLocalizedString>
@@ -59,11 +66,15 @@
 #include <Element>
 #include <Entry>
 #include <File>
+#include <Macro>
+#include <Preferences>
 #include <FileExporterBibTeX>
 #include <FileExporterBibTeX2HTML>
 #include <FileExporterRIS>
 #include <FileExporterXML>
 #include <file/FileView>
+#include <models/FileModel>
+#include <Tracing>
 #include "logging_program.h"
 
 typedef struct {
@@ -74,6 +85,37 @@ typedef struct {
 
 Q_DECLARE_METATYPE(PreviewStyle)
 
+/// Everything required to render a preview, safe to be used outside the GUI thread
+typedef struct {
+    PreviewStyle previewStyle;
+    QSharedPointer<const Element> element;
+    QSharedPointer<const File> file;
+    QString htmlStart;
+    QString fixedFontFamily;
+} PreviewRequest;
+
+typedef struct {
+    QString html;
+    bool buttonsEnabled;
+} PreviewResult;
+
+/// Identifies a rendered preview: which element in which revision in which style
+typedef struct {
+    const Element *element;
+    quint64 revision;
+    int styleId;
+} PreviewKey;
+
+inline bool operator==(const PreviewKey &a, const PreviewKey &b)
+{
+    return a.element == b.element && a.revision == b.revision && a.styleId == b.styleId;
+}
+
+inline uint qHash(const PreviewKey &key, uint seed = 0)
+{
+    return qHash(key.element, seed) ^ qHash(key.revision, seed) ^ qHash(key.styleId, seed);
+}
+
 class ReferencePreview::Private
 {
 private:
@@ -120,12 +162,31 @@ public:
     const File *file;
     FileView *fileView;
 
+    /// Renders previews in the background, not too many at once as styles may invoke external programs
+    QThreadPool renderPool;
+    /// Rendered previews, most recently used ones are kept
+    QCache<PreviewKey, PreviewResult> renderedPreviews;
+    /// Previews queued or being rendered, mapped to the generation of the selection they were requested for
+    QHash<PreviewKey, QSharedPointer<QAtomicInteger<quint64>>> pendingPreviews;
+    /// Incremented whenever the selection moves on, so that outdated requests get skipped
+    const QSharedPointer<QAtomicInteger<quint64>> currentGeneration;
+    /// Revisions of elements that got modified since the model was set
+    QHash<const Element *, quint64> elementRevisions;
+    /// Incremented on changes that may affect any element's preview, such as modified macros
+    quint64 modelRevision;
+    QPointer<FileModel> fileModel;
+
+    static const int maxRenderedPreviews;
+    static const int preRenderedNeighbours;
+
     Private(ReferencePreview *parent)
             : p(parent), config(KSharedConfig::openConfig(QStringLiteral("kbibtexrc"))),
           htmlStart(QString(QStringLiteral("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<style type=\"text/css\">\npre {\n white-space: pre-wrap;\n white-space: -moz-pre-wrap;\n white-space: -pre-wrap;\n white-space: -o-pre-wrap;\n word-wrap: break-word;\n}\n</style>\n</head>\n<body style=\"color: %1; background-color: '%2'; font-family: '%3'; font-size: %4pt\">")).arg(QApplication::palette().text().color().name(QColor::HexRgb), QApplication::palette().base().color().name(QColor::HexRgb), QFontDatabase::systemFont(QFontDatabase::GeneralFont).family(), QString::number(QFontDatabase::systemFont(QFontDatabase::GeneralFont).pointSize()))),
           errorMessageOuterTemplate(htmlStart + errorMessageInnerTemplate + QStringLiteral("</body></html>")),
-          file(nullptr), fileView(nullptr)
+          file(nullptr), fileView(nullptr), renderedPreviews(maxRenderedPreviews), currentGeneration(new QAtomicInteger<quint64>(0)), modelRevision(0)
     {
+        renderPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 2));
+
         QGridLayout *gridLayout = new QGridLayout(p);
         gridLayout->setContentsMargins(0, 0, 0, 0);
         gridLayout->setColumnStretch(0, 1);
@@ -157,6 +218,185 @@ public:
         gridLayout->addWidget(buttonSaveAsHTML, 2, 2, 1, 1);
     }
 
+    ~Private() {
+        /// Rendering jobs refer to the widget, so they must not outlive it
+        renderPool.clear();
+        renderPool.waitForDone();
+    }
+
+    void setFileModel(FileModel *newFileModel) {
+        if (newFileModel == fileModel) return;
+
+        if (!fileModel.isNull())
+            QObject::disconnect(fileModel, nullptr, p, nullptr);
+        fileModel = newFileModel;
+        modelChanged();
+        if (!fileModel.isNull()) {
+            QObject::connect(fileModel, &FileModel::dataChanged, p, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+                    const QSharedPointer<Element> changedElement = fileModel->element(row);
+                    if (changedElement.isNull()) continue;
+                    if (Entry::isEntry(*changedElement))
+                        ++elementRevisions[changedElement.data()];
+                    else
+                        /// Macros and other elements may affect the preview of any entry
+                        modelChanged();
+                }
+            });
+            /// Memory addresses of removed elements may get reused by new elements
+            QObject::connect(fileModel, &FileModel::rowsAboutToBeRemoved, p, [this]() {
+                modelChanged();
+            });
+            QObject::connect(fileModel, &FileModel::modelReset, p, [this]() {
+                modelChanged();
+            });
+        }
+    }
+
+    void modelChanged() {
+        ++modelRevision;
+        elementRevisions.clear();
+        renderedPreviews.clear();
+    }
+
+    PreviewKey keyFor(const Element *keyElement, int styleId) const {
+        return PreviewKey {keyElement, (modelRevision << 32) + elementRevisions.value(keyElement, 0), styleId};
+    }
+
+    /// Copy of an entry not sharing any values with the original, which may get modified while rendering
+    static QSharedPointer<Entry> deepCopy(const Entry &entry) {
+        QSharedPointer<Entry> copy(new Entry(entry));
+        for (Entry::Iterator it = copy->begin(); it != copy->end(); ++it)
+            it.value() = it.value().deepCopy();
+        return copy;
+    }
+
+    PreviewRequest requestFor(const QSharedPointer<const Element> &requestedElement, const PreviewStyle &previewStyle) const {
+        /// Elements may get modified while being rendered, so render copies instead
+        const QSharedPointer<const Entry> entry = requestedElement.dynamicCast<const Entry>();
+        const QSharedPointer<const Macro> macro = requestedElement.dynamicCast<const Macro>();
+        QSharedPointer<const Element> elementCopy = requestedElement;
+        if (!entry.isNull())
+            elementCopy = deepCopy(*entry);
+        else if (!macro.isNull())
+            elementCopy = QSharedPointer<Macro>(new Macro(macro->key(), macro->value().deepCopy()));
+
+        QSharedPointer<File> fileCopy;
+        if (file != nullptr) {
+            /// Creating a File reads the preferences, so this has to happen here
+            /// in the GUI thread; this copy holds only what exporters may look up:
+            /// the file's properties, the cross-referenced entries, and all macros
+            static const QStringList copiedProperties {File::Encoding, File::StringDelimiter, File::CommentContext, File::CommentPrefix, File::KeywordCasing, File::ProtectCasing, File::NameFormatting, File::ListSeparator, File::SortedByIdentifier};
+            fileCopy = QSharedPointer<File>(new File());
+            for (const QString &key : copiedProperties)
+                if (file->hasProperty(key))
+                    fileCopy->setProperty(key, file->property(key));
+            /// An empty name formatting means to use the preferences' one
+            if (fileCopy->property(File::NameFormatting).toString().isEmpty())
+                fileCopy->setProperty(File::NameFormatting, Preferences::instance().personNameFormat());
+
+            if (!entry.isNull())
+                for (const QString &crossRefField : {Entry::ftCrossRef, Entry::ftXData}) {
+                    const QString crossRef = PlainTextValue::text(entry->value(crossRefField));
+                    const QSharedPointer<const Entry> crossRefEntry = crossRef.isEmpty() ? QSharedPointer<const Entry>() : file->containsKey(crossRef, File::ElementType::Entry).dynamicCast<const Entry>();
+                    if (!crossRefEntry.isNull())
+                        fileCopy->append(deepCopy(*crossRefEntry));
+                }
+            for (const QSharedPointer<Element> &fileElement : *file) {
+                const QSharedPointer<const Macro> fileMacro = fileElement.dynamicCast<const Macro>();
+                if (!fileMacro.isNull())
+                    fileCopy->append(QSharedPointer<Macro>(new Macro(fileMacro->key(), fileMacro->value().deepCopy())));
+            }
+        }
+        return PreviewRequest {previewStyle, elementCopy, fileCopy, htmlStart, QFontDatabase::systemFont(QFontDatabase::FixedFont).family()};
+    }
+
+    class RenderRunnable : public QRunnable
+    {
+    public:
+        RenderRunnable(Private *d, const PreviewRequest &request, const PreviewKey &key, const QSharedPointer<QAtomicInteger<quint64>> &requestGeneration)
+                : d(d), request(request), key(key), requestGeneration(requestGeneration) {
+            /// nothing
+        }
+
+        void run() override {
+            /// Skip requests made for a selection that has moved on meanwhile
+            const bool skipped = requestGeneration->loadAcquire() != d->currentGeneration->loadAcquire();
+            const PreviewResult result = skipped ? PreviewResult {QString(), false} : Private::render(request);
+            Private *d = this->d;
+            const PreviewKey key = this->key;
+            QMetaObject::invokeMethod(d->p, [d, key, result, skipped]() {
+                d->renderFinished(key, result, skipped);
+            }, Qt::QueuedConnection);
+        }
+
+    private:
+        Private *d;
+        const PreviewRequest request;
+        const PreviewKey key;
+        const QSharedPointer<QAtomicInteger<quint64>> requestGeneration;
+    };
+
+    /// Queue rendering a preview unless it is queued already, in which case it is kept from being skipped
+    void enqueue(const PreviewRequest &request, const PreviewKey &key, int priority) {
+        const quint64 generation = currentGeneration->loadAcquire();
+        const auto pending = pendingPreviews.constFind(key);
+        if (pending != pendingPreviews.constEnd()) {
+            pending.value()->storeRelease(generation);
+            return;
+        }
+
+        const QSharedPointer<QAtomicInteger<quint64>> requestGeneration(new QAtomicInteger<quint64>(generation));
+        pendingPreviews.insert(key, requestGeneration);
+        renderPool.start(new RenderRunnable(this, request, key, requestGeneration), priority);
+    }
+
+    void preRenderNeighbours(const PreviewStyle &previewStyle) {
+        if (fileView == nullptr || fileModel.isNull() || fileView->sortFilterProxyModel() == nullptr) return;
+
+        const QModelIndex currentIndex = fileView->currentIndex();
+        if (!currentIndex.isValid()) return;
+        QSortFilterProxyModel *sortFilterProxyModel = fileView->sortFilterProxyModel();
+        for (int distance = 1; distance <= preRenderedNeighbours; ++distance)
+            for (const int row : {currentIndex.row() + distance, currentIndex.row() - distance}) {
+                if (row < 0 || row >= sortFilterProxyModel->rowCount()) continue;
+                const QModelIndex sourceIndex = sortFilterProxyModel->mapToSource(sortFilterProxyModel->index(row, 0));
+                const QSharedPointer<const Element> neighbour = fileModel->element(sourceIndex.row());
+                if (neighbour.isNull()) continue;
+                const PreviewKey key = keyFor(neighbour.data(), previewStyle.id);
+                if (!renderedPreviews.contains(key))
+                    enqueue(requestFor(neighbour, previewStyle), key, -distance);
+            }
+    }
+
+    PreviewStyle currentPreviewStyle() const {
+        return comboBox->itemData(comboBox->currentIndex()).value<PreviewStyle>();
+    }
+
+    void renderFinished(const PreviewKey &key, const PreviewResult &result, bool skipped) {
+        pendingPreviews.remove(key);
+        const PreviewStyle previewStyle = currentPreviewStyle();
+        const bool isCurrent = !element.isNull() && key == keyFor(element.data(), previewStyle.id);
+
+        if (skipped) {
+            /// Selection may have returned to this element before the request was skipped
+            if (isCurrent)
+                enqueue(requestFor(element, previewStyle), key, 0);
+            return;
+        }
+
+        /// Element may have been modified while rendering
+        if (key == keyFor(key.element, key.styleId))
+            renderedPreviews.insert(key, new PreviewResult(result));
+
+        if (isCurrent) {
+            htmlView->viewport()->unsetCursor();
+            setHtml(result.html, result.buttonsEnabled);
+        }
+    }
+
+    static PreviewResult render(const PreviewRequest &request);
+
     bool saveHTML(const QUrl &url) const {
         QTemporaryFile tempFile;
         tempFile.setAutoRemove(true);
@@ -227,65 +467,30 @@ public:
 const QString ReferencePreview::Private::configGroupName {QStringLiteral("Reference Preview Docklet")};
 const QString ReferencePreview::Private::configKeyName {QStringLiteral("Style")};
 const QString ReferencePreview::Private::errorMessageInnerTemplate {QString(QStringLiteral("<p style=\"font-style: italic;\">%1</p><p style=\"font-size: 90%;\">%2 %3</p>")).arg(i18n("No preview available"), i18n("Reason:"))};
+const int ReferencePreview::Private::maxRenderedPreviews = 64;
+const int ReferencePreview::Private::preRenderedNeighbours = 2;
 
-ReferencePreview::ReferencePreview(QWidget *parent)
-        : QWidget(parent), d(new Private(this))
-{
-    d->loadState();
-
-    connect(d->buttonOpen, &QPushButton::clicked, this, &ReferencePreview::openAsHTML);
-    connect(d->buttonSaveAsHTML, &QPushButton::clicked, this, &ReferencePreview::saveAsHTML);
-    connect(d->comboBox, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &ReferencePreview::renderHTML);
-
-    setEnabled(false);
-}
-
-ReferencePreview::~ReferencePreview()
-{
-    delete d;
-}
-
-void ReferencePreview::setEnabled(bool enabled)
-{
-    if (enabled)
-        d->setHtml(d->htmlText, true);
-    else
-        d->setHtml(d->errorMessageOuterTemplate.arg(i18nc("Message in case reference preview widget is disabled", "Preview disabled")), false);
-    d->htmlView->setEnabled(enabled);
-    d->comboBox->setEnabled(enabled);
-}
-
-void ReferencePreview::setElement(QSharedPointer<const Element> element, const File *file)
+PreviewResult ReferencePreview::Private::render(const PreviewRequest &request)
 {
-    d->element = element;
-    d->file = file;
-    renderHTML();
-}
-
-void ReferencePreview::renderHTML()
-{
-    if (d->element.isNull()) {
-        d->setHtml(d->errorMessageOuterTemplate.arg(i18nc("Message in case no bibliographic element is selected for preview", "No element selected")), false);
-        return;
-    }
-
-    const bool elementIsEntry {!d->element.dynamicCast<const Entry>().isNull()};
-    const PreviewStyle previewStyle = d->comboBox->itemData(d->comboBox->currentIndex()).value<PreviewStyle>();
+    Tracing::Scope traceScope("program", "ReferencePreview::render");
+    traceScope.setDetail(request.previewStyle.label);
+    const bool elementIsEntry {!request.element.dynamicCast<const Entry>().isNull()};
+    const PreviewStyle &previewStyle = request.previewStyle;
 
     const QString exporterName = previewStyle.attributes.value(QStringLiteral("exporter"), QString()).toString();
-    QScopedPointer<FileExporter> exporter([this, &previewStyle, &exporterName]() {
+    QScopedPointer<FileExporter> exporter([&previewStyle, &exporterName]() {
         if (exporterName == QStringLiteral("bibtex")) {
-            FileExporterBibTeX *exporterBibTeX = new FileExporterBibTeX(this);
+            FileExporterBibTeX *exporterBibTeX = new FileExporterBibTeX(nullptr);
             exporterBibTeX->setEncoding(QStringLiteral("utf-8"));
             return qobject_cast<FileExporter *>(exporterBibTeX);
         } else if (exporterName == QStringLiteral("ris"))
-            return qobject_cast<FileExporter * >(new FileExporterRIS(this));
+            return qobject_cast<FileExporter * >(new FileExporterRIS(nullptr));
         else if (exporterName == QStringLiteral("bibtex2html")) {
-            FileExporterBibTeX2HTML *exporterBibTeX2HTML = new FileExporterBibTeX2HTML(this);
+            FileExporterBibTeX2HTML *exporterBibTeX2HTML = new FileExporterBibTeX2HTML(nullptr);
             exporterBibTeX2HTML->setLaTeXBibliographyStyle(previewStyle.attributes.value(QStringLiteral("bibtexstyle"), QString()).toString());
             return qobject_cast<FileExporter *>(exporterBibTeX2HTML);
         } else if (exporterName == QStringLiteral("xml")) {
-            FileExporterXML *exporterXML = new FileExporterXML(this);
+            FileExporterXML *exporterXML = new FileExporterXML(nullptr);
             exporterXML->setOutputStyle(previewStyle.attributes.value(QStringLiteral("style"), QVariant::fromValue(FileExporterXML::OutputStyle::XML_KBibTeX)).value<FileExporterXML::OutputStyle>());
             return qobject_cast<FileExporter *>(exporterXML);
         } else if (!exporterName.isEmpty())
@@ -298,23 +503,16 @@ void ReferencePreview::renderHTML()
     bool exporterResult = false;
     bool textIsErrorMessage = false;
     if (!exporter.isNull()) {
-        const bool externalProgramInvocation {previewStyle.attributes.value(QStringLiteral("externalprogram"), false).toBool()};
-        if (externalProgramInvocation) {
-            // Exporter may invoke external programs which take time, so set the busy cursor
-            QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-        }
-        QBuffer buffer(this);
+        QBuffer buffer;
         buffer.open(QBuffer::WriteOnly);
-        exporterResult = exporter->save(&buffer, d->element, d->file);
+        exporterResult = exporter->save(&buffer, request.element, request.file.data());
         buffer.close();
-        if (externalProgramInvocation)
-            QApplication::restoreOverrideCursor();
 
         buffer.open(QBuffer::ReadOnly);
         text = QString::fromUtf8(buffer.readAll().constData()).trimmed();
         buffer.close();
     } else {
-        text = d->errorMessageInnerTemplate.arg(i18nc("No exporter clould be located to generate output", "No output generated"));
+        text = errorMessageInnerTemplate.arg(i18nc("No exporter clould be located to generate output", "No output generated"));
         textIsErrorMessage = true;
     }
 
@@ -356,14 +554,14 @@ void ReferencePreview::renderHTML()
     if ((!exporterResult || text.isEmpty()) && !elementIsEntry) {
         // Some exporters do not handle things like macros or preamble.
         // Assume that this is the case here and provide an appropriate error message for that
-        text = d->errorMessageInnerTemplate.arg(i18n("Cannot show a preview for this type of element"));
+        text = errorMessageInnerTemplate.arg(i18n("Cannot show a preview for this type of element"));
         textIsErrorMessage = true;
     }
 
     if (!textIsErrorMessage && previewStyle.attributes.value(QStringLiteral("fixed-font"), false).toBool()) {
         // Preview text gets formatted as verbatim text in monospaced font
         text.prepend(QStringLiteral("';\">"));
-        text.prepend(QFontDatabase::systemFont(QFontDatabase::FixedFont).family());
+        text.prepend(request.fixedFontFamily);
         text.prepend(QStringLiteral("<pre style=\"font-family: '"));
         text.append(QStringLiteral("</pre>"));
     } else if (!textIsErrorMessage && previewStyle.attributes.value(QStringLiteral("html"), false).toBool()) {
@@ -384,7 +582,7 @@ void ReferencePreview::renderHTML()
         text.remove(QStringLiteral("\n")).replace(QStringLiteral("| "), QStringLiteral("|"));
     else if (previewStyle.attributes.value(QStringLiteral("style"), QVariant::fromValue(FileExporterXML::OutputStyle::XML_KBibTeX)).value<FileExporterXML::OutputStyle>() == FileExporterXML::OutputStyle::HTML_AbstractOnly) {
         if (text.isEmpty()) {
-            text = d->errorMessageInnerTemplate.arg(i18nc("Cannot show a reference preview as entry does not contain an abstract", "No abstract"));
+            text = errorMessageInnerTemplate.arg(i18nc("Cannot show a reference preview as entry does not contain an abstract", "No abstract"));
             textIsErrorMessage = true;
         }
     }
@@ -402,10 +600,75 @@ void ReferencePreview::renderHTML()
     text.replace(QStringLiteral("--"), QString(QChar(0x2013)));
 
     // Add common HTML start and end
-    text.prepend(d->htmlStart);
+    text.prepend(request.htmlStart);
     text.append(QStringLiteral("</body></html>"));
 
-    d->setHtml(text, !textIsErrorMessage);
+    return PreviewResult {text, !textIsErrorMessage};
+}
+
+
+
+ReferencePreview::ReferencePreview(QWidget *parent)
+        : QWidget(parent), d(new Private(this))
+{
+    d->loadState();
+
+    connect(d->buttonOpen, &QPushButton::clicked, this, &ReferencePreview::openAsHTML);
+    connect(d->buttonSaveAsHTML, &QPushButton::clicked, this, &ReferencePreview::saveAsHTML);
+    connect(d->comboBox, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &ReferencePreview::renderHTML);
+
+    setEnabled(false);
+}
+
+ReferencePreview::~ReferencePreview()
+{
+    delete d;
+}
+
+void ReferencePreview::setEnabled(bool enabled)
+{
+    if (enabled)
+        d->setHtml(d->htmlText, true);
+    else
+        d->setHtml(d->errorMessageOuterTemplate.arg(i18nc("Message in case reference preview widget is disabled", "Preview disabled")), false);
+    d->htmlView->setEnabled(enabled);
+    d->comboBox->setEnabled(enabled);
+}
+
+void ReferencePreview::setElement(QSharedPointer<const Element> element, const File *file)
+{
+    d->element = element;
+    d->file = file;
+    renderHTML();
+}
+
+void ReferencePreview::renderHTML()
+{
+    if (d->element.isNull()) {
+        d->setHtml(d->errorMessageOuterTemplate.arg(i18nc("Message in case no bibliographic element is selected for preview", "No element selected")), false);
+        return;
+    }
+
+    if (d->fileView != nullptr)
+        d->setFileModel(d->fileView->fileModel());
+
+    /// Any request for a previously selected element not started yet gets skipped
+    d->currentGeneration->fetchAndAddOrdered(1);
+
+    const PreviewStyle previewStyle = d->currentPreviewStyle();
+    const PreviewKey key = d->keyFor(d->element.data(), previewStyle.id);
+    const PreviewResult *renderedPreview = d->renderedPreviews.object(key);
+    if (renderedPreview != nullptr) {
+        d->htmlView->viewport()->unsetCursor();
+        d->setHtml(renderedPreview->html, renderedPreview->buttonsEnabled);
+    } else {
+        /// Rendering may invoke external programs which take time, so indicate being busy
+        d->htmlView->viewport()->setCursor(Qt::BusyCursor);
+        d->buttonOpen->setEnabled(false);
+        d->buttonSaveAsHTML->setEnabled(false);
+        d->enqueue(d->requestFor(d->element, previewStyle), key, 0);
+    }
+    d->preRenderNeighbours(previewStyle);
     d->saveState();
 }
 
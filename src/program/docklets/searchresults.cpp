@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2019 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -203,8 +203,9 @@ void SearchResults::importSelected()
     FileModel *sourceModel = d->resultList->fileModel();
     if (targetModel == nullptr || sourceModel == nullptr) return; ///< either source or target model is invalid
 
-    bool atLeastOneSuccessfullInsertion = false;
+    QVector<QSharedPointer<Element>> clones;
     const QModelIndexList selList = d->resultList->selectionModel()->selectedRows();
+    clones.reserve(selList.count());
     for (const QModelIndex &modelIndex : selList) {
         /// Map from visible row to 'real' row
         /// that may be hidden through sorting
@@ -215,12 +216,13 @@ void SearchResults::importSelected()
         if (!entry.isNull()) {
             /// Important: make clone of entry before inserting
             /// in main list, otherwise data would be shared
-            QSharedPointer<Entry> clone(new Entry(*entry));
-            atLeastOneSuccessfullInsertion |= targetModel->insertRow(clone, targetModel->rowCount());
+            clones.append(QSharedPointer<Entry>(new Entry(*entry)));
         } else
             qCWarning(LOG_KBIBTEX_PROGRAM) << "Trying to import something that isn't an Entry";
     }
 
+    /// Insert all clones in one go
+    const bool atLeastOneSuccessfullInsertion = !clones.isEmpty() && targetModel->insertRowList(clones, targetModel->rowCount());
     if (atLeastOneSuccessfullInsertion)
         d->mainEditor->externalModification();
 }
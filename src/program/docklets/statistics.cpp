@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2019 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -22,15 +22,13 @@
 #include <QFormLayout>
 #include <QLabel>
 #include <QFont>
-#include <QItemSelectionModel>
 
 #include <KLocalizedString>
 
 #include <File>
 #include <file/FileView>
 #include <Entry>
-#include <Macro>
-#include <Comment>
+#include <BibliographyStatistics>
 #include "openfileinfo.h"
 
 class Statistics::StatisticsPrivate
@@ -38,14 +36,14 @@ class Statistics::StatisticsPrivate
 private:
     // UNUSED Statistics *p;
     QLabel *labelNumberOfElements, *labelNumberOfEntries, *labelNumberOfJournalArticles, *labelNumberOfConferencePublications, *labelNumberOfBooks, *labelNumberOfOtherEntries, *labelNumberOfComments, *labelNumberOfMacros;
+    QLabel *labelYears, *labelTopVenues, *labelTopAuthors, *labelFillRates;
 
 public:
     FileView *fileView;
-    const File *file;
-    const QItemSelectionModel *selectionModel;
+    BibliographyStatistics *bibliographyStatistics;
 
     StatisticsPrivate(Statistics *parent)
-        : /* UNUSED p(parent),*/ fileView(nullptr), file(nullptr), selectionModel(nullptr) {
+        : /* UNUSED p(parent),*/ fileView(nullptr), bibliographyStatistics(new BibliographyStatistics(parent)) {
         QFormLayout *layout = new QFormLayout(parent);
 
         labelNumberOfElements = new QLabel(parent);
@@ -75,6 +73,22 @@ public:
         labelNumberOfMacros = new QLabel(parent);
         setBold(labelNumberOfMacros);
         layout->addRow(i18n("Number of Macros:"), labelNumberOfMacros);
+
+        labelYears = new QLabel(parent);
+        labelYears->setWordWrap(true);
+        layout->addRow(i18n("Years:"), labelYears);
+
+        labelTopVenues = new QLabel(parent);
+        labelTopVenues->setWordWrap(true);
+        layout->addRow(i18n("Top Venues:"), labelTopVenues);
+
+        labelTopAuthors = new QLabel(parent);
+        labelTopAuthors->setWordWrap(true);
+        layout->addRow(i18n("Top Authors:"), labelTopAuthors);
+
+        labelFillRates = new QLabel(parent);
+        labelFillRates->setWordWrap(true);
+        layout->addRow(i18n("Entries with:"), labelFillRates);
     }
 
     void setBold(QLabel *label) {
@@ -83,22 +97,56 @@ public:
         label->setFont(font);
     }
 
-    void update() {
-        file = fileView != nullptr && fileView->fileModel() != nullptr ? fileView->fileModel()->bibliographyFile() : nullptr;
-        selectionModel = fileView != nullptr ? fileView->selectionModel() : nullptr;
-
-        if (file != nullptr) {
-            int numElements, numEntries, numJournalArticles, numConferencePublications, numBooks, numComments, numMacros;
-            countElementTypes(numElements, numEntries, numJournalArticles, numConferencePublications, numBooks, numComments, numMacros);
+    static QString topList(const QHash<QString, int> &counts) {
+        static const int maxTopListLength = 3;
+        const auto top = BibliographyStatistics::Summary::top(counts, maxTopListLength);
+        if (top.isEmpty()) return QString(QChar(0x2013));
+        QStringList lines;
+        for (const auto &pair : top)
+            lines.append(i18nc("Name followed by how often it occurs", "%1 (%2)", pair.first, pair.second));
+        return lines.join(QStringLiteral("\n"));
+    }
 
-            labelNumberOfElements->setText(QString::number(numElements));
-            labelNumberOfEntries->setText(QString::number(numEntries));
+    void update() {
+        FileModel *fileModel = fileView != nullptr ? fileView->fileModel() : nullptr;
+        bibliographyStatistics->setFileModel(fileModel);
+
+        if (fileModel != nullptr && fileModel->bibliographyFile() != nullptr) {
+            /// Use selected items for statistics if selection contains at least two elements,
+            /// otherwise fall back to using the whole file for statistics
+            const QList<QSharedPointer<Element>> &selectedElements = fileView->selectedElements();
+            const BibliographyStatistics::Summary summary = selectedElements.count() > 1 ? bibliographyStatistics->summary(selectedElements) : bibliographyStatistics->summary();
+
+            const int numJournalArticles = summary.entryTypes.value(Entry::etArticle, 0);
+            const int numConferencePublications = summary.entryTypes.value(Entry::etInProceedings, 0);
+            const int numBooks = summary.entryTypes.value(Entry::etBook, 0);
+            labelNumberOfElements->setText(QString::number(summary.numElements));
+            labelNumberOfEntries->setText(QString::number(summary.numEntries));
             labelNumberOfJournalArticles->setText(QString::number(numJournalArticles));
             labelNumberOfConferencePublications->setText(QString::number(numConferencePublications));
             labelNumberOfBooks->setText(QString::number(numBooks));
-            labelNumberOfOtherEntries->setText(QString::number(numEntries - numJournalArticles - numConferencePublications - numBooks));
-            labelNumberOfComments->setText(QString::number(numComments));
-            labelNumberOfMacros->setText(QString::number(numMacros));
+            labelNumberOfOtherEntries->setText(QString::number(summary.numEntries - numJournalArticles - numConferencePublications - numBooks));
+            labelNumberOfComments->setText(QString::number(summary.numComments));
+            labelNumberOfMacros->setText(QString::number(summary.numMacros));
+
+            if (summary.years.isEmpty())
+                labelYears->setText(QChar(0x2013));
+            else {
+                int peakYear = summary.years.firstKey();
+                for (auto it = summary.years.constBegin(); it != summary.years.constEnd(); ++it)
+                    if (it.value() > summary.years.value(peakYear)) peakYear = it.key();
+                labelYears->setText(i18n("%1 to %2, most entries in %3 (%4)", summary.years.firstKey(), summary.years.lastKey(), peakYear, summary.years.value(peakYear)));
+            }
+            labelTopVenues->setText(topList(summary.venues));
+            labelTopAuthors->setText(topList(summary.authors));
+            if (summary.numEntries > 0) {
+                static const QVector<QPair<QString, QString>> fillRateFields {{Entry::ftDOI, i18n("DOI")}, {Entry::ftUrl, i18n("URL")}, {Entry::ftAbstract, i18n("Abstract")}, {Entry::ftKeywords, i18n("Keywords")}};
+                QStringList lines;
+                for (const auto &field : fillRateFields)
+                    lines.append(i18nc("Field name followed by percentage of entries having this field", "%1: %2%", field.second, qRound(summary.fillRate(field.first) * 100.0)));
+                labelFillRates->setText(lines.join(QStringLiteral("\n")));
+            } else
+                labelFillRates->setText(QChar(0x2013));
         } else {
             labelNumberOfElements->setText(QChar(0x2013));
             labelNumberOfEntries->setText(QChar(0x2013));
@@ -108,43 +156,10 @@ public:
             labelNumberOfOtherEntries->setText(QChar(0x2013));
             labelNumberOfComments->setText(QChar(0x2013));
             labelNumberOfMacros->setText(QChar(0x2013));
-        }
-    }
-
-    void countElement(const QSharedPointer<const Element> &element, int &numEntries, int &numJournalArticles, int &numConferencePublications, int &numBooks, int &numComments, int &numMacros) {
-        const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
-        if (!entry.isNull()) {
-            if (entry->type().toLower() == Entry::etArticle)
-                ++numJournalArticles;
-            else if (entry->type().toLower() == Entry::etInProceedings)
-                ++numConferencePublications;
-            else if (entry->type().toLower() == Entry::etBook)
-                ++numBooks;
-            ++numEntries;
-        } else if (!element.dynamicCast<const Macro>().isNull())
-            ++numMacros;
-        else if (!element.dynamicCast<const Comment>().isNull())
-            ++numComments;
-    }
-
-    void countElementTypes(int &numElements, int &numEntries, int &numJournalArticles, int &numConferencePublications, int &numBooks, int &numComments, int &numMacros) {
-        numElements = numEntries = numJournalArticles = numConferencePublications = numBooks = numComments = numMacros = 0;
-        Q_ASSERT_X(file != nullptr, "Statistics::StatisticsPrivate::countElementTypes(..)", "Function was called with file==NULL");
-
-        if (selectionModel != nullptr && selectionModel->selectedRows().count() > 1) {
-            /// Use selected items for statistics if selection contains at least two elements
-            const auto selectedRows = selectionModel->selectedRows();
-            numElements = selectedRows.count();
-            for (const QModelIndex &index : selectedRows) {
-                const int row = index.row();
-                if (row >= 0 && row < file->count())
-                    countElement(file->at(row), numEntries, numJournalArticles, numConferencePublications, numBooks, numComments, numMacros);
-            }
-        } else {
-            /// Default/fall-back: use whole file for statistics
-            numElements = file->count();
-            for (const auto &element : const_cast<const File &>(*file))
-                countElement(element, numEntries, numJournalArticles, numConferencePublications, numBooks, numComments, numMacros);
+            labelYears->setText(QChar(0x2013));
+            labelTopVenues->setText(QChar(0x2013));
+            labelTopAuthors->setText(QChar(0x2013));
+            labelFillRates->setText(QChar(0x2013));
         }
     }
 };
@@ -154,6 +169,7 @@ Statistics::Statistics(QWidget *parent)
 {
     d->update();
     connect(&OpenFileInfoManager::instance(), &OpenFileInfoManager::currentChanged, this, &Statistics::update);
+    connect(d->bibliographyStatistics, &BibliographyStatistics::changed, this, &Statistics::update);
 }
 
 Statistics::~Statistics()
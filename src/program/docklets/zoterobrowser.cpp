@@ -267,6 +267,11 @@ void ZoteroBrowser::showItem(QSharedPointer<Element> e)
     Q_EMIT itemToShow();
 }
 
+void ZoteroBrowser::clearItems()
+{
+    d->searchResults->clear();
+}
+
 void ZoteroBrowser::reenableWidget()
 {
     setCursor(d->nonBusyCursor);
@@ -301,6 +306,7 @@ bool ZoteroBrowser::applyCredentials()
         if (d->items != nullptr) {
             disconnect(d->items, &Zotero::Items::stoppedSearch, this, &ZoteroBrowser::reenableWidget);
             disconnect(d->items, &Zotero::Items::foundElement, this, &ZoteroBrowser::showItem);
+            disconnect(d->items, &Zotero::Items::invalidatedElements, this, &ZoteroBrowser::clearItems);
             d->items->deleteLater();
         }
         if (d->tagModel != nullptr) {
@@ -318,6 +324,7 @@ bool ZoteroBrowser::applyCredentials()
         const bool makeGroupRequest = d->radioGroupLibrary->isChecked() && groupId > 0;
         d->api = QSharedPointer<Zotero::API>(new Zotero::API(makeGroupRequest ? Zotero::API::RequestScope::Group : Zotero::API::RequestScope::User, makeGroupRequest ? groupId : userId, d->lineEditApiKey->text(), this));
         d->items = new Zotero::Items(d->api, this);
+        d->items->setMaxParallelRequests(4);
         d->tags = new Zotero::Tags(d->api, this);
         d->tagModel = new Zotero::TagModel(d->tags, this);
         d->tagBrowser->setModel(d->tagModel);
@@ -328,6 +335,7 @@ bool ZoteroBrowser::applyCredentials()
         connect(d->collectionModel, &Zotero::CollectionModel::modelReset, this, &ZoteroBrowser::modelReset);
         connect(d->tagModel, &Zotero::TagModel::modelReset, this, &ZoteroBrowser::modelReset);
         connect(d->items, &Zotero::Items::foundElement, this, &ZoteroBrowser::showItem);
+        connect(d->items, &Zotero::Items::invalidatedElements, this, &ZoteroBrowser::clearItems);
         connect(d->items, &Zotero::Items::stoppedSearch, this, &ZoteroBrowser::reenableWidget);
         connect(d->tags, &Zotero::Tags::finishedLoading, this, &ZoteroBrowser::reenableWidget);
 
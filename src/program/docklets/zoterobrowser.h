@@ -52,6 +52,7 @@ private Q_SLOTS:
     void collectionDoubleClicked(const QModelIndex &index);
     void tagDoubleClicked(const QModelIndex &index);
     void showItem(QSharedPointer<Element>);
+    void clearItems();
     void reenableWidget();
     void updateButtons();
     bool applyCredentials();
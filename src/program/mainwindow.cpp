@@ -390,7 +390,7 @@ void KBibTeXMainWindow::documentSwitched(FileView *oldFileView, FileView *newFil
         if (d->elementForm == nullptr)
             qWarning() << "About to disconnect from nullptr";
         #endif // EXTRA_VERBOSE
-        disconnect(d->elementForm, &ElementForm::elementModified, oldFileView, &FileView::externalModification);
+        disconnect(d->elementForm, &ElementForm::elementModified, oldFileView, &FileView::externalElementModification);
     }
     if (newFileView != nullptr) {
         connect(newFileView, &FileView::currentElementChanged, d->referencePreview, &ReferencePreview::setElement);
@@ -400,8 +400,7 @@ void KBibTeXMainWindow::documentSwitched(FileView *oldFileView, FileView *newFil
         connect(newFileView, &FileView::modified, d->valueList, &ValueList::update);
         connect(newFileView, &FileView::modified, d->statistics, &Statistics::update);
         // FIXME connect(newEditor, SIGNAL(modified()), d->elementForm, SLOT(refreshElement()));
-        connect(d->elementForm, &ElementForm::elementModified, newFileView, &FileView::externalModification);
-        connect(d->elementForm, &ElementForm::elementModified, newFileView, &FileView::externalModification);
+        connect(d->elementForm, &ElementForm::elementModified, newFileView, &FileView::externalElementModification);
     }
 
     d->documentPreview->setBibTeXUrl(validFile ? openFileInfo->url() : QUrl());
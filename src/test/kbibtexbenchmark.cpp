@@ -0,0 +1,570 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+#include <QRandomGenerator>
+#include <QProcess>
+#include <QTemporaryDir>
+
+#include <File>
+#include <Entry>
+#include <Value>
+#include <FileImporterBibTeX>
+#include <FileExporterBibTeX>
+#include <FileSnapshot>
+#include <EncoderLaTeX>
+#include <FindDuplicates>
+#include <IdSuggestions>
+#include <models/FileModel>
+#include <file/SortFilterFileModel>
+
+/**
+ * Benchmarks for KBibTeX's hot paths, operating on synthetic
+ * bibliographies of various sizes.
+ *
+ * Bibliographies are generated deterministically from a fixed seed, so
+ * that results of different runs and builds can be compared. Sizes to
+ * benchmark are set as a comma-separated list of entry counts in the
+ * environment variable KBIBTEX_BENCHMARK_SIZES, by default 1000 and 10000
+ * entries; sizes of 100000 or 1000000 entries need considerable memory
+ * and time. Finding duplicates has quadratic complexity and is skipped
+ * for more than 10000 entries.
+ *
+ * For machine-readable results to track trends over time, use QtTest's
+ * output options, e.g. 'kbibtexbenchmark -o results.xml,xml' or
+ * 'kbibtexbenchmark -o results.csv,csv'.
+ *
+ * Per-request latency of kbibtex-cli is measured both for starting a new
+ * process per conversion ('cold') and for forwarding conversions to a
+ * running 'kbibtex-cli --server' ('warm').
+ */
+class KBibTeXBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void importBibTeX_data();
+    void importBibTeX();
+    void importBibTeXDeferredFieldDecoding_data();
+    void importBibTeXDeferredFieldDecoding();
+    void parsePersonList_data();
+    void parsePersonList();
+    void loadSnapshot_data();
+    void loadSnapshot();
+    void exportBibTeX_data();
+    void exportBibTeX();
+    void encoderLaTeXDecode_data();
+    void encoderLaTeXDecode();
+    void encoderLaTeXEncode_data();
+    void encoderLaTeXEncode();
+    void sortFilterFileModelSort_data();
+    void sortFilterFileModelSort();
+    void sortFilterFileModelFilter_data();
+    void sortFilterFileModelFilter();
+    void findDuplicates_data();
+    void findDuplicates();
+    void idSuggestions_data();
+    void idSuggestions();
+    void commandLineRequest_data();
+    void commandLineRequest();
+
+private:
+    /// A synthetic bibliography, both as BibTeX source and as parsed File object
+    struct Bibliography {
+        QByteArray source;
+        /// Raw text of all titles and author lists, with LaTeX commands
+        QString laTeXText;
+        File *file;
+    };
+    QVector<int> sizes;
+    QHash<int, Bibliography> bibliographies;
+
+    const Bibliography &bibliography(int size);
+    void addSizeColumn();
+
+    static QString generateBibTeX(int size, QString &laTeXText);
+};
+
+/// Names in various scripts and spellings, some with LaTeX commands as often found in real bibliographies
+static const QStringList firstNames {QStringLiteral("Anna"), QStringLiteral("Jos{\\'e}"), QStringLiteral("Björn"), QStringLiteral("Zoë"), QStringLiteral("Wei"), QStringLiteral("Mar{\\'\\i}a"), QStringLiteral("Olga"), QStringLiteral("Søren"), QStringLiteral("Hiroshi"), QStringLiteral("J."), QStringLiteral("Fran{\\c{c}}ois"), QStringLiteral("Dmitrij"), QStringLiteral("Ayşe"), QStringLiteral("Nguyễn"), QStringLiteral("Peter")};
+static const QStringList lastNames {QStringLiteral("M{\\\"u}ller"), QStringLiteral("Müller"), QStringLiteral("Smith"), QStringLiteral("Ødegaard"), QStringLiteral("Łukasiewicz"), QStringLiteral("{van der} Berg"), QStringLiteral("Zhang"), QStringLiteral("Garc{\\'\\i}a"), QStringLiteral("Σαββίδης"), QStringLiteral("Иванов"), QStringLiteral("佐藤"), QStringLiteral("O'Neil"), QStringLiteral("Dupont"), QStringLiteral("Yılmaz"), QStringLiteral("Kowalski"), QStringLiteral("Schr{\\\"o}dinger"), QStringLiteral("Nakamura"), QStringLiteral("Fischer")};
+static const QStringList titleWords {QStringLiteral("learning"), QStringLiteral("efficient"), QStringLiteral("quantum"), QStringLiteral("networks"), QStringLiteral("analysis"), QStringLiteral("of"), QStringLiteral("the"), QStringLiteral("a"), QStringLiteral("towards"), QStringLiteral("scalable"), QStringLiteral("bibliographic"), QStringLiteral("{BibTeX}"), QStringLiteral("$\\alpha$-stable"), QStringLiteral("über"), QStringLiteral("distributed"), QStringLiteral("systems"), QStringLiteral("graph"), QStringLiteral("{\\\"a}hnliche"), QStringLiteral("models"), QStringLiteral("for"), QStringLiteral("{DNA}"), QStringLiteral("sequencing"), QStringLiteral("naïve"), QStringLiteral("evaluation"), QStringLiteral("–"), QStringLiteral("revisited")};
+static const QStringList venues {QStringLiteral("Journal of Irreproducible Results"), QStringLiteral("Communications of the {ACM}"), QStringLiteral("Physical Review Letters"), QStringLiteral("Zeitschrift f{\\\"u}r Physik"), QStringLiteral("Nature"), QStringLiteral("IEEE Transactions on Software Engineering"), QStringLiteral("Bioinformatics")};
+
+QString KBibTeXBenchmark::generateBibTeX(int size, QString &laTeXText)
+{
+    QRandomGenerator random(0x4b426962u + static_cast<quint32>(size));
+    QString result;
+    result.reserve(size * 400);
+    laTeXText.clear();
+    laTeXText.reserve(size * 120);
+
+    result.append(QStringLiteral("@string{jir = \"Journal of Irreproducible Results\"}\n\n"));
+    /// Proceedings that some inproceedings cross-reference; as required
+    /// by BibTeX, they are placed after all entries referencing them
+    const int numProceedings = qMax(1, size / 50);
+
+    for (int i = 0; i < size - numProceedings; ++i) {
+        QString authors;
+        const int numAuthors = 1 + static_cast<int>(random.bounded(6));
+        for (int a = 0; a < numAuthors; ++a) {
+            if (a > 0)
+                authors.append(QStringLiteral(" and "));
+            const QString &lastName = lastNames[static_cast<int>(random.bounded(lastNames.size()))];
+            const QString &firstName = firstNames[static_cast<int>(random.bounded(firstNames.size()))];
+            if (random.bounded(2) == 0)
+                authors.append(lastName).append(QStringLiteral(", ")).append(firstName);
+            else
+                authors.append(firstName).append(QLatin1Char(' ')).append(lastName);
+        }
+        QString title;
+        const int numTitleWords = 4 + static_cast<int>(random.bounded(10));
+        for (int w = 0; w < numTitleWords; ++w) {
+            if (w > 0)
+                title.append(QLatin1Char(' '));
+            title.append(titleWords[static_cast<int>(random.bounded(titleWords.size()))]);
+        }
+        const int year = 1950 + static_cast<int>(random.bounded(76));
+        laTeXText.append(authors).append(QLatin1Char('\n')).append(title).append(QLatin1Char('\n'));
+
+        const quint32 kind = random.bounded(100);
+        if (kind < 55) {
+            const QString venue = kind < 5 ? QStringLiteral("jir") : QStringLiteral("{") + venues[static_cast<int>(random.bounded(venues.size()))] + QStringLiteral("}");
+            result.append(QString(QStringLiteral("@article{entry%1,\n\tauthor = {%2},\n\ttitle = {%3},\n\tjournal = %4,\n\tyear = %5,\n\tvolume = {%6},\n\tpages = {%7--%8},\n\tdoi = {10.1000/bench.%1}\n}\n\n")).arg(i).arg(authors, title, venue).arg(year).arg(1 + random.bounded(60)).arg(i % 1000).arg(i % 1000 + 12));
+        } else if (kind < 85) {
+            const int proceedingsIndex = static_cast<int>(random.bounded(numProceedings));
+            /// About a third of the inproceedings cross-reference their proceedings
+            const QString crossRefOrBookTitle = kind < 65 ? QString(QStringLiteral("crossref = {proc%1}")).arg(proceedingsIndex) : QString(QStringLiteral("booktitle = {Proceedings of the %1th Workshop on %2}")).arg(proceedingsIndex).arg(titleWords[proceedingsIndex % titleWords.size()]);
+            result.append(QString(QStringLiteral("@inproceedings{entry%1,\n\tauthor = {%2},\n\ttitle = {%3},\n\t%4,\n\tyear = {%5},\n\tmonth = %6,\n\turl = {https://example.org/papers/%1.pdf}\n}\n\n")).arg(i).arg(authors, title, crossRefOrBookTitle).arg(year).arg(QStringLiteral("jan,feb,mar,apr,may,jun,jul,aug,sep,oct,nov,dec").split(QLatin1Char(','))[i % 12]));
+        } else if (kind < 95) {
+            result.append(QString(QStringLiteral("@book{entry%1,\n\tauthor = {%2},\n\ttitle = {%3},\n\tpublisher = {Springer},\n\taddress = {Berlin, Heidelberg},\n\tyear = {%4},\n\tisbn = {978-3-16-148410-%5},\n\tkeywords = {benchmark; synthetic; %6}\n}\n\n")).arg(i).arg(authors, title).arg(year).arg(i % 10).arg(titleWords[i % titleWords.size()]));
+        } else
+            result.append(QString(QStringLiteral("@misc{entry%1,\n\tauthor = {%2},\n\ttitle = {%3},\n\thowpublished = {Preprint},\n\tyear = {%4},\n\tabstract = {%3. %3.}\n}\n\n")).arg(i).arg(authors, title).arg(year));
+    }
+
+    for (int p = 0; p < numProceedings; ++p)
+        result.append(QString(QStringLiteral("@proceedings{proc%1,\n\ttitle = {Proceedings of the %1th Workshop on %2},\n\teditor = {%3, %4},\n\tpublisher = {ACM},\n\tyear = {%5}\n}\n\n")).arg(p).arg(titleWords[p % titleWords.size()], lastNames[p % lastNames.size()], firstNames[p % firstNames.size()]).arg(1990 + p % 35));
+
+    return result;
+}
+
+const KBibTeXBenchmark::Bibliography &KBibTeXBenchmark::bibliography(int size)
+{
+    auto it = bibliographies.find(size);
+    if (it == bibliographies.end()) {
+        Bibliography bibliography;
+        bibliography.source = generateBibTeX(size, bibliography.laTeXText).toUtf8();
+        FileImporterBibTeX importer(this);
+        bibliography.file = importer.fromString(QString::fromUtf8(bibliography.source));
+        it = bibliographies.insert(size, bibliography);
+    }
+    return it.value();
+}
+
+void KBibTeXBenchmark::addSizeColumn()
+{
+    QTest::addColumn<int>("size");
+}
+
+void KBibTeXBenchmark::initTestCase()
+{
+    const QString sizesText = qEnvironmentVariable("KBIBTEX_BENCHMARK_SIZES", QStringLiteral("1000,10000"));
+    for (const QString &sizeText : sizesText.split(QLatin1Char(','))) {
+        bool ok = false;
+        const int size = sizeText.trimmed().toInt(&ok);
+        if (ok && size > 0)
+            sizes.append(size);
+    }
+    QVERIFY2(!sizes.isEmpty(), "No valid sizes in KBIBTEX_BENCHMARK_SIZES");
+}
+
+void KBibTeXBenchmark::cleanupTestCase()
+{
+    for (const Bibliography &bibliography : const_cast<const QHash<int, Bibliography> &>(bibliographies))
+        delete bibliography.file;
+    bibliographies.clear();
+}
+
+void KBibTeXBenchmark::importBibTeX_data()
+{
+    addSizeColumn();
+    for (const int size : const_cast<const QVector<int> &>(sizes))
+        QTest::newRow(QString::number(size).toLatin1().constData()) << size;
+}
+
+void KBibTeXBenchmark::importBibTeX()
+{
+    QFETCH(int, size);
+    const Bibliography &data = bibliography(size);
+
+    QBENCHMARK {
+        QBuffer buffer(const_cast<QByteArray *>(&data.source));
+        buffer.open(QIODevice::ReadOnly);
+        FileImporterBibTeX importer(this);
+        File *file = importer.load(&buffer);
+        QVERIFY(file != nullptr);
+        delete file;
+    }
+}
+
+void KBibTeXBenchmark::importBibTeXDeferredFieldDecoding_data()
+{
+    importBibTeX_data();
+}
+
+void KBibTeXBenchmark::importBibTeXDeferredFieldDecoding()
+{
+    QFETCH(int, size);
+    const Bibliography &data = bibliography(size);
+
+    /// Measures the total loading time like importBibTeX; as all fields are
+    /// decoded before load() returns, this is also the time to first paint
+    QBENCHMARK {
+        QBuffer buffer(const_cast<QByteArray *>(&data.source));
+        buffer.open(QIODevice::ReadOnly);
+        FileImporterBibTeX importer(this);
+        importer.setDeferredFieldDecoding(true);
+        File *file = importer.load(&buffer);
+        QVERIFY(file != nullptr);
+        QCOMPARE(file->count(), data.file->count());
+        delete file;
+    }
+}
+
+void KBibTeXBenchmark::parsePersonList_data()
+{
+    QTest::addColumn<int>("numAuthors");
+    QTest::addColumn<bool>("lastNameFirst");
+    /// Large collaborations in physics list thousands of authors per entry
+    for (const int numAuthors : {10, 100, 3000}) {
+        QTest::newRow(QString(QStringLiteral("%1 authors last-first")).arg(numAuthors).toLatin1().constData()) << numAuthors << true;
+        QTest::newRow(QString(QStringLiteral("%1 authors first-last")).arg(numAuthors).toLatin1().constData()) << numAuthors << false;
+    }
+}
+
+void KBibTeXBenchmark::parsePersonList()
+{
+    QFETCH(int, numAuthors);
+    QFETCH(bool, lastNameFirst);
+
+    QString text;
+    for (int a = 0; a < numAuthors; ++a) {
+        if (a > 0)
+            text.append(QStringLiteral(" and "));
+        const QString &firstName = firstNames[a % firstNames.size()];
+        const QString &lastName = lastNames[(a * 7) % lastNames.size()];
+        if (lastNameFirst)
+            text.append(lastName).append(QStringLiteral(", ")).append(firstName);
+        else
+            text.append(firstName).append(QLatin1Char(' ')).append(lastName);
+    }
+
+    QBENCHMARK {
+        Value value;
+        FileImporterBibTeX::parsePersonList(text, value);
+        QCOMPARE(value.count(), numAuthors);
+    }
+}
+
+void KBibTeXBenchmark::loadSnapshot_data()
+{
+    importBibTeX_data();
+}
+
+void KBibTeXBenchmark::loadSnapshot()
+{
+    QFETCH(int, size);
+    const Bibliography &data = bibliography(size);
+
+    /// Same bibliography as used for importBibTeX, but restored from a snapshot
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString sourceFilename = tempDir.filePath(QStringLiteral("source.bib"));
+    QFile sourceFile(sourceFilename);
+    QVERIFY(sourceFile.open(QFile::WriteOnly));
+    sourceFile.write(data.source);
+    sourceFile.close();
+    const FileSnapshot::Source source = FileSnapshot::source(sourceFilename, data.source, QStringLiteral("benchmark"));
+    const QString snapshotFilename = tempDir.filePath(QStringLiteral("source.snapshot"));
+    QVERIFY(FileSnapshot::save(*data.file, source, snapshotFilename));
+
+    QBENCHMARK {
+        File *file = FileSnapshot::load(source, snapshotFilename);
+        QVERIFY(file != nullptr);
+        QCOMPARE(file->count(), data.file->count());
+        delete file;
+    }
+}
+
+void KBibTeXBenchmark::exportBibTeX_data()
+{
+    addSizeColumn();
+    QTest::addColumn<QString>("encoding");
+    static const QStringList encodings {QStringLiteral("utf-8"), QStringLiteral("iso-8859-1"), QStringLiteral("windows-1252"), QStringLiteral("latex")};
+    for (const int size : const_cast<const QVector<int> &>(sizes))
+        for (const QString &encoding : encodings)
+            QTest::newRow(QString(QStringLiteral("%1 %2")).arg(size).arg(encoding).toLatin1().constData()) << size << encoding;
+}
+
+void KBibTeXBenchmark::exportBibTeX()
+{
+    QFETCH(int, size);
+    QFETCH(QString, encoding);
+    const Bibliography &data = bibliography(size);
+
+    QBENCHMARK {
+        QByteArray output;
+        QBuffer buffer(&output);
+        buffer.open(QIODevice::WriteOnly);
+        FileExporterBibTeX exporter(this);
+        exporter.setEncoding(encoding);
+        QVERIFY(exporter.save(&buffer, data.file));
+    }
+}
+
+void KBibTeXBenchmark::encoderLaTeXDecode_data()
+{
+    importBibTeX_data();
+}
+
+void KBibTeXBenchmark::encoderLaTeXDecode()
+{
+    QFETCH(int, size);
+    const Bibliography &data = bibliography(size);
+    const EncoderLaTeX &encoder = EncoderLaTeX::instance();
+
+    QBENCHMARK {
+        const QString decoded = encoder.decode(data.laTeXText);
+        QVERIFY(!decoded.isEmpty());
+    }
+}
+
+void KBibTeXBenchmark::encoderLaTeXEncode_data()
+{
+    addSizeColumn();
+    QTest::addColumn<int>("targetEncoding");
+    for (const int size : const_cast<const QVector<int> &>(sizes)) {
+        QTest::newRow(QString(QStringLiteral("%1 ASCII")).arg(size).toLatin1().constData()) << size << static_cast<int>(Encoder::TargetEncoding::ASCII);
+        QTest::newRow(QString(QStringLiteral("%1 UTF-8")).arg(size).toLatin1().constData()) << size << static_cast<int>(Encoder::TargetEncoding::UTF8);
+    }
+}
+
+void KBibTeXBenchmark::encoderLaTeXEncode()
+{
+    QFETCH(int, size);
+    QFETCH(int, targetEncoding);
+    const Bibliography &data = bibliography(size);
+    const EncoderLaTeX &encoder = EncoderLaTeX::instance();
+    const QString unicodeText = encoder.decode(data.laTeXText);
+
+    QBENCHMARK {
+        const QString encoded = encoder.encode(unicodeText, static_cast<Encoder::TargetEncoding>(targetEncoding));
+        QVERIFY(!encoded.isEmpty());
+    }
+}
+
+void KBibTeXBenchmark::sortFilterFileModelSort_data()
+{
+    addSizeColumn();
+    QTest::addColumn<int>("column");
+    for (const int size : const_cast<const QVector<int> &>(sizes))
+        for (int column = 0; column < 4; ++column)
+            QTest::newRow(QString(QStringLiteral("%1 column %2")).arg(size).arg(column).toLatin1().constData()) << size << column;
+}
+
+void KBibTeXBenchmark::sortFilterFileModelSort()
+{
+    QFETCH(int, size);
+    QFETCH(int, column);
+    const Bibliography &data = bibliography(size);
+    FileModel model;
+    model.setBibliographyFile(data.file);
+    SortFilterFileModel sortFilterModel;
+    sortFilterModel.setSourceModel(&model);
+    QVERIFY(column < sortFilterModel.columnCount());
+
+    Qt::SortOrder order = Qt::AscendingOrder;
+    QBENCHMARK {
+        /// Alternate the order, so that each iteration has to sort again
+        order = order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+        sortFilterModel.sort(column, order);
+    }
+}
+
+void KBibTeXBenchmark::sortFilterFileModelFilter_data()
+{
+    addSizeColumn();
+    QTest::addColumn<QStringList>("terms");
+    QTest::addColumn<bool>("everyTerm");
+    for (const int size : const_cast<const QVector<int> &>(sizes)) {
+        QTest::newRow(QString(QStringLiteral("%1 single term")).arg(size).toLatin1().constData()) << size << QStringList {QStringLiteral("quantum")} << false;
+        QTest::newRow(QString(QStringLiteral("%1 any of three terms")).arg(size).toLatin1().constData()) << size << QStringList {QStringLiteral("graph"), QStringLiteral("müller"), QStringLiteral("1999")} << false;
+        QTest::newRow(QString(QStringLiteral("%1 every of two terms")).arg(size).toLatin1().constData()) << size << QStringList {QStringLiteral("learning"), QStringLiteral("zhang")} << true;
+    }
+}
+
+void KBibTeXBenchmark::sortFilterFileModelFilter()
+{
+    QFETCH(int, size);
+    QFETCH(QStringList, terms);
+    QFETCH(bool, everyTerm);
+    const Bibliography &data = bibliography(size);
+    FileModel model;
+    model.setBibliographyFile(data.file);
+    SortFilterFileModel sortFilterModel;
+    sortFilterModel.setSourceModel(&model);
+
+    SortFilterFileModel::FilterQuery emptyQuery;
+    emptyQuery.combination = SortFilterFileModel::FilterCombination::AnyTerm;
+    emptyQuery.searchPDFfiles = false;
+    SortFilterFileModel::FilterQuery filterQuery = emptyQuery;
+    filterQuery.terms = terms;
+    filterQuery.combination = everyTerm ? SortFilterFileModel::FilterCombination::EveryTerm : SortFilterFileModel::FilterCombination::AnyTerm;
+
+    QBENCHMARK {
+        sortFilterModel.updateFilter(filterQuery);
+        QVERIFY(sortFilterModel.rowCount() <= size);
+        sortFilterModel.updateFilter(emptyQuery);
+    }
+}
+
+void KBibTeXBenchmark::findDuplicates_data()
+{
+    importBibTeX_data();
+}
+
+void KBibTeXBenchmark::findDuplicates()
+{
+    QFETCH(int, size);
+    if (size > 10000)
+        QSKIP("Finding duplicates is skipped for large bibliographies due to its quadratic complexity");
+    const Bibliography &data = bibliography(size);
+
+    QBENCHMARK {
+        FindDuplicates findDuplicates(nullptr);
+        QVector<EntryClique *> cliques;
+        findDuplicates.findDuplicateEntries(data.file, cliques);
+        qDeleteAll(cliques);
+    }
+}
+
+void KBibTeXBenchmark::idSuggestions_data()
+{
+    addSizeColumn();
+    QTest::addColumn<QString>("formatStr");
+    for (const int size : const_cast<const QVector<int> &>(sizes)) {
+        QTest::newRow(QString(QStringLiteral("%1 author year")).arg(size).toLatin1().constData()) << size << QStringLiteral("A|Y");
+        QTest::newRow(QString(QStringLiteral("%1 author year title")).arg(size).toLatin1().constData()) << size << QStringLiteral("A|Y|T");
+    }
+}
+
+void KBibTeXBenchmark::idSuggestions()
+{
+    QFETCH(int, size);
+    QFETCH(QString, formatStr);
+    const Bibliography &data = bibliography(size);
+    QVector<QSharedPointer<Entry>> entries;
+    entries.reserve(data.file->size());
+    for (const auto &element : const_cast<const File &>(*data.file)) {
+        const QSharedPointer<Entry> entry = element.dynamicCast<Entry>();
+        if (!entry.isNull())
+            entries.append(entry);
+    }
+
+    QBENCHMARK {
+        int numNonEmpty = 0;
+        for (const QSharedPointer<Entry> &entry : const_cast<const QVector<QSharedPointer<Entry>> &>(entries))
+            if (!IdSuggestions::formatId(*entry, formatStr).isEmpty())
+                ++numNonEmpty;
+        QVERIFY(numNonEmpty > 0);
+    }
+}
+
+void KBibTeXBenchmark::commandLineRequest_data()
+{
+    addSizeColumn();
+    QTest::addColumn<bool>("warm");
+    for (const int size : const_cast<const QVector<int> &>(sizes)) {
+        QTest::newRow(QString(QStringLiteral("%1 cold")).arg(size).toLatin1().constData()) << size << false;
+        QTest::newRow(QString(QStringLiteral("%1 warm")).arg(size).toLatin1().constData()) << size << true;
+    }
+}
+
+void KBibTeXBenchmark::commandLineRequest()
+{
+#ifndef KBIBTEX_CLI_EXECUTABLE
+    QSKIP("kbibtex-cli is not built");
+#else // KBIBTEX_CLI_EXECUTABLE
+    QFETCH(int, size);
+    QFETCH(bool, warm);
+    const Bibliography &data = bibliography(size);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString inputFilename = tempDir.filePath(QStringLiteral("input.bib"));
+    QFile inputFile(inputFilename);
+    QVERIFY(inputFile.open(QFile::WriteOnly));
+    inputFile.write(data.source);
+    inputFile.close();
+
+    const QString program = QStringLiteral(KBIBTEX_CLI_EXECUTABLE);
+    const QString socketName = QString(QStringLiteral("kbibtexbenchmark-%1")).arg(QCoreApplication::applicationPid());
+    QStringList arguments {inputFilename, QStringLiteral("-o"), tempDir.filePath(QStringLiteral("output.bib"))};
+
+    QProcess server;
+    if (warm) {
+        server.setReadChannel(QProcess::StandardError);
+        server.start(program, {QStringLiteral("--server"), QStringLiteral("--socket"), socketName});
+        QVERIFY(server.waitForStarted());
+        /// Server announces on stderr when it is ready to accept requests
+        QByteArray serverOutput;
+        while (!serverOutput.contains("Listening on")) {
+            QVERIFY2(server.waitForReadyRead(10000), "kbibtex-cli server did not start listening");
+            serverOutput.append(server.readAll());
+        }
+        arguments << QStringLiteral("--connect") << QStringLiteral("--socket") << socketName;
+    }
+
+    QBENCHMARK {
+        QProcess client;
+        client.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        client.start(program, arguments);
+        QVERIFY(client.waitForFinished(300000));
+        QCOMPARE(client.exitCode(), 0);
+        if (warm) {
+            /// Keep server's log lines from filling up the pipe
+            server.waitForReadyRead(0);
+            server.readAll();
+        }
+    }
+
+    if (warm) {
+        server.terminate();
+        if (!server.waitForFinished(5000))
+            server.kill();
+    }
+#endif // KBIBTEX_CLI_EXECUTABLE
+}
+
+QTEST_MAIN(KBibTeXBenchmark)
+
+#include "kbibtexbenchmark.moc"
@@ -0,0 +1,231 @@
+/***************************************************************************
+ *   SPDX-License-Identifier: GPL-2.0-or-later
+ *                                                                         *
+ *   SPDX-FileCopyrightText: 2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include <QProcess>
+#include <QTemporaryDir>
+
+#include <Value>
+#include <Entry>
+#include <File>
+#include <FileImporterBibTeX>
+#include "commandlineserver.h"
+
+class KBibTeXCLITest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void mergeDuplicateIds_data();
+    void mergeDuplicateIds();
+    void emptyOutput();
+    void validateIdsAndCrossRefs();
+    void serverMessageRoundTrip();
+    void serverMessageRejected_data();
+    void serverMessageRejected();
+
+private:
+    /// Run kbibtex-cli with the given arguments, returning its exit code
+    static int runCommandLine(const QStringList &arguments, QByteArray *standardOutput = nullptr);
+    static bool writeFile(const QString &filename, const QByteArray &content);
+};
+
+int KBibTeXCLITest::runCommandLine(const QStringList &arguments, QByteArray *standardOutput)
+{
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process.start(QStringLiteral(KBIBTEX_CLI_EXECUTABLE), arguments);
+    if (!process.waitForFinished(60000) || process.exitStatus() != QProcess::NormalExit)
+        return -1;
+    if (standardOutput != nullptr)
+        *standardOutput = process.readAllStandardOutput();
+    return process.exitCode();
+}
+
+bool KBibTeXCLITest::writeFile(const QString &filename, const QByteArray &content)
+{
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly))
+        return false;
+    const bool ok = file.write(content) == content.size();
+    file.close();
+    return ok;
+}
+
+void KBibTeXCLITest::mergeDuplicateIds_data()
+{
+    QTest::addColumn<QString>("policy");
+    QTest::addColumn<int>("exitCode");
+    /// Ids and titles of merged entries, each as 'id:title'
+    QTest::addColumn<QStringList>("expectedEntries");
+    /// Cross-references of merged entries, each as 'id:crossref'
+    QTest::addColumn<QStringList>("expectedCrossRefs");
+
+    QTest::newRow("rename") << QStringLiteral("rename") << 0 << QStringList {QStringLiteral("smith:First A"), QStringLiteral("conf:Proceedings A"), QStringLiteral("paper:Paper A"), QStringLiteral("Smitha:First B"), QStringLiteral("talk:Talk B"), QStringLiteral("Confa:Proceedings B")} << QStringList {QStringLiteral("paper:conf"), QStringLiteral("talk:Confa")};
+    QTest::newRow("keep-first") << QStringLiteral("keep-first") << 0 << QStringList {QStringLiteral("smith:First A"), QStringLiteral("conf:Proceedings A"), QStringLiteral("paper:Paper A"), QStringLiteral("talk:Talk B")} << QStringList {QStringLiteral("paper:conf"), QStringLiteral("talk:CONF")};
+    QTest::newRow("keep-last") << QStringLiteral("keep-last") << 0 << QStringList {QStringLiteral("Smith:First B"), QStringLiteral("Conf:Proceedings B"), QStringLiteral("paper:Paper A"), QStringLiteral("talk:Talk B")} << QStringList {QStringLiteral("paper:conf"), QStringLiteral("talk:CONF")};
+    QTest::newRow("keep-all") << QStringLiteral("keep-all") << 0 << QStringList {QStringLiteral("smith:First A"), QStringLiteral("conf:Proceedings A"), QStringLiteral("paper:Paper A"), QStringLiteral("Smith:First B"), QStringLiteral("talk:Talk B"), QStringLiteral("Conf:Proceedings B")} << QStringList {QStringLiteral("paper:conf"), QStringLiteral("talk:CONF")};
+    QTest::newRow("fail") << QStringLiteral("fail") << 1 << QStringList() << QStringList();
+}
+
+void KBibTeXCLITest::mergeDuplicateIds()
+{
+    QFETCH(QString, policy);
+    QFETCH(int, exitCode);
+    QFETCH(QStringList, expectedEntries);
+    QFETCH(QStringList, expectedCrossRefs);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString firstFilename = tempDir.filePath(QStringLiteral("a.bib"));
+    QVERIFY(writeFile(firstFilename, "@article{smith, title = {First A}}\n"
+                      "@proceedings{conf, title = {Proceedings A}}\n"
+                      "@inproceedings{paper, crossref = {conf}, title = {Paper A}}\n"));
+    /// The entry cross-referencing an entry whose id clashes comes first;
+    /// ids clash case-insensitively, just like BibTeX compares them
+    const QString secondFilename = tempDir.filePath(QStringLiteral("b.bib"));
+    QVERIFY(writeFile(secondFilename, "@article{Smith, title = {First B}}\n"
+                      "@inproceedings{talk, crossref = {CONF}, title = {Talk B}}\n"
+                      "@proceedings{Conf, title = {Proceedings B}}\n"));
+    const QString outputFilename = tempDir.filePath(QStringLiteral("merged.bib"));
+
+    QCOMPARE(runCommandLine({firstFilename, secondFilename, QStringLiteral("-o"), outputFilename, QStringLiteral("--on-duplicate-id"), policy}), exitCode);
+    if (exitCode != 0)
+        return;
+
+    QFile outputFile(outputFilename);
+    QVERIFY(outputFile.open(QFile::ReadOnly));
+    FileImporterBibTeX importer(this);
+    QScopedPointer<File> merged(importer.load(&outputFile));
+    outputFile.close();
+    QVERIFY(!merged.isNull());
+
+    QStringList entries, crossRefs;
+    for (const QSharedPointer<Element> &element : const_cast<const File &>(*merged)) {
+        const QSharedPointer<const Entry> entry = element.dynamicCast<const Entry>();
+        QVERIFY(!entry.isNull());
+        /// Titles' casing may get protected by braces when written
+        const QString title = PlainTextValue::text(entry->value(Entry::ftTitle)).remove(QLatin1Char('{')).remove(QLatin1Char('}'));
+        entries.append(entry->id() + QStringLiteral(":") + title);
+        const QString crossRef = PlainTextValue::text(entry->value(Entry::ftCrossRef));
+        if (!crossRef.isEmpty())
+            crossRefs.append(entry->id() + QStringLiteral(":") + crossRef);
+    }
+    QCOMPARE(entries, expectedEntries);
+    QCOMPARE(crossRefs, expectedCrossRefs);
+}
+
+void KBibTeXCLITest::emptyOutput()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString emptyFilename = tempDir.filePath(QStringLiteral("empty.bib"));
+    QVERIFY(writeFile(emptyFilename, "\n"));
+    const QString otherEmptyFilename = tempDir.filePath(QStringLiteral("other.bib"));
+    QVERIFY(writeFile(otherEmptyFilename, "\n\n"));
+
+    /// Converting an empty bibliography to stdout is not an error, neither
+    /// for a single input file nor when merging several input files
+    QByteArray standardOutput;
+    QCOMPARE(runCommandLine({emptyFilename}, &standardOutput), 0);
+    QVERIFY(standardOutput.trimmed().isEmpty());
+    QCOMPARE(runCommandLine({emptyFilename, otherEmptyFilename}, &standardOutput), 0);
+    QVERIFY(standardOutput.trimmed().isEmpty());
+}
+
+void KBibTeXCLITest::validateIdsAndCrossRefs()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString filename = tempDir.filePath(QStringLiteral("input.bib"));
+    QVERIFY(writeFile(filename, "@article{Smith, author = {Smith, John}, title = {First}, journal = {Journal}, year = {2000}}\n"
+                      "@article{smith, author = {Smith, Jane}, title = {Second}, journal = {Journal}, year = {2001}}\n"
+                      "@inproceedings{paper, author = {Doe, Jo}, title = {Paper}, year = {2002}, crossref = {nowhere}}\n"));
+
+    /// These checks do not depend on BibTeX being installed
+    const CheckBibTeX::Settings checkSettings {QStringLiteral("english"), QStringLiteral("plain")};
+    const CommandLineServer::Reply reply = CommandLineServer::process({CommandLineServer::Command::Validate, filename, QString(), QString(), QString()}, checkSettings);
+    QCOMPARE(reply.exitCode, 1);
+    QVERIFY(reply.messages.contains(QStringLiteral("Entry 'smith': id is already used by entry 'Smith'")));
+    QVERIFY(reply.messages.contains(QStringLiteral("Entry 'paper': cross-referenced entry 'nowhere' does not exist")));
+    QVERIFY(reply.messages.contains(QStringLiteral("Entry 'paper': required field 'booktitle' is missing")));
+}
+
+void KBibTeXCLITest::serverMessageRoundTrip()
+{
+    const CommandLineServer::Request request {CommandLineServer::Command::FormatIds, QStringLiteral("/tmp/input.bib"), QStringLiteral("/tmp/output.ris"), QStringLiteral("ris"), QStringLiteral("A|y|T")};
+    CommandLineServer::Request decodedRequest {CommandLineServer::Command::Convert, QString(), QString(), QString(), QString()};
+    QVERIFY(CommandLineServer::decodeRequest(CommandLineServer::encodeRequest(request), decodedRequest));
+    QCOMPARE(decodedRequest.command, request.command);
+    QCOMPARE(decodedRequest.inputFilename, request.inputFilename);
+    QCOMPARE(decodedRequest.outputFilename, request.outputFilename);
+    QCOMPARE(decodedRequest.outputFormat, request.outputFormat);
+    QCOMPARE(decodedRequest.formatIdString, request.formatIdString);
+
+    const CommandLineServer::Reply reply {1, QByteArrayLiteral("@misc{a,\n}\n"), {QStringLiteral("First message"), QStringLiteral("Second message")}};
+    CommandLineServer::Reply decodedReply {0, QByteArray(), QStringList()};
+    QVERIFY(CommandLineServer::decodeReply(CommandLineServer::encodeReply(reply), decodedReply));
+    QCOMPARE(decodedReply.exitCode, reply.exitCode);
+    QCOMPARE(decodedReply.output, reply.output);
+    QCOMPARE(decodedReply.messages, reply.messages);
+}
+
+void KBibTeXCLITest::serverMessageRejected_data()
+{
+    QTest::addColumn<bool>("isRequest");
+    QTest::addColumn<QByteArray>("data");
+
+    const QByteArray request = CommandLineServer::encodeRequest({CommandLineServer::Command::Validate, QStringLiteral("/tmp/input.bib"), QString(), QString(), QString()});
+    const QByteArray reply = CommandLineServer::encodeReply({0, QByteArrayLiteral("output"), {QStringLiteral("message")}});
+    /// Messages start with the magic number 'KBCS' (4 bytes), followed by the protocol version (2 bytes)
+    const auto replaced = [](const QByteArray &data, int position, const QByteArray &bytes) {
+        QByteArray result = data;
+        return result.replace(position, bytes.size(), bytes);
+    };
+
+    QTest::newRow("request with bad magic") << true << replaced(request, 0, QByteArrayLiteral("KBCX"));
+    QTest::newRow("request with other version") << true << replaced(request, 4, QByteArrayLiteral("\x00\x02"));
+    /// Commands are encoded as 32 bit integers after the version
+    QTest::newRow("request with unknown command") << true << replaced(request, 6, QByteArrayLiteral("\x00\x00\x00\x63"));
+    QTest::newRow("truncated request") << true << request.left(request.size() - 3);
+    QTest::newRow("empty request") << true << QByteArray();
+    QTest::newRow("reply with bad magic") << false << replaced(reply, 0, QByteArrayLiteral("XBCS"));
+    QTest::newRow("reply with other version") << false << replaced(reply, 4, QByteArrayLiteral("\x01\x00"));
+    QTest::newRow("truncated reply") << false << reply.left(reply.size() - 3);
+    QTest::newRow("empty reply") << false << QByteArray();
+}
+
+void KBibTeXCLITest::serverMessageRejected()
+{
+    QFETCH(bool, isRequest);
+    QFETCH(QByteArray, data);
+
+    if (isRequest) {
+        CommandLineServer::Request request;
+        QVERIFY(!CommandLineServer::decodeRequest(data, request));
+    } else {
+        CommandLineServer::Reply reply;
+        QVERIFY(!CommandLineServer::decodeReply(data, reply));
+    }
+}
+
+QTEST_MAIN(KBibTeXCLITest)
+
+#include "kbibtexclitest.moc"
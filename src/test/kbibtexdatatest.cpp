@@ -1,7 +1,7 @@
 /***************************************************************************
  *   SPDX-License-Identifier: GPL-2.0-or-later
  *                                                                         *
- *   SPDX-FileCopyrightText: 2004-2023 Thomas Fischer <fischer@unix-ag.uni-kl.de>
+ *   SPDX-FileCopyrightText: 2004-2025 Thomas Fischer <fischer@unix-ag.uni-kl.de>
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -24,6 +24,24 @@
 #include <Value>
 #include <Entry>
 #include <Macro>
+#include <Preamble>
+#include <File>
+#include <FileModel>
+#include <BibTeXFields>
+#include <BibTeXEntries>
+#include <JournalAbbreviations>
+#include <IdSuggestions>
+#include <BibliographyStatistics>
+#include <CheckBibTeX>
+#include <CheckBibTeXModel>
+
+/// Gives access to the constructor, so that each test can load the current abbreviation list
+class TestJournalAbbreviations : public JournalAbbreviations
+{
+public:
+    TestJournalAbbreviations() = default;
+    ~TestJournalAbbreviations() = default;
+};
 
 class KBibTeXDataTest : public QObject
 {
@@ -48,7 +66,30 @@ private Q_SLOTS:
     void beautifyingMonths_data();
     void beautifyingMonths();
 
+    void fileModelInsertRowList();
+    void fileModelRemoveRowList_data();
+    void fileModelRemoveRowList();
+    void fileModelRenderCache();
+
+    void bibTeXEntriesAndFieldsLookup_data();
+    void bibTeXEntriesAndFieldsLookup();
+
+    void journalAbbreviationsIndex();
+    void journalAbbreviationsConvertJournals();
+
+    void idSuggestionsFormatProgram_data();
+    void idSuggestionsFormatProgram();
+    void idSuggestionsApplyFormatId();
+    void idSuggestionsApplyFormatIdManyCollisions();
+
+    void bibliographyStatisticsIncremental();
+
+    void checkBibTeXParseBibTeXLog();
+    void checkBibTeXModelSplitIntoShards();
+
 private:
+    static QSharedPointer<Entry> entryForIdSuggestions(const QString &id, const QString &lastName, const QString &year);
+    static void writeJournalAbbreviationList(const QByteArray &content);
 };
 
 
@@ -276,9 +317,534 @@ void KBibTeXDataTest::beautifyingMonths()
     QCOMPARE(PlainTextValue::text(monthsInput), expectedWithoutBeautification);
 }
 
+void KBibTeXDataTest::fileModelInsertRowList()
+{
+    File file;
+    file.append(QSharedPointer<Entry>(new Entry(Entry::etArticle, QStringLiteral("smith"))));
+    file.append(QSharedPointer<Macro>(new Macro(QStringLiteral("jones"))));
+    FileModel model;
+    model.setBibliographyFile(&file);
+
+    const QVector<QSharedPointer<Element>> elements {
+        QSharedPointer<Entry>(new Entry(Entry::etBook, QStringLiteral("smith"))),
+        QSharedPointer<Entry>(new Entry(Entry::etBook, QStringLiteral("jones"))),
+        QSharedPointer<Entry>(new Entry(Entry::etBook, QStringLiteral("smith")))
+    };
+    QVERIFY(model.insertRowList(elements, 1));
+    QCOMPARE(model.rowCount(), 5);
+    /// Clashing ids got resolved, considering both existing and newly inserted elements
+    QCOMPARE(file.allKeys(), QStringList() << QStringLiteral("smith") << QStringLiteral("smith_2") << QStringLiteral("jones_2") << QStringLiteral("smith_3") << QStringLiteral("jones"));
+    for (int row = 0; row < file.count(); ++row)
+        QCOMPARE(model.row(file.at(row)), row);
+
+    /// Rows must stay correct when the file gets modified bypassing the model
+    const QSharedPointer<Element> last = file.last();
+    file.removeFirst();
+    QCOMPARE(model.row(last), file.count() - 1);
+    QCOMPARE(model.row(QSharedPointer<Entry>(new Entry())), -1);
+    /// Elements added bypassing the model are found, too
+    const QSharedPointer<Element> appended(new Entry(Entry::etMisc, QStringLiteral("appended")));
+    file.append(appended);
+    QCOMPARE(model.row(appended), file.count() - 1);
+    QCOMPARE(model.row(QSharedPointer<Entry>(new Entry())), -1);
+}
+
+void KBibTeXDataTest::fileModelRemoveRowList_data()
+{
+    QTest::addColumn<int>("fileSize");
+    QTest::addColumn<QList<int>>("rowsToRemove");
+    QTest::addColumn<bool>("expectedSuccess");
+
+    QTest::newRow("Nothing to remove") << 5 << QList<int>() << true;
+    QTest::newRow("Single row") << 5 << (QList<int>() << 2) << true;
+    QTest::newRow("Two ranges, unordered, with duplicates") << 10 << (QList<int>() << 7 << 1 << 2 << 8 << 1) << true;
+    QList<int> everyOtherRow;
+    for (int row = 0; row < 200; row += 2)
+        everyOtherRow << row;
+    QTest::newRow("Many ranges") << 200 << everyOtherRow << true;
+    QTest::newRow("Invalid row") << 5 << (QList<int>() << 1 << 5) << false;
+}
+
+void KBibTeXDataTest::fileModelRemoveRowList()
+{
+    QFETCH(int, fileSize);
+    QFETCH(QList<int>, rowsToRemove);
+    QFETCH(bool, expectedSuccess);
+
+    File file;
+    for (int i = 0; i < fileSize; ++i)
+        file.append(QSharedPointer<Entry>(new Entry(Entry::etMisc, QString::number(i))));
+    FileModel model;
+    model.setBibliographyFile(&file);
+
+    QStringList expectedKeys;
+    for (int i = 0; i < fileSize; ++i)
+        if (!expectedSuccess || !rowsToRemove.contains(i))
+            expectedKeys << QString::number(i);
+
+    QCOMPARE(model.removeRowList(rowsToRemove), expectedSuccess);
+    QCOMPARE(file.allKeys(), expectedKeys);
+    QCOMPARE(model.rowCount(), expectedKeys.count());
+    for (int row = 0; row < file.count(); ++row)
+        QCOMPARE(model.row(file.at(row)), row);
+}
+
+void KBibTeXDataTest::fileModelRenderCache()
+{
+    int titleColumn = -1;
+    for (int column = 0; titleColumn < 0 && column < BibTeXFields::instance().count(); ++column)
+        if (BibTeXFields::instance().at(column).upperCamelCase.toLower() == Entry::ftTitle)
+            titleColumn = column;
+    if (titleColumn < 0)
+        QSKIP("No title column configured");
+
+    File file;
+    QSharedPointer<Entry> entry(new Entry(Entry::etArticle, QStringLiteral("smith")));
+    entry->insert(Entry::ftTitle, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("First"))));
+    file.append(entry);
+    FileModel model;
+    model.setBibliographyFile(&file);
+
+    const QModelIndex index = model.index(0, titleColumn);
+    QCOMPARE(model.data(index).toString(), QStringLiteral("First"));
+    entry->remove(Entry::ftTitle);
+    entry->insert(Entry::ftTitle, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Second"))));
+    /// Cached until model gets notified about the change
+    QCOMPARE(model.data(index).toString(), QStringLiteral("First"));
+    model.elementChanged(0);
+    QCOMPARE(model.data(index).toString(), QStringLiteral("Second"));
+
+    entry->remove(Entry::ftTitle);
+    model.allElementsChanged();
+    QCOMPARE(model.data(index).toString(), QString());
+}
+
+void KBibTeXDataTest::bibTeXEntriesAndFieldsLookup_data()
+{
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<bool>("isEntryType");
+    QTest::addColumn<QString>("expectedEntryUpperCamelCase");
+    QTest::addColumn<bool>("isField");
+    QTest::addColumn<QString>("expectedFieldUpperCamelCase");
+
+    QTest::newRow("Lower case entry type") << QStringLiteral("inproceedings") << true << QStringLiteral("InProceedings") << false << QStringLiteral("Inproceedings");
+    QTest::newRow("Upper case entry type") << QStringLiteral("PHDTHESIS") << true << QStringLiteral("PhDThesis") << false << QStringLiteral("Phdthesis");
+    QTest::newRow("Lower case field name") << QStringLiteral("booktitle") << false << QStringLiteral("Booktitle") << true << QStringLiteral("BookTitle");
+    QTest::newRow("Mixed case field name") << QStringLiteral("bOoKtItLe") << false << QStringLiteral("Booktitle") << true << QStringLiteral("BookTitle");
+    QTest::newRow("Unknown name") << QStringLiteral("xyzzy") << false << QStringLiteral("Xyzzy") << false << QStringLiteral("Xyzzy");
+}
+
+void KBibTeXDataTest::bibTeXEntriesAndFieldsLookup()
+{
+    QFETCH(QString, name);
+    QFETCH(bool, isEntryType);
+    QFETCH(QString, expectedEntryUpperCamelCase);
+    QFETCH(bool, isField);
+    QFETCH(QString, expectedFieldUpperCamelCase);
+
+    QCOMPARE(BibTeXEntries::instance().format(name, KBibTeX::Casing::UpperCamelCase), expectedEntryUpperCamelCase);
+    QCOMPARE(BibTeXEntries::instance().label(name).isEmpty(), !isEntryType);
+    QCOMPARE(BibTeXEntries::instance().label(name.toUpper()), BibTeXEntries::instance().label(name));
+
+    QCOMPARE(BibTeXFields::instance().format(name, KBibTeX::Casing::UpperCamelCase), expectedFieldUpperCamelCase);
+    QCOMPARE(BibTeXFields::instance().format(name, KBibTeX::Casing::LowerCase), name.toLower());
+    QCOMPARE(BibTeXFields::instance().find(name).upperCamelCase, isField ? expectedFieldUpperCamelCase : QString());
+}
+
+void KBibTeXDataTest::writeJournalAbbreviationList(const QByteArray &content)
+{
+    const QString dataDirectory = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/kbibtex");
+    QVERIFY(QDir().mkpath(dataDirectory));
+    QFile listFile(dataDirectory + QStringLiteral("/jabref_journalabbrevlist.txt"));
+    QVERIFY(listFile.open(QFile::WriteOnly));
+    listFile.write(content);
+    listFile.close();
+}
+
+void KBibTeXDataTest::journalAbbreviationsIndex()
+{
+    const QString indexFilename = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/journalabbreviations.idx");
+    QFile::remove(indexFilename);
+    writeJournalAbbreviationList(QByteArrayLiteral("# Comment\nAccounts of Chemical Research=Acc. Chem. Res.;ACHRE4;M\nCommunications of the ACM = Commun. ACM\nCommunications of the ACM=Comm. ACM\n\nZeitschrift f\xc3\xbcr Physik=Z. Phys.\n"));
+
+    {
+        /// Compiles the text list into an index
+        TestJournalAbbreviations compiling;
+        QCOMPARE(compiling.toShortName(QStringLiteral("Accounts of Chemical Research")), QStringLiteral("Acc. Chem. Res."));
+        QVERIFY(QFileInfo::exists(indexFilename));
+    }
+
+    /// Uses the previously compiled index
+    TestJournalAbbreviations mapping;
+    QCOMPARE(mapping.toShortName(QStringLiteral("Accounts of Chemical Research")), QStringLiteral("Acc. Chem. Res."));
+    QCOMPARE(mapping.toLongName(QStringLiteral("Acc. Chem. Res.")), QStringLiteral("Accounts of Chemical Research"));
+    /// Of several abbreviations, the shorter one is kept, but both can be expanded
+    QCOMPARE(mapping.toShortName(QStringLiteral("Communications of the ACM")), QStringLiteral("Comm. ACM"));
+    QCOMPARE(mapping.toLongName(QStringLiteral("Commun. ACM")), QStringLiteral("Communications of the ACM"));
+    QCOMPARE(mapping.toLongName(QStringLiteral("Comm. ACM")), QStringLiteral("Communications of the ACM"));
+    QCOMPARE(mapping.toShortName(QString::fromUtf8("Zeitschrift f\xc3\xbcr Physik")), QStringLiteral("Z. Phys."));
+    /// Unknown names are returned unchanged
+    QCOMPARE(mapping.toShortName(QStringLiteral("Journal of Irreproducible Results")), QStringLiteral("Journal of Irreproducible Results"));
+    QCOMPARE(mapping.toLongName(QStringLiteral("Acc. Chem.")), QStringLiteral("Acc. Chem."));
+
+    /// A modified list invalidates the index
+    writeJournalAbbreviationList(QByteArrayLiteral("Accounts of Chemical Research=Accts. Chem. Res.\n"));
+    TestJournalAbbreviations recompiling;
+    QCOMPARE(recompiling.toShortName(QStringLiteral("Accounts of Chemical Research")), QStringLiteral("Accts. Chem. Res."));
+    QCOMPARE(recompiling.toShortName(QStringLiteral("Communications of the ACM")), QStringLiteral("Communications of the ACM"));
+}
+
+void KBibTeXDataTest::journalAbbreviationsConvertJournals()
+{
+    writeJournalAbbreviationList(QByteArrayLiteral("Accounts of Chemical Research=Acc. Chem. Res.\nCommunications of the ACM=Commun. ACM\n"));
+    TestJournalAbbreviations journalAbbreviations;
+
+    File file;
+    QSharedPointer<Entry> plain(new Entry(Entry::etArticle, QStringLiteral("plain")));
+    plain->insert(Entry::ftJournal, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Accounts of Chemical Research"))));
+    file.append(plain);
+    QSharedPointer<Entry> unknown(new Entry(Entry::etArticle, QStringLiteral("unknown")));
+    unknown->insert(Entry::ftJournal, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Journal of Irreproducible Results"))));
+    file.append(unknown);
+    QSharedPointer<Entry> macro(new Entry(Entry::etArticle, QStringLiteral("macro")));
+    macro->insert(Entry::ftJournal, Value() << QSharedPointer<MacroKey>(new MacroKey(QStringLiteral("cacm"))));
+    file.append(macro);
+    file.append(QSharedPointer<Macro>(new Macro(QStringLiteral("cacm"), Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Communications of the ACM"))))));
+
+    QCOMPARE(journalAbbreviations.convertJournals(file, JournalAbbreviations::Direction::ToShortName), 1);
+    QCOMPARE(PlainTextValue::text(plain->value(Entry::ftJournal)), QStringLiteral("Acc. Chem. Res."));
+    QCOMPARE(PlainTextValue::text(unknown->value(Entry::ftJournal)), QStringLiteral("Journal of Irreproducible Results"));
+    QVERIFY(!macro->value(Entry::ftJournal).first().dynamicCast<MacroKey>().isNull());
+
+    /// Converting back restores the original names
+    QCOMPARE(journalAbbreviations.convertJournals(file, JournalAbbreviations::Direction::ToLongName), 1);
+    QCOMPARE(PlainTextValue::text(plain->value(Entry::ftJournal)), QStringLiteral("Accounts of Chemical Research"));
+    QCOMPARE(journalAbbreviations.convertJournals(file, JournalAbbreviations::Direction::ToLongName), 0);
+}
+
+QSharedPointer<Entry> KBibTeXDataTest::entryForIdSuggestions(const QString &id, const QString &lastName, const QString &year)
+{
+    QSharedPointer<Entry> entry(new Entry(Entry::etArticle, id));
+    if (!lastName.isEmpty())
+        entry->insert(Entry::ftAuthor, Value() << QSharedPointer<Person>(new Person(QStringLiteral("John"), lastName)) << QSharedPointer<Person>(new Person(QStringLiteral("Jane"), QStringLiteral("Doe"))));
+    if (!year.isEmpty())
+        entry->insert(Entry::ftYear, Value() << QSharedPointer<PlainText>(new PlainText(year)));
+    entry->insert(Entry::ftTitle, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("A Study of the Efficient Parsing"))));
+    return entry;
+}
+
+void KBibTeXDataTest::idSuggestionsFormatProgram_data()
+{
+    QTest::addColumn<QString>("formatStr");
+    QTest::addColumn<QString>("expectedId");
+
+    QTest::newRow("First author and year") << QStringLiteral("a|Y") << QStringLiteral("Smith2005");
+    QTest::newRow("Lower case author, literal text, short year") << QStringLiteral("al|\"_|y") << QStringLiteral("smith_05");
+    QTest::newRow("All authors") << QStringLiteral("A|y") << QStringLiteral("SmithDoe05");
+    QTest::newRow("Title without small words") << QStringLiteral("T") << QStringLiteral("studyefficientparsing");
+    QTest::newRow("Empty format") << QString() << QString();
+}
+
+void KBibTeXDataTest::idSuggestionsFormatProgram()
+{
+    QFETCH(QString, formatStr);
+    QFETCH(QString, expectedId);
+
+    const QSharedPointer<Entry> entry = entryForIdSuggestions(QStringLiteral("id"), QStringLiteral("Smith"), QStringLiteral("2005"));
+    const IdSuggestions::FormatProgram program(formatStr);
+    QCOMPARE(program.isEmpty(), formatStr.isEmpty());
+    /// A compiled program can be applied repeatedly
+    QCOMPARE(program.apply(*entry), expectedId);
+    QCOMPARE(program.apply(*entry), expectedId);
+    QCOMPARE(IdSuggestions::formatId(*entry, formatStr), expectedId);
+}
+
+void KBibTeXDataTest::idSuggestionsApplyFormatId()
+{
+    File file;
+    file.append(entryForIdSuggestions(QStringLiteral("e1"), QStringLiteral("Smith"), QStringLiteral("2005")));
+    file.append(entryForIdSuggestions(QStringLiteral("e2"), QStringLiteral("Smith"), QStringLiteral("2005")));
+    file.append(QSharedPointer<Macro>(new Macro(QStringLiteral("m"), Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Macro"))))));
+    file.append(entryForIdSuggestions(QStringLiteral("e3"), QStringLiteral("Smith"), QStringLiteral("2005")));
+    file.append(entryForIdSuggestions(QStringLiteral("e4"), QString(), QString()));
+    file.append(entryForIdSuggestions(QStringLiteral("Jones2001"), QStringLiteral("Jones"), QStringLiteral("2001")));
+
+    const IdSuggestions::BulkFormatIdResult result = IdSuggestions::applyFormatId(file, QStringLiteral("a|Y"));
+    QCOMPARE(result.changedIds, 3);
+    QCOMPARE(result.resolvedCollisions, 2);
+    QCOMPARE(result.emptyIds, 1);
+    /// Collisions get resolved in the entries' order
+    QCOMPARE(file.at(0).dynamicCast<Entry>()->id(), QStringLiteral("Smith2005"));
+    QCOMPARE(file.at(1).dynamicCast<Entry>()->id(), QStringLiteral("Smith2005a"));
+    QCOMPARE(file.at(3).dynamicCast<Entry>()->id(), QStringLiteral("Smith2005b"));
+    /// Entries without a generated id keep their id
+    QCOMPARE(file.at(4).dynamicCast<Entry>()->id(), QStringLiteral("e4"));
+    QCOMPARE(file.at(5).dynamicCast<Entry>()->id(), QStringLiteral("Jones2001"));
+
+    /// Reserved ids, e.g. of entries not being re-keyed, are never generated
+    const QVector<QSharedPointer<Entry>> entries {entryForIdSuggestions(QStringLiteral("x1"), QStringLiteral("Smith"), QStringLiteral("2005")), entryForIdSuggestions(QStringLiteral("x2"), QStringLiteral("Smith"), QStringLiteral("2005"))};
+    const IdSuggestions::BulkFormatIdResult reservedResult = IdSuggestions::applyFormatId(entries, QStringLiteral("a|Y"), QSet<QString> {QStringLiteral("Smith2005"), QStringLiteral("Smith2005a")});
+    QCOMPARE(reservedResult.resolvedCollisions, 2);
+    QCOMPARE(entries[0]->id(), QStringLiteral("Smith2005b"));
+    QCOMPARE(entries[1]->id(), QStringLiteral("Smith2005c"));
+
+    /// Ids kept by entries without a generated id are not generated for entries before them
+    const QVector<QSharedPointer<Entry>> keptIdEntries {entryForIdSuggestions(QStringLiteral("y1"), QStringLiteral("Smith"), QStringLiteral("2005")), entryForIdSuggestions(QStringLiteral("Smith2005"), QString(), QString())};
+    const IdSuggestions::BulkFormatIdResult keptIdResult = IdSuggestions::applyFormatId(keptIdEntries, QStringLiteral("a|Y"));
+    QCOMPARE(keptIdResult.emptyIds, 1);
+    QCOMPARE(keptIdResult.resolvedCollisions, 1);
+    QCOMPARE(keptIdEntries[0]->id(), QStringLiteral("Smith2005a"));
+    QCOMPARE(keptIdEntries[1]->id(), QStringLiteral("Smith2005"));
+}
+
+void KBibTeXDataTest::idSuggestionsApplyFormatIdManyCollisions()
+{
+    /// Enough entries to generate ids in parallel and to need two-letter suffixes
+    QVector<QSharedPointer<Entry>> entries;
+    for (int i = 0; i < 100; ++i)
+        entries.append(entryForIdSuggestions(QString(QStringLiteral("e%1")).arg(i), QStringLiteral("Smith"), QStringLiteral("2005")));
+
+    const IdSuggestions::BulkFormatIdResult result = IdSuggestions::applyFormatId(entries, QStringLiteral("a|Y"));
+    QCOMPARE(result.changedIds, 100);
+    QCOMPARE(result.resolvedCollisions, 99);
+    QCOMPARE(entries[0]->id(), QStringLiteral("Smith2005"));
+    QCOMPARE(entries[1]->id(), QStringLiteral("Smith2005a"));
+    QCOMPARE(entries[26]->id(), QStringLiteral("Smith2005z"));
+    QCOMPARE(entries[27]->id(), QStringLiteral("Smith2005aa"));
+    QCOMPARE(entries[99]->id(), QStringLiteral("Smith2005cu"));
+    QSet<QString> ids;
+    for (const QSharedPointer<Entry> &entry : const_cast<const QVector<QSharedPointer<Entry>> &>(entries))
+        ids.insert(entry->id());
+    QCOMPARE(ids.count(), 100);
+}
+
 void KBibTeXDataTest::initTestCase()
 {
-    // TODO
+    /// Keep abbreviation lists and caches written by tests away from the user's files
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KBibTeXDataTest::bibliographyStatisticsIncremental()
+{
+    const auto article = [](const QString &id, const QString &year, const QString &journal, const QVector<QSharedPointer<Person>> &authors) {
+        QSharedPointer<Entry> entry(new Entry(Entry::etArticle, id));
+        entry->insert(Entry::ftYear, Value() << QSharedPointer<PlainText>(new PlainText(year)));
+        entry->insert(Entry::ftJournal, Value() << QSharedPointer<PlainText>(new PlainText(journal)));
+        Value authorsValue;
+        for (const QSharedPointer<Person> &author : authors)
+            authorsValue.append(author);
+        entry->insert(Entry::ftAuthor, authorsValue);
+        return entry;
+    };
+    const QSharedPointer<Person> smith(new Person(QStringLiteral("John"), QStringLiteral("Smith")));
+    const QSharedPointer<Person> doe(new Person(QStringLiteral("Jane"), QStringLiteral("Doe")));
+
+    File file;
+    const QSharedPointer<Entry> first = article(QStringLiteral("smith2001"), QStringLiteral("2001"), QStringLiteral("Nature"), {smith});
+    file.append(first);
+    QSharedPointer<Entry> book(new Entry(Entry::etBook, QStringLiteral("doe2001")));
+    book->insert(Entry::ftYear, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("2001"))));
+    file.append(book);
+    file.append(QSharedPointer<Macro>(new Macro(QStringLiteral("nat"), Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Nature"))))));
+    FileModel model;
+    model.setBibliographyFile(&file);
+
+    BibliographyStatistics statistics;
+    statistics.setFileModel(&model);
+    QSignalSpy changedSpy(&statistics, &BibliographyStatistics::changed);
+    const BibliographyStatistics::Summary &summary = statistics.summary();
+    QCOMPARE(summary.numElements, 3);
+    QCOMPARE(summary.numEntries, 2);
+    QCOMPARE(summary.numMacros, 1);
+    QCOMPARE(summary.entryTypes.value(Entry::etBook.toLower()), 1);
+    QCOMPARE(summary.years.value(2001), 2);
+    QCOMPARE(summary.venues.value(QStringLiteral("Nature")), 1);
+    QCOMPARE(summary.authors.value(QStringLiteral("Smith, John")), 1);
+    QCOMPARE(summary.fillRate(Entry::ftJournal), 0.5);
+
+    /// Inserted rows get added
+    const QSharedPointer<Entry> second = article(QStringLiteral("smithdoe2005"), QStringLiteral("2005"), QStringLiteral("Nature"), {smith, doe});
+    QVERIFY(model.insertRow(second, model.rowCount()));
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(summary.numElements, 4);
+    QCOMPARE(summary.numEntries, 3);
+    QCOMPARE(summary.years.value(2005), 1);
+    QCOMPARE(summary.venues.value(QStringLiteral("Nature")), 2);
+    QCOMPARE(summary.authors.value(QStringLiteral("Smith, John")), 2);
+    QCOMPARE(summary.authors.value(QStringLiteral("Doe, Jane")), 1);
+
+    /// Changed rows replace their previous contribution
+    first->insert(Entry::ftYear, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("2005"))));
+    first->insert(Entry::ftJournal, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Science"))));
+    model.elementChanged(model.row(first));
+    QCOMPARE(changedSpy.count(), 2);
+    QCOMPARE(summary.numEntries, 3);
+    QCOMPARE(summary.years.value(2001), 1);
+    QCOMPARE(summary.years.value(2005), 2);
+    QCOMPARE(summary.venues.value(QStringLiteral("Nature")), 1);
+    QCOMPARE(summary.venues.value(QStringLiteral("Science")), 1);
+
+    /// Removed rows get subtracted, counts dropping to zero vanish
+    QVERIFY(model.removeRow(model.row(second)));
+    QCOMPARE(changedSpy.count(), 3);
+    QCOMPARE(summary.numElements, 3);
+    QCOMPARE(summary.years.value(2005), 1);
+    QVERIFY(!summary.venues.contains(QStringLiteral("Nature")));
+    QVERIFY(!summary.authors.contains(QStringLiteral("Doe, Jane")));
+    QCOMPARE(summary.authors.value(QStringLiteral("Smith, John")), 1);
+
+    /// Enough rows to get extracted in parallel
+    QVector<QSharedPointer<Element>> manyEntries;
+    for (int i = 0; i < 1000; ++i)
+        manyEntries.append(article(QStringLiteral("many%1").arg(i), QString::number(1900 + i % 100), QStringLiteral("Journal %1").arg(i % 7), {i % 2 == 0 ? smith : doe}));
+    QVERIFY(model.insertRowList(manyEntries, 1));
+    QCOMPARE(summary.numEntries, 1002);
+    QCOMPARE(summary.authors.value(QStringLiteral("Doe, Jane")), 500);
+
+    /// Incrementally maintained statistics must match statistics computed from scratch
+    BibliographyStatistics fromScratch;
+    fromScratch.setFileModel(&model);
+    const BibliographyStatistics::Summary &expected = fromScratch.summary();
+    QCOMPARE(summary.numElements, expected.numElements);
+    QCOMPARE(summary.numEntries, expected.numEntries);
+    QCOMPARE(summary.numMacros, expected.numMacros);
+    QCOMPARE(summary.entryTypes, expected.entryTypes);
+    QCOMPARE(summary.years, expected.years);
+    QCOMPARE(summary.venues, expected.venues);
+    QCOMPARE(summary.authors, expected.authors);
+    QCOMPARE(summary.fields, expected.fields);
+}
+
+void KBibTeXDataTest::checkBibTeXParseBibTeXLog()
+{
+    const QString bibTeXSource = QStringLiteral("% Test bibliography\n"
+                                 "@article{smith2001,\n"
+                                 "\ttitle = {First},\n"
+                                 "\tyear = 2001x,\n"
+                                 "}\n"
+                                 "\n"
+                                 "@string{nat = {Nature}}\n"
+                                 "@book{doe2002,\n"
+                                 "\ttitle = {Second}\n"
+                                 "}\n");
+    const QSet<QString> entryIds {QStringLiteral("smith2001"), QStringLiteral("doe2002")};
+    const QString bibTeXLog = QStringLiteral("This is BibTeX, Version 0.99d (TeX Live 2023)\n"
+                              "The top-level auxiliary file: bibtex-to-blg.aux\n"
+                              "The style file: plain.bst\n"
+                              "Database file #1: bibtex-to-blg.bib\n"
+                              "I was expecting a `,' or a `}'---line 4 of file bibtex-to-blg.bib\n"
+                              " : \tyear = 2001\n"
+                              " :             x,\n"
+                              "I'm skipping whatever remains of this entry\n"
+                              "Repeated entry---line 9 of file bibtex-to-blg.bib\n"
+                              "Illegal end of database file---line 99 of file bibtex-to-blg.bib\n"
+                              "Warning--empty journal in smith2001\n"
+                              "Warning--to sort, need author or key in doe2002\n"
+                              "Warning--can't use both author and editor fields in doe2002\n"
+                              "Warning--I didn't find a database entry for \"jones1999\"\n"
+                              "Warning--something unexpected\n"
+                              "(There were 3 error messages)\n");
+
+    QVector<CheckBibTeX::Diagnostic> diagnostics;
+    QCOMPARE(CheckBibTeX::parseBibTeXLog(bibTeXLog, bibTeXSource, entryIds, diagnostics), CheckBibTeX::CheckBibTeXResult::BibTeXError);
+    QCOMPARE(diagnostics.count(), 8);
+
+    /// Errors are mapped via their line number to the entry starting before it
+    QCOMPARE(diagnostics[0].severity, CheckBibTeX::Diagnostic::Severity::Error);
+    QCOMPARE(diagnostics[0].id, QStringLiteral("smith2001"));
+    QCOMPARE(diagnostics[0].message, QStringLiteral("I was expecting a `,' or a `}' in line <tt>year = 2001x,</tt>"));
+    /// Macros in between are not entries
+    QCOMPARE(diagnostics[1].id, QStringLiteral("doe2002"));
+    QCOMPARE(diagnostics[1].message, QStringLiteral("Repeated entry in line <tt>title = {Second}</tt>"));
+    /// Line numbers beyond the .bib file cannot be mapped
+    QCOMPARE(diagnostics[2].severity, CheckBibTeX::Diagnostic::Severity::Error);
+    QCOMPARE(diagnostics[2].id, QString());
+    QCOMPARE(diagnostics[2].message, QStringLiteral("Illegal end of database file"));
+
+    /// Warnings name their entry
+    QCOMPARE(diagnostics[3].severity, CheckBibTeX::Diagnostic::Severity::Warning);
+    QCOMPARE(diagnostics[3].id, QStringLiteral("smith2001"));
+    QCOMPARE(diagnostics[3].message, QStringLiteral("Field <b>journal</b> is empty"));
+    QCOMPARE(diagnostics[4].id, QStringLiteral("doe2002"));
+    QCOMPARE(diagnostics[4].message, QStringLiteral("Fields <b>author</b> or <b>key</b> are required to sort entry"));
+    QCOMPARE(diagnostics[5].id, QStringLiteral("doe2002"));
+    QCOMPARE(diagnostics[5].message, QStringLiteral("Fields <b>author</b> and <b>editor</b> cannot be used at the same time"));
+    QCOMPARE(diagnostics[6].id, QStringLiteral("jones1999"));
+    QCOMPARE(diagnostics[6].message, QStringLiteral("Unknown warning: I didn't find a database entry for &quot;jones1999&quot;"));
+    QCOMPARE(diagnostics[7].id, QString());
+    QCOMPARE(diagnostics[7].message, QStringLiteral("Unknown warning: something unexpected"));
+
+    /// Only warnings
+    diagnostics.clear();
+    QCOMPARE(CheckBibTeX::parseBibTeXLog(QStringLiteral("Warning--empty year in smith2001\n(There was 1 warning)\n"), bibTeXSource, entryIds, diagnostics), CheckBibTeX::CheckBibTeXResult::BibTeXWarning);
+    QCOMPARE(diagnostics.count(), 1);
+    QCOMPARE(diagnostics[0].message, QStringLiteral("Field <b>year</b> is empty"));
+
+    /// Neither warnings nor errors
+    diagnostics.clear();
+    QCOMPARE(CheckBibTeX::parseBibTeXLog(QStringLiteral("This is BibTeX, Version 0.99d (TeX Live 2023)\n"), bibTeXSource, entryIds, diagnostics), CheckBibTeX::CheckBibTeXResult::NoProblem);
+    QVERIFY(diagnostics.isEmpty());
+}
+
+void KBibTeXDataTest::checkBibTeXModelSplitIntoShards()
+{
+    File file;
+    file << QSharedPointer<Macro>(new Macro(QStringLiteral("nat"), Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Nature")))));
+    for (int i = 0; i < 1100; ++i) {
+        if (i == 700)
+            file << QSharedPointer<Preamble>(new Preamble(Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("\\newcommand{\\noopsort}[1]{}")))));
+        QSharedPointer<Entry> entry(new Entry(Entry::etArticle, QString(QStringLiteral("entry%1")).arg(i)));
+        if (i == 5)
+            /// Cross-reference to an entry in the other shard, in different casing
+            entry->insert(Entry::ftCrossRef, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("ENTRY1090"))));
+        else if (i == 600)
+            /// Cross-reference to an entry in the same shard
+            entry->insert(Entry::ftCrossRef, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("entry601"))));
+        file << entry;
+    }
+
+    /// Each shard must have at least 512 entries, so 1100 entries make only two shards
+    const QVector<CheckBibTeXModel::Shard> shards = CheckBibTeXModel::splitIntoShards(file, 8);
+    QCOMPARE(shards.count(), 2);
+
+    /// Each entry is owned by exactly one shard
+    QCOMPARE(shards[0].ownIds.count() + shards[1].ownIds.count(), 1100);
+    QVERIFY(!shards[0].ownIds.intersects(shards[1].ownIds));
+    QVERIFY(shards[0].ownIds.contains(QStringLiteral("entry0")));
+    QVERIFY(shards[0].ownIds.contains(QStringLiteral("entry549")));
+    QVERIFY(shards[1].ownIds.contains(QStringLiteral("entry550")));
+    QVERIFY(shards[1].ownIds.contains(QStringLiteral("entry1099")));
+
+    for (const CheckBibTeXModel::Shard &shard : shards) {
+        /// All macros and preambles precede the shard's entries
+        QVERIFY(Macro::isMacro(*shard.file[0]));
+        QVERIFY(Preamble::isPreamble(*shard.file[1]));
+        for (int i = 2; i < shard.file.count(); ++i)
+            QVERIFY(Entry::isEntry(*shard.file[i]));
+        /// Elements are copies, not shared with the original bibliography
+        QVERIFY(shard.file[0] != file[0]);
+    }
+
+    /// The cross-referenced entry from the other shard is appended, as BibTeX
+    /// requires it after the referencing entry, but not owned by this shard
+    QCOMPARE(shards[0].file.count(), 2 + 550 + 1);
+    const QSharedPointer<const Entry> crossRefTarget = shards[0].file.last().dynamicCast<const Entry>();
+    QVERIFY(!crossRefTarget.isNull());
+    QCOMPARE(crossRefTarget->id(), QStringLiteral("entry1090"));
+    QVERIFY(!shards[0].ownIds.contains(QStringLiteral("entry1090")));
+    QVERIFY(!shards[0].file.containsKey(QStringLiteral("nat"), File::ElementType::Macro).isNull());
+    /// Cross-references within the shard do not duplicate entries
+    QCOMPARE(shards[1].file.count(), 2 + 550);
+    QVERIFY(!shards[1].file.containsKey(QStringLiteral("nat"), File::ElementType::Macro).isNull());
+
+    /// Small bibliographies are checked in a single shard, empty ones in none
+    File smallFile;
+    for (int i = 0; i < 10; ++i)
+        smallFile << QSharedPointer<Entry>(new Entry(Entry::etBook, QString(QStringLiteral("book%1")).arg(i)));
+    const QVector<CheckBibTeXModel::Shard> smallShards = CheckBibTeXModel::splitIntoShards(smallFile, 4);
+    QCOMPARE(smallShards.count(), 1);
+    QCOMPARE(smallShards[0].ownIds.count(), 10);
+    QVERIFY(CheckBibTeXModel::splitIntoShards(File(), 0).isEmpty());
 }
 
 QTEST_MAIN(KBibTeXDataTest)
@@ -20,10 +20,15 @@
 #include <field/FieldLineEdit>
 #include <File>
 #include <Entry>
+#include <Macro>
+#include <Comment>
 #include <element/ElementEditor>
 #include "element/elementeditor_p.h"
 #include <models/FileModel>
 #include <file/SortFilterFileModel>
+#ifdef HAVE_POPPLERQT
+#include "file/pdftextindex.h"
+#endif // HAVE_POPPLERQT
 #include <preferences/SettingsGlobalKeywordsWidget>
 
 class KBibTeXGUITest : public QObject
@@ -34,15 +39,24 @@ private Q_SLOTS:
     void initTestCase();
 
     void sortedFilterFileModelSetSourceModel();
+    void sortedFilterFileModelFilter_data();
+    void sortedFilterFileModelFilter();
+#ifdef HAVE_POPPLERQT
+    void pdfTextIndexElementsContaining();
+#endif // HAVE_POPPLERQT
     void settingsGlobalKeywordsWidgetAddRemove();
     void elementEditorApply();
 
 private:
+#ifdef HAVE_POPPLERQT
+    static bool writeSinglePagePDF(const QString &filename, const QString &text);
+#endif // HAVE_POPPLERQT
 };
 
 void KBibTeXGUITest::initTestCase()
 {
-    // nothing
+    /// Keep extracted text of PDF files away from the user's cache
+    QStandardPaths::setTestModeEnabled(true);
 }
 
 void KBibTeXGUITest::sortedFilterFileModelSetSourceModel()
@@ -66,6 +80,150 @@ void KBibTeXGUITest::sortedFilterFileModelSetSourceModel()
     QCOMPARE(sortFilterProxyModel->rowCount(), 1);
 }
 
+void KBibTeXGUITest::sortedFilterFileModelFilter_data()
+{
+    QTest::addColumn<QStringList>("terms");
+    QTest::addColumn<bool>("everyTerm");
+    QTest::addColumn<QString>("field");
+    QTest::addColumn<int>("expectedRowCount");
+
+    QTest::newRow("No terms") << QStringList() << false << QString() << 4;
+    QTest::newRow("Single term in title") << (QStringList() << QStringLiteral("LITERATURE")) << false << QString() << 1;
+    QTest::newRow("Single term in id") << (QStringList() << QStringLiteral("kirsop")) << false << QString() << 1;
+    QTest::newRow("Person name as 'last, first'") << (QStringList() << QStringLiteral("Chan, Les")) << false << QString() << 1;
+    QTest::newRow("Term with braces removed") << (QStringList() << QStringLiteral("Schrodinger")) << false << QString() << 1;
+    QTest::newRow("Short term") << (QStringList() << QStringLiteral("qu")) << false << QString() << 1;
+    QTest::newRow("Any of two terms") << (QStringList() << QStringLiteral("serials") << QStringLiteral("quanten")) << false << QString() << 2;
+    QTest::newRow("Every of two terms") << (QStringList() << QStringLiteral("serials") << QStringLiteral("quanten")) << true << QString() << 0;
+    QTest::newRow("Every of two terms, one short") << (QStringList() << QStringLiteral("19") << QStringLiteral("quanten")) << true << QString() << 1;
+    QTest::newRow("Restricted to field") << (QStringList() << QStringLiteral("2005")) << false << Entry::ftTitle << 0;
+    QTest::newRow("Macro by type") << (QStringList() << QStringLiteral("macro")) << false << QStringLiteral("^type") << 1;
+    QTest::newRow("Comment text") << (QStringList() << QStringLiteral("remember")) << false << QString() << 1;
+    QTest::newRow("Nothing found") << (QStringList() << QStringLiteral("xyzzy")) << false << QString() << 0;
+}
+
+void KBibTeXGUITest::sortedFilterFileModelFilter()
+{
+    QFETCH(QStringList, terms);
+    QFETCH(bool, everyTerm);
+    QFETCH(QString, field);
+    QFETCH(int, expectedRowCount);
+
+    File *bibTeXfile = new File();
+    QSharedPointer<Entry> entry(new Entry(Entry::etArticle, QStringLiteral("kirsop2005accessrelitdevcountries")));
+    entry->insert(Entry::ftTitle, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Transforming access to research literature for developing countries"))));
+    entry->insert(Entry::ftAuthor, Value() << QSharedPointer<Person>(new Person(QStringLiteral("Barbara"), QStringLiteral("Kirsop"))) << QSharedPointer<Person>(new Person(QStringLiteral("Leslie"), QStringLiteral("Chan"))));
+    entry->insert(Entry::ftJournal, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Serials Reviews"))));
+    entry->insert(Entry::ftYear, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("2005"))));
+    bibTeXfile->append(entry);
+    entry = QSharedPointer<Entry>(new Entry(Entry::etBook, QStringLiteral("schroedinger1935")));
+    entry->insert(Entry::ftTitle, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Die gegenw{\\\"a}rtige Situation in der Quantenmechanik"))));
+    entry->insert(Entry::ftAuthor, Value() << QSharedPointer<Person>(new Person(QStringLiteral("Erwin"), QStringLiteral("Schr{o}dinger"))));
+    entry->insert(Entry::ftYear, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("1935"))));
+    bibTeXfile->append(entry);
+    bibTeXfile->append(QSharedPointer<Macro>(new Macro(QStringLiteral("chem"), Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("Chemistry"))))));
+    bibTeXfile->append(QSharedPointer<Comment>(new Comment(QStringLiteral("Remember to check these references"), Preferences::CommentContext::Command)));
+
+    QPointer<FileModel> model = new FileModel();
+    model->setBibliographyFile(bibTeXfile);
+    QPointer<SortFilterFileModel> sortFilterProxyModel = new SortFilterFileModel();
+    sortFilterProxyModel->setSourceModel(model.data());
+
+    SortFilterFileModel::FilterQuery filterQuery;
+    filterQuery.terms = terms;
+    filterQuery.combination = everyTerm ? SortFilterFileModel::FilterCombination::EveryTerm : SortFilterFileModel::FilterCombination::AnyTerm;
+    filterQuery.field = field;
+    filterQuery.searchPDFfiles = false;
+    sortFilterProxyModel->updateFilter(filterQuery);
+    QCOMPARE(sortFilterProxyModel->rowCount(), expectedRowCount);
+
+    /// Filter result must stay correct after modifying an element through the model
+    QSharedPointer<Entry> first = model->element(0).dynamicCast<Entry>();
+    first->insert(Entry::ftNote, Value() << QSharedPointer<PlainText>(new PlainText(QStringLiteral("xyzzy"))));
+    model->elementChanged(0);
+    filterQuery.terms = QStringList() << QStringLiteral("xyzzy");
+    filterQuery.combination = SortFilterFileModel::FilterCombination::AnyTerm;
+    filterQuery.field = QString();
+    sortFilterProxyModel->updateFilter(filterQuery);
+    QCOMPARE(sortFilterProxyModel->rowCount(), 1);
+
+    delete sortFilterProxyModel;
+    delete model;
+    delete bibTeXfile;
+}
+
+#ifdef HAVE_POPPLERQT
+bool KBibTeXGUITest::writeSinglePagePDF(const QString &filename, const QString &text)
+{
+    const QByteArray content = QByteArrayLiteral("BT /F1 12 Tf 72 712 Td (") + text.toLatin1() + QByteArrayLiteral(") Tj ET");
+    const QVector<QByteArray> objects {
+        QByteArrayLiteral("<< /Type /Catalog /Pages 2 0 R >>"),
+        QByteArrayLiteral("<< /Type /Pages /Kids [3 0 R] /Count 1 >>"),
+        QByteArrayLiteral("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Contents 4 0 R /Resources << /Font << /F1 5 0 R >> >> >>"),
+        QByteArrayLiteral("<< /Length ") + QByteArray::number(content.length()) + QByteArrayLiteral(" >>\nstream\n") + content + QByteArrayLiteral("\nendstream"),
+        QByteArrayLiteral("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>")
+    };
+
+    QByteArray pdf = QByteArrayLiteral("%PDF-1.4\n");
+    QVector<int> offsets;
+    for (int i = 0; i < objects.count(); ++i) {
+        offsets.append(pdf.length());
+        pdf.append(QByteArray::number(i + 1)).append(" 0 obj\n").append(objects[i]).append("\nendobj\n");
+    }
+    const int xrefOffset = pdf.length();
+    pdf.append("xref\n0 ").append(QByteArray::number(objects.count() + 1)).append("\n0000000000 65535 f \n");
+    for (const int offset : const_cast<const QVector<int> &>(offsets))
+        pdf.append(QByteArray::number(offset).rightJustified(10, '0')).append(" 00000 n \n");
+    pdf.append("trailer\n<< /Size ").append(QByteArray::number(objects.count() + 1)).append(" /Root 1 0 R >>\nstartxref\n").append(QByteArray::number(xrefOffset)).append("\n%%EOF\n");
+
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly))
+        return false;
+    const bool result = file.write(pdf) == pdf.length();
+    file.close();
+    return result;
+}
+
+void KBibTeXGUITest::pdfTextIndexElementsContaining()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    /// PDF files named after an entry's id next to the bibliography get associated with the entry
+    QVERIFY(writeSinglePagePDF(tempDir.filePath(QStringLiteral("einstein1935.pdf")), QStringLiteral("Can quantum-mechanical description of physical reality be considered complete")));
+    QVERIFY(writeSinglePagePDF(tempDir.filePath(QStringLiteral("rumelhart1986.pdf")), QStringLiteral("Learning representations by back-propagating errors")));
+
+    File bibTeXfile;
+    bibTeXfile.setProperty(File::Url, QUrl::fromLocalFile(tempDir.filePath(QStringLiteral("references.bib"))));
+    const QSharedPointer<Entry> einstein(new Entry(Entry::etArticle, QStringLiteral("einstein1935")));
+    bibTeXfile.append(einstein);
+    const QSharedPointer<Entry> rumelhart(new Entry(Entry::etArticle, QStringLiteral("rumelhart1986")));
+    bibTeXfile.append(rumelhart);
+    const QSharedPointer<Entry> withoutPdf(new Entry(Entry::etArticle, QStringLiteral("shannon1948")));
+    bibTeXfile.append(withoutPdf);
+
+    PDFTextIndex index;
+    QSignalSpy updatedSpy(&index, &PDFTextIndex::updated);
+    index.setFile(&bibTeXfile);
+    QTRY_VERIFY_WITH_TIMEOUT(!index.isLoading(), 30000);
+    QVERIFY(updatedSpy.count() > 0);
+
+    QCOMPARE(index.elementsContaining(QStringLiteral("quantum")), QSet<const Element *>() << einstein.data());
+    /// Search is case-insensitive
+    QCOMPARE(index.elementsContaining(QStringLiteral("LEARNING")), QSet<const Element *>() << rumelhart.data());
+    /// Extending a previous term only searches in that term's results
+    QCOMPARE(index.elementsContaining(QStringLiteral("re")), QSet<const Element *>() << einstein.data() << rumelhart.data());
+    QCOMPARE(index.elementsContaining(QStringLiteral("reality")), QSet<const Element *>() << einstein.data());
+    QCOMPARE(index.elementsContaining(QStringLiteral("shannon")), QSet<const Element *>());
+
+    /// Entries removed from the bibliography are no longer found
+    bibTeXfile.removeOne(einstein);
+    index.setFile(&bibTeXfile);
+    QTRY_VERIFY_WITH_TIMEOUT(!index.isLoading(), 30000);
+    QCOMPARE(index.elementsContaining(QStringLiteral("quantum")), QSet<const Element *>());
+    QCOMPARE(index.elementsContaining(QStringLiteral("errors")), QSet<const Element *>() << rumelhart.data());
+}
+#endif // HAVE_POPPLERQT
+
 void KBibTeXGUITest::settingsGlobalKeywordsWidgetAddRemove()
 {
     QPointer<SettingsGlobalKeywordsWidget> sgkw = new SettingsGlobalKeywordsWidget(nullptr);
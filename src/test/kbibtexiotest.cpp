@@ -46,6 +46,7 @@
 #include <FileExporterRIS>
 #include <FileExporterBibUtils>
 #include <FileExporterXML>
+#include <FileSnapshot>
 
 #include "logging_test.h"
 // Provides definition of KDESRCDIR
@@ -92,6 +93,7 @@ private Q_SLOTS:
     void fileInfoMimeTypeForUrl();
     void fileInfoUrlsInText_data();
     void fileInfoUrlsInText();
+    void fileInfoUrlSpansInText();
     void fileExporterXMLsave_data();
     void fileExporterXMLsave();
     void fileExporterRISsave_data();
@@ -102,12 +104,20 @@ private Q_SLOTS:
     void fileImporterRISload();
     void fileImporterBibTeXload_data();
     void fileImporterBibTeXload();
+    void fileSnapshotRoundtrip();
+    void fileSnapshotKeywordCasing();
+    void fileSnapshotKeepsWarnings();
+    void fileSnapshotPrune();
+    void fileImporterBibTeXDeferredFieldDecoding();
+    void fileImporterBibTeXparsePersonList_data();
+    void fileImporterBibTeXparsePersonList();
     void fileExporterBibTeXEncoding_data();
     void fileExporterBibTeXEncoding();
     void fileExporterBibTeXcanEncode_data();
     void fileExporterBibTeXcanEncode();
     void fileImportExportBibTeXroundtrip_data();
     void fileImportExportBibTeXroundtrip();
+    void fileImportExportBibTeXlargeRoundtrip();
     void protectiveCasingEntryGeneratedOnTheFly();
     void protectiveCasingEntryFromData();
     void partialBibTeXInput_data();
@@ -369,6 +379,9 @@ void KBibTeXIOTest::fileInfoUrlsInText_data()
     QTest::newRow("URLs and DOI (without URL), all semicolon-separated") << QStringLiteral("http://www.example.com;10.1000/38-abc   ;\nhttps://www.example.com") << QSet<QUrl> {QUrl(QStringLiteral("http://www.example.com")), QUrl(KBibTeX::doiUrlPrefix + QStringLiteral("10.1000/38-abc")), QUrl(QStringLiteral("https://www.example.com"))};
     QTest::newRow("URLs and DOI (with URL), all semicolon-separated") << QStringLiteral("http://www.example.com\n;   10.1000/38-abc;https://www.example.com") << QSet<QUrl> {QUrl(QStringLiteral("http://www.example.com")), QUrl(KBibTeX::doiUrlPrefix + QStringLiteral("10.1000/38-abc")), QUrl(QStringLiteral("https://www.example.com"))};
     QTest::newRow("URLs with various separators") << QStringLiteral("http://www.example.com/def.pdf https://www.example.com\nhttp://download.example.com/abc") << QSet<QUrl> {QUrl(QStringLiteral("http://www.example.com/def.pdf")), QUrl(QStringLiteral("https://www.example.com")), QUrl(QStringLiteral("http://download.example.com/abc"))};
+    QTest::newRow("DOI followed by URL, semicolon-separated") << QStringLiteral("10.1000/38-abc;https://doi.example.org/10.1000/42-XYZ") << QSet<QUrl> {QUrl(KBibTeX::doiUrlPrefix + QStringLiteral("10.1000/38-abc")), QUrl(KBibTeX::doiUrlPrefix + QStringLiteral("10.1000/42-XYZ"))};
+    QTest::newRow("Domain name without scheme") << QStringLiteral("www.example.org/index.html") << QSet<QUrl> {QUrl(QStringLiteral("https://www.example.org/index.html"))};
+    QTest::newRow("URL and relative file, semicolon-separated") << QStringLiteral("https://www.example.com/abc; docs/paper.pdf") << QSet<QUrl> {QUrl(QStringLiteral("https://www.example.com/abc")), QUrl::fromLocalFile(QStringLiteral("docs/paper.pdf"))};
     QTest::newRow("URLs with query strings and anchors") << QStringLiteral("http://www.example.com/def.pdf?a=3&b=1 https://www.example.com#1581584\nhttp://download.example.com/abc,7352,A#abc?gh=352&ghi=1254") << QSet<QUrl> {QUrl(QStringLiteral("http://www.example.com/def.pdf?a=3&b=1")), QUrl(QStringLiteral("https://www.example.com#1581584")), QUrl(QStringLiteral("http://download.example.com/abc,7352,A#abc?gh=352&ghi=1254"))};
 }
 
@@ -385,6 +398,21 @@ void KBibTeXIOTest::fileInfoUrlsInText()
         QCOMPARE(extractedUrls.contains(expectedUrl), true);
 }
 
+void KBibTeXIOTest::fileInfoUrlSpansInText()
+{
+    const QString text = QStringLiteral("See https://doi.example.org/10.1000/38-abc and https://www.example.com/page; paper.pdf");
+    const QVector<FileInfo::UrlSpan> spans = FileInfo::urlSpansInText(text, FileInfo::TestExistence::No, QString());
+
+    QCOMPARE(spans.count(), 3);
+    QCOMPARE(spans[0].type, FileInfo::UrlSpan::Type::DOI);
+    QCOMPARE(text.mid(spans[0].start, spans[0].length), QStringLiteral("https://doi.example.org/10.1000/38-abc"));
+    QCOMPARE(spans[0].url, QUrl(KBibTeX::doiUrlPrefix + QStringLiteral("10.1000/38-abc")));
+    QCOMPARE(spans[1].type, FileInfo::UrlSpan::Type::Url);
+    QCOMPARE(text.mid(spans[1].start, spans[1].length), QStringLiteral("https://www.example.com/page"));
+    QCOMPARE(spans[2].type, FileInfo::UrlSpan::Type::File);
+    QCOMPARE(text.mid(spans[2].start, spans[2].length), QStringLiteral("paper.pdf"));
+}
+
 static const char *fileImporterExporterTestCases_Label_Empty_file = "Empty file";
 static const char *fileImporterExporterTestCases_Label_Moby_Dick = "Moby Dick";
 static const char *fileImporterExporterTestCases_Label_Latin_Umlaut = "Latin umlaut";
@@ -718,6 +746,243 @@ void KBibTeXIOTest::fileImporterBibTeXload()
     QVERIFY(generatedFile->operator ==(*bibTeXfile));
 }
 
+void KBibTeXIOTest::fileSnapshotRoundtrip()
+{
+    static const QString bibTeX {QStringLiteral("@comment{Bibliography for testing snapshots}\n\n@string{cacm = \"Communications of the ACM\"}\n\n@preamble{\"\\newcommand{\\noopsort}[1]{}\"}\n\n@article{smith2020,\n\tauthor = {Smith, John and M{\\\"u}ller, Anna and Doe, Jr., Jane},\n\tjournal = cacm,\n\tkeywords = {parsing; bibliographies},\n\ttitle = {{Efficient Parsing of Bibliographies}},\n\turl = {https://www.example.com/},\n\tyear = {2020}\n}\n")};
+
+    FileImporterBibTeX importer(this);
+    importer.setCommentHandling(FileImporterBibTeX::CommentHandling::Keep);
+    QScopedPointer<File> file(importer.fromString(bibTeX));
+    QVERIFY(!file.isNull());
+    QCOMPARE(file->count(), 4);
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString sourceFilename {tempDir.filePath(QStringLiteral("source.bib"))};
+    QFile sourceFile(sourceFilename);
+    QVERIFY(sourceFile.open(QFile::WriteOnly));
+    sourceFile.write(bibTeX.toUtf8());
+    sourceFile.close();
+
+    const FileSnapshot::Source source {FileSnapshot::source(sourceFilename, bibTeX.toUtf8(), QStringLiteral("test"))};
+    const QString snapshotFilename {tempDir.filePath(QStringLiteral("source.snapshot"))};
+    QVERIFY(FileSnapshot::save(*file, source, snapshotFilename));
+
+    QScopedPointer<File> restoredFile(FileSnapshot::load(source, snapshotFilename));
+    QVERIFY(!restoredFile.isNull());
+    QVERIFY(file->operator ==(*restoredFile));
+    /// Comparing File objects considers entries only, so compare the generated BibTeX code as well
+    FileExporterBibTeX exporter(this);
+    QCOMPARE(exporter.toString(restoredFile.data()), exporter.toString(file.data()));
+    QCOMPARE(restoredFile->property(File::StringDelimiter), file->property(File::StringDelimiter));
+    QCOMPARE(restoredFile->property(File::SortedByIdentifier), file->property(File::SortedByIdentifier));
+
+    /// Snapshots must not be used if the source's content or the importer's settings differ,
+    /// such outdated snapshots get deleted
+    FileSnapshot::Source modifiedSource {source};
+    modifiedSource.contentHash = QCryptographicHash::hash(QByteArrayLiteral("something else"), QCryptographicHash::Sha1);
+    QVERIFY(FileSnapshot::load(modifiedSource, snapshotFilename) == nullptr);
+    QVERIFY(!QFile::exists(snapshotFilename));
+    QVERIFY(FileSnapshot::save(*file, source, snapshotFilename));
+    modifiedSource = source;
+    modifiedSource.variant = QStringLiteral("other");
+    QVERIFY(FileSnapshot::load(modifiedSource, snapshotFilename) == nullptr);
+    QVERIFY(!QFile::exists(snapshotFilename));
+}
+
+void KBibTeXIOTest::fileSnapshotKeywordCasing()
+{
+    /// Large enough for the importer to use a snapshot
+    QByteArray bibTeX;
+    for (int i = 0; bibTeX.size() < (1 << 17); ++i)
+        bibTeX.append(QString(QStringLiteral("@article{entry%1,\n\tauthor = {Smith, John},\n\ttitle = {Snapshots and Casing %1},\n\tyear = {2020}\n}\n\n")).arg(i).toUtf8());
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QFile sourceFile(tempDir.filePath(QStringLiteral("casing.bib")));
+    QVERIFY(sourceFile.open(QFile::WriteOnly));
+    sourceFile.write(bibTeX);
+    sourceFile.close();
+
+    const KBibTeX::Casing previousCasing = Preferences::instance().bibTeXKeywordCasing();
+    FileImporterBibTeX importer(this);
+    importer.setSnapshotCaching(true);
+    QStringList firstEntryKeys[2];
+    const KBibTeX::Casing casings[2] {KBibTeX::Casing::LowerCase, KBibTeX::Casing::UpperCase};
+    for (int i = 0; i < 2; ++i) {
+        Preferences::instance().setBibTeXKeywordCasing(casings[i]);
+        /// Second load of each casing may be served from the snapshot written by the first one
+        for (int j = 0; j < 2; ++j) {
+            QScopedPointer<File> file(importer.load(&sourceFile));
+            QVERIFY(!file.isNull());
+            const QSharedPointer<const Entry> entry = file->first().dynamicCast<const Entry>();
+            QVERIFY(!entry.isNull());
+            firstEntryKeys[i] = entry->keys();
+        }
+    }
+    Preferences::instance().setBibTeXKeywordCasing(previousCasing);
+
+    QCOMPARE(firstEntryKeys[0], QStringList({QStringLiteral("author"), QStringLiteral("title"), QStringLiteral("year")}));
+    QCOMPARE(firstEntryKeys[1], QStringList({QStringLiteral("AUTHOR"), QStringLiteral("TITLE"), QStringLiteral("YEAR")}));
+}
+
+void KBibTeXIOTest::fileSnapshotKeepsWarnings()
+{
+    /// Large enough for the importer to use a snapshot, with a duplicate field in the first entry
+    QByteArray bibTeX("@article{duplicate,\n\ttitle = {First},\n\ttitle = {Second}\n}\n\n");
+    for (int i = 0; bibTeX.size() < (1 << 17); ++i)
+        bibTeX.append(QString(QStringLiteral("@article{entry%1,\n\tauthor = {Smith, John},\n\ttitle = {Snapshots and Warnings %1},\n\tyear = {2020}\n}\n\n")).arg(i).toUtf8());
+
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QFile sourceFile(tempDir.filePath(QStringLiteral("warnings.bib")));
+    QVERIFY(sourceFile.open(QFile::WriteOnly));
+    sourceFile.write(bibTeX);
+    sourceFile.close();
+
+    FileImporterBibTeX importer(this);
+    importer.setSnapshotCaching(true);
+    int warningCount = 0;
+    connect(&importer, &FileImporter::message, [&warningCount](const FileImporter::MessageSeverity messageSeverity, const QString &) {
+        if (messageSeverity == FileImporter::MessageSeverity::Warning)
+            ++warningCount;
+    });
+    /// Every load has to report the duplicate field, even if an earlier load was completed
+    for (int i = 0; i < 2; ++i) {
+        warningCount = 0;
+        QScopedPointer<File> file(importer.load(&sourceFile));
+        QVERIFY(!file.isNull());
+        QCOMPARE(warningCount, 1);
+    }
+}
+
+void KBibTeXIOTest::fileSnapshotPrune()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QDateTime now {QDateTime::currentDateTime()};
+    /// Snapshots of 1000 bytes each, last used 1, 2, 3, and 60 days ago
+    const int daysAgo[4] {1, 2, 3, 60};
+    for (int i = 0; i < 4; ++i) {
+        QFile snapshotFile(tempDir.filePath(QString(QStringLiteral("%1.snapshot")).arg(i)));
+        QVERIFY(snapshotFile.open(QFile::WriteOnly));
+        snapshotFile.write(QByteArray(1000, 'x'));
+        snapshotFile.flush();
+        QVERIFY(snapshotFile.setFileTime(now.addDays(-daysAgo[i]), QFileDevice::FileModificationTime));
+        snapshotFile.close();
+    }
+    /// Other files in the same directory are left untouched
+    QFile otherFile(tempDir.filePath(QStringLiteral("other.txt")));
+    QVERIFY(otherFile.open(QFile::WriteOnly));
+    otherFile.write(QByteArray(5000, 'x'));
+    otherFile.flush();
+    QVERIFY(otherFile.setFileTime(now.addDays(-90), QFileDevice::FileModificationTime));
+    otherFile.close();
+
+    /// Nothing to do if all snapshots are recent enough and small enough
+    FileSnapshot::prune(tempDir.path(), 4000, 90);
+    QCOMPARE(QDir(tempDir.path()).entryList({QStringLiteral("*.snapshot")}, QDir::Files, QDir::Name), QStringList({QStringLiteral("0.snapshot"), QStringLiteral("1.snapshot"), QStringLiteral("2.snapshot"), QStringLiteral("3.snapshot")}));
+    /// Too old
+    FileSnapshot::prune(tempDir.path(), 4000, 30);
+    QCOMPARE(QDir(tempDir.path()).entryList({QStringLiteral("*.snapshot")}, QDir::Files, QDir::Name), QStringList({QStringLiteral("0.snapshot"), QStringLiteral("1.snapshot"), QStringLiteral("2.snapshot")}));
+    /// Too large, least recently used ones go first
+    FileSnapshot::prune(tempDir.path(), 1500, 30);
+    QCOMPARE(QDir(tempDir.path()).entryList({QStringLiteral("*.snapshot")}, QDir::Files, QDir::Name), QStringList({QStringLiteral("0.snapshot")}));
+    QVERIFY(QFile::exists(otherFile.fileName()));
+}
+
+void KBibTeXIOTest::fileImporterBibTeXDeferredFieldDecoding()
+{
+    /// Enough fields to be decoded in several chunks, including repeated author and keyword fields
+    QString bibTeX {QStringLiteral("@string{acm = \"ACM\"}\n\n")};
+    for (int i = 0; i < 1500; ++i)
+        bibTeX.append(QString(QStringLiteral("@inproceedings{entry%1,\n\tauthor = {M{\\\"u}ller, Anna and Smith, Jr., John},\n\tauthor = {Doe, Jane},\n\ttitle = {{Efficient Parsing %1}},\n\tbooktitle = acm # { Conference},\n\tkeywords = {parsing; bibliographies},\n\tkeywords = {entry %1},\n\tpages = {%1--%2},\n\turl = {https://www.example.com/%1.pdf; https://www.example.org/%1.pdf},\n\tdoi = {10.1000/test.%1},\n\tmonth = sep\n}\n\n")).arg(i).arg(i + 10));
+
+    FileImporterBibTeX importer(this);
+    QScopedPointer<File> file(importer.fromString(bibTeX));
+    QVERIFY(!file.isNull());
+    QCOMPARE(file->count(), 1501);
+
+    FileImporterBibTeX deferringImporter(this);
+    deferringImporter.setDeferredFieldDecoding(true);
+    QScopedPointer<File> deferredFile(deferringImporter.fromString(bibTeX));
+    QVERIFY(!deferredFile.isNull());
+    QVERIFY(file->operator ==(*deferredFile));
+    const QSharedPointer<const Entry> lastEntry {deferredFile->at(1500).dynamicCast<const Entry>()};
+    QVERIFY(!lastEntry.isNull());
+    QCOMPARE(lastEntry->value(Entry::ftAuthor).count(), 3);
+    QCOMPARE(lastEntry->value(Entry::ftKeywords).count(), 3);
+    for (const QString &property : {File::NameFormatting, File::ProtectCasing, File::ListSeparator})
+        QCOMPARE(deferredFile->property(property), file->property(property));
+    FileExporterBibTeX exporter(this);
+    QCOMPARE(exporter.toString(deferredFile.data()), exporter.toString(file.data()));
+}
+
+void KBibTeXIOTest::fileImporterBibTeXparsePersonList_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<Value>("expectedValue");
+
+    QTest::newRow("Last name first") << QStringLiteral("Smith, John and {M{\\\"u}ller}, Anna") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("John"), QStringLiteral("Smith"))) << QSharedPointer<Person>(new Person(QStringLiteral("Anna"), QStringLiteral("{M{\\\"u}ller}"))));
+    QTest::newRow("Last name first with suffix") << QStringLiteral("Doe, Jr., Jane") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("Jane"), QStringLiteral("Doe"), QStringLiteral("Jr."))));
+    QTest::newRow("First name first with particles") << QStringLiteral("Peter Ole van der Tuckwell") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("Peter Ole"), QStringLiteral("van der Tuckwell"))));
+    QTest::newRow("First name first with suffix") << QStringLiteral("John   Smith Jr.") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("John"), QStringLiteral("Smith"), QStringLiteral("Jr."))));
+    QTest::newRow("Capital case particle") << QStringLiteral("Roberto Di Cosmo") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("Roberto"), QStringLiteral("Di Cosmo"))));
+    QTest::newRow("PubMed style") << QStringLiteral("Tuckwell P H") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("P H"), QStringLiteral("Tuckwell"))));
+    QTest::newRow("Protected name") << QStringLiteral("{Barnes and Noble, Inc.}") << (Value() << QSharedPointer<Person>(new Person(QString(), QStringLiteral("{Barnes and Noble, Inc.}"))));
+    QTest::newRow("and others") << QStringLiteral("Smith, John and others") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("John"), QStringLiteral("Smith"))) << QSharedPointer<PlainText>(new PlainText(QStringLiteral("others"))));
+    QTest::newRow("Superfluous and") << QStringLiteral("and Smith, John and and Doe, Jane") << (Value() << QSharedPointer<Person>(new Person(QStringLiteral("John"), QStringLiteral("Smith"))) << QSharedPointer<Person>(new Person(QStringLiteral("Jane"), QStringLiteral("Doe"))));
+}
+
+void KBibTeXIOTest::fileImporterBibTeXparsePersonList()
+{
+    QFETCH(QString, text);
+    QFETCH(Value, expectedValue);
+
+    Value value;
+    FileImporterBibTeX::parsePersonList(text, value);
+    QVERIFY(value == expectedValue);
+}
+
+void KBibTeXIOTest::fileImportExportBibTeXlargeRoundtrip()
+{
+    /// Output is converted in blocks of 64 KiB; with two-byte characters in GB18030,
+    /// one of both paddings puts a character across the first block's boundary
+    static const int blockSize = 1 << 16;
+    bool characterStraddledBlocks = false;
+    for (int padding = 0; padding < 2; ++padding) {
+        const QString text {QString(padding, u'x') + QStringLiteral("BEGIN") + QString(40000, QChar(0x4E2D)) + QStringLiteral("END")};
+        File file;
+        file.setProperty(File::ProtectCasing, Qt::Unchecked);
+        QSharedPointer<Entry> entry(new Entry(Entry::etMisc, QStringLiteral("large")));
+        entry->insert(Entry::ftNote, Value() << QSharedPointer<PlainText>(new PlainText(text)));
+        file.append(entry);
+
+        FileExporterBibTeX exporter(this);
+        exporter.setEncoding(QStringLiteral("GB18030"));
+        QByteArray generatedOutput;
+        QBuffer buffer(&generatedOutput);
+        buffer.open(QBuffer::WriteOnly);
+        QVERIFY(exporter.save(&buffer, &file));
+        buffer.close();
+        QVERIFY(generatedOutput.size() > blockSize);
+        const int runStart = generatedOutput.indexOf("BEGIN") + 5;
+        QVERIFY(runStart > 5 && runStart < blockSize);
+        characterStraddledBlocks |= (blockSize - runStart) % 2 == 1;
+
+        FileImporterBibTeX importer(this);
+        buffer.open(QBuffer::ReadOnly);
+        QScopedPointer<File> importedFile(importer.load(&buffer));
+        buffer.close();
+        QVERIFY(!importedFile.isNull());
+        QCOMPARE(importedFile->count(), 1);
+        const QSharedPointer<const Entry> importedEntry {importedFile->first().dynamicCast<const Entry>()};
+        QVERIFY(!importedEntry.isNull());
+        QCOMPARE(PlainTextValue::text(importedEntry->value(Entry::ftNote)), text);
+    }
+    QVERIFY(characterStraddledBlocks);
+}
+
 void KBibTeXIOTest::protectiveCasingEntryGeneratedOnTheFly()
 {
     static const QString titleText = QStringLiteral("Some Title for a Journal Article");
@@ -1345,6 +1610,8 @@ void KBibTeXIOTest::pdfToText()
 
 void KBibTeXIOTest::initTestCase()
 {
+    /// Keep the user's settings and cached snapshots out of the tests
+    QStandardPaths::setTestModeEnabled(true);
     qRegisterMetaType<FileImporter::MessageSeverity>();
 }
 